@@ -196,20 +196,12 @@ void init_rnn_parameters (
 }
 
 
-void init_rnn_state (
+static void rnn_state_set_initial_values (
         struct rnn_state *rnn_s,
-        struct rnn_parameters *rnn_p,
-        int length,
         const double* const* input,
         const double* const* target)
 {
-    assert(length > 0);
-
-    rnn_s->rnn_p = rnn_p;
-    rnn_s->length = length;
-
-    rnn_state_alloc(rnn_s);
-
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
     for (int i = 0; i < rnn_p->c_state_size; i++) {
         //rnn_s->init_c_inter_state[i] = (2*genrand_real1()-1);
         rnn_s->init_c_inter_state[i] = 0;
@@ -238,6 +230,24 @@ void init_rnn_state (
 }
 
 
+void init_rnn_state (
+        struct rnn_state *rnn_s,
+        struct rnn_parameters *rnn_p,
+        int length,
+        const double* const* input,
+        const double* const* target)
+{
+    assert(length > 0);
+
+    rnn_s->rnn_p = rnn_p;
+    rnn_s->length = length;
+    rnn_s->reuse_delta = 0;
+
+    rnn_state_alloc(rnn_s);
+    rnn_state_set_initial_values(rnn_s, input, target);
+}
+
+
 void init_recurrent_neural_network (
         struct recurrent_neural_network *rnn,
         int in_state_size,
@@ -266,6 +276,332 @@ void rnn_add_target (
 }
 
 
+/*
+ * An arena of rnn_state is a single memory block that holds the row pointers
+ * of all 2-dimensional arrays followed by the elements of all arrays.
+ * rnn_state_carve is called twice: first with row == NULL and data == NULL
+ * to count the required sizes, and then with the allocated block to set the
+ * pointers of rnn_state. The offset of each array in the block is thus
+ * determined by the same sequence of calls as in rnn_state_alloc.
+ * If has_work == 0, the work arrays which hold the states of each time step
+ * (c_state, out_state, delta_c_inter, etc.), the row pointers of in_state
+ * and teach_state, and the gradients of the weights (delta_w_*) are not
+ * allocated. If has_gradient == 0, none of the gradients of the weights,
+ * the thresholds and the time constants (delta_w_*, delta_t_* and
+ * delta_tau) are allocated, whereas those of the initial states are.
+ */
+struct rnn_state_arena {
+    double **row;
+    double *data;
+    size_t row_size;
+    size_t data_size;
+    int has_work;
+    int has_gradient;
+};
+
+static double* arena_alloc (
+        struct rnn_state_arena *arena,
+        size_t n)
+{
+    double *x = (arena->data != NULL) ? arena->data + arena->data_size : NULL;
+    arena->data_size += n;
+    return x;
+}
+
+static double** arena_alloc2 (
+        struct rnn_state_arena *arena,
+        size_t m,
+        size_t n)
+{
+    double **x = (arena->row != NULL) ? arena->row + arena->row_size : NULL;
+    double *y = arena_alloc(arena, m * n);
+    if (x != NULL) {
+        for (size_t i = 0; i < m; i++) {
+            x[i] = y + i * n;
+        }
+    }
+    arena->row_size += m;
+    return x;
+}
+
+static double** arena_alloc_work (
+        struct rnn_state_arena *arena,
+        size_t m,
+        size_t n)
+{
+    return arena->has_work ? arena_alloc2(arena, m, n) : NULL;
+}
+
+static double** arena_alloc_view (
+        struct rnn_state_arena *arena,
+        size_t m,
+        const double* const* view)
+{
+    double **x = (arena->row != NULL) ? arena->row + arena->row_size : NULL;
+    if (x != NULL) {
+        for (size_t i = 0; i < m; i++) {
+            x[i] = (double*)view[i];
+        }
+    }
+    arena->row_size += m;
+    return x;
+}
+
+static void rnn_state_carve (
+        struct rnn_state *rnn_s,
+        struct rnn_state_arena *arena,
+        const double* const* in_view,
+        const double* const* teach_view)
+{
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+    const int in_state_size = rnn_p->in_state_size;
+    const int c_state_size = rnn_p->c_state_size;
+    const int out_state_size = rnn_p->out_state_size;
+    const int rep_init_size = rnn_p->rep_init_size;
+    const int length = rnn_s->length;
+
+    rnn_s->init_c_inter_state = arena_alloc(arena, c_state_size);
+    rnn_s->init_c_state = arena_alloc(arena, c_state_size);
+    rnn_s->delta_init_c_inter_state = arena_alloc(arena, c_state_size);
+    rnn_s->gate_init_c = arena_alloc(arena, rep_init_size);
+    rnn_s->beta_init_c = arena_alloc(arena, rep_init_size);
+    rnn_s->delta_beta_init_c = arena_alloc(arena, rep_init_size);
+
+    rnn_s->in_data = NULL;
+    rnn_s->teach_data = NULL;
+    if (!arena->has_work) {
+        rnn_s->in_state = NULL;
+    } else if (in_view != NULL) {
+        rnn_s->in_state = arena_alloc_view(arena, length, in_view);
+    } else {
+        rnn_s->in_state = arena_alloc2(arena, length, in_state_size);
+    }
+    rnn_s->c_state = arena_alloc_work(arena, length, c_state_size);
+    rnn_s->out_state = arena_alloc_work(arena, length, out_state_size);
+    rnn_s->var_state = arena_alloc_work(arena, length, out_state_size);
+    if (!arena->has_work) {
+        rnn_s->teach_state = NULL;
+    } else if (teach_view != NULL) {
+        rnn_s->teach_state = arena_alloc_view(arena, length, teach_view);
+    } else {
+        rnn_s->teach_state = arena_alloc2(arena, length, out_state_size);
+    }
+    rnn_s->c_inputsum = arena_alloc_work(arena, length, c_state_size);
+    rnn_s->c_inter_state = arena_alloc_work(arena, length, c_state_size);
+    rnn_s->o_inter_state = arena_alloc_work(arena, length, out_state_size);
+    rnn_s->v_inter_state = arena_alloc_work(arena, length, out_state_size);
+    rnn_s->likelihood = arena_alloc_work(arena, length, out_state_size);
+    rnn_s->delta_likelihood = arena_alloc_work(arena, length, out_state_size);
+    rnn_s->delta_c_inter = arena_alloc_work(arena, length, c_state_size);
+    rnn_s->delta_o_inter = arena_alloc_work(arena, length, out_state_size);
+    rnn_s->delta_v_inter = arena_alloc_work(arena, length, out_state_size);
+
+    if (arena->has_gradient) {
+        rnn_s->delta_w_ci = arena_alloc_work(arena, c_state_size,
+                in_state_size);
+        rnn_s->delta_w_cc = arena_alloc_work(arena, c_state_size,
+                c_state_size);
+        rnn_s->delta_w_oc = arena_alloc_work(arena, out_state_size,
+                c_state_size);
+        rnn_s->delta_w_vc = arena_alloc_work(arena, out_state_size,
+                c_state_size);
+        rnn_s->delta_t_c = arena_alloc(arena, c_state_size);
+        rnn_s->delta_t_o = arena_alloc(arena, out_state_size);
+        rnn_s->delta_t_v = arena_alloc(arena, out_state_size);
+        rnn_s->delta_tau = arena_alloc(arena, c_state_size);
+    } else {
+        rnn_s->delta_w_ci = NULL;
+        rnn_s->delta_w_cc = NULL;
+        rnn_s->delta_w_oc = NULL;
+        rnn_s->delta_w_vc = NULL;
+        rnn_s->delta_t_c = NULL;
+        rnn_s->delta_t_o = NULL;
+        rnn_s->delta_t_v = NULL;
+        rnn_s->delta_tau = NULL;
+    }
+    rnn_s->delta_i = arena_alloc(arena, c_state_size);
+    rnn_s->delta_b = arena_alloc(arena, rep_init_size);
+#ifdef ENABLE_ADAPTIVE_LEARNING_RATE
+    rnn_s->tmp_init_c_inter_state = arena_alloc(arena, c_state_size);
+    rnn_s->tmp_init_c_state = arena_alloc(arena, c_state_size);
+    rnn_s->tmp_gate_init_c = arena_alloc(arena, rep_init_size);
+    rnn_s->tmp_beta_init_c = arena_alloc(arena, rep_init_size);
+#endif
+}
+
+
+static void rnn_add_packed_targets (
+        struct recurrent_neural_network *rnn,
+        int num,
+        const int *length,
+        const double* const* const* input,
+        const double* const* const* target,
+        int is_view,
+        int has_work,
+        int has_gradient)
+{
+    if (num <= 0) {
+        return;
+    }
+    const int offset = rnn->series_num;
+    rnn->series_num += num;
+    REALLOC(rnn->rnn_s, rnn->series_num);
+
+    // the views are read from input and target directly, since the number
+    // of series may be too large for arrays on the stack
+    const double* const* const* in_view = is_view ? input : NULL;
+    const double* const* const* teach_view = is_view ? target : NULL;
+
+    struct rnn_state_arena arena = {NULL, NULL, 0, 0, has_work, has_gradient};
+    for (int i = 0; i < num; i++) {
+        struct rnn_state *rnn_s = rnn->rnn_s + offset + i;
+        assert(length[i] > 0);
+        rnn_s->rnn_p = &rnn->rnn_p;
+        rnn_s->length = length[i];
+        rnn_s->reuse_delta = 0;
+        rnn_s->packed = 1;
+        rnn_s->arena = NULL;
+        rnn_state_carve(rnn_s, &arena, (in_view != NULL) ? in_view[i] : NULL,
+                (teach_view != NULL) ? teach_view[i] : NULL);
+    }
+    // the row pointers are placed in front of the data, and the size of the
+    // former is rounded up so that the data is aligned for double.
+    size_t row_bytes = sizeof(double*) * arena.row_size;
+    row_bytes = (row_bytes + sizeof(double) - 1) / sizeof(double) *
+        sizeof(double);
+    char *block;
+    MALLOC(block, row_bytes + sizeof(double) * arena.data_size);
+    arena.row = (double**)block;
+    arena.data = (double*)(block + row_bytes);
+    arena.row_size = 0;
+    arena.data_size = 0;
+    rnn->rnn_s[offset].arena = block;
+
+    for (int i = 0; i < num; i++) {
+        struct rnn_state *rnn_s = rnn->rnn_s + offset + i;
+        rnn_state_carve(rnn_s, &arena, (in_view != NULL) ? in_view[i] : NULL,
+                (teach_view != NULL) ? teach_view[i] : NULL);
+        rnn_state_set_initial_values(rnn_s,
+                (input != NULL && !is_view) ? input[i] : NULL,
+                (target != NULL && !is_view) ? target[i] : NULL);
+    }
+}
+
+
+/*
+ * This function adds num time series to rnn at once.
+ * Unlike calling rnn_add_target num times, the array of rnn_state is
+ * reallocated only once, and all arrays of the new states are packed into a
+ * single arena in the order of the series. input (target) may be NULL, and
+ * so may each input[i] (target[i]).
+ *
+ *   @parameter  rnn        : recurrent neural network
+ *   @parameter  num        : number of time series
+ *   @parameter  length     : length[i] is the length of the i-th series
+ *   @parameter  input      : input[i] is the input of the i-th series
+ *   @parameter  target     : target[i] is the target of the i-th series
+ */
+void rnn_add_targets (
+        struct recurrent_neural_network *rnn,
+        int num,
+        const int *length,
+        const double* const* const* input,
+        const double* const* const* target)
+{
+    rnn_add_packed_targets(rnn, num, length, input, target, 0, 1, 1);
+}
+
+
+/*
+ * This function is the same as rnn_add_targets except that in_state and
+ * teach_state of the new states are not copied but refer to the rows of
+ * input[i] and target[i] (if not NULL). Hence, if input and target are
+ * shifted views of the same time series, only one copy of the series
+ * resides in memory. The caller must keep input and target unchanged until
+ * the targets are removed from rnn.
+ */
+void rnn_add_target_views (
+        struct recurrent_neural_network *rnn,
+        int num,
+        const int *length,
+        const double* const* const* input,
+        const double* const* const* target)
+{
+    rnn_add_packed_targets(rnn, num, length, input, target, 1, 1, 1);
+}
+
+
+/*
+ * This function adds a time series for an inference session (e.g.
+ * rnn_runner), which never learns the weights, the thresholds nor the time
+ * constants. The new state is packed as in rnn_add_targets but has none of
+ * their gradients (delta_w_*, delta_t_* and delta_tau), whereas the initial
+ * state can still be learned. The inputs and the targets of the series are
+ * left to the caller.
+ */
+void rnn_add_session_target (
+        struct recurrent_neural_network *rnn,
+        int length)
+{
+    rnn_add_packed_targets(rnn, 1, &length, NULL, NULL, 0, 1, 0);
+}
+
+
+/*
+ * This function adds num time series whose rows are stored contiguously:
+ * the n-th row of the input (target) of the i-th series is
+ * input[i] + n * in_state_size (target[i] + n * out_state_size). Only the
+ * initial states and the gradients of each series except those of the
+ * weights reside in rnn, and neither the work arrays of time steps
+ * (c_state, out_state, delta_c_inter, etc.), the row pointers of in_state
+ * and teach_state nor delta_w_* are allocated. They are supplied while the
+ * series is computed (see rnn_stream.h), so that rnn needs no memory per
+ * time step. The caller must keep input and target unchanged until the
+ * targets are removed from rnn. If target is NULL, the series have no
+ * teach_state.
+ */
+void rnn_add_streamed_targets (
+        struct recurrent_neural_network *rnn,
+        int num,
+        const int *length,
+        const double* const* input,
+        const double* const* target)
+{
+    const int offset = rnn->series_num;
+    rnn_add_packed_targets(rnn, num, length, NULL, NULL, 1, 0, 1);
+    for (int i = 0; i < num; i++) {
+        rnn->rnn_s[offset + i].in_data = input[i];
+        rnn->rnn_s[offset + i].teach_data = (target != NULL) ? target[i] :
+            NULL;
+    }
+}
+
+
+/*
+ * These functions return the n-th row of in_state (teach_state) of rnn_s,
+ * which may be a streamed series.
+ */
+const double* rnn_in_state_row (
+        const struct rnn_state *rnn_s,
+        int n)
+{
+    if (rnn_s->in_data != NULL) {
+        return rnn_s->in_data + (size_t)n * rnn_s->rnn_p->in_state_size;
+    }
+    return rnn_s->in_state[n];
+}
+
+const double* rnn_teach_state_row (
+        const struct rnn_state *rnn_s,
+        int n)
+{
+    if (rnn_s->teach_data != NULL) {
+        return rnn_s->teach_data + (size_t)n * rnn_s->rnn_p->out_state_size;
+    }
+    return rnn_s->teach_state[n];
+}
+
+
 void rnn_clean_target (struct recurrent_neural_network *rnn)
 {
     for (int i = 0; i < rnn->series_num; i++) {
@@ -283,6 +619,8 @@ void rnn_parameters_alloc (struct rnn_parameters *rnn_p)
     const int out_state_size = rnn_p->out_state_size;
     const int rep_init_size = rnn_p->rep_init_size;
 
+    rnn_p->mapped = 0;
+
     MALLOC(rnn_p->const_init_c, c_state_size);
     MALLOC(rnn_p->softmax_group_id, out_state_size);
 
@@ -338,12 +676,42 @@ void rnn_parameters_alloc (struct rnn_parameters *rnn_p)
 
 void free_rnn_parameters (struct rnn_parameters *rnn_p)
 {
-    FREE(rnn_p->const_init_c);
-    FREE(rnn_p->softmax_group_id);
-    FREE2(rnn_p->weight_ci);
-    FREE2(rnn_p->weight_cc);
-    FREE2(rnn_p->weight_oc);
-    FREE2(rnn_p->weight_vc);
+    if (rnn_p->mapped) {
+        rnn_p->const_init_c = NULL;
+        rnn_p->softmax_group_id = NULL;
+        FREE(rnn_p->weight_ci);
+        FREE(rnn_p->weight_cc);
+        FREE(rnn_p->weight_oc);
+        FREE(rnn_p->weight_vc);
+        rnn_p->threshold_c = NULL;
+        rnn_p->threshold_o = NULL;
+        rnn_p->threshold_v = NULL;
+        rnn_p->tau = NULL;
+        rnn_p->eta = NULL;
+        FREE(rnn_p->rep_init_c);
+        FREE(rnn_p->connection_ci);
+        FREE(rnn_p->connection_cc);
+        FREE(rnn_p->connection_oc);
+        FREE(rnn_p->connection_vc);
+        rnn_p->mapped = 0;
+    } else {
+        FREE(rnn_p->const_init_c);
+        FREE(rnn_p->softmax_group_id);
+        FREE2(rnn_p->weight_ci);
+        FREE2(rnn_p->weight_cc);
+        FREE2(rnn_p->weight_oc);
+        FREE2(rnn_p->weight_vc);
+        FREE(rnn_p->threshold_c);
+        FREE(rnn_p->threshold_o);
+        FREE(rnn_p->threshold_v);
+        FREE(rnn_p->tau);
+        FREE(rnn_p->eta);
+        FREE2(rnn_p->rep_init_c);
+        FREE2(rnn_p->connection_ci);
+        FREE2(rnn_p->connection_cc);
+        FREE2(rnn_p->connection_oc);
+        FREE2(rnn_p->connection_vc);
+    }
     FREE2(rnn_p->delta_weight_ci);
     FREE2(rnn_p->delta_weight_cc);
     FREE2(rnn_p->delta_weight_oc);
@@ -352,11 +720,6 @@ void free_rnn_parameters (struct rnn_parameters *rnn_p)
     FREE2(rnn_p->prior_weight_cc);
     FREE2(rnn_p->prior_weight_oc);
     FREE2(rnn_p->prior_weight_vc);
-    FREE(rnn_p->threshold_c);
-    FREE(rnn_p->threshold_o);
-    FREE(rnn_p->threshold_v);
-    FREE(rnn_p->tau);
-    FREE(rnn_p->eta);
     FREE(rnn_p->delta_threshold_c);
     FREE(rnn_p->delta_threshold_o);
     FREE(rnn_p->delta_threshold_v);
@@ -365,13 +728,8 @@ void free_rnn_parameters (struct rnn_parameters *rnn_p)
     FREE(rnn_p->prior_threshold_o);
     FREE(rnn_p->prior_threshold_v);
     FREE(rnn_p->prior_tau);
-    FREE2(rnn_p->rep_init_c);
     FREE2(rnn_p->delta_rep_init_c);
     FREE2(rnn_p->prior_rep_init_c);
-    FREE2(rnn_p->connection_ci);
-    FREE2(rnn_p->connection_cc);
-    FREE2(rnn_p->connection_oc);
-    FREE2(rnn_p->connection_vc);
 #ifdef ENABLE_ADAPTIVE_LEARNING_RATE
     FREE(rnn_p->tmp_weight_ci);
     FREE(rnn_p->tmp_weight_cc);
@@ -397,6 +755,11 @@ void rnn_state_alloc (struct rnn_state *rnn_s)
     const int rep_init_size = rnn_p->rep_init_size;
     const int length = rnn_s->length;
 
+    rnn_s->packed = 0;
+    rnn_s->in_data = NULL;
+    rnn_s->teach_data = NULL;
+    rnn_s->arena = NULL;
+
     MALLOC(rnn_s->init_c_inter_state, c_state_size);
     MALLOC(rnn_s->init_c_state, c_state_size);
     MALLOC(rnn_s->delta_init_c_inter_state, c_state_size);
@@ -440,6 +803,10 @@ void rnn_state_alloc (struct rnn_state *rnn_s)
 
 void free_rnn_state (struct rnn_state *rnn_s)
 {
+    if (rnn_s->packed) {
+        FREE(rnn_s->arena);
+        return;
+    }
     FREE(rnn_s->init_c_inter_state);
     FREE(rnn_s->init_c_state);
     FREE(rnn_s->delta_init_c_inter_state);
@@ -486,6 +853,45 @@ void free_recurrent_neural_network (struct recurrent_neural_network *rnn)
 }
 
 
+/*
+ * This function initializes a mini-batch of a recurrent neural network.
+ * The mini-batch shares the model parameters and the states of the series
+ * index[0], ..., index[batch_size-1] with rnn, so that learning of the
+ * mini-batch updates rnn. Since the prior distribution is applied once per
+ * update, prior_strength is scaled by the ratio of the mini-batch length to
+ * the total length of rnn.
+ *
+ *   @parameter  batch      : mini-batch
+ *   @parameter  rnn        : recurrent neural network
+ *   @parameter  batch_size : number of series in the mini-batch
+ *   @parameter  index      : indices of the series in the mini-batch
+ */
+void init_rnn_batch (
+        struct recurrent_neural_network *batch,
+        const struct recurrent_neural_network *rnn,
+        int batch_size,
+        const int *index)
+{
+    assert(batch_size > 0 && batch_size <= rnn->series_num);
+    batch->series_num = batch_size;
+    batch->rnn_p = rnn->rnn_p;
+    MALLOC(batch->rnn_s, batch_size);
+    for (int i = 0; i < batch_size; i++) {
+        assert(0 <= index[i] && index[i] < rnn->series_num);
+        batch->rnn_s[i] = rnn->rnn_s[index[i]];
+    }
+    batch->rnn_p.prior_strength *= (double)rnn_get_total_length(batch) /
+        rnn_get_total_length(rnn);
+}
+
+
+void free_rnn_batch (struct recurrent_neural_network *batch)
+{
+    FREE(batch->rnn_s);
+    batch->series_num = 0;
+}
+
+
 /******************************************************************************/
 /********** File IO ***********************************************************/
 /******************************************************************************/
@@ -656,8 +1062,8 @@ void fwrite_rnn_state (
     FWRITE(rnn_s->beta_init_c, rnn_p->rep_init_size, fp);
     FWRITE(rnn_s->delta_beta_init_c, rnn_p->rep_init_size, fp);
     for (int n = 0; n < rnn_s->length; n++) {
-        FWRITE(rnn_s->in_state[n], rnn_p->in_state_size, fp);
-        FWRITE(rnn_s->teach_state[n], rnn_p->out_state_size, fp);
+        FWRITE(rnn_in_state_row(rnn_s, n), rnn_p->in_state_size, fp);
+        FWRITE(rnn_teach_state_row(rnn_s, n), rnn_p->out_state_size, fp);
     }
 }
 
@@ -669,6 +1075,7 @@ void fread_rnn_state (
 {
     const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
     FREAD(&rnn_s->length, 1, fp);
+    rnn_s->reuse_delta = 0;
 
     rnn_state_alloc(rnn_s);
 
@@ -1046,6 +1453,74 @@ double rnn_get_total_likelihood (const struct recurrent_neural_network *rnn)
     return total_likelihood;
 }
 
+/*
+ * This function returns the logarithm of the prior density (up to a
+ * constant) from which rnn_update_delta_parameters adds its prior terms:
+ * the Gaussian prior of prior_strength on the weights, the thresholds, tau
+ * and rep_init_c, and the mixture of Gaussians centered on rep_init_c on the
+ * initial states. The sum of rnn_get_total_likelihood and this value is the
+ * objective whose gradient is computed by rnn_update_delta_parameters.
+ */
+double rnn_get_log_prior (const struct recurrent_neural_network *rnn)
+{
+    const struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    double sum = 0, d;
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        foreach (j, rnn_p->connection_ci[i]) {
+            d = rnn_p->weight_ci[i][j] - rnn_p->prior_weight_ci[i][j];
+            sum += d * d;
+        }
+        foreach (j, rnn_p->connection_cc[i]) {
+            d = rnn_p->weight_cc[i][j] - rnn_p->prior_weight_cc[i][j];
+            sum += d * d;
+        }
+        d = rnn_p->threshold_c[i] - rnn_p->prior_threshold_c[i];
+        sum += d * d;
+        if (isfinite(rnn_p->tau[i])) {
+            d = rnn_p->tau[i] - rnn_p->prior_tau[i];
+            sum += d * d;
+        }
+    }
+    for (int i = 0; i < rnn_p->out_state_size; i++) {
+        foreach (j, rnn_p->connection_oc[i]) {
+            d = rnn_p->weight_oc[i][j] - rnn_p->prior_weight_oc[i][j];
+            sum += d * d;
+        }
+        foreach (j, rnn_p->connection_vc[i]) {
+            d = rnn_p->weight_vc[i][j] - rnn_p->prior_weight_vc[i][j];
+            sum += d * d;
+        }
+        d = rnn_p->threshold_o[i] - rnn_p->prior_threshold_o[i];
+        sum += d * d;
+        d = rnn_p->threshold_v[i] - rnn_p->prior_threshold_v[i];
+        sum += d * d;
+    }
+    for (int i = 0; i < rnn_p->rep_init_size; i++) {
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            d = rnn_p->rep_init_c[i][j] - rnn_p->prior_rep_init_c[i][j];
+            sum += d * d;
+        }
+    }
+    double log_prior = -0.5 * rnn_p->prior_strength * sum;
+
+    for (int k = 0; k < rnn->series_num; k++) {
+        const struct rnn_state *rnn_s = rnn->rnn_s + k;
+        double p = 0;
+        for (int i = 0; i < rnn_p->rep_init_size; i++) {
+            sum = 0;
+            for (int j = 0; j < rnn_p->c_state_size; j++) {
+                d = rnn_s->init_c_inter_state[j] - rnn_p->rep_init_c[i][j];
+                sum += d * d;
+            }
+            // the same density as delta_b of rnn_set_delta_b
+            p += rnn_s->gate_init_c[i] *
+                (exp((-sum) / (2 * rnn_p->rep_init_variance)) + DBL_MIN);
+        }
+        log_prior += log(p);
+    }
+    return log_prior;
+}
+
 
 static inline double fmap (
         const struct connection_domain * const restrict connection,
@@ -1100,21 +1575,14 @@ static void forward_output_map_for_standard (
     }
 }
 
-static void forward_output_map_for_softmax (
+static void normalize_softmax (
         const struct rnn_parameters *rnn_p,
-        const double *c_state,
-        double *o_inter_state,
         double *out_state)
 {
     const int out_state_size = rnn_p->out_state_size;
     const int softmax_group_num = rnn_p->softmax_group_num;
     double sum[softmax_group_num];
 
-    for (int i = 0; i < out_state_size; i++) {
-        o_inter_state[i] = fmap(rnn_p->connection_oc[i], rnn_p->weight_oc[i],
-                c_state, rnn_p->threshold_o[i]);
-        out_state[i] = exp(o_inter_state[i]);
-    }
     for (int c = 0; c < softmax_group_num; c++) {
         sum[c] = 0;
     }
@@ -1126,6 +1594,22 @@ static void forward_output_map_for_softmax (
     }
 }
 
+static void forward_output_map_for_softmax (
+        const struct rnn_parameters *rnn_p,
+        const double *c_state,
+        double *o_inter_state,
+        double *out_state)
+{
+    const int out_state_size = rnn_p->out_state_size;
+
+    for (int i = 0; i < out_state_size; i++) {
+        o_inter_state[i] = fmap(rnn_p->connection_oc[i], rnn_p->weight_oc[i],
+                c_state, rnn_p->threshold_o[i]);
+        out_state[i] = exp(o_inter_state[i]);
+    }
+    normalize_softmax(rnn_p, out_state);
+}
+
 void rnn_forward_output_map (
         const struct rnn_parameters *rnn_p,
         const double *c_state,
@@ -1165,6 +1649,205 @@ void rnn_forward_map (
 }
 
 
+/*
+ * The states of a batch are transposed into panels of BATCH_PANEL_WIDTH
+ * states: the j-th element of the r-th state of the p-th panel is
+ * x[(p*size+j)*BATCH_PANEL_WIDTH+r], where size is the dimension of the
+ * states. The last panel is padded with zeros.
+ */
+#define BATCH_PANEL_WIDTH 8
+
+static int batch_panel_num (int num)
+{
+    return (num + BATCH_PANEL_WIDTH - 1) / BATCH_PANEL_WIDTH;
+}
+
+static void transpose_states (
+        double **state,
+        int size,
+        int num,
+        double *x)
+{
+    for (int k = 0; k < batch_panel_num(num) * BATCH_PANEL_WIDTH; k++) {
+        const int p = k / BATCH_PANEL_WIDTH, r = k % BATCH_PANEL_WIDTH;
+        for (int j = 0; j < size; j++) {
+            x[(p * size + j) * BATCH_PANEL_WIDTH + r] = (k < num) ?
+                state[k][j] : 0;
+        }
+    }
+}
+
+/*
+ * This function adds the products of the weights of a unit and the states
+ * of a panel to sum[0], ..., sum[BATCH_PANEL_WIDTH-1]. Each weight is loaded
+ * once for the states of the panel, and the sums are kept in registers. The
+ * terms are added in the same order as fmap.
+ */
+static inline void fmap_panel (
+        const struct connection_domain * const restrict connection,
+        const double * const restrict weight,
+        const double * const restrict x,
+        double * const restrict sum)
+{
+    double s0 = sum[0], s1 = sum[1], s2 = sum[2], s3 = sum[3];
+    double s4 = sum[4], s5 = sum[5], s6 = sum[6], s7 = sum[7];
+    foreach (j, connection) {
+        const double w = weight[j];
+        const double *xj = x + j * BATCH_PANEL_WIDTH;
+        s0 += w * xj[0];
+        s1 += w * xj[1];
+        s2 += w * xj[2];
+        s3 += w * xj[3];
+        s4 += w * xj[4];
+        s5 += w * xj[5];
+        s6 += w * xj[6];
+        s7 += w * xj[7];
+    }
+    sum[0] = s0;
+    sum[1] = s1;
+    sum[2] = s2;
+    sum[3] = s3;
+    sum[4] = s4;
+    sum[5] = s5;
+    sum[6] = s6;
+    sum[7] = s7;
+}
+
+static void fmap_batch (
+        const struct connection_domain *connection,
+        const double *weight,
+        const double *x,
+        int size,
+        int num,
+        double *sum)
+{
+    for (int p = 0; p < batch_panel_num(num); p++) {
+        fmap_panel(connection, weight, x + p * size * BATCH_PANEL_WIDTH,
+                sum + p * BATCH_PANEL_WIDTH);
+    }
+}
+
+void init_rnn_batch_buffer (
+        struct rnn_batch_buffer *buffer,
+        int max_num,
+        int in_state_size,
+        int c_state_size)
+{
+    const int width = batch_panel_num(max_num) * BATCH_PANEL_WIDTH;
+    buffer->max_num = max_num;
+    buffer->in_state_size = in_state_size;
+    buffer->c_state_size = c_state_size;
+    MALLOC(buffer->state, max_num);
+    MALLOC(buffer->x_in, in_state_size * width);
+    MALLOC(buffer->x_c, c_state_size * width);
+    MALLOC(buffer->sum, width);
+}
+
+void free_rnn_batch_buffer (struct rnn_batch_buffer *buffer)
+{
+    FREE(buffer->state);
+    FREE(buffer->x_in);
+    FREE(buffer->x_c);
+    FREE(buffer->sum);
+}
+
+/*
+ * This function computes the first step of the forward dynamics (see
+ * rnn_forward_dynamics) of num states sharing rnn_p at once, that is,
+ * rnn_forward_map from in_state[0], init_c_inter_state and init_c_state to
+ * row 0 of the states. The products of the weights and the states are
+ * computed as products of the weight matrices and the matrices whose columns
+ * are the states, so that the weights are read once for all the states.
+ * The results are the same as those of rnn_forward_map.
+ * The work arrays are taken from buffer, which has to be large enough for
+ * the batch (see init_rnn_batch_buffer).
+ */
+void rnn_forward_map_batch (
+        const struct rnn_parameters *rnn_p,
+        struct rnn_state **rnn_s,
+        int num,
+        struct rnn_batch_buffer *buffer)
+{
+    const int in_state_size = rnn_p->in_state_size;
+    const int c_state_size = rnn_p->c_state_size;
+    const int out_state_size = rnn_p->out_state_size;
+    const int width = batch_panel_num(num) * BATCH_PANEL_WIDTH;
+    double **state = buffer->state;
+    double *x_in = buffer->x_in;
+    double *x_c = buffer->x_c;
+    double *sum = buffer->sum;
+
+    if (num <= 0) return;
+    assert(num <= buffer->max_num);
+    assert(in_state_size <= buffer->in_state_size);
+    assert(c_state_size <= buffer->c_state_size);
+
+    for (int k = 0; k < num; k++) {
+        state[k] = rnn_s[k]->in_state[0];
+    }
+    transpose_states(state, in_state_size, num, x_in);
+    for (int k = 0; k < num; k++) {
+        state[k] = rnn_s[k]->init_c_state;
+    }
+    transpose_states(state, c_state_size, num, x_c);
+
+    for (int i = 0; i < c_state_size; i++) {
+        for (int k = 0; k < width; k++) {
+            sum[k] = rnn_p->threshold_c[i];
+        }
+        fmap_batch(rnn_p->connection_ci[i], rnn_p->weight_ci[i], x_in,
+                in_state_size, num, sum);
+        fmap_batch(rnn_p->connection_cc[i], rnn_p->weight_cc[i], x_c,
+                c_state_size, num, sum);
+        for (int k = 0; k < num; k++) {
+            struct rnn_state *s = rnn_s[k];
+            s->c_inputsum[0][i] = sum[k];
+            s->c_inter_state[0][i] = (1 - rnn_p->eta[i]) *
+                s->init_c_inter_state[i] + rnn_p->eta[i] * sum[k];
+            s->c_state[0][i] = tanh(s->c_inter_state[0][i]);
+        }
+    }
+
+    for (int k = 0; k < num; k++) {
+        state[k] = rnn_s[k]->c_state[0];
+    }
+    transpose_states(state, c_state_size, num, x_c);
+
+    for (int i = 0; i < out_state_size; i++) {
+        for (int k = 0; k < width; k++) {
+            sum[k] = rnn_p->threshold_o[i];
+        }
+        fmap_batch(rnn_p->connection_oc[i], rnn_p->weight_oc[i], x_c,
+                c_state_size, num, sum);
+        for (int k = 0; k < num; k++) {
+            rnn_s[k]->o_inter_state[0][i] = sum[k];
+        }
+        if (rnn_p->output_type == STANDARD_TYPE) {
+            for (int k = 0; k < width; k++) {
+                sum[k] = rnn_p->threshold_v[i];
+            }
+            fmap_batch(rnn_p->connection_vc[i], rnn_p->weight_vc[i], x_c,
+                    c_state_size, num, sum);
+            for (int k = 0; k < num; k++) {
+                struct rnn_state *s = rnn_s[k];
+                s->v_inter_state[0][i] = sum[k];
+                s->out_state[0][i] = tanh(s->o_inter_state[0][i]);
+                s->var_state[0][i] = exp(s->v_inter_state[0][i]);
+            }
+        } else if (rnn_p->output_type == SOFTMAX_TYPE) {
+            for (int k = 0; k < num; k++) {
+                rnn_s[k]->out_state[0][i] = exp(rnn_s[k]->o_inter_state[0][i]);
+            }
+        }
+    }
+    if (rnn_p->output_type == SOFTMAX_TYPE) {
+        for (int k = 0; k < num; k++) {
+            normalize_softmax(rnn_p, rnn_s[k]->out_state[0]);
+        }
+    }
+}
+
+
 void rnn_forward_dynamics (struct rnn_state *rnn_s)
 {
     const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
@@ -1439,10 +2122,12 @@ void rnn_forward_backward_dynamics (struct rnn_state *rnn_s)
 void rnn_forward_backward_dynamics_forall (struct recurrent_neural_network *rnn)
 {
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic)
 #endif
     for (int i = 0; i < rnn->series_num; i++) {
-        rnn_forward_backward_dynamics(rnn->rnn_s + i);
+        if (!rnn->rnn_s[i].reuse_delta) {
+            rnn_forward_backward_dynamics(rnn->rnn_s + i);
+        }
     }
 }
 
@@ -1549,10 +2234,49 @@ void rnn_set_delta_tau (struct rnn_state *rnn_s)
     }
 }
 
+/*
+ * This function sets the attraction of the initial state towards the mean of
+ * the internal states of rnn_s, which rnn_set_delta_i adds to delta_i if
+ * ENABLE_ATTRACTION_OF_INIT_C is defined. The attraction is a heuristic, and
+ * is not the gradient of the likelihood.
+ *
+ *   @parameter  rnn_s      : state of the recurrent neural network
+ *   @parameter  attraction : attraction of each initial state
+ */
+void rnn_get_attraction_of_init_c (
+        const struct rnn_state *rnn_s,
+        double *attraction)
+{
+    const int length = rnn_s->length;
+    for (int i = 0; i < rnn_s->rnn_p->c_state_size; i++) {
+        double mean, var;
+        mean = rnn_s->init_c_inter_state[i];
+        for (int n = 0; n < length; n++) {
+            mean += rnn_s->c_inter_state[n][i];
+        }
+        mean /= length + 1;
+        double d = mean - rnn_s->init_c_inter_state[i];
+        var = d * d;
+        for (int n = 0; n < length; n++) {
+            d = mean - rnn_s->c_inter_state[n][i];
+            var += d * d;
+        }
+        var /= length + 1;
+        if (var < MIN_VARIANCE) {
+            var = MIN_VARIANCE;
+        }
+        attraction[i] = (mean - rnn_s->init_c_inter_state[i]) / var;
+    }
+}
+
 void rnn_set_delta_i (struct rnn_state *rnn_s)
 {
     const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
     const int c_state_size = rnn_p->c_state_size;
+#ifdef ENABLE_ATTRACTION_OF_INIT_C
+    double attraction[c_state_size];
+    rnn_get_attraction_of_init_c(rnn_s, attraction);
+#endif
     for (int i = 0; i < c_state_size; i++) {
         rnn_s->delta_i[i] = 0;
     }
@@ -1568,24 +2292,7 @@ void rnn_set_delta_i (struct rnn_state *rnn_s)
         rnn_s->delta_i[i] *= dtanh_c;
         rnn_s->delta_i[i] += rnn_s->delta_c_inter[0][i] * (1 - rnn_p->eta[i]);
 #ifdef ENABLE_ATTRACTION_OF_INIT_C
-        const int length = rnn_s->length;
-        double mean, var;
-        mean = rnn_s->init_c_inter_state[i];
-        for (int n = 0; n < length; n++) {
-            mean += rnn_s->c_inter_state[n][i];
-        }
-        mean /= length + 1;
-        double d = mean - rnn_s->init_c_inter_state[i];
-        var = d * d;
-        for (int n = 0; n < length; n++) {
-            d = mean - rnn_s->c_inter_state[n][i];
-            var += d * d;
-        }
-        var /= length + 1;
-        if (var < MIN_VARIANCE) {
-            var = MIN_VARIANCE;
-        }
-        rnn_s->delta_i[i] += (mean - rnn_s->init_c_inter_state[i]) / var;
+        rnn_s->delta_i[i] += attraction[i];
 #endif
     }
 }
@@ -1886,6 +2593,31 @@ void rnn_update_init_c_inter_state (
 }
 
 
+/*
+ * This function sets the initial state of rnn_s to the internal state of
+ * prev_s at time step n, so that rnn_s continues the trajectory of prev_s.
+ * It is used to tie consecutive chunks of a long time series together.
+ *
+ *   @parameter  rnn_s  : state whose initial state is replaced
+ *   @parameter  prev_s : preceding state
+ *   @parameter  n      : time step of prev_s
+ */
+void rnn_connect_init_c_inter_state (
+        struct rnn_state *rnn_s,
+        const struct rnn_state *prev_s,
+        int n)
+{
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+    assert(0 <= n && n < prev_s->length);
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        if (!rnn_p->const_init_c[i]) {
+            rnn_s->init_c_inter_state[i] = prev_s->c_inter_state[n][i];
+            rnn_s->init_c_state[i] = prev_s->c_state[n][i];
+        }
+    }
+}
+
+
 void rnn_update_delta_parameters (
         struct recurrent_neural_network *rnn,
         double momentum)
@@ -1977,6 +2709,194 @@ void rnn_learn_s (
 }
 
 
+
+/*
+ * This function computes learning of a recurrent neural network
+ * asynchronously in the manner of Hogwild!. Each series is learned by
+ * rnn_learn_s as a mini-batch of its own, and the threads update the shared
+ * parameters and momentum terms without any lock or reduction. Since each
+ * update touches all of the parameters, a thread may read parameters which
+ * are partially updated by another thread. These races are tolerated on
+ * purpose: they only add a small noise to the stochastic gradient.
+ *
+ *   @parameter  rnn        : recurrent neural network
+ *   @parameter  rho        : learning rate
+ *   @parameter  momentum   : momentum of learning
+ */
+void rnn_learn_s_async (
+        struct recurrent_neural_network *rnn,
+        double rho,
+        double momentum)
+{
+    const double total_length = rnn_get_total_length(rnn);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < rnn->series_num; i++) {
+        struct recurrent_neural_network series = *rnn;
+        series.series_num = 1;
+        series.rnn_s = rnn->rnn_s + i;
+        series.rnn_p.prior_strength *= rnn->rnn_s[i].length / total_length;
+        rnn_learn_s(&series, rho, momentum);
+    }
+}
+
+
+/*
+ * This function copies the parameters changed by learning (weights,
+ * thresholds and time constants) from src to dst, which have the same
+ * structure.
+ */
+void rnn_copy_parameters (
+        struct rnn_parameters *dst_p,
+        const struct rnn_parameters *src_p)
+{
+    const int in_state_size = src_p->in_state_size;
+    const int c_state_size = src_p->c_state_size;
+    const int out_state_size = src_p->out_state_size;
+    const int rep_init_size = src_p->rep_init_size;
+
+    for (int i = 0; i < c_state_size; i++) {
+        memcpy(dst_p->weight_ci[i], src_p->weight_ci[i], sizeof(double) *
+                in_state_size);
+        memcpy(dst_p->weight_cc[i], src_p->weight_cc[i], sizeof(double) *
+                c_state_size);
+    }
+    for (int i = 0; i < out_state_size; i++) {
+        memcpy(dst_p->weight_oc[i], src_p->weight_oc[i], sizeof(double) *
+                c_state_size);
+        memcpy(dst_p->weight_vc[i], src_p->weight_vc[i], sizeof(double) *
+                c_state_size);
+    }
+    memcpy(dst_p->threshold_c, src_p->threshold_c, sizeof(double) *
+            c_state_size);
+    memcpy(dst_p->threshold_o, src_p->threshold_o, sizeof(double) *
+            out_state_size);
+    memcpy(dst_p->threshold_v, src_p->threshold_v, sizeof(double) *
+            out_state_size);
+    memcpy(dst_p->tau, src_p->tau, sizeof(double) * c_state_size);
+    memcpy(dst_p->eta, src_p->eta, sizeof(double) * c_state_size);
+    for (int i = 0; i < rep_init_size; i++) {
+        memcpy(dst_p->rep_init_c[i], src_p->rep_init_c[i], sizeof(double) *
+                c_state_size);
+    }
+    dst_p->prior_strength = src_p->prior_strength;
+}
+
+/*
+ * This function allocates dst_p as a duplicate of src_p, which may refer to
+ * a mapped model file. Unlike rnn_copy_parameters, the structure, the
+ * connections and the learning states (delta_* and prior_*) are also copied.
+ */
+void rnn_duplicate_parameters (
+        struct rnn_parameters *dst_p,
+        const struct rnn_parameters *src_p)
+{
+    const int in_state_size = src_p->in_state_size;
+    const int c_state_size = src_p->c_state_size;
+    const int out_state_size = src_p->out_state_size;
+    const int rep_init_size = src_p->rep_init_size;
+
+    dst_p->in_state_size = in_state_size;
+    dst_p->c_state_size = c_state_size;
+    dst_p->out_state_size = out_state_size;
+    dst_p->rep_init_size = rep_init_size;
+    dst_p->output_type = src_p->output_type;
+    dst_p->fixed_weight = src_p->fixed_weight;
+    dst_p->fixed_threshold = src_p->fixed_threshold;
+    dst_p->fixed_tau = src_p->fixed_tau;
+    dst_p->fixed_init_c_state = src_p->fixed_init_c_state;
+    dst_p->softmax_group_num = src_p->softmax_group_num;
+    dst_p->rep_init_variance = src_p->rep_init_variance;
+
+    rnn_parameters_alloc(dst_p);
+    rnn_copy_parameters(dst_p, src_p);
+
+    memcpy(dst_p->const_init_c, src_p->const_init_c, sizeof(int) *
+            c_state_size);
+    memcpy(dst_p->softmax_group_id, src_p->softmax_group_id, sizeof(int) *
+            out_state_size);
+    for (int i = 0; i < c_state_size; i++) {
+        memcpy(dst_p->delta_weight_ci[i], src_p->delta_weight_ci[i],
+                sizeof(double) * in_state_size);
+        memcpy(dst_p->delta_weight_cc[i], src_p->delta_weight_cc[i],
+                sizeof(double) * c_state_size);
+        memcpy(dst_p->prior_weight_ci[i], src_p->prior_weight_ci[i],
+                sizeof(double) * in_state_size);
+        memcpy(dst_p->prior_weight_cc[i], src_p->prior_weight_cc[i],
+                sizeof(double) * c_state_size);
+        memcpy(dst_p->connection_ci[i], src_p->connection_ci[i],
+                sizeof(struct connection_domain) * (in_state_size + 1));
+        memcpy(dst_p->connection_cc[i], src_p->connection_cc[i],
+                sizeof(struct connection_domain) * (c_state_size + 1));
+    }
+    for (int i = 0; i < out_state_size; i++) {
+        memcpy(dst_p->delta_weight_oc[i], src_p->delta_weight_oc[i],
+                sizeof(double) * c_state_size);
+        memcpy(dst_p->delta_weight_vc[i], src_p->delta_weight_vc[i],
+                sizeof(double) * c_state_size);
+        memcpy(dst_p->prior_weight_oc[i], src_p->prior_weight_oc[i],
+                sizeof(double) * c_state_size);
+        memcpy(dst_p->prior_weight_vc[i], src_p->prior_weight_vc[i],
+                sizeof(double) * c_state_size);
+        memcpy(dst_p->connection_oc[i], src_p->connection_oc[i],
+                sizeof(struct connection_domain) * (c_state_size + 1));
+        memcpy(dst_p->connection_vc[i], src_p->connection_vc[i],
+                sizeof(struct connection_domain) * (c_state_size + 1));
+    }
+    memcpy(dst_p->delta_threshold_c, src_p->delta_threshold_c,
+            sizeof(double) * c_state_size);
+    memcpy(dst_p->delta_threshold_o, src_p->delta_threshold_o,
+            sizeof(double) * out_state_size);
+    memcpy(dst_p->delta_threshold_v, src_p->delta_threshold_v,
+            sizeof(double) * out_state_size);
+    memcpy(dst_p->delta_tau, src_p->delta_tau, sizeof(double) *
+            c_state_size);
+    memcpy(dst_p->prior_threshold_c, src_p->prior_threshold_c,
+            sizeof(double) * c_state_size);
+    memcpy(dst_p->prior_threshold_o, src_p->prior_threshold_o,
+            sizeof(double) * out_state_size);
+    memcpy(dst_p->prior_threshold_v, src_p->prior_threshold_v,
+            sizeof(double) * out_state_size);
+    memcpy(dst_p->prior_tau, src_p->prior_tau, sizeof(double) *
+            c_state_size);
+    for (int i = 0; i < rep_init_size; i++) {
+        memcpy(dst_p->delta_rep_init_c[i], src_p->delta_rep_init_c[i],
+                sizeof(double) * c_state_size);
+        memcpy(dst_p->prior_rep_init_c[i], src_p->prior_rep_init_c[i],
+                sizeof(double) * c_state_size);
+    }
+}
+
+/*
+ * This function copies the parameters changed by learning and the initial
+ * states of the series from src to dst, which have the same structure and
+ * series.
+ */
+void rnn_copy_learning_parameters (
+        struct recurrent_neural_network *dst,
+        const struct recurrent_neural_network *src)
+{
+    const int c_state_size = src->rnn_p.c_state_size;
+    const int rep_init_size = src->rnn_p.rep_init_size;
+
+    assert(dst->series_num == src->series_num);
+    rnn_copy_parameters(&dst->rnn_p, &src->rnn_p);
+    for (int i = 0; i < src->series_num; i++) {
+        struct rnn_state *dst_s = dst->rnn_s + i;
+        const struct rnn_state *src_s = src->rnn_s + i;
+        memcpy(dst_s->init_c_inter_state, src_s->init_c_inter_state,
+                sizeof(double) * c_state_size);
+        memcpy(dst_s->init_c_state, src_s->init_c_state,
+                sizeof(double) * c_state_size);
+        memcpy(dst_s->gate_init_c, src_s->gate_init_c, sizeof(double) *
+                rep_init_size);
+        memcpy(dst_s->beta_init_c, src_s->beta_init_c, sizeof(double) *
+                rep_init_size);
+    }
+}
+
+
 #ifdef ENABLE_ADAPTIVE_LEARNING_RATE
 
 void rnn_backup_learning_parameters (struct recurrent_neural_network *rnn)
@@ -102,6 +102,15 @@ typedef struct rnn_parameters {
     struct connection_domain **connection_oc;
     struct connection_domain **connection_vc;
 
+    /*
+     * If mapped != 0, const_init_c, softmax_group_id, weight_*, threshold_*,
+     * tau, eta, rep_init_c and connection_* refer to a mapped model file
+     * (see rnn_file.h), and only the row pointers of them are owned by
+     * rnn_parameters. The mapping is read-only, so that these arrays must
+     * not be modified.
+     */
+    int mapped;
+
 #ifdef ENABLE_ADAPTIVE_LEARNING_RATE
     double *tmp_weight_ci;
     double *tmp_weight_cc;
@@ -120,6 +129,33 @@ typedef struct rnn_state {
     struct rnn_parameters *rnn_p;
     int length;
 
+    /*
+     * If reuse_delta != 0, rnn_forward_backward_dynamics_forall skips this
+     * state, and its last gradient (delta_*) is reused in learning.
+     */
+    int reuse_delta;
+
+    /*
+     * If packed != 0, the arrays of this state are carved out of an arena
+     * shared by all series added in one call of rnn_add_targets. The arena
+     * is owned by the first of them (arena != NULL) and is released
+     * together with that state. The series added by rnn_add_target_views
+     * are also packed, but their in_state and teach_state refer to memory
+     * owned by the caller. Those added by rnn_add_session_target have no
+     * gradients of the weights, the thresholds and the time constants
+     * (delta_w_*, delta_t_* and delta_tau), which are NULL. Those added by
+     * rnn_add_streamed_targets have neither the work arrays of time steps
+     * (c_state, etc.), the row pointers of in_state and teach_state nor the
+     * gradients of the weights (delta_w_*), which are NULL except while the
+     * series is computed (see rnn_stream.h). The rows of such a series are
+     * stored contiguously from in_data and teach_data, which are NULL for
+     * the other series (see rnn_in_state_row and rnn_teach_state_row).
+     */
+    int packed;
+    void *arena;
+    const double *in_data;
+    const double *teach_data;
+
     double *init_c_inter_state;
     double *init_c_state;
     double *delta_init_c_inter_state;
@@ -171,6 +207,22 @@ typedef struct recurrent_neural_network {
 } recurrent_neural_network;
 
 
+/*
+ * rnn_batch_buffer holds the work arrays of rnn_forward_map_batch for
+ * batches of up to max_num states whose dimensions are up to in_state_size
+ * and c_state_size, so that they are allocated once for many batches.
+ */
+typedef struct rnn_batch_buffer {
+    int max_num;
+    int in_state_size;
+    int c_state_size;
+    double **state;
+    double *x_in;
+    double *x_c;
+    double *sum;
+} rnn_batch_buffer;
+
+
 void init_rnn_parameters (
         struct rnn_parameters *rnn_p,
         int in_state_size,
@@ -198,8 +250,49 @@ void rnn_add_target (
         const double* const* input,
         const double* const* target);
 
+void rnn_add_targets (
+        struct recurrent_neural_network *rnn,
+        int num,
+        const int *length,
+        const double* const* const* input,
+        const double* const* const* target);
+
+void rnn_add_target_views (
+        struct recurrent_neural_network *rnn,
+        int num,
+        const int *length,
+        const double* const* const* input,
+        const double* const* const* target);
+
+void rnn_add_session_target (
+        struct recurrent_neural_network *rnn,
+        int length);
+
+void rnn_add_streamed_targets (
+        struct recurrent_neural_network *rnn,
+        int num,
+        const int *length,
+        const double* const* input,
+        const double* const* target);
+
+const double* rnn_in_state_row (
+        const struct rnn_state *rnn_s,
+        int n);
+
+const double* rnn_teach_state_row (
+        const struct rnn_state *rnn_s,
+        int n);
+
 void rnn_clean_target (struct recurrent_neural_network *rnn);
 
+void init_rnn_batch (
+        struct recurrent_neural_network *batch,
+        const struct recurrent_neural_network *rnn,
+        int batch_size,
+        const int *index);
+
+void free_rnn_batch (struct recurrent_neural_network *batch);
+
 void rnn_parameters_alloc (struct rnn_parameters *rnn_p);
 void rnn_state_alloc (struct rnn_state *rnn_s);
 
@@ -280,6 +373,7 @@ double rnn_get_total_error (const struct recurrent_neural_network *rnn);
 
 double rnn_get_likelihood (const struct rnn_state *rnn_s);
 double rnn_get_total_likelihood (const struct recurrent_neural_network *rnn);
+double rnn_get_log_prior (const struct recurrent_neural_network *rnn);
 
 
 void rnn_forward_context_map (
@@ -312,6 +406,20 @@ void rnn_forward_map (
         double *v_inter_state,
         double *var_state);
 
+void init_rnn_batch_buffer (
+        struct rnn_batch_buffer *buffer,
+        int max_num,
+        int in_state_size,
+        int c_state_size);
+
+void free_rnn_batch_buffer (struct rnn_batch_buffer *buffer);
+
+void rnn_forward_map_batch (
+        const struct rnn_parameters *rnn_p,
+        struct rnn_state **rnn_s,
+        int num,
+        struct rnn_batch_buffer *buffer);
+
 void rnn_forward_dynamics (struct rnn_state *rnn_s);
 
 void rnn_forward_dynamics_in_closed_loop (
@@ -364,6 +472,10 @@ void rnn_forward_backward_dynamics_forall (
 void rnn_set_delta_w (struct rnn_state *rnn_s);
 void rnn_set_delta_t (struct rnn_state *rnn_s);
 void rnn_set_delta_tau (struct rnn_state *rnn_s);
+void rnn_get_attraction_of_init_c (
+        const struct rnn_state *rnn_s,
+        double *attraction);
+
 void rnn_set_delta_i (struct rnn_state *rnn_s);
 void rnn_set_delta_b (struct rnn_state *rnn_s);
 void rnn_set_delta_parameters (struct rnn_state *rnn_s);
@@ -409,6 +521,11 @@ void rnn_update_init_c_inter_state (
         struct rnn_state *rnn_s,
         double rho);
 
+void rnn_connect_init_c_inter_state (
+        struct rnn_state *rnn_s,
+        const struct rnn_state *prev_s,
+        int n);
+
 void rnn_update_delta_parameters (
         struct recurrent_neural_network *rnn,
         double momentum);
@@ -431,6 +548,23 @@ void rnn_learn_s (
         double rho,
         double momentum);
 
+void rnn_learn_s_async (
+        struct recurrent_neural_network *rnn,
+        double rho,
+        double momentum);
+
+void rnn_copy_parameters (
+        struct rnn_parameters *dst_p,
+        const struct rnn_parameters *src_p);
+
+void rnn_duplicate_parameters (
+        struct rnn_parameters *dst_p,
+        const struct rnn_parameters *src_p);
+
+void rnn_copy_learning_parameters (
+        struct recurrent_neural_network *dst,
+        const struct recurrent_neural_network *src);
+
 #ifdef ENABLE_ADAPTIVE_LEARNING_RATE
 
 void rnn_backup_learning_parameters (struct recurrent_neural_network *rnn);
@@ -0,0 +1,207 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "rnn_dataset.h"
+
+
+#define HEADER_SIZE (8 + 4 * sizeof(int32_t))
+
+static size_t data_offset (int num)
+{
+    size_t offset = HEADER_SIZE + num * sizeof(int32_t);
+    return (offset + RNN_DATASET_ALIGNMENT - 1) / RNN_DATASET_ALIGNMENT *
+        RNN_DATASET_ALIGNMENT;
+}
+
+
+void init_rnn_dataset (struct rnn_dataset *dataset)
+{
+    dataset->dtype = RNN_DATASET_FLOAT64;
+    dataset->dimension = 0;
+    dataset->num = 0;
+    dataset->length = NULL;
+    dataset->data = NULL;
+    dataset->map = NULL;
+    dataset->map_size = 0;
+}
+
+
+/*
+ * This function returns 1 if the file begins with RNN_DATASET_MAGIC, and
+ * returns 0 otherwise.
+ */
+int is_rnn_dataset_file (const char *filename)
+{
+    char magic[8];
+    FILE *fp;
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        return 0;
+    }
+    int is_dataset = (fread(magic, 1, 8, fp) == 8 &&
+            memcmp(magic, RNN_DATASET_MAGIC, 8) == 0);
+    fclose(fp);
+    return is_dataset;
+}
+
+
+/*
+ * This function maps a binary target file into memory read-only. The values
+ * are not copied, so that the pages of the file are loaded on demand and can
+ * be reclaimed by the operating system.
+ * It returns 0 on success, and -1 on failure.
+ */
+int map_rnn_dataset (
+        struct rnn_dataset *dataset,
+        const char *filename)
+{
+    int fd;
+    struct stat st;
+    init_rnn_dataset(dataset);
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        print_error_msg("cannot open %s", filename);
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        print_error_msg("cannot stat %s", filename);
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < HEADER_SIZE) {
+        print_error_msg("%s is too short", filename);
+        close(fd);
+        return -1;
+    }
+    dataset->map_size = st.st_size;
+    dataset->map = mmap(NULL, dataset->map_size, PROT_READ, MAP_SHARED, fd,
+            0);
+    close(fd);
+    if (dataset->map == MAP_FAILED) {
+        print_error_msg("cannot map %s", filename);
+        dataset->map = NULL;
+        return -1;
+    }
+
+    const char *p = dataset->map;
+    int32_t header[4];
+    memcpy(header, p + 8, sizeof(header));
+    if (memcmp(p, RNN_DATASET_MAGIC, 8) != 0) {
+        print_error_msg("%s is not a binary target file", filename);
+        goto error;
+    }
+    if (header[0] != RNN_DATASET_VERSION) {
+        print_error_msg("unsupported version %d in %s", header[0], filename);
+        goto error;
+    }
+    if (header[1] != RNN_DATASET_FLOAT64) {
+        print_error_msg("unsupported dtype %d in %s", header[1], filename);
+        goto error;
+    }
+    // a file with no series (e.g. converted from an empty input) may have
+    // dimension 0
+    if (header[2] < 0 || header[3] < 0 || (header[2] == 0 && header[3] > 0) ||
+            dataset->map_size < data_offset(header[3])) {
+        print_error_msg("broken header in %s", filename);
+        goto error;
+    }
+    dataset->dtype = header[1];
+    dataset->dimension = header[2];
+    dataset->num = header[3];
+    MALLOC(dataset->length, dataset->num);
+    MALLOC(dataset->data, dataset->num);
+    size_t offset = data_offset(dataset->num);
+    for (int i = 0; i < dataset->num; i++) {
+        int32_t length;
+        memcpy(&length, p + HEADER_SIZE + i * sizeof(int32_t),
+                sizeof(int32_t));
+        size_t size = (size_t)length * dataset->dimension * sizeof(double);
+        if (length <= 0 || dataset->map_size - offset < size) {
+            print_error_msg("broken length of series %d in %s", i, filename);
+            goto error;
+        }
+        dataset->length[i] = length;
+        dataset->data[i] = (const double*)(p + offset);
+        offset += size;
+    }
+    return 0;
+error:
+    unmap_rnn_dataset(dataset);
+    return -1;
+}
+
+
+void unmap_rnn_dataset (struct rnn_dataset *dataset)
+{
+    if (dataset->map != NULL) {
+        munmap(dataset->map, dataset->map_size);
+    }
+    FREE(dataset->length);
+    FREE(dataset->data);
+    init_rnn_dataset(dataset);
+}
+
+
+/*
+ * This function writes time series in the binary target format.
+ *
+ *   @parameter  dimension  : dimension of the time series
+ *   @parameter  num        : number of the time series
+ *   @parameter  length     : length[i] is the length of the i-th series
+ *   @parameter  data       : data[i][n] is the n-th vector of the i-th series
+ *   @parameter  fp         : output stream
+ */
+void fwrite_rnn_dataset (
+        int dimension,
+        int num,
+        const int *length,
+        const double* const* const* data,
+        FILE *fp)
+{
+    const char padding[RNN_DATASET_ALIGNMENT] = {0};
+    int32_t header[4] = {RNN_DATASET_VERSION, RNN_DATASET_FLOAT64, dimension,
+        num};
+    FWRITE(RNN_DATASET_MAGIC, 8, fp);
+    FWRITE(header, 4, fp);
+    for (int i = 0; i < num; i++) {
+        int32_t l = length[i];
+        FWRITE(&l, 1, fp);
+    }
+    size_t size = data_offset(num) - (HEADER_SIZE + num * sizeof(int32_t));
+    if (size > 0) {
+        FWRITE(padding, size, fp);
+    }
+    for (int i = 0; i < num; i++) {
+        for (int n = 0; n < length[i]; n++) {
+            FWRITE(data[i][n], dimension, fp);
+        }
+    }
+}
+
@@ -0,0 +1,80 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RNN_DATASET_H
+#define RNN_DATASET_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+/*
+ * Binary target file
+ *
+ * The file consists of a header followed by the time series, and all
+ * integers are stored in the native byte order.
+ *
+ *   magic      : 8 bytes, RNN_DATASET_MAGIC
+ *   version    : int32, RNN_DATASET_VERSION
+ *   dtype      : int32, type of values (enum rnn_dataset_dtype)
+ *   dimension  : int32, dimension of the time series (0 only if num is 0)
+ *   num        : int32, number of the time series
+ *   length     : int32 x num, length of each time series
+ *   padding    : up to the next multiple of RNN_DATASET_ALIGNMENT bytes
+ *   data       : the values of all time series stored contiguously, where
+ *                the i-th series is a (length[i] x dimension) row-major matrix
+ */
+#define RNN_DATASET_MAGIC "\x89RNT\r\n\x1a\n"
+#define RNN_DATASET_VERSION 1
+#define RNN_DATASET_ALIGNMENT 64
+
+typedef enum rnn_dataset_dtype {
+    RNN_DATASET_FLOAT64 = 0
+} rnn_dataset_dtype;
+
+
+typedef struct rnn_dataset {
+    enum rnn_dataset_dtype dtype;
+    int dimension;
+    int num;
+    int *length;
+    /* data[i] points to the first value of the i-th series in the mapping */
+    const double **data;
+
+    void *map;
+    size_t map_size;
+} rnn_dataset;
+
+
+void init_rnn_dataset (struct rnn_dataset *dataset);
+
+int is_rnn_dataset_file (const char *filename);
+
+int map_rnn_dataset (
+        struct rnn_dataset *dataset,
+        const char *filename);
+
+void unmap_rnn_dataset (struct rnn_dataset *dataset);
+
+void fwrite_rnn_dataset (
+        int dimension,
+        int num,
+        const int *length,
+        const double* const* const* data,
+        FILE *fp);
+
+#endif
+
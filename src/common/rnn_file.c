@@ -0,0 +1,1112 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "rnn_file.h"
+
+
+#define HEADER_SIZE (8 + 2 * sizeof(int32_t) + sizeof(int64_t))
+
+
+/******************************************************************************/
+/********** Writer ************************************************************/
+/******************************************************************************/
+
+static long writer_position (const struct rnn_file_writer *writer)
+{
+    long position = ftell(writer->fp);
+    if (position == -1) {
+        print_error_msg("`ftell' failed");
+        exit(EXIT_FAILURE);
+    }
+    return position - writer->begin;
+}
+
+static void writer_align (struct rnn_file_writer *writer)
+{
+    const char padding[RNN_FILE_ALIGNMENT] = {0};
+    long size = writer_position(writer) % RNN_FILE_ALIGNMENT;
+    if (size > 0) {
+        FWRITE(padding, RNN_FILE_ALIGNMENT - size, writer->fp);
+    }
+}
+
+
+/*
+ * This function writes the header of a model file to fp, which has to be
+ * seekable, and prepares to write sections.
+ */
+void init_rnn_file_writer (
+        struct rnn_file_writer *writer,
+        FILE *fp)
+{
+    int32_t header[2] = {RNN_FILE_VERSION, 0};
+    int64_t table_offset = 0;
+    writer->fp = fp;
+    writer->begin = 0;
+    writer->begin = writer_position(writer);
+    writer->section_num = 0;
+    FWRITE(RNN_FILE_MAGIC, 8, fp);
+    FWRITE(header, 2, fp);
+    FWRITE(&table_offset, 1, fp);
+}
+
+
+/*
+ * rnn_file_begin_section and rnn_file_end_section enclose the data of a
+ * section which are written to writer->fp directly.
+ */
+void rnn_file_begin_section (
+        struct rnn_file_writer *writer,
+        enum rnn_file_section_id id)
+{
+    writer_align(writer);
+    if (writer->section_num >= RNN_FILE_SECTION_ID_NUM) {
+        print_error_msg("too many sections");
+        exit(EXIT_FAILURE);
+    }
+    struct rnn_file_section *section = writer->section + writer->section_num;
+    section->id = id;
+    section->reserved = 0;
+    section->offset = writer_position(writer);
+    section->size = 0;
+    writer->section_num++;
+}
+
+void rnn_file_end_section (struct rnn_file_writer *writer)
+{
+    struct rnn_file_section *section = writer->section + writer->section_num -
+        1;
+    section->size = writer_position(writer) - section->offset;
+}
+
+
+void rnn_file_write_section (
+        struct rnn_file_writer *writer,
+        enum rnn_file_section_id id,
+        const void *data,
+        size_t size)
+{
+    rnn_file_begin_section(writer, id);
+    if (size > 0) {
+        FWRITE((const char*)data, size, writer->fp);
+    }
+    rnn_file_end_section(writer);
+}
+
+
+/*
+ * This function writes the section table, and completes the header.
+ */
+void fini_rnn_file_writer (struct rnn_file_writer *writer)
+{
+    writer_align(writer);
+    int32_t header[2] = {RNN_FILE_VERSION, writer->section_num};
+    int64_t table_offset = writer_position(writer);
+    FWRITE(writer->section, writer->section_num, writer->fp);
+    if (fseek(writer->fp, writer->begin + 8, SEEK_SET) != 0) {
+        print_error_msg("`fseek' failed");
+        exit(EXIT_FAILURE);
+    }
+    FWRITE(header, 2, writer->fp);
+    FWRITE(&table_offset, 1, writer->fp);
+    if (fseek(writer->fp, 0, SEEK_END) != 0) {
+        print_error_msg("`fseek' failed");
+        exit(EXIT_FAILURE);
+    }
+    writer->section_num = 0;
+}
+
+
+/*
+ * Matrices of rnn_parameters are allocated by MALLOC2, so that the rows of
+ * each of them are contiguous.
+ */
+static void write_matrix (
+        struct rnn_file_writer *writer,
+        enum rnn_file_section_id id,
+        double* const* x,
+        int m,
+        int n)
+{
+    rnn_file_write_section(writer, id, (m > 0) ? x[0] : NULL,
+            sizeof(double) * m * n);
+}
+
+static void write_connection (
+        struct rnn_file_writer *writer,
+        enum rnn_file_section_id id,
+        struct connection_domain* const* x,
+        int m,
+        int n)
+{
+    rnn_file_write_section(writer, id, (m > 0) ? x[0] : NULL,
+            sizeof(struct connection_domain) * m * (n + 1));
+}
+
+#define WRITE_SERIES_SECTION(writer,id,rnn,x,n) do { \
+    rnn_file_begin_section((writer), (id)); \
+    for (int _i = 0; _i < (rnn)->series_num; _i++) { \
+        FWRITE((rnn)->rnn_s[_i].x, (n), (writer)->fp); \
+    } \
+    rnn_file_end_section(writer); \
+    } while (0)
+
+#define WRITE_SERIES_ROWS(writer,id,rnn,row,n) do { \
+    rnn_file_begin_section((writer), (id)); \
+    for (int _i = 0; _i < (rnn)->series_num; _i++) { \
+        for (int _n = 0; _n < (rnn)->rnn_s[_i].length; _n++) { \
+            FWRITE(row((rnn)->rnn_s + _i, _n), (n), (writer)->fp); \
+        } \
+    } \
+    rnn_file_end_section(writer); \
+    } while (0)
+
+
+static void write_header (
+        struct rnn_file_writer *writer,
+        const struct recurrent_neural_network *rnn,
+        int delay_length,
+        double adapt_lr,
+        long init_epoch)
+{
+    const struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    struct rnn_file_header header;
+    memset(&header, 0, sizeof(header));
+    header.delay_length = delay_length;
+    header.in_state_size = rnn_p->in_state_size;
+    header.c_state_size = rnn_p->c_state_size;
+    header.out_state_size = rnn_p->out_state_size;
+    header.rep_init_size = rnn_p->rep_init_size;
+    header.output_type = rnn_p->output_type;
+    header.fixed_weight = rnn_p->fixed_weight;
+    header.fixed_threshold = rnn_p->fixed_threshold;
+    header.fixed_tau = rnn_p->fixed_tau;
+    header.fixed_init_c_state = rnn_p->fixed_init_c_state;
+    header.softmax_group_num = rnn_p->softmax_group_num;
+    header.series_num = rnn->series_num;
+    header.rep_init_variance = rnn_p->rep_init_variance;
+    header.prior_strength = rnn_p->prior_strength;
+    header.adapt_lr = adapt_lr;
+    header.init_epoch = init_epoch;
+    rnn_file_write_section(writer, RNN_FILE_HEADER, &header, sizeof(header));
+}
+
+
+static void write_parameters (
+        struct rnn_file_writer *writer,
+        const struct rnn_parameters *rnn_p)
+{
+    const int in_state_size = rnn_p->in_state_size;
+    const int c_state_size = rnn_p->c_state_size;
+    const int out_state_size = rnn_p->out_state_size;
+    const int rep_init_size = rnn_p->rep_init_size;
+
+    rnn_file_write_section(writer, RNN_FILE_CONST_INIT_C, rnn_p->const_init_c,
+            sizeof(int) * c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_SOFTMAX_GROUP_ID,
+            rnn_p->softmax_group_id, sizeof(int) * out_state_size);
+    write_matrix(writer, RNN_FILE_WEIGHT_CI, rnn_p->weight_ci, c_state_size,
+            in_state_size);
+    write_matrix(writer, RNN_FILE_WEIGHT_CC, rnn_p->weight_cc, c_state_size,
+            c_state_size);
+    write_matrix(writer, RNN_FILE_WEIGHT_OC, rnn_p->weight_oc, out_state_size,
+            c_state_size);
+    write_matrix(writer, RNN_FILE_WEIGHT_VC, rnn_p->weight_vc, out_state_size,
+            c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_THRESHOLD_C, rnn_p->threshold_c,
+            sizeof(double) * c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_THRESHOLD_O, rnn_p->threshold_o,
+            sizeof(double) * out_state_size);
+    rnn_file_write_section(writer, RNN_FILE_THRESHOLD_V, rnn_p->threshold_v,
+            sizeof(double) * out_state_size);
+    rnn_file_write_section(writer, RNN_FILE_TAU, rnn_p->tau, sizeof(double) *
+            c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_ETA, rnn_p->eta, sizeof(double) *
+            c_state_size);
+    write_matrix(writer, RNN_FILE_REP_INIT_C, rnn_p->rep_init_c, rep_init_size,
+            c_state_size);
+    write_connection(writer, RNN_FILE_CONNECTION_CI, rnn_p->connection_ci,
+            c_state_size, in_state_size);
+    write_connection(writer, RNN_FILE_CONNECTION_CC, rnn_p->connection_cc,
+            c_state_size, c_state_size);
+    write_connection(writer, RNN_FILE_CONNECTION_OC, rnn_p->connection_oc,
+            out_state_size, c_state_size);
+    write_connection(writer, RNN_FILE_CONNECTION_VC, rnn_p->connection_vc,
+            out_state_size, c_state_size);
+}
+
+
+static int in_length (
+        const struct rnn_state *rnn_s,
+        int max_in_length)
+{
+    return (rnn_s->length < max_in_length) ? rnn_s->length : max_in_length;
+}
+
+/*
+ * This function writes the initial states of the time series, and the first
+ * max_in_length rows of in_state of each series.
+ */
+static void write_series (
+        struct rnn_file_writer *writer,
+        const struct recurrent_neural_network *rnn,
+        int max_in_length)
+{
+    const int in_state_size = rnn->rnn_p.in_state_size;
+    const int c_state_size = rnn->rnn_p.c_state_size;
+    const int rep_init_size = rnn->rnn_p.rep_init_size;
+
+    rnn_file_begin_section(writer, RNN_FILE_SERIES_LENGTH);
+    for (int i = 0; i < rnn->series_num; i++) {
+        FWRITE(&rnn->rnn_s[i].length, 1, writer->fp);
+    }
+    rnn_file_end_section(writer);
+    rnn_file_begin_section(writer, RNN_FILE_IN_STATE_LENGTH);
+    for (int i = 0; i < rnn->series_num; i++) {
+        int length = in_length(rnn->rnn_s + i, max_in_length);
+        FWRITE(&length, 1, writer->fp);
+    }
+    rnn_file_end_section(writer);
+    WRITE_SERIES_SECTION(writer, RNN_FILE_INIT_C_INTER_STATE, rnn,
+            init_c_inter_state, c_state_size);
+    WRITE_SERIES_SECTION(writer, RNN_FILE_INIT_C_STATE, rnn, init_c_state,
+            c_state_size);
+    WRITE_SERIES_SECTION(writer, RNN_FILE_GATE_INIT_C, rnn, gate_init_c,
+            rep_init_size);
+    WRITE_SERIES_SECTION(writer, RNN_FILE_BETA_INIT_C, rnn, beta_init_c,
+            rep_init_size);
+    rnn_file_begin_section(writer, RNN_FILE_IN_STATE);
+    for (int i = 0; i < rnn->series_num; i++) {
+        const int length = in_length(rnn->rnn_s + i, max_in_length);
+        for (int n = 0; n < length; n++) {
+            FWRITE(rnn_in_state_row(rnn->rnn_s + i, n), in_state_size,
+                    writer->fp);
+        }
+    }
+    rnn_file_end_section(writer);
+}
+
+
+/*
+ * This function writes the sections used only for learning.
+ */
+static void write_learning_sections (
+        struct rnn_file_writer *writer,
+        const struct recurrent_neural_network *rnn)
+{
+    const struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    const int in_state_size = rnn_p->in_state_size;
+    const int c_state_size = rnn_p->c_state_size;
+    const int out_state_size = rnn_p->out_state_size;
+    const int rep_init_size = rnn_p->rep_init_size;
+
+    write_matrix(writer, RNN_FILE_DELTA_WEIGHT_CI, rnn_p->delta_weight_ci,
+            c_state_size, in_state_size);
+    write_matrix(writer, RNN_FILE_DELTA_WEIGHT_CC, rnn_p->delta_weight_cc,
+            c_state_size, c_state_size);
+    write_matrix(writer, RNN_FILE_DELTA_WEIGHT_OC, rnn_p->delta_weight_oc,
+            out_state_size, c_state_size);
+    write_matrix(writer, RNN_FILE_DELTA_WEIGHT_VC, rnn_p->delta_weight_vc,
+            out_state_size, c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_DELTA_THRESHOLD_C,
+            rnn_p->delta_threshold_c, sizeof(double) * c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_DELTA_THRESHOLD_O,
+            rnn_p->delta_threshold_o, sizeof(double) * out_state_size);
+    rnn_file_write_section(writer, RNN_FILE_DELTA_THRESHOLD_V,
+            rnn_p->delta_threshold_v, sizeof(double) * out_state_size);
+    rnn_file_write_section(writer, RNN_FILE_DELTA_TAU, rnn_p->delta_tau,
+            sizeof(double) * c_state_size);
+    write_matrix(writer, RNN_FILE_DELTA_REP_INIT_C, rnn_p->delta_rep_init_c,
+            rep_init_size, c_state_size);
+    write_matrix(writer, RNN_FILE_PRIOR_WEIGHT_CI, rnn_p->prior_weight_ci,
+            c_state_size, in_state_size);
+    write_matrix(writer, RNN_FILE_PRIOR_WEIGHT_CC, rnn_p->prior_weight_cc,
+            c_state_size, c_state_size);
+    write_matrix(writer, RNN_FILE_PRIOR_WEIGHT_OC, rnn_p->prior_weight_oc,
+            out_state_size, c_state_size);
+    write_matrix(writer, RNN_FILE_PRIOR_WEIGHT_VC, rnn_p->prior_weight_vc,
+            out_state_size, c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_PRIOR_THRESHOLD_C,
+            rnn_p->prior_threshold_c, sizeof(double) * c_state_size);
+    rnn_file_write_section(writer, RNN_FILE_PRIOR_THRESHOLD_O,
+            rnn_p->prior_threshold_o, sizeof(double) * out_state_size);
+    rnn_file_write_section(writer, RNN_FILE_PRIOR_THRESHOLD_V,
+            rnn_p->prior_threshold_v, sizeof(double) * out_state_size);
+    rnn_file_write_section(writer, RNN_FILE_PRIOR_TAU, rnn_p->prior_tau,
+            sizeof(double) * c_state_size);
+    write_matrix(writer, RNN_FILE_PRIOR_REP_INIT_C, rnn_p->prior_rep_init_c,
+            rep_init_size, c_state_size);
+    WRITE_SERIES_SECTION(writer, RNN_FILE_DELTA_INIT_C_INTER_STATE, rnn,
+            delta_init_c_inter_state, c_state_size);
+    WRITE_SERIES_SECTION(writer, RNN_FILE_DELTA_BETA_INIT_C, rnn,
+            delta_beta_init_c, rep_init_size);
+    WRITE_SERIES_ROWS(writer, RNN_FILE_TEACH_STATE, rnn, rnn_teach_state_row,
+            out_state_size);
+}
+
+
+/*
+ * This function writes all sections of a recurrent neural network.
+ *
+ *   @parameter  writer       : writer of a model file
+ *   @parameter  rnn          : recurrent neural network
+ *   @parameter  delay_length : delay length of the closed loop
+ *   @parameter  adapt_lr     : adaptive learning rate
+ *   @parameter  init_epoch   : epoch at which learning is resumed
+ */
+void rnn_file_write_recurrent_neural_network (
+        struct rnn_file_writer *writer,
+        const struct recurrent_neural_network *rnn,
+        int delay_length,
+        double adapt_lr,
+        long init_epoch)
+{
+    write_header(writer, rnn, delay_length, adapt_lr, init_epoch);
+    write_parameters(writer, &rnn->rnn_p);
+    write_series(writer, rnn, INT_MAX);
+    write_learning_sections(writer, rnn);
+}
+
+
+/*
+ * This function writes the sections of a recurrent neural network needed for
+ * computation of forward dynamics. The gradients, the prior distribution and
+ * the teacher signals are omitted, and only the first max_in_length rows of
+ * in_state of each series are kept. set_init_state_of_rnn_runner uses
+ * delay_length rows, and set_init_state_of_rnn_runner2 uses
+ * (window_length + delay_length) rows.
+ *
+ *   @parameter  writer        : writer of a model file
+ *   @parameter  rnn           : recurrent neural network
+ *   @parameter  delay_length  : delay length of the closed loop
+ *   @parameter  max_in_length : maximum number of the rows of in_state
+ */
+void rnn_file_write_inference_network (
+        struct rnn_file_writer *writer,
+        const struct recurrent_neural_network *rnn,
+        int delay_length,
+        int max_in_length)
+{
+    write_header(writer, rnn, delay_length, 0, 0);
+    write_parameters(writer, &rnn->rnn_p);
+    write_series(writer, rnn, (max_in_length > 0) ? max_in_length : 1);
+}
+
+
+
+/******************************************************************************/
+/********** Reader ************************************************************/
+/******************************************************************************/
+
+void init_rnn_file (struct rnn_file *file)
+{
+    file->header = NULL;
+    file->section_num = 0;
+    file->section = NULL;
+    file->map = NULL;
+    file->map_size = 0;
+}
+
+
+/*
+ * This function returns 1 if the file begins with RNN_FILE_MAGIC, and
+ * returns 0 otherwise.
+ */
+int is_rnn_file (const char *filename)
+{
+    char magic[8];
+    FILE *fp;
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        return 0;
+    }
+    int is_file = (fread(magic, 1, 8, fp) == 8 &&
+            memcmp(magic, RNN_FILE_MAGIC, 8) == 0);
+    fclose(fp);
+    return is_file;
+}
+
+
+/*
+ * This function returns 1 if fp is at the beginning of a model file, and
+ * returns 0 otherwise. The position of fp is not changed. Streams which are
+ * not seekable are never regarded as model files.
+ */
+int is_rnn_file_stream (FILE *fp)
+{
+    char magic[8];
+    if (ftell(fp) != 0) {
+        return 0;
+    }
+    int is_file = (fread(magic, 1, 8, fp) == 8 &&
+            memcmp(magic, RNN_FILE_MAGIC, 8) == 0);
+    if (fseek(fp, 0, SEEK_SET) != 0) {
+        print_error_msg("`fseek' failed");
+        exit(EXIT_FAILURE);
+    }
+    return is_file;
+}
+
+
+const void* rnn_file_get_section (
+        const struct rnn_file *file,
+        enum rnn_file_section_id id,
+        size_t *size)
+{
+    for (int i = 0; i < file->section_num; i++) {
+        if (file->section[i].id == (int32_t)id) {
+            if (size != NULL) {
+                *size = file->section[i].size;
+            }
+            return (const char*)file->map + file->section[i].offset;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+ * This function returns the offset of the section in the file, or -1 if the
+ * file has no such section.
+ */
+long rnn_file_section_offset (
+        const struct rnn_file *file,
+        enum rnn_file_section_id id)
+{
+    const void *p = rnn_file_get_section(file, id, NULL);
+    return (p != NULL) ? (long)((const char*)p - (const char*)file->map) : -1;
+}
+
+
+static int64_t expected_section_size (
+        const struct rnn_file_header *header,
+        enum rnn_file_section_id id,
+        int64_t total_length,
+        int64_t total_in_length)
+{
+    const int64_t in_state_size = header->in_state_size;
+    const int64_t c_state_size = header->c_state_size;
+    const int64_t out_state_size = header->out_state_size;
+    const int64_t rep_init_size = header->rep_init_size;
+    const int64_t series_num = header->series_num;
+    const int64_t d = sizeof(double);
+    const int64_t cd = sizeof(struct connection_domain);
+
+    switch (id) {
+    case RNN_FILE_HEADER:
+        return sizeof(struct rnn_file_header);
+    case RNN_FILE_CONST_INIT_C:
+        return sizeof(int) * c_state_size;
+    case RNN_FILE_SOFTMAX_GROUP_ID:
+        return sizeof(int) * out_state_size;
+    case RNN_FILE_WEIGHT_CI:
+    case RNN_FILE_DELTA_WEIGHT_CI:
+    case RNN_FILE_PRIOR_WEIGHT_CI:
+        return d * c_state_size * in_state_size;
+    case RNN_FILE_WEIGHT_CC:
+    case RNN_FILE_DELTA_WEIGHT_CC:
+    case RNN_FILE_PRIOR_WEIGHT_CC:
+        return d * c_state_size * c_state_size;
+    case RNN_FILE_WEIGHT_OC:
+    case RNN_FILE_WEIGHT_VC:
+    case RNN_FILE_DELTA_WEIGHT_OC:
+    case RNN_FILE_DELTA_WEIGHT_VC:
+    case RNN_FILE_PRIOR_WEIGHT_OC:
+    case RNN_FILE_PRIOR_WEIGHT_VC:
+        return d * out_state_size * c_state_size;
+    case RNN_FILE_THRESHOLD_C:
+    case RNN_FILE_TAU:
+    case RNN_FILE_ETA:
+    case RNN_FILE_DELTA_THRESHOLD_C:
+    case RNN_FILE_DELTA_TAU:
+    case RNN_FILE_PRIOR_THRESHOLD_C:
+    case RNN_FILE_PRIOR_TAU:
+        return d * c_state_size;
+    case RNN_FILE_THRESHOLD_O:
+    case RNN_FILE_THRESHOLD_V:
+    case RNN_FILE_DELTA_THRESHOLD_O:
+    case RNN_FILE_DELTA_THRESHOLD_V:
+    case RNN_FILE_PRIOR_THRESHOLD_O:
+    case RNN_FILE_PRIOR_THRESHOLD_V:
+        return d * out_state_size;
+    case RNN_FILE_REP_INIT_C:
+    case RNN_FILE_DELTA_REP_INIT_C:
+    case RNN_FILE_PRIOR_REP_INIT_C:
+        return d * rep_init_size * c_state_size;
+    case RNN_FILE_CONNECTION_CI:
+        return cd * c_state_size * (in_state_size + 1);
+    case RNN_FILE_CONNECTION_CC:
+        return cd * c_state_size * (c_state_size + 1);
+    case RNN_FILE_CONNECTION_OC:
+    case RNN_FILE_CONNECTION_VC:
+        return cd * out_state_size * (c_state_size + 1);
+    case RNN_FILE_SERIES_LENGTH:
+    case RNN_FILE_IN_STATE_LENGTH:
+        return sizeof(int) * series_num;
+    case RNN_FILE_INIT_C_INTER_STATE:
+    case RNN_FILE_INIT_C_STATE:
+    case RNN_FILE_DELTA_INIT_C_INTER_STATE:
+        return d * series_num * c_state_size;
+    case RNN_FILE_GATE_INIT_C:
+    case RNN_FILE_BETA_INIT_C:
+    case RNN_FILE_DELTA_BETA_INIT_C:
+        return d * series_num * rep_init_size;
+    case RNN_FILE_IN_STATE:
+        return d * total_in_length * in_state_size;
+    case RNN_FILE_TEACH_STATE:
+        return d * total_length * out_state_size;
+    default:
+        return -1;
+    }
+}
+
+
+/*
+ * This function returns 0 if each of m rows of connection domains, which
+ * have n + 1 entries, is a list of disjoint ascending domains within
+ * [0, n] terminated by begin = -1 as made by rnn_set_connection, and
+ * returns -1 otherwise.
+ */
+static int check_connection (
+        const struct connection_domain *x,
+        int m,
+        int n)
+{
+    for (int i = 0; i < m; i++, x += n + 1) {
+        int prev_end = 0, j;
+        for (j = 0; j <= n && x[j].begin != -1; j++) {
+            if (x[j].begin < prev_end || x[j].end <= x[j].begin ||
+                    x[j].end > n) {
+                return -1;
+            }
+            prev_end = x[j].end;
+        }
+        if (j > n) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * This function checks that the sizes of the sections agree with the header,
+ * that all sections required for computation are present, and that the
+ * connection domains are within the state sizes.
+ */
+static int check_rnn_file (
+        const struct rnn_file *file,
+        const char *name)
+{
+    const struct rnn_file_header *header = file->header;
+    if (header->in_state_size < 0 || header->c_state_size < 0 ||
+            header->out_state_size < 0 || header->rep_init_size < 0 ||
+            header->series_num < 0 || header->delay_length < 0) {
+        print_error_msg("broken header in %s", name);
+        return -1;
+    }
+    size_t size = 0, in_size = 0;
+    const int *length = rnn_file_get_section(file, RNN_FILE_SERIES_LENGTH,
+            &size);
+    const int *in_length = rnn_file_get_section(file,
+            RNN_FILE_IN_STATE_LENGTH, &in_size);
+    if (length == NULL || in_length == NULL || size != in_size ||
+            (int64_t)size != expected_section_size(header,
+                RNN_FILE_SERIES_LENGTH, 0, 0)) {
+        print_error_msg("broken length of series in %s", name);
+        return -1;
+    }
+    int64_t total_length = 0, total_in_length = 0;
+    for (int i = 0; i < header->series_num; i++) {
+        if (length[i] <= 0 || in_length[i] <= 0 || in_length[i] > length[i]) {
+            print_error_msg("broken length of series %d in %s", i, name);
+            return -1;
+        }
+        total_length += length[i];
+        total_in_length += in_length[i];
+    }
+    for (int id = 0; id < RNN_FILE_OPTIMIZER; id++) {
+        if (rnn_file_get_section(file, id, &size) == NULL) {
+            if (id < RNN_FILE_DELTA_WEIGHT_CI) {
+                print_error_msg("no section %d in %s", id, name);
+                return -1;
+            }
+        } else if ((int64_t)size != expected_section_size(header, id,
+                    total_length, total_in_length)) {
+            print_error_msg("wrong size of section %d in %s", id, name);
+            return -1;
+        }
+    }
+    const int in_state_size = header->in_state_size;
+    const int c_state_size = header->c_state_size;
+    const int out_state_size = header->out_state_size;
+    if (check_connection(rnn_file_get_section(file, RNN_FILE_CONNECTION_CI,
+                    NULL), c_state_size, in_state_size) != 0 ||
+            check_connection(rnn_file_get_section(file,
+                    RNN_FILE_CONNECTION_CC, NULL), c_state_size,
+                c_state_size) != 0 ||
+            check_connection(rnn_file_get_section(file,
+                    RNN_FILE_CONNECTION_OC, NULL), out_state_size,
+                c_state_size) != 0 ||
+            check_connection(rnn_file_get_section(file,
+                    RNN_FILE_CONNECTION_VC, NULL), out_state_size,
+                c_state_size) != 0) {
+        print_error_msg("broken connection domains in %s", name);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * This function maps a model file into memory. The mapping is read-only, so
+ * that the arrays in the file must not be modified (e.g. by learning) while
+ * they are used in place.
+ * It returns 0 on success, and -1 on failure.
+ */
+int map_rnn_file_descriptor (
+        struct rnn_file *file,
+        int fd,
+        const char *name)
+{
+    struct stat st;
+    init_rnn_file(file);
+    if (fstat(fd, &st) == -1) {
+        print_error_msg("cannot stat %s", name);
+        return -1;
+    }
+    if ((size_t)st.st_size < HEADER_SIZE) {
+        print_error_msg("%s is too short", name);
+        return -1;
+    }
+    file->map_size = st.st_size;
+    file->map = mmap(NULL, file->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (file->map == MAP_FAILED) {
+        print_error_msg("cannot map %s", name);
+        file->map = NULL;
+        return -1;
+    }
+
+    const char *p = file->map;
+    int32_t header[2];
+    int64_t table_offset;
+    memcpy(header, p + 8, sizeof(header));
+    memcpy(&table_offset, p + 8 + sizeof(header), sizeof(table_offset));
+    if (memcmp(p, RNN_FILE_MAGIC, 8) != 0) {
+        print_error_msg("%s is not a model file", name);
+        goto error;
+    }
+    if (header[0] != RNN_FILE_VERSION) {
+        print_error_msg("unsupported version %d in %s", header[0], name);
+        goto error;
+    }
+    if (header[1] < 0 || table_offset < (int64_t)HEADER_SIZE ||
+            table_offset % RNN_FILE_ALIGNMENT != 0 ||
+            (uint64_t)table_offset > file->map_size ||
+            (file->map_size - table_offset) / sizeof(struct rnn_file_section)
+            < (size_t)header[1]) {
+        print_error_msg("broken header in %s", name);
+        goto error;
+    }
+    file->section_num = header[1];
+    file->section = (const struct rnn_file_section*)(p + table_offset);
+    for (int i = 0; i < file->section_num; i++) {
+        const struct rnn_file_section *section = file->section + i;
+        if (section->offset < (int64_t)HEADER_SIZE ||
+                section->offset % RNN_FILE_ALIGNMENT != 0 ||
+                section->size < 0 ||
+                (uint64_t)section->offset > file->map_size ||
+                (uint64_t)section->size > file->map_size - section->offset) {
+            print_error_msg("broken section table in %s", name);
+            goto error;
+        }
+    }
+    size_t size;
+    file->header = rnn_file_get_section(file, RNN_FILE_HEADER, &size);
+    if (file->header == NULL || size != sizeof(struct rnn_file_header)) {
+        print_error_msg("broken header in %s", name);
+        goto error;
+    }
+    if (check_rnn_file(file, name) != 0) {
+        goto error;
+    }
+    return 0;
+error:
+    unmap_rnn_file(file);
+    return -1;
+}
+
+
+int map_rnn_file (
+        struct rnn_file *file,
+        const char *filename)
+{
+    int fd, status;
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        init_rnn_file(file);
+        print_error_msg("cannot open %s", filename);
+        return -1;
+    }
+    status = map_rnn_file_descriptor(file, fd, filename);
+    close(fd);
+    return status;
+}
+
+
+void unmap_rnn_file (struct rnn_file *file)
+{
+    if (file->map != NULL) {
+        munmap(file->map, file->map_size);
+    }
+    init_rnn_file(file);
+}
+
+
+static void set_rnn_parameters_from_header (
+        const struct rnn_file_header *header,
+        struct rnn_parameters *rnn_p)
+{
+    rnn_p->in_state_size = header->in_state_size;
+    rnn_p->c_state_size = header->c_state_size;
+    rnn_p->out_state_size = header->out_state_size;
+    rnn_p->rep_init_size = header->rep_init_size;
+    rnn_p->output_type = header->output_type;
+    rnn_p->fixed_weight = header->fixed_weight;
+    rnn_p->fixed_threshold = header->fixed_threshold;
+    rnn_p->fixed_tau = header->fixed_tau;
+    rnn_p->fixed_init_c_state = header->fixed_init_c_state;
+    rnn_p->softmax_group_num = header->softmax_group_num;
+    rnn_p->rep_init_variance = header->rep_init_variance;
+    rnn_p->prior_strength = header->prior_strength;
+}
+
+
+/*
+ * This function copies a section to x if the file has the section, and
+ * returns 1. Otherwise, it returns 0.
+ */
+static int read_section (
+        const struct rnn_file *file,
+        enum rnn_file_section_id id,
+        void *x)
+{
+    size_t size;
+    const void *p = rnn_file_get_section(file, id, &size);
+    if (p == NULL) {
+        return 0;
+    }
+    if (size > 0) {
+        memcpy(x, p, size);
+    }
+    return 1;
+}
+
+static double* matrix_data (
+        double **x,
+        int m)
+{
+    return (m > 0) ? x[0] : NULL;
+}
+
+static struct connection_domain* connection_data (
+        struct connection_domain **x,
+        int m)
+{
+    return (m > 0) ? x[0] : NULL;
+}
+
+
+/*
+ * This function reads a recurrent neural network from a mapped model file.
+ * All arrays are copied, so that the file can be unmapped afterwards. The
+ * gradients and the prior distribution missing in the file are initialized
+ * in the same way as a new network.
+ */
+void rnn_file_read_recurrent_neural_network (
+        const struct rnn_file *file,
+        struct recurrent_neural_network *rnn)
+{
+    struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    set_rnn_parameters_from_header(file->header, rnn_p);
+    rnn_parameters_alloc(rnn_p);
+
+    const int c_state_size = rnn_p->c_state_size;
+    const int out_state_size = rnn_p->out_state_size;
+    const int rep_init_size = rnn_p->rep_init_size;
+
+    read_section(file, RNN_FILE_CONST_INIT_C, rnn_p->const_init_c);
+    read_section(file, RNN_FILE_SOFTMAX_GROUP_ID, rnn_p->softmax_group_id);
+    read_section(file, RNN_FILE_WEIGHT_CI, matrix_data(rnn_p->weight_ci,
+                c_state_size));
+    read_section(file, RNN_FILE_WEIGHT_CC, matrix_data(rnn_p->weight_cc,
+                c_state_size));
+    read_section(file, RNN_FILE_WEIGHT_OC, matrix_data(rnn_p->weight_oc,
+                out_state_size));
+    read_section(file, RNN_FILE_WEIGHT_VC, matrix_data(rnn_p->weight_vc,
+                out_state_size));
+    read_section(file, RNN_FILE_THRESHOLD_C, rnn_p->threshold_c);
+    read_section(file, RNN_FILE_THRESHOLD_O, rnn_p->threshold_o);
+    read_section(file, RNN_FILE_THRESHOLD_V, rnn_p->threshold_v);
+    read_section(file, RNN_FILE_TAU, rnn_p->tau);
+    read_section(file, RNN_FILE_ETA, rnn_p->eta);
+    read_section(file, RNN_FILE_REP_INIT_C, matrix_data(rnn_p->rep_init_c,
+                rep_init_size));
+    read_section(file, RNN_FILE_CONNECTION_CI, connection_data(
+                rnn_p->connection_ci, c_state_size));
+    read_section(file, RNN_FILE_CONNECTION_CC, connection_data(
+                rnn_p->connection_cc, c_state_size));
+    read_section(file, RNN_FILE_CONNECTION_OC, connection_data(
+                rnn_p->connection_oc, out_state_size));
+    read_section(file, RNN_FILE_CONNECTION_VC, connection_data(
+                rnn_p->connection_vc, out_state_size));
+
+    rnn_reset_delta_parameters(rnn_p);
+    read_section(file, RNN_FILE_DELTA_WEIGHT_CI, matrix_data(
+                rnn_p->delta_weight_ci, c_state_size));
+    read_section(file, RNN_FILE_DELTA_WEIGHT_CC, matrix_data(
+                rnn_p->delta_weight_cc, c_state_size));
+    read_section(file, RNN_FILE_DELTA_WEIGHT_OC, matrix_data(
+                rnn_p->delta_weight_oc, out_state_size));
+    read_section(file, RNN_FILE_DELTA_WEIGHT_VC, matrix_data(
+                rnn_p->delta_weight_vc, out_state_size));
+    read_section(file, RNN_FILE_DELTA_THRESHOLD_C, rnn_p->delta_threshold_c);
+    read_section(file, RNN_FILE_DELTA_THRESHOLD_O, rnn_p->delta_threshold_o);
+    read_section(file, RNN_FILE_DELTA_THRESHOLD_V, rnn_p->delta_threshold_v);
+    read_section(file, RNN_FILE_DELTA_TAU, rnn_p->delta_tau);
+    read_section(file, RNN_FILE_DELTA_REP_INIT_C, matrix_data(
+                rnn_p->delta_rep_init_c, rep_init_size));
+
+    rnn_reset_prior_distribution(rnn_p);
+    read_section(file, RNN_FILE_PRIOR_WEIGHT_CI, matrix_data(
+                rnn_p->prior_weight_ci, c_state_size));
+    read_section(file, RNN_FILE_PRIOR_WEIGHT_CC, matrix_data(
+                rnn_p->prior_weight_cc, c_state_size));
+    read_section(file, RNN_FILE_PRIOR_WEIGHT_OC, matrix_data(
+                rnn_p->prior_weight_oc, out_state_size));
+    read_section(file, RNN_FILE_PRIOR_WEIGHT_VC, matrix_data(
+                rnn_p->prior_weight_vc, out_state_size));
+    read_section(file, RNN_FILE_PRIOR_THRESHOLD_C, rnn_p->prior_threshold_c);
+    read_section(file, RNN_FILE_PRIOR_THRESHOLD_O, rnn_p->prior_threshold_o);
+    read_section(file, RNN_FILE_PRIOR_THRESHOLD_V, rnn_p->prior_threshold_v);
+    read_section(file, RNN_FILE_PRIOR_TAU, rnn_p->prior_tau);
+    read_section(file, RNN_FILE_PRIOR_REP_INIT_C, matrix_data(
+                rnn_p->prior_rep_init_c, rep_init_size));
+
+    const int in_state_size = rnn_p->in_state_size;
+    const int *length = rnn_file_get_section(file, RNN_FILE_SERIES_LENGTH,
+            NULL);
+    const int *in_length = rnn_file_get_section(file,
+            RNN_FILE_IN_STATE_LENGTH, NULL);
+    const double *init_c_inter_state = rnn_file_get_section(file,
+            RNN_FILE_INIT_C_INTER_STATE, NULL);
+    const double *init_c_state = rnn_file_get_section(file,
+            RNN_FILE_INIT_C_STATE, NULL);
+    const double *gate_init_c = rnn_file_get_section(file,
+            RNN_FILE_GATE_INIT_C, NULL);
+    const double *beta_init_c = rnn_file_get_section(file,
+            RNN_FILE_BETA_INIT_C, NULL);
+    const double *delta_init_c_inter_state = rnn_file_get_section(file,
+            RNN_FILE_DELTA_INIT_C_INTER_STATE, NULL);
+    const double *delta_beta_init_c = rnn_file_get_section(file,
+            RNN_FILE_DELTA_BETA_INIT_C, NULL);
+    const double *in_state = rnn_file_get_section(file, RNN_FILE_IN_STATE,
+            NULL);
+    const double *teach_state = rnn_file_get_section(file,
+            RNN_FILE_TEACH_STATE, NULL);
+
+    rnn->series_num = file->header->series_num;
+    MALLOC(rnn->rnn_s, rnn->series_num);
+    for (int i = 0; i < rnn->series_num; i++) {
+        struct rnn_state *rnn_s = rnn->rnn_s + i;
+        rnn_s->rnn_p = rnn_p;
+        rnn_s->length = length[i];
+        rnn_s->reuse_delta = 0;
+        rnn_state_alloc(rnn_s);
+
+        memcpy(rnn_s->init_c_inter_state, init_c_inter_state + i *
+                c_state_size, sizeof(double) * c_state_size);
+        memcpy(rnn_s->init_c_state, init_c_state + i * c_state_size,
+                sizeof(double) * c_state_size);
+        memcpy(rnn_s->gate_init_c, gate_init_c + i * rep_init_size,
+                sizeof(double) * rep_init_size);
+        memcpy(rnn_s->beta_init_c, beta_init_c + i * rep_init_size,
+                sizeof(double) * rep_init_size);
+        for (int j = 0; j < c_state_size; j++) {
+            rnn_s->delta_init_c_inter_state[j] =
+                (delta_init_c_inter_state != NULL) ?
+                delta_init_c_inter_state[i * c_state_size + j] : 0;
+        }
+        for (int j = 0; j < rep_init_size; j++) {
+            rnn_s->delta_beta_init_c[j] = (delta_beta_init_c != NULL) ?
+                delta_beta_init_c[i * rep_init_size + j] : 0;
+        }
+        for (int n = 0; n < rnn_s->length; n++) {
+            for (int j = 0; j < in_state_size; j++) {
+                rnn_s->in_state[n][j] = (n < in_length[i]) ?
+                    in_state[n * in_state_size + j] : 0;
+            }
+            for (int j = 0; j < out_state_size; j++) {
+                rnn_s->teach_state[n][j] = (teach_state != NULL) ?
+                    teach_state[n * out_state_size + j] : 0;
+            }
+        }
+        in_state += (size_t)in_length[i] * in_state_size;
+        if (teach_state != NULL) {
+            teach_state += (size_t)length[i] * out_state_size;
+        }
+    }
+}
+
+
+#define MAP_VECTOR(file,id,x) do { \
+    free(x); \
+    (x) = (void*)rnn_file_get_section((file), (id), NULL); \
+    } while (0)
+
+#define MAP_MATRIX(file,id,x,m,n) do { \
+    const int _m = (m); \
+    const int _n = (n); \
+    if (_m > 0) { \
+        free((x)[0]); \
+        (x)[0] = (void*)rnn_file_get_section((file), (id), NULL); \
+        for (int _i = 1; _i < _m; _i++) { \
+            (x)[_i] = (x)[0] + _i * _n; \
+        } \
+    }} while (0)
+
+
+/*
+ * This function initializes rnn_p with the model parameters in a mapped model
+ * file. The parameters are not copied but used in place (rnn_p->mapped is
+ * set), hence the file has to stay mapped until rnn_p is freed. The gradients
+ * are reset, and the prior distribution is set to the parameters.
+ */
+void rnn_file_map_rnn_parameters (
+        const struct rnn_file *file,
+        struct rnn_parameters *rnn_p)
+{
+    set_rnn_parameters_from_header(file->header, rnn_p);
+    rnn_parameters_alloc(rnn_p);
+
+    const int in_state_size = rnn_p->in_state_size;
+    const int c_state_size = rnn_p->c_state_size;
+    const int out_state_size = rnn_p->out_state_size;
+    const int rep_init_size = rnn_p->rep_init_size;
+
+    MAP_VECTOR(file, RNN_FILE_CONST_INIT_C, rnn_p->const_init_c);
+    MAP_VECTOR(file, RNN_FILE_SOFTMAX_GROUP_ID, rnn_p->softmax_group_id);
+    MAP_MATRIX(file, RNN_FILE_WEIGHT_CI, rnn_p->weight_ci, c_state_size,
+            in_state_size);
+    MAP_MATRIX(file, RNN_FILE_WEIGHT_CC, rnn_p->weight_cc, c_state_size,
+            c_state_size);
+    MAP_MATRIX(file, RNN_FILE_WEIGHT_OC, rnn_p->weight_oc, out_state_size,
+            c_state_size);
+    MAP_MATRIX(file, RNN_FILE_WEIGHT_VC, rnn_p->weight_vc, out_state_size,
+            c_state_size);
+    MAP_VECTOR(file, RNN_FILE_THRESHOLD_C, rnn_p->threshold_c);
+    MAP_VECTOR(file, RNN_FILE_THRESHOLD_O, rnn_p->threshold_o);
+    MAP_VECTOR(file, RNN_FILE_THRESHOLD_V, rnn_p->threshold_v);
+    MAP_VECTOR(file, RNN_FILE_TAU, rnn_p->tau);
+    MAP_VECTOR(file, RNN_FILE_ETA, rnn_p->eta);
+    MAP_MATRIX(file, RNN_FILE_REP_INIT_C, rnn_p->rep_init_c, rep_init_size,
+            c_state_size);
+    MAP_MATRIX(file, RNN_FILE_CONNECTION_CI, rnn_p->connection_ci,
+            c_state_size, in_state_size + 1);
+    MAP_MATRIX(file, RNN_FILE_CONNECTION_CC, rnn_p->connection_cc,
+            c_state_size, c_state_size + 1);
+    MAP_MATRIX(file, RNN_FILE_CONNECTION_OC, rnn_p->connection_oc,
+            out_state_size, c_state_size + 1);
+    MAP_MATRIX(file, RNN_FILE_CONNECTION_VC, rnn_p->connection_vc,
+            out_state_size, c_state_size + 1);
+    rnn_p->mapped = 1;
+
+    rnn_reset_delta_parameters(rnn_p);
+    rnn_reset_prior_distribution(rnn_p);
+}
+
+
+/*
+ * This function initializes rnn with a mapped model file for computation of
+ * forward dynamics. The model parameters and in_state of the time series
+ * refer to the mapping (see rnn_file_map_rnn_parameters and
+ * rnn_add_streamed_targets), and only the initial states of the series are
+ * copied. The length of each series is the number of the rows of in_state
+ * kept in the file.
+ */
+void rnn_file_map_recurrent_neural_network (
+        const struct rnn_file *file,
+        struct recurrent_neural_network *rnn)
+{
+    rnn_file_map_rnn_parameters(file, &rnn->rnn_p);
+    rnn->series_num = 0;
+    rnn->rnn_s = NULL;
+
+    const int num = file->header->series_num;
+    if (num <= 0) {
+        return;
+    }
+    const struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    const int in_state_size = rnn_p->in_state_size;
+    const int c_state_size = rnn_p->c_state_size;
+    const int rep_init_size = rnn_p->rep_init_size;
+    const int *in_length = rnn_file_get_section(file,
+            RNN_FILE_IN_STATE_LENGTH, NULL);
+    const double *in_state = rnn_file_get_section(file, RNN_FILE_IN_STATE,
+            NULL);
+    const double *init_c_inter_state = rnn_file_get_section(file,
+            RNN_FILE_INIT_C_INTER_STATE, NULL);
+    const double *init_c_state = rnn_file_get_section(file,
+            RNN_FILE_INIT_C_STATE, NULL);
+    const double *gate_init_c = rnn_file_get_section(file,
+            RNN_FILE_GATE_INIT_C, NULL);
+    const double *beta_init_c = rnn_file_get_section(file,
+            RNN_FILE_BETA_INIT_C, NULL);
+
+    const double **input;
+    MALLOC(input, num);
+    for (int i = 0; i < num; i++) {
+        input[i] = in_state;
+        in_state += (size_t)in_length[i] * in_state_size;
+    }
+    rnn_add_streamed_targets(rnn, num, in_length, input, NULL);
+    FREE(input);
+
+    for (int i = 0; i < num; i++) {
+        struct rnn_state *rnn_s = rnn->rnn_s + i;
+        memcpy(rnn_s->init_c_inter_state, init_c_inter_state + i *
+                c_state_size, sizeof(double) * c_state_size);
+        memcpy(rnn_s->init_c_state, init_c_state + i * c_state_size,
+                sizeof(double) * c_state_size);
+        memcpy(rnn_s->gate_init_c, gate_init_c + i * rep_init_size,
+                sizeof(double) * rep_init_size);
+        memcpy(rnn_s->beta_init_c, beta_init_c + i * rep_init_size,
+                sizeof(double) * rep_init_size);
+    }
+}
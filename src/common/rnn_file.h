@@ -0,0 +1,220 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RNN_FILE_H
+#define RNN_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rnn.h"
+
+
+/*
+ * Model file
+ *
+ * The file consists of a header, sections and a section table, and all
+ * values are stored in the native byte order.
+ *
+ *   magic          : 8 bytes, RNN_FILE_MAGIC
+ *   version        : int32, RNN_FILE_VERSION
+ *   section_num    : int32, number of sections
+ *   table_offset   : int64, offset of the section table
+ *   sections       : each section begins at a multiple of RNN_FILE_ALIGNMENT
+ *   section table  : section_num x struct rnn_file_section
+ *
+ * Each tensor of the model is stored in a section of its own as a row-major
+ * array, so that a mapped file can be used in place. Offsets are counted
+ * from the magic, which has to be at the beginning of the file to be mapped.
+ */
+#define RNN_FILE_MAGIC "\x89RNN\r\n\x1a\n"
+#define RNN_FILE_VERSION 1
+#define RNN_FILE_ALIGNMENT 64
+
+typedef enum rnn_file_section_id {
+    RNN_FILE_HEADER,                    // struct rnn_file_header
+    RNN_FILE_CONST_INIT_C,              // int [c_state_size]
+    RNN_FILE_SOFTMAX_GROUP_ID,          // int [out_state_size]
+    RNN_FILE_WEIGHT_CI,
+    RNN_FILE_WEIGHT_CC,
+    RNN_FILE_WEIGHT_OC,
+    RNN_FILE_WEIGHT_VC,
+    RNN_FILE_THRESHOLD_C,
+    RNN_FILE_THRESHOLD_O,
+    RNN_FILE_THRESHOLD_V,
+    RNN_FILE_TAU,
+    RNN_FILE_ETA,
+    RNN_FILE_REP_INIT_C,
+    RNN_FILE_CONNECTION_CI,             // struct connection_domain
+    RNN_FILE_CONNECTION_CC,
+    RNN_FILE_CONNECTION_OC,
+    RNN_FILE_CONNECTION_VC,
+    RNN_FILE_SERIES_LENGTH,             // int [series_num]
+    RNN_FILE_IN_STATE_LENGTH,           // int [series_num]
+    RNN_FILE_INIT_C_INTER_STATE,        // double [series_num][c_state_size]
+    RNN_FILE_INIT_C_STATE,
+    RNN_FILE_GATE_INIT_C,               // double [series_num][rep_init_size]
+    RNN_FILE_BETA_INIT_C,
+    /* the first in_state_length[i] rows of in_state of each series */
+    RNN_FILE_IN_STATE,
+    /* sections used only for learning, which a model for inference lacks */
+    RNN_FILE_DELTA_WEIGHT_CI,
+    RNN_FILE_DELTA_WEIGHT_CC,
+    RNN_FILE_DELTA_WEIGHT_OC,
+    RNN_FILE_DELTA_WEIGHT_VC,
+    RNN_FILE_DELTA_THRESHOLD_C,
+    RNN_FILE_DELTA_THRESHOLD_O,
+    RNN_FILE_DELTA_THRESHOLD_V,
+    RNN_FILE_DELTA_TAU,
+    RNN_FILE_DELTA_REP_INIT_C,
+    RNN_FILE_PRIOR_WEIGHT_CI,
+    RNN_FILE_PRIOR_WEIGHT_CC,
+    RNN_FILE_PRIOR_WEIGHT_OC,
+    RNN_FILE_PRIOR_WEIGHT_VC,
+    RNN_FILE_PRIOR_THRESHOLD_C,
+    RNN_FILE_PRIOR_THRESHOLD_O,
+    RNN_FILE_PRIOR_THRESHOLD_V,
+    RNN_FILE_PRIOR_TAU,
+    RNN_FILE_PRIOR_REP_INIT_C,
+    RNN_FILE_DELTA_INIT_C_INTER_STATE,
+    RNN_FILE_DELTA_BETA_INIT_C,
+    RNN_FILE_TEACH_STATE,               // all rows of teach_state
+    RNN_FILE_OPTIMIZER,                 // written by fwrite_rnn_optimizer
+    RNN_FILE_SECTION_ID_NUM
+} rnn_file_section_id;
+
+typedef struct rnn_file_header {
+    int32_t delay_length;
+    int32_t in_state_size;
+    int32_t c_state_size;
+    int32_t out_state_size;
+    int32_t rep_init_size;
+    int32_t output_type;
+    int32_t fixed_weight;
+    int32_t fixed_threshold;
+    int32_t fixed_tau;
+    int32_t fixed_init_c_state;
+    int32_t softmax_group_num;
+    int32_t series_num;
+    double rep_init_variance;
+    double prior_strength;
+    double adapt_lr;
+    int64_t init_epoch;
+} rnn_file_header;
+
+typedef struct rnn_file_section {
+    int32_t id;
+    int32_t reserved;
+    int64_t offset;
+    int64_t size;
+} rnn_file_section;
+
+
+/*
+ * Each section is written at most once, hence the section table of a writer
+ * has a fixed size, and writing a model file allocates no memory (see the
+ * checkpoint of rnn-learn, which writes a model in a forked process).
+ */
+typedef struct rnn_file_writer {
+    FILE *fp;
+    long begin;
+    int section_num;
+    struct rnn_file_section section[RNN_FILE_SECTION_ID_NUM];
+} rnn_file_writer;
+
+typedef struct rnn_file {
+    const struct rnn_file_header *header;
+    int section_num;
+    const struct rnn_file_section *section;
+
+    void *map;
+    size_t map_size;
+} rnn_file;
+
+
+void init_rnn_file_writer (
+        struct rnn_file_writer *writer,
+        FILE *fp);
+
+void rnn_file_begin_section (
+        struct rnn_file_writer *writer,
+        enum rnn_file_section_id id);
+
+void rnn_file_end_section (struct rnn_file_writer *writer);
+
+void rnn_file_write_section (
+        struct rnn_file_writer *writer,
+        enum rnn_file_section_id id,
+        const void *data,
+        size_t size);
+
+void fini_rnn_file_writer (struct rnn_file_writer *writer);
+
+void rnn_file_write_recurrent_neural_network (
+        struct rnn_file_writer *writer,
+        const struct recurrent_neural_network *rnn,
+        int delay_length,
+        double adapt_lr,
+        long init_epoch);
+
+void rnn_file_write_inference_network (
+        struct rnn_file_writer *writer,
+        const struct recurrent_neural_network *rnn,
+        int delay_length,
+        int max_in_length);
+
+
+void init_rnn_file (struct rnn_file *file);
+
+int is_rnn_file (const char *filename);
+
+int is_rnn_file_stream (FILE *fp);
+
+int map_rnn_file (
+        struct rnn_file *file,
+        const char *filename);
+
+int map_rnn_file_descriptor (
+        struct rnn_file *file,
+        int fd,
+        const char *name);
+
+void unmap_rnn_file (struct rnn_file *file);
+
+const void* rnn_file_get_section (
+        const struct rnn_file *file,
+        enum rnn_file_section_id id,
+        size_t *size);
+
+long rnn_file_section_offset (
+        const struct rnn_file *file,
+        enum rnn_file_section_id id);
+
+void rnn_file_read_recurrent_neural_network (
+        const struct rnn_file *file,
+        struct recurrent_neural_network *rnn);
+
+void rnn_file_map_rnn_parameters (
+        const struct rnn_file *file,
+        struct rnn_parameters *rnn_p);
+
+void rnn_file_map_recurrent_neural_network (
+        const struct rnn_file *file,
+        struct recurrent_neural_network *rnn);
+
+#endif
+
@@ -0,0 +1,234 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "rnn_log.h"
+
+
+#define HEADER_SIZE (8 + 4 * sizeof(int32_t) + sizeof(int64_t))
+
+static size_t data_offset (size_t text_size)
+{
+    size_t offset = HEADER_SIZE + text_size;
+    return (offset + RNN_LOG_ALIGNMENT - 1) / RNN_LOG_ALIGNMENT *
+        RNN_LOG_ALIGNMENT;
+}
+
+
+void init_rnn_log (struct rnn_log *log)
+{
+    log->id = -1;
+    log->row_num = 0;
+    log->col_num = 0;
+    log->text = NULL;
+    log->text_size = 0;
+    log->record_num = 0;
+    log->record_size = 0;
+    log->data = NULL;
+    log->map = NULL;
+    log->map_size = 0;
+}
+
+
+/*
+ * This function returns 1 if the file begins with RNN_LOG_MAGIC, and returns
+ * 0 otherwise.
+ */
+int is_rnn_log_file (const char *filename)
+{
+    char magic[8];
+    FILE *fp;
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        return 0;
+    }
+    int is_log = (fread(magic, 1, 8, fp) == 8 &&
+            memcmp(magic, RNN_LOG_MAGIC, 8) == 0);
+    fclose(fp);
+    return is_log;
+}
+
+
+/*
+ * This function maps a binary log file into memory read-only. Records
+ * appended after the mapping are not visible.
+ * It returns 0 on success, and -1 on failure.
+ */
+int map_rnn_log (
+        struct rnn_log *log,
+        const char *filename)
+{
+    int fd;
+    struct stat st;
+    init_rnn_log(log);
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        print_error_msg("cannot open %s", filename);
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        print_error_msg("cannot stat %s", filename);
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < HEADER_SIZE) {
+        print_error_msg("%s is too short", filename);
+        close(fd);
+        return -1;
+    }
+    log->map_size = st.st_size;
+    log->map = mmap(NULL, log->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (log->map == MAP_FAILED) {
+        print_error_msg("cannot map %s", filename);
+        log->map = NULL;
+        return -1;
+    }
+
+    const char *p = log->map;
+    int32_t header[4];
+    int64_t text_size;
+    memcpy(header, p + 8, sizeof(header));
+    memcpy(&text_size, p + 8 + sizeof(header), sizeof(int64_t));
+    if (memcmp(p, RNN_LOG_MAGIC, 8) != 0) {
+        print_error_msg("%s is not a binary log file", filename);
+        goto error;
+    }
+    if (header[0] != RNN_LOG_VERSION) {
+        print_error_msg("unsupported version %d in %s", header[0], filename);
+        goto error;
+    }
+    if (header[2] < 0 || header[3] < 0 || text_size < 0 ||
+            (uint64_t)text_size > log->map_size ||
+            log->map_size < data_offset(text_size)) {
+        print_error_msg("broken header in %s", filename);
+        goto error;
+    }
+    log->id = header[1];
+    log->row_num = header[2];
+    log->col_num = header[3];
+    log->text = p + HEADER_SIZE;
+    log->text_size = text_size;
+    log->record_size = sizeof(int64_t) +
+        (size_t)log->row_num * log->col_num * sizeof(double);
+    log->data = p + data_offset(text_size);
+    log->record_num = (log->map_size - data_offset(text_size)) /
+        log->record_size;
+    return 0;
+error:
+    unmap_rnn_log(log);
+    return -1;
+}
+
+
+void unmap_rnn_log (struct rnn_log *log)
+{
+    if (log->map != NULL) {
+        munmap(log->map, log->map_size);
+    }
+    init_rnn_log(log);
+}
+
+
+long rnn_log_epoch (
+        const struct rnn_log *log,
+        long index)
+{
+    int64_t epoch;
+    memcpy(&epoch, log->data + index * log->record_size, sizeof(int64_t));
+    return epoch;
+}
+
+/*
+ * This function returns the (row_num x col_num) values of the index-th
+ * record in the mapping.
+ */
+const double* rnn_log_values (
+        const struct rnn_log *log,
+        long index)
+{
+    return (const double*)(log->data + index * log->record_size +
+            sizeof(int64_t));
+}
+
+/*
+ * This function returns the index of the first record whose epoch is greater
+ * than or equal to epoch (record_num if there is no such record). Records are
+ * assumed to be sorted by epoch, so that binary search is used.
+ */
+long rnn_log_find (
+        const struct rnn_log *log,
+        long epoch)
+{
+    long begin = 0, end = log->record_num;
+    while (begin < end) {
+        long mid = begin + (end - begin) / 2;
+        if (rnn_log_epoch(log, mid) < epoch) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return begin;
+}
+
+
+/*
+ * This function writes the header of a binary log file. Records are appended
+ * after it by writing an int64 epoch and (row_num x col_num) doubles.
+ *
+ *   @parameter  id         : index of the series (-1 if not per series)
+ *   @parameter  row_num    : number of rows of values in a record
+ *   @parameter  col_num    : number of columns of values in a record
+ *   @parameter  text       : comment lines of the log
+ *   @parameter  text_size  : size of text
+ *   @parameter  fp         : output stream
+ */
+void fwrite_rnn_log_header (
+        int id,
+        int row_num,
+        int col_num,
+        const char *text,
+        size_t text_size,
+        FILE *fp)
+{
+    const char padding[RNN_LOG_ALIGNMENT] = {0};
+    int32_t header[4] = {RNN_LOG_VERSION, id, row_num, col_num};
+    int64_t size = text_size;
+    FWRITE(RNN_LOG_MAGIC, 8, fp);
+    FWRITE(header, 4, fp);
+    FWRITE(&size, 1, fp);
+    if (text_size > 0) {
+        FWRITE(text, text_size, fp);
+    }
+    size_t padding_size = data_offset(text_size) - (HEADER_SIZE + text_size);
+    if (padding_size > 0) {
+        FWRITE(padding, padding_size, fp);
+    }
+}
@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RNN_LOG_H
+#define RNN_LOG_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * Binary log file
+ *
+ * The file consists of a header followed by records appended at each epoch,
+ * and all integers are stored in the native byte order. Every record has the
+ * same size, so that the k-th record is found without reading the others.
+ *
+ *   magic      : 8 bytes, RNN_LOG_MAGIC
+ *   version    : int32, RNN_LOG_VERSION
+ *   id         : int32, index of the series (-1 if the log is not per series)
+ *   row_num    : int32, number of rows of values in a record
+ *   col_num    : int32, number of columns of values in a record
+ *   text_size  : int64, size of the text
+ *   text       : text_size bytes, the comment lines of the text log
+ *   padding    : up to the next multiple of RNN_LOG_ALIGNMENT bytes
+ *   records    : each record consists of
+ *                  epoch   : int64
+ *                  values  : (row_num x col_num) row-major matrix of double
+ *
+ * A record left incomplete by an interrupted writer is ignored.
+ */
+#define RNN_LOG_MAGIC "\x89RNL\r\n\x1a\n"
+#define RNN_LOG_VERSION 1
+#define RNN_LOG_ALIGNMENT 64
+
+
+typedef struct rnn_log {
+    int id;
+    int row_num;
+    int col_num;
+    const char *text;
+    size_t text_size;
+    long record_num;
+    size_t record_size;
+    const char *data;                   // the first record in the mapping
+
+    void *map;
+    size_t map_size;
+} rnn_log;
+
+
+void init_rnn_log (struct rnn_log *log);
+
+int is_rnn_log_file (const char *filename);
+
+int map_rnn_log (
+        struct rnn_log *log,
+        const char *filename);
+
+void unmap_rnn_log (struct rnn_log *log);
+
+long rnn_log_epoch (
+        const struct rnn_log *log,
+        long index);
+
+const double* rnn_log_values (
+        const struct rnn_log *log,
+        long index);
+
+long rnn_log_find (
+        const struct rnn_log *log,
+        long epoch);
+
+void fwrite_rnn_log_header (
+        int id,
+        int row_num,
+        int col_num,
+        const char *text,
+        size_t text_size,
+        FILE *fp);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "utils.h"
+#include "rnn_model.h"
+
+
+/*
+ * This function indexes the time series in a legacy file, whose position is
+ * just after the model parameters. A stream which is not seekable is copied
+ * to a temporary file in advance.
+ */
+static void index_legacy_file (
+        struct rnn_model *model,
+        FILE *fp)
+{
+    const struct rnn_parameters *rnn_p = &model->rnn_p;
+    FILE *tmp = NULL;
+    long position = ftell(fp);
+    if (position == -1 || fseek(fp, position, SEEK_SET) != 0) {
+        char buf[BUFSIZ];
+        size_t size;
+        if ((tmp = tmpfile()) == NULL) {
+            print_error_msg("cannot open tmpfile");
+            exit(EXIT_FAILURE);
+        }
+        while ((size = fread(buf, 1, sizeof(buf), fp)) > 0) {
+            FWRITE(buf, size, tmp);
+        }
+        fflush(tmp);
+        fseek(tmp, 0L, SEEK_SET);
+        fp = tmp;
+        position = 0;
+    }
+    if ((model->fd = dup(fileno(fp))) == -1) {
+        print_error_msg("`dup' failed");
+        exit(EXIT_FAILURE);
+    }
+
+    const long state_size = sizeof(double) * (3 * rnn_p->c_state_size + 3 *
+            rnn_p->rep_init_size);
+    const long row_size = sizeof(double) * (rnn_p->in_state_size +
+            rnn_p->out_state_size);
+    MALLOC(model->series, model->series_num);
+    for (int i = 0; i < model->series_num; i++) {
+        int length;
+        FREAD(&length, 1, fp);
+        model->series[i].length = length;
+        model->series[i].offset = position + sizeof(int);
+        position += sizeof(int) + state_size + length * row_size;
+        if (fseek(fp, position, SEEK_SET) != 0) {
+            print_error_msg("`fseek' failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (tmp != NULL) {
+        fclose(tmp);
+    }
+}
+
+
+static void index_rnn_file (struct rnn_model *model)
+{
+    const int *in_length = rnn_file_get_section(&model->file,
+            RNN_FILE_IN_STATE_LENGTH, NULL);
+    long offset = 0;
+    MALLOC(model->series, model->series_num);
+    for (int i = 0; i < model->series_num; i++) {
+        model->series[i].length = in_length[i];
+        model->series[i].offset = offset;
+        offset += in_length[i];
+    }
+}
+
+
+/*
+ * This function loads a model saved by rnn-learn. The returned model has a
+ * reference, which is dropped by release_rnn_model.
+ */
+struct rnn_model* new_rnn_model (FILE *fp)
+{
+    struct rnn_model *model;
+    MALLOC(model, 1);
+    init_rnn_file(&model->file);
+    model->fd = -1;
+    if (is_rnn_file_stream(fp)) {
+        if (map_rnn_file_descriptor(&model->file, fileno(fp), "model file")
+                != 0) {
+            exit(EXIT_FAILURE);
+        }
+        model->delay_length = model->file.header->delay_length;
+        rnn_file_map_rnn_parameters(&model->file, &model->rnn_p);
+        model->series_num = model->file.header->series_num;
+        index_rnn_file(model);
+    } else {
+        FREAD(&model->delay_length, 1, fp);
+        fread_rnn_parameters(&model->rnn_p, fp);
+        FREAD(&model->series_num, 1, fp);
+        index_legacy_file(model, fp);
+    }
+    model->ref_count = 1;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&model->mutex, NULL);
+#endif
+    return model;
+}
+
+
+struct rnn_model* new_rnn_model_with_filename (const char *filename)
+{
+    struct rnn_model *model = NULL;
+    FILE *fp;
+    fp = fopen(filename, "rb");
+    if (fp != NULL) {
+        model = new_rnn_model(fp);
+        fclose(fp);
+    } else {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    return model;
+}
+
+
+struct rnn_model* retain_rnn_model (struct rnn_model *model)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&model->mutex);
+#endif
+    model->ref_count++;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&model->mutex);
+#endif
+    return model;
+}
+
+
+void release_rnn_model (struct rnn_model *model)
+{
+    if (model == NULL) {
+        return;
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&model->mutex);
+#endif
+    const int ref_count = --model->ref_count;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&model->mutex);
+#endif
+    if (ref_count > 0) {
+        return;
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_destroy(&model->mutex);
+#endif
+    free_rnn_parameters(&model->rnn_p);
+    unmap_rnn_file(&model->file);
+    if (model->fd != -1) {
+        close(model->fd);
+    }
+    FREE(model->series);
+    FREE(model);
+}
+
+
+static void read_doubles (
+        int fd,
+        double *x,
+        int n,
+        long offset)
+{
+    char *p = (char*)x;
+    size_t size = sizeof(double) * n;
+    if (lseek(fd, offset, SEEK_SET) == -1) {
+        print_error_msg("`lseek' failed");
+        exit(EXIT_FAILURE);
+    }
+    while (size > 0) {
+        ssize_t s = read(fd, p, size);
+        if (s <= 0) {
+            print_error_msg("`read' failed");
+            exit(EXIT_FAILURE);
+        }
+        p += s;
+        size -= s;
+    }
+}
+
+/*
+ * This function reads the initial state of a training series into rnn_s.
+ * The rows of in_state beyond the series are set at random by the generator
+ * rng of the caller, so that it may be called from threads at once.
+ */
+void rnn_model_copy_init_state (
+        struct rnn_model *model,
+        int series_id,
+        struct rnn_state *rnn_s,
+        struct genrand_state *rng)
+{
+    const struct rnn_model_series *src = model->series + series_id;
+    const int in_state_size = model->rnn_p.in_state_size;
+    const int c_state_size = model->rnn_p.c_state_size;
+    const int length = (rnn_s->length < src->length) ? rnn_s->length :
+        src->length;
+
+    if (model->file.map != NULL) {
+        const struct rnn_file *file = &model->file;
+        const double *in_state = rnn_file_get_section(file, RNN_FILE_IN_STATE,
+                NULL);
+        const double *init_c_state = rnn_file_get_section(file,
+                RNN_FILE_INIT_C_STATE, NULL);
+        const double *init_c_inter_state = rnn_file_get_section(file,
+                RNN_FILE_INIT_C_INTER_STATE, NULL);
+        for (int n = 0; n < length; n++) {
+            memcpy(rnn_s->in_state[n], in_state + (src->offset + n) *
+                    in_state_size, sizeof(double) * in_state_size);
+        }
+        memcpy(rnn_s->init_c_state, init_c_state + series_id * c_state_size,
+                sizeof(double) * c_state_size);
+        memcpy(rnn_s->init_c_inter_state, init_c_inter_state + series_id *
+                c_state_size, sizeof(double) * c_state_size);
+    } else {
+        const long row_offset = src->offset + sizeof(double) * (3 *
+                c_state_size + 3 * model->rnn_p.rep_init_size);
+        const long row_size = sizeof(double) * (in_state_size +
+                model->rnn_p.out_state_size);
+#ifdef HAVE_PTHREAD
+        pthread_mutex_lock(&model->mutex);
+#endif
+        for (int n = 0; n < length; n++) {
+            read_doubles(model->fd, rnn_s->in_state[n], in_state_size,
+                    row_offset + n * row_size);
+        }
+        read_doubles(model->fd, rnn_s->init_c_inter_state, c_state_size,
+                src->offset);
+        read_doubles(model->fd, rnn_s->init_c_state, c_state_size,
+                src->offset + sizeof(double) * c_state_size);
+#ifdef HAVE_PTHREAD
+        pthread_mutex_unlock(&model->mutex);
+#endif
+    }
+    for (int n = length; n < rnn_s->length; n++) {
+        for (int i = 0; i < in_state_size; i++) {
+            rnn_s->in_state[n][i] = (2*genrand_real3_r(rng)-1);
+        }
+    }
+}
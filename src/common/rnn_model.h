@@ -0,0 +1,82 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RNN_MODEL_H
+#define RNN_MODEL_H
+
+#include <stdio.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "utils.h"
+#include "rnn.h"
+#include "rnn_file.h"
+
+
+/*
+ * rnn_model holds the parameters of a trained model and the index of its
+ * training series, which are shared by runners (see rnn_runner.h and
+ * rnn_runner2.h). The model is read-only after it is loaded, and is
+ * released when the last reference to it is dropped. Each runner holds only
+ * its own states and a copy of the header of rnn_p, whose arrays belong to
+ * the model.
+ *
+ * A model file (see rnn_file.h) is mapped into memory and its parameters
+ * are used in place, whereas the parameters in a file of the legacy format
+ * are read into memory. In both cases, only the index of the training
+ * series is built: series[i].length is the number of the rows of in_state
+ * of the i-th series, and series[i].offset is the position of the series in
+ * a legacy file (the index of its first row in RNN_FILE_IN_STATE for a
+ * model file).
+ */
+typedef struct rnn_model {
+    int delay_length;
+    struct rnn_parameters rnn_p;
+
+    int series_num;
+    struct rnn_model_series {
+        int length;
+        long offset;
+    } *series;
+
+    /* model file mapped into memory, or descriptor of a legacy file */
+    struct rnn_file file;
+    int fd;
+
+    int ref_count;
+#ifdef HAVE_PTHREAD
+    /* lock of ref_count and of reading from fd */
+    pthread_mutex_t mutex;
+#endif
+} rnn_model;
+
+
+struct rnn_model* new_rnn_model (FILE *fp);
+
+struct rnn_model* new_rnn_model_with_filename (const char *filename);
+
+struct rnn_model* retain_rnn_model (struct rnn_model *model);
+
+void release_rnn_model (struct rnn_model *model);
+
+void rnn_model_copy_init_state (
+        struct rnn_model *model,
+        int series_id,
+        struct rnn_state *rnn_s,
+        struct genrand_state *rng);
+
+#endif
@@ -0,0 +1,565 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "rnn_optimizer.h"
+
+#ifndef MAX_ITERATION_IN_LINE_SEARCH
+#define MAX_ITERATION_IN_LINE_SEARCH 20
+#endif
+
+#define foreach(i,c) \
+    for (int _c = 0; (c)[_c].begin != -1; _c++) \
+        for (int i = (c)[_c].begin, _e = (c)[_c].end; i < _e; i++)
+
+
+static void add_parameter (
+        struct rnn_optimizer *optimizer,
+        double *param,
+        double *delta)
+{
+    if (optimizer->param) {
+        optimizer->param[optimizer->size] = param;
+        optimizer->delta[optimizer->size] = delta;
+    }
+    optimizer->size++;
+}
+
+/*
+ * This function enumerates the learnable parameters of rnn.
+ * If optimizer->param == NULL, the parameters are only counted.
+ */
+static void set_parameter_table (struct rnn_optimizer *optimizer)
+{
+    struct recurrent_neural_network *rnn = optimizer->rnn;
+    struct rnn_parameters *rnn_p = &rnn->rnn_p;
+
+    optimizer->size = 0;
+    optimizer->group_offset[0] = optimizer->size;
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        foreach (j, rnn_p->connection_ci[i]) {
+            add_parameter(optimizer, rnn_p->weight_ci[i] + j,
+                    rnn_p->delta_weight_ci[i] + j);
+        }
+        foreach (j, rnn_p->connection_cc[i]) {
+            add_parameter(optimizer, rnn_p->weight_cc[i] + j,
+                    rnn_p->delta_weight_cc[i] + j);
+        }
+    }
+    for (int i = 0; i < rnn_p->out_state_size; i++) {
+        foreach (j, rnn_p->connection_oc[i]) {
+            add_parameter(optimizer, rnn_p->weight_oc[i] + j,
+                    rnn_p->delta_weight_oc[i] + j);
+        }
+        foreach (j, rnn_p->connection_vc[i]) {
+            add_parameter(optimizer, rnn_p->weight_vc[i] + j,
+                    rnn_p->delta_weight_vc[i] + j);
+        }
+    }
+    optimizer->group_offset[1] = optimizer->size;
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        add_parameter(optimizer, rnn_p->threshold_c + i,
+                rnn_p->delta_threshold_c + i);
+    }
+    for (int i = 0; i < rnn_p->out_state_size; i++) {
+        add_parameter(optimizer, rnn_p->threshold_o + i,
+                rnn_p->delta_threshold_o + i);
+        add_parameter(optimizer, rnn_p->threshold_v + i,
+                rnn_p->delta_threshold_v + i);
+    }
+    optimizer->group_offset[2] = optimizer->size;
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        if (isfinite(rnn_p->tau[i])) {
+            add_parameter(optimizer, rnn_p->tau + i, rnn_p->delta_tau + i);
+        }
+    }
+    optimizer->group_offset[3] = optimizer->size;
+    for (int i = 0; i < rnn_p->rep_init_size; i++) {
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            add_parameter(optimizer, rnn_p->rep_init_c[i] + j,
+                    rnn_p->delta_rep_init_c[i] + j);
+        }
+    }
+    for (int i = 0; i < rnn->series_num; i++) {
+        struct rnn_state *rnn_s = rnn->rnn_s + i;
+        for (int j = 0; j < rnn_p->rep_init_size; j++) {
+            add_parameter(optimizer, rnn_s->beta_init_c + j,
+                    rnn_s->delta_beta_init_c + j);
+        }
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            if (!rnn_p->const_init_c[j]) {
+                add_parameter(optimizer, rnn_s->init_c_inter_state + j,
+                        rnn_s->delta_init_c_inter_state + j);
+            }
+        }
+    }
+    optimizer->group_offset[4] = optimizer->size;
+}
+
+
+/*
+ * This function initializes an optimizer for rnn.
+ * The optimizer refers to the parameters of rnn, so that it must be
+ * initialized again when series are added to rnn.
+ *
+ *   @parameter  optimizer   : optimizer
+ *   @parameter  rnn         : recurrent neural network
+ *   @parameter  type        : type of optimizer
+ *   @parameter  memory_size : number of correction pairs of L-BFGS
+ */
+void init_rnn_optimizer (
+        struct rnn_optimizer *optimizer,
+        struct recurrent_neural_network *rnn,
+        enum rnn_optimizer_t type,
+        int memory_size)
+{
+    assert(memory_size > 0);
+    optimizer->type = type;
+    optimizer->rnn = rnn;
+    optimizer->momentum = 0;
+    optimizer->beta1 = 0.9;
+    optimizer->beta2 = 0.999;
+    optimizer->epsilon = 1e-8;
+    optimizer->memory_size = memory_size;
+
+    optimizer->param = NULL;
+    optimizer->delta = NULL;
+    optimizer->moment1 = NULL;
+    optimizer->moment2 = NULL;
+    optimizer->s = NULL;
+    optimizer->y = NULL;
+    optimizer->sy = NULL;
+    optimizer->prev_param = NULL;
+    optimizer->prev_grad = NULL;
+    optimizer->grad = NULL;
+
+    set_parameter_table(optimizer);
+    if (type == MOMENTUM_OPTIMIZER) {
+        optimizer->size = 0;
+    } else {
+        MALLOC(optimizer->param, optimizer->size);
+        MALLOC(optimizer->delta, optimizer->size);
+        set_parameter_table(optimizer);
+        MALLOC(optimizer->grad, optimizer->size);
+    }
+    if (type == ADAM_OPTIMIZER) {
+        MALLOC(optimizer->moment1, optimizer->size);
+        MALLOC(optimizer->moment2, optimizer->size);
+    } else if (type == LBFGS_OPTIMIZER) {
+        MALLOC2(optimizer->s, memory_size, optimizer->size);
+        MALLOC2(optimizer->y, memory_size, optimizer->size);
+        MALLOC(optimizer->sy, memory_size);
+        MALLOC(optimizer->prev_param, optimizer->size);
+        MALLOC(optimizer->prev_grad, optimizer->size);
+    }
+    rnn_reset_optimizer(optimizer);
+}
+
+
+void free_rnn_optimizer (struct rnn_optimizer *optimizer)
+{
+    FREE(optimizer->param);
+    FREE(optimizer->delta);
+    FREE(optimizer->grad);
+    FREE(optimizer->moment1);
+    FREE(optimizer->moment2);
+    if (optimizer->s) {
+        FREE2(optimizer->s);
+    }
+    if (optimizer->y) {
+        FREE2(optimizer->y);
+    }
+    FREE(optimizer->sy);
+    FREE(optimizer->prev_param);
+    FREE(optimizer->prev_grad);
+}
+
+
+void rnn_reset_optimizer (struct rnn_optimizer *optimizer)
+{
+    optimizer->step = 0;
+    optimizer->memory_num = 0;
+    optimizer->memory_head = 0;
+    for (int i = 0; i < optimizer->size; i++) {
+        *optimizer->delta[i] = 0;
+    }
+    if (optimizer->type == ADAM_OPTIMIZER) {
+        for (int i = 0; i < optimizer->size; i++) {
+            optimizer->moment1[i] = 0;
+            optimizer->moment2[i] = 0;
+        }
+    }
+}
+
+
+/*
+ * The state of the optimizer is stored after a header which contains its type
+ * and size. The hyper-parameters (momentum, beta1, beta2, epsilon) are not
+ * stored because they are given as options.
+ */
+void fwrite_rnn_optimizer (
+        const struct rnn_optimizer *optimizer,
+        FILE *fp)
+{
+    FWRITE(&optimizer->type, 1, fp);
+    FWRITE(&optimizer->size, 1, fp);
+    FWRITE(&optimizer->memory_size, 1, fp);
+    FWRITE(&optimizer->step, 1, fp);
+    if (optimizer->type == ADAM_OPTIMIZER) {
+        FWRITE(optimizer->moment1, optimizer->size, fp);
+        FWRITE(optimizer->moment2, optimizer->size, fp);
+    } else if (optimizer->type == LBFGS_OPTIMIZER) {
+        FWRITE(&optimizer->memory_num, 1, fp);
+        FWRITE(&optimizer->memory_head, 1, fp);
+        for (int i = 0; i < optimizer->memory_size; i++) {
+            FWRITE(optimizer->s[i], optimizer->size, fp);
+            FWRITE(optimizer->y[i], optimizer->size, fp);
+        }
+        FWRITE(optimizer->sy, optimizer->memory_size, fp);
+        FWRITE(optimizer->prev_param, optimizer->size, fp);
+        FWRITE(optimizer->prev_grad, optimizer->size, fp);
+    }
+}
+
+
+static long state_size (
+        enum rnn_optimizer_t type,
+        int size,
+        int memory_size)
+{
+    if (type == ADAM_OPTIMIZER) {
+        return 2 * size * (long)sizeof(double);
+    } else if (type == LBFGS_OPTIMIZER) {
+        return 2 * (long)sizeof(int) + (2L * memory_size * size + memory_size +
+                2 * size) * (long)sizeof(double);
+    }
+    return 0;
+}
+
+/*
+ * This function reads the state of an optimizer written by
+ * fwrite_rnn_optimizer. If the file has no state (end of file) or the state
+ * does not match the optimizer (e.g. the type has been changed), the state is
+ * skipped and the optimizer is kept unchanged.
+ *
+ *   @return  1 if the state is restored, and 0 otherwise
+ */
+int fread_rnn_optimizer (
+        struct rnn_optimizer *optimizer,
+        FILE *fp)
+{
+    enum rnn_optimizer_t type;
+    int size, memory_size;
+    long step;
+
+    if (fread(&type, sizeof(type), 1, fp) != 1) {
+        return 0;
+    }
+    FREAD(&size, 1, fp);
+    FREAD(&memory_size, 1, fp);
+    FREAD(&step, 1, fp);
+    if (type != optimizer->type || size != optimizer->size ||
+            (type == LBFGS_OPTIMIZER && memory_size != optimizer->memory_size)) {
+        if (fseek(fp, state_size(type, size, memory_size), SEEK_CUR) != 0) {
+            print_error_msg("`fseek' failed");
+            exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+    optimizer->step = step;
+    if (type == ADAM_OPTIMIZER) {
+        FREAD(optimizer->moment1, size, fp);
+        FREAD(optimizer->moment2, size, fp);
+    } else if (type == LBFGS_OPTIMIZER) {
+        FREAD(&optimizer->memory_num, 1, fp);
+        FREAD(&optimizer->memory_head, 1, fp);
+        for (int i = 0; i < memory_size; i++) {
+            FREAD(optimizer->s[i], size, fp);
+            FREAD(optimizer->y[i], size, fp);
+        }
+        FREAD(optimizer->sy, memory_size, fp);
+        FREAD(optimizer->prev_param, size, fp);
+        FREAD(optimizer->prev_grad, size, fp);
+    }
+    return 1;
+}
+
+
+
+static void gather_gradient (struct rnn_optimizer *optimizer)
+{
+    const struct rnn_parameters *rnn_p = &optimizer->rnn->rnn_p;
+    const int fixed[4] = {rnn_p->fixed_weight, rnn_p->fixed_threshold,
+        rnn_p->fixed_tau, rnn_p->fixed_init_c_state};
+    for (int k = 0; k < 4; k++) {
+        for (int i = optimizer->group_offset[k];
+                i < optimizer->group_offset[k+1]; i++) {
+            optimizer->grad[i] = fixed[k] ? 0 : *optimizer->delta[i];
+        }
+    }
+}
+
+
+static void adam_update_delta (struct rnn_optimizer *optimizer)
+{
+    const double beta1 = optimizer->beta1;
+    const double beta2 = optimizer->beta2;
+    optimizer->step++;
+    const double c1 = 1.0 - pow(beta1, optimizer->step);
+    const double c2 = 1.0 - pow(beta2, optimizer->step);
+    for (int i = 0; i < optimizer->size; i++) {
+        const double g = optimizer->grad[i];
+        optimizer->moment1[i] = beta1 * optimizer->moment1[i] +
+            (1.0 - beta1) * g;
+        optimizer->moment2[i] = beta2 * optimizer->moment2[i] +
+            (1.0 - beta2) * g * g;
+        *optimizer->delta[i] = (optimizer->moment1[i] / c1) /
+            (sqrt(optimizer->moment2[i] / c2) + optimizer->epsilon);
+    }
+}
+
+
+static double dot_product (
+        const double *x,
+        const double *y,
+        int size)
+{
+    double sum = 0;
+    for (int i = 0; i < size; i++) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+/*
+ * Since the gradient grad is the direction of steepest descent of the error
+ * (delta of rnn_update_delta_parameters), y is the difference of the
+ * gradients of the error, i.e. prev_grad - grad.
+ */
+static void lbfgs_update_delta (struct rnn_optimizer *optimizer)
+{
+    const int size = optimizer->size;
+    const int memory_size = optimizer->memory_size;
+    double *grad = optimizer->grad;
+
+    if (optimizer->step > 0) {
+        double sy = 0, ss = 0, yy = 0;
+        for (int i = 0; i < size; i++) {
+            double s = *optimizer->param[i] - optimizer->prev_param[i];
+            double y = optimizer->prev_grad[i] - grad[i];
+            sy += s * y;
+            ss += s * s;
+            yy += y * y;
+        }
+        /* the pair is stored only if the curvature condition holds */
+        if (sy > 1e-10 * sqrt(ss * yy)) {
+            int n = (optimizer->memory_head + 1) % memory_size;
+            for (int i = 0; i < size; i++) {
+                optimizer->s[n][i] = *optimizer->param[i] -
+                    optimizer->prev_param[i];
+                optimizer->y[n][i] = optimizer->prev_grad[i] - grad[i];
+            }
+            optimizer->sy[n] = sy;
+            optimizer->memory_head = n;
+            if (optimizer->memory_num < memory_size) {
+                optimizer->memory_num++;
+            }
+        }
+    }
+    optimizer->step++;
+    for (int i = 0; i < size; i++) {
+        optimizer->prev_param[i] = *optimizer->param[i];
+        optimizer->prev_grad[i] = grad[i];
+    }
+
+    double alpha[memory_size];
+    double *q = grad;
+    for (int k = 0; k < optimizer->memory_num; k++) {
+        int n = (optimizer->memory_head - k + memory_size) % memory_size;
+        alpha[n] = dot_product(optimizer->s[n], q, size) / optimizer->sy[n];
+        for (int i = 0; i < size; i++) {
+            q[i] -= alpha[n] * optimizer->y[n][i];
+        }
+    }
+    double gamma;
+    if (optimizer->memory_num > 0) {
+        const int n = optimizer->memory_head;
+        gamma = optimizer->sy[n] / dot_product(optimizer->y[n],
+                optimizer->y[n], size);
+    } else {
+        double norm = sqrt(dot_product(q, q, size));
+        gamma = (norm > 0) ? 1.0 / norm : 0;
+    }
+    for (int i = 0; i < size; i++) {
+        q[i] *= gamma;
+    }
+    for (int k = optimizer->memory_num - 1; k >= 0; k--) {
+        int n = (optimizer->memory_head - k + memory_size) % memory_size;
+        double beta = dot_product(optimizer->y[n], q, size) / optimizer->sy[n];
+        for (int i = 0; i < size; i++) {
+            q[i] += (alpha[n] - beta) * optimizer->s[n][i];
+        }
+    }
+    for (int i = 0; i < size; i++) {
+        *optimizer->delta[i] = q[i];
+    }
+}
+
+
+static void restore_parameters (struct rnn_optimizer *optimizer)
+{
+    struct recurrent_neural_network *rnn = optimizer->rnn;
+    for (int i = 0; i < optimizer->size; i++) {
+        *optimizer->param[i] = optimizer->prev_param[i];
+    }
+    rnn_set_tau(&rnn->rnn_p, rnn->rnn_p.tau);
+    for (int i = 0; i < rnn->series_num; i++) {
+        rnn_update_init_c_inter_state(rnn->rnn_s + i, 0);
+    }
+}
+
+/*
+ * This function returns the objective which L-BFGS maximizes, i.e. the log
+ * posterior whose gradient is computed by rnn_update_delta_parameters. The
+ * forward dynamics is computed with the current parameters.
+ *
+ *   @parameter  optimizer  : optimizer
+ */
+double rnn_optimizer_get_objective (struct rnn_optimizer *optimizer)
+{
+    struct recurrent_neural_network *rnn = optimizer->rnn;
+    rnn_forward_dynamics_forall(rnn);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < rnn->series_num; i++) {
+        rnn_set_likelihood(rnn->rnn_s + i);
+    }
+    return rnn_get_total_likelihood(rnn) + rnn_get_log_prior(rnn);
+}
+
+/*
+ * This function updates the parameters along the direction of L-BFGS by the
+ * backtracking line search. The step length starts from rho, and is halved
+ * until the objective does not decrease. If no step is accepted, the
+ * parameters are restored and the correction pairs are discarded.
+ */
+static void lbfgs_line_search (
+        struct rnn_optimizer *optimizer,
+        double rho)
+{
+    struct recurrent_neural_network *rnn = optimizer->rnn;
+    const double objective = rnn_get_total_likelihood(rnn) +
+        rnn_get_log_prior(rnn);
+    for (int count = 0; count < MAX_ITERATION_IN_LINE_SEARCH; count++) {
+        rnn_update_parameters(rnn, rho, rho, rho);
+        if (rnn_optimizer_get_objective(optimizer) >= objective) {
+            return;
+        }
+        restore_parameters(optimizer);
+        rho *= 0.5;
+    }
+    optimizer->memory_num = 0;
+}
+
+
+#ifdef ENABLE_ATTRACTION_OF_INIT_C
+/*
+ * The attraction of the initial states (see rnn_set_delta_i) is not the
+ * gradient of any objective. It is removed from the gradient for L-BFGS,
+ * whose line search evaluates rnn_optimizer_get_objective.
+ */
+static void remove_attraction_of_init_c (struct rnn_optimizer *optimizer)
+{
+    struct recurrent_neural_network *rnn = optimizer->rnn;
+    if (rnn->rnn_p.fixed_init_c_state) {
+        return;
+    }
+    for (int k = 0; k < rnn->series_num; k++) {
+        struct rnn_state *rnn_s = rnn->rnn_s + k;
+        double attraction[rnn->rnn_p.c_state_size];
+        rnn_get_attraction_of_init_c(rnn_s, attraction);
+        for (int i = 0; i < rnn->rnn_p.c_state_size; i++) {
+            rnn_s->delta_init_c_inter_state[i] -= attraction[i];
+        }
+    }
+}
+#endif
+
+/*
+ * This function computes the update direction of the parameters.
+ * It replaces rnn_update_delta_parameters.
+ */
+void rnn_optimizer_update_delta_parameters (struct rnn_optimizer *optimizer)
+{
+    if (optimizer->type == MOMENTUM_OPTIMIZER) {
+        rnn_update_delta_parameters(optimizer->rnn, optimizer->momentum);
+        optimizer->step++;
+        return;
+    }
+    rnn_update_delta_parameters(optimizer->rnn, 0);
+#ifdef ENABLE_ATTRACTION_OF_INIT_C
+    if (optimizer->type == LBFGS_OPTIMIZER) {
+        remove_attraction_of_init_c(optimizer);
+    }
+#endif
+    gather_gradient(optimizer);
+    if (optimizer->type == ADAM_OPTIMIZER) {
+        adam_update_delta(optimizer);
+    } else {
+        lbfgs_update_delta(optimizer);
+    }
+}
+
+
+/*
+ * This function computes learning of a recurrent neural network by the
+ * optimizer. For MOMENTUM_OPTIMIZER, the learning rate is scaled in the same
+ * way as rnn_learn_s. The other optimizers are invariant to the scale of the
+ * gradient, and rho is used as it is (for LBFGS_OPTIMIZER, rho is the initial
+ * step length of the line search).
+ *
+ *   @parameter  optimizer  : optimizer
+ *   @parameter  rho        : learning rate
+ */
+void rnn_learn_with_optimizer (
+        struct rnn_optimizer *optimizer,
+        double rho)
+{
+    struct recurrent_neural_network *rnn = optimizer->rnn;
+    rnn_forward_backward_dynamics_forall(rnn);
+    rnn_optimizer_update_delta_parameters(optimizer);
+    if (optimizer->type == MOMENTUM_OPTIMIZER) {
+        double r = 1.0 / (rnn_get_total_length(rnn) *
+                rnn->rnn_p.out_state_size);
+        rnn_update_parameters(rnn, r * rho, r * rho,
+                rho / rnn->rnn_p.out_state_size);
+    } else if (optimizer->type == ADAM_OPTIMIZER) {
+        rnn_update_parameters(rnn, rho, rho, rho);
+    } else {
+        lbfgs_line_search(optimizer, rho);
+    }
+}
+
@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RNN_OPTIMIZER_H
+#define RNN_OPTIMIZER_H
+
+#include <stdio.h>
+
+#include "rnn.h"
+
+
+typedef enum rnn_optimizer_t {
+    MOMENTUM_OPTIMIZER,
+    ADAM_OPTIMIZER,
+    LBFGS_OPTIMIZER
+} rnn_optimizer_t;
+
+
+/*
+ * Optimizer which turns the gradient computed by rnn_update_delta_parameters
+ * into the update direction used by rnn_update_parameters.
+ * MOMENTUM_OPTIMIZER is the gradient descent with momentum (the same as
+ * rnn_learn_s), ADAM_OPTIMIZER is Adam, and LBFGS_OPTIMIZER is the full-batch
+ * limited-memory BFGS method with a backtracking line search.
+ */
+typedef struct rnn_optimizer {
+    enum rnn_optimizer_t type;
+    struct recurrent_neural_network *rnn;
+
+    /*
+     * The learnable parameters of rnn and their update directions.
+     * group_offset[k] <= i < group_offset[k+1] holds weights (k=0),
+     * thresholds (k=1), time constants (k=2) and initial states (k=3).
+     */
+    int size;
+    double **param;
+    double **delta;
+    int group_offset[5];
+
+    long step;                  // number of updates
+    double momentum;            // momentum of learning (MOMENTUM_OPTIMIZER)
+
+    /* parameters and moment estimates of Adam */
+    double beta1;
+    double beta2;
+    double epsilon;
+    double *moment1;
+    double *moment2;
+
+    /* correction pairs of L-BFGS stored in a ring buffer */
+    int memory_size;
+    int memory_num;
+    int memory_head;
+    double **s;
+    double **y;
+    double *sy;
+    double *prev_param;
+    double *prev_grad;
+
+    double *grad;
+} rnn_optimizer;
+
+
+void init_rnn_optimizer (
+        struct rnn_optimizer *optimizer,
+        struct recurrent_neural_network *rnn,
+        enum rnn_optimizer_t type,
+        int memory_size);
+
+void free_rnn_optimizer (struct rnn_optimizer *optimizer);
+
+void rnn_reset_optimizer (struct rnn_optimizer *optimizer);
+
+void fwrite_rnn_optimizer (
+        const struct rnn_optimizer *optimizer,
+        FILE *fp);
+
+int fread_rnn_optimizer (
+        struct rnn_optimizer *optimizer,
+        FILE *fp);
+
+double rnn_optimizer_get_objective (struct rnn_optimizer *optimizer);
+
+void rnn_optimizer_update_delta_parameters (struct rnn_optimizer *optimizer);
+
+void rnn_learn_with_optimizer (
+        struct rnn_optimizer *optimizer,
+        double rho);
+
+#endif
+
@@ -50,16 +50,17 @@ void _delete_rnn_runner (struct rnn_runner *runner)
 
 
 
+/*
+ * This function initializes a runner with a model saved by rnn-learn.
+ * The model is loaded only for this runner (see rnn_model.h).
+ */
 void init_rnn_runner (
         struct rnn_runner *runner,
         FILE *fp)
 {
-    int delay_length;
-
-    FREAD(&delay_length, 1, fp);
-    fread_recurrent_neural_network(&runner->rnn, fp);
-    rnn_add_target(&runner->rnn, delay_length, NULL, NULL);
-    runner->id = runner->rnn.series_num - 1;
+    struct rnn_model *model = new_rnn_model(fp);
+    init_rnn_runner_with_model(runner, model);
+    release_rnn_model(model);
 }
 
 
@@ -79,41 +80,55 @@ void init_rnn_runner_with_filename (
 }
 
 
-void free_rnn_runner (struct rnn_runner *runner)
+/*
+ * This function initializes a runner which shares the parameters of model,
+ * and takes a reference to the model.
+ */
+void init_rnn_runner_with_model (
+        struct rnn_runner *runner,
+        struct rnn_model *model)
 {
-    free_recurrent_neural_network(&runner->rnn);
+    runner->model = retain_rnn_model(model);
+    runner->rnn.rnn_p = model->rnn_p;
+    runner->rnn.series_num = 0;
+    runner->rnn.rnn_s = NULL;
+    rnn_add_session_target(&runner->rnn, model->delay_length);
+    runner->id = runner->rnn.series_num - 1;
+
+    struct rnn_state *rnn_s = runner->rnn.rnn_s + runner->id;
+    runner->in_base = rnn_s->in_state;
+    MALLOC(runner->in_ring, 2 * rnn_s->length);
+    for (int n = 0; n < rnn_s->length; n++) {
+        runner->in_ring[n] = runner->in_base[n];
+        runner->in_ring[n + rnn_s->length] = runner->in_base[n];
+    }
+    runner->in_head = 0;
+    rnn_s->in_state = runner->in_ring;
+    split_genrand(&runner->rng);
 }
 
 
-static void copy_init_state (
-        struct rnn_state *dst,
-        struct rnn_state *src)
+void free_rnn_runner (struct rnn_runner *runner)
 {
-    for (int n = 0; n < dst->length; n++) {
-        if (n < src->length) {
-            memmove(dst->in_state[n], src->in_state[n], sizeof(double) *
-                    dst->rnn_p->in_state_size);
-        } else {
-            for (int i = 0; i < dst->rnn_p->in_state_size; i++) {
-                dst->in_state[n][i] = (2*genrand_real3()-1);
-            }
-        }
-    }
-    memmove(dst->init_c_state, src->init_c_state, sizeof(double) *
-            dst->rnn_p->c_state_size);
-    memmove(dst->init_c_inter_state, src->init_c_inter_state, sizeof(double) *
-            dst->rnn_p->c_state_size);
+    runner->rnn.rnn_s[runner->id].in_state = runner->in_base;
+    FREE(runner->in_ring);
+    rnn_clean_target(&runner->rnn);
+    release_rnn_model(runner->model);
+    runner->model = NULL;
 }
 
-static void random_init_state (struct rnn_state *rnn_s)
+
+static void random_init_state (
+        struct rnn_state *rnn_s,
+        struct genrand_state *rng)
 {
     for (int n = 0; n < rnn_s->length; n++) {
         for (int i = 0; i < rnn_s->rnn_p->in_state_size; i++) {
-            rnn_s->in_state[n][i] = (2*genrand_real3()-1);
+            rnn_s->in_state[n][i] = (2*genrand_real3_r(rng)-1);
         }
     }
     for (int i = 0; i < rnn_s->rnn_p->c_state_size; i++) {
-        rnn_s->init_c_state[i] = (2*genrand_real3()-1);
+        rnn_s->init_c_state[i] = (2*genrand_real3_r(rng)-1);
         rnn_s->init_c_inter_state[i] = atanh(rnn_s->init_c_state[i]);
     }
 }
@@ -123,11 +138,11 @@ void set_init_state_of_rnn_runner (
         struct rnn_runner *runner,
         int series_id)
 {
-    if (series_id >= 0 && series_id < runner->id) {
-        copy_init_state(runner->rnn.rnn_s + runner->id, runner->rnn.rnn_s +
-                series_id);
+    if (series_id >= 0 && series_id < runner->model->series_num) {
+        rnn_model_copy_init_state(runner->model, series_id,
+                runner->rnn.rnn_s + runner->id, &runner->rng);
     } else {
-        random_init_state(runner->rnn.rnn_s + runner->id);
+        random_init_state(runner->rnn.rnn_s + runner->id, &runner->rng);
     }
 }
 
@@ -137,8 +152,34 @@ void set_init_state_of_rnn_runner (
 /******************************************************************************/
 
 
-static void rnn_fmap (struct rnn_state *rnn_s)
+/*
+ * This function feeds the output of a step back to the delay line. The
+ * oldest row of the delay line, which is consumed as the input, is replaced
+ * with the output by advancing the head of the ring buffer, so that the cost
+ * does not depend on the delay length. The state of the step becomes the
+ * initial state of the next step.
+ */
+static void shift_state (struct rnn_runner *runner)
+{
+    struct rnn_state *rnn_s = runner->rnn.rnn_s + runner->id;
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+
+    memmove(rnn_s->in_state[0], rnn_s->out_state[0], sizeof(double) *
+            rnn_p->in_state_size);
+    runner->in_head = (runner->in_head + 1) % rnn_s->length;
+    rnn_s->in_state = runner->in_ring + runner->in_head;
+    memmove(rnn_s->init_c_state, rnn_s->c_state[0], sizeof(double) *
+            rnn_p->c_state_size);
+    memmove(rnn_s->init_c_inter_state, rnn_s->c_inter_state[0], sizeof(double) *
+            rnn_p->c_state_size);
+}
+
+/*
+ * This function computes one step of the closed-loop dynamics.
+ */
+static void rnn_fmap (struct rnn_runner *runner)
 {
+    struct rnn_state *rnn_s = runner->rnn.rnn_s + runner->id;
     const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
 
     assert(rnn_p->in_state_size <= rnn_p->out_state_size);
@@ -147,23 +188,75 @@ static void rnn_fmap (struct rnn_state *rnn_s)
             rnn_s->init_c_state, rnn_s->c_inputsum[0], rnn_s->c_inter_state[0],
             rnn_s->c_state[0], rnn_s->o_inter_state[0], rnn_s->out_state[0],
             rnn_s->v_inter_state[0], rnn_s->var_state[0]);
+    shift_state(runner);
+}
+
 
-    for (int n = 1; n < rnn_s->length; n++) {
-        memmove(rnn_s->in_state[n-1], rnn_s->in_state[n], sizeof(double) *
-                rnn_p->in_state_size);
+void update_rnn_runner (struct rnn_runner *runner)
+{
+    rnn_fmap(runner);
+}
+
+
+/*
+ * This function updates num runners by step_num steps. The runners which
+ * share a model (see rnn_model.h) are updated together in blocks of
+ * RNN_RUNNER_BATCH_SIZE runners by rnn_forward_map_batch, so that the
+ * weights are read once per block and step instead of once per runner. The
+ * results are the same as those of update_rnn_runner called step_num times
+ * for each runner. Runners with different models may be mixed, and
+ * consecutive runners with the same model form a block. The work arrays of
+ * rnn_forward_map_batch are allocated once for all the blocks and steps.
+ */
+void update_rnn_runner_batch_with_steps (
+        struct rnn_runner **runners,
+        int num,
+        int step_num)
+{
+    struct rnn_state *rnn_s[RNN_RUNNER_BATCH_SIZE];
+    struct rnn_batch_buffer buffer;
+    int in_state_size = 0, c_state_size = 0;
+    for (int k = 0; k < num; k++) {
+        const struct rnn_parameters *rnn_p = &runners[k]->rnn.rnn_p;
+        if (in_state_size < rnn_p->in_state_size) {
+            in_state_size = rnn_p->in_state_size;
+        }
+        if (c_state_size < rnn_p->c_state_size) {
+            c_state_size = rnn_p->c_state_size;
+        }
     }
-    memmove(rnn_s->in_state[rnn_s->length-1], rnn_s->out_state[0],
-            sizeof(double) * rnn_p->in_state_size);
-    memmove(rnn_s->init_c_state, rnn_s->c_state[0], sizeof(double) *
-            rnn_p->c_state_size);
-    memmove(rnn_s->init_c_inter_state, rnn_s->c_inter_state[0], sizeof(double) *
-            rnn_p->c_state_size);
+    init_rnn_batch_buffer(&buffer, (num < RNN_RUNNER_BATCH_SIZE) ? num :
+            RNN_RUNNER_BATCH_SIZE, in_state_size, c_state_size);
+    int begin = 0;
+    while (begin < num) {
+        const struct rnn_model *model = runners[begin]->model;
+        const struct rnn_parameters *rnn_p = &runners[begin]->rnn.rnn_p;
+        int end = begin + 1;
+        while (end < num && end - begin < RNN_RUNNER_BATCH_SIZE &&
+                runners[end]->model == model) {
+            end++;
+        }
+        assert(rnn_p->in_state_size <= rnn_p->out_state_size);
+        for (int n = 0; n < step_num; n++) {
+            for (int k = begin; k < end; k++) {
+                rnn_s[k - begin] = runners[k]->rnn.rnn_s + runners[k]->id;
+            }
+            rnn_forward_map_batch(rnn_p, rnn_s, end - begin, &buffer);
+            for (int k = begin; k < end; k++) {
+                shift_state(runners[k]);
+            }
+        }
+        begin = end;
+    }
+    free_rnn_batch_buffer(&buffer);
 }
 
 
-void update_rnn_runner (struct rnn_runner *runner)
+void update_rnn_runner_batch (
+        struct rnn_runner **runners,
+        int num)
 {
-    rnn_fmap(runner->rnn.rnn_s + runner->id);
+    update_rnn_runner_batch_with_steps(runners, num, 1);
 }
 
 
@@ -204,7 +297,7 @@ int rnn_output_type_from_runner (struct rnn_runner *runner)
 
 int rnn_target_num_from_runner (struct rnn_runner *runner)
 {
-    return runner->id;
+    return runner->model->series_num;
 }
 
 double* rnn_in_state_from_runner (struct rnn_runner *runner)
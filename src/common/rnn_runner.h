@@ -18,11 +18,42 @@
 #define RNN_RUNNER_H
 
 #include "rnn.h"
+#include "rnn_model.h"
 
 
+#define RNN_RUNNER_BATCH_SIZE 64
+
+/*
+ * The runner keeps only its own state in rnn, and the parameters and the
+ * training series are those of model, which may be shared by other runners
+ * (see rnn_model.h). rnn.rnn_p is a copy of the header of model->rnn_p, and
+ * its arrays belong to the model. Runners sharing a model can be updated
+ * from different threads at once.
+ */
 typedef struct rnn_runner {
     int id;
     struct recurrent_neural_network rnn;
+    struct rnn_model *model;
+
+    /*
+     * The rows of in_state of the runner form a delay line, which is kept
+     * as a ring buffer. in_ring has twice as many row pointers as the delay
+     * line (in_ring[n] and in_ring[n+length] refer to the same row), and
+     * in_state of the runner points to in_ring + in_head, so that the rows
+     * are read in order without wrapping. in_base is the original array of
+     * in_state, which is restored before the state is freed.
+     */
+    double **in_ring;
+    double **in_base;
+    int in_head;
+
+    /*
+     * rng is the random number generator of the runner, which is seeded
+     * from the global one (see utils.h) at the initialization. The random
+     * initial state of the runner is drawn from rng, so that runners can
+     * be used from threads at once.
+     */
+    struct genrand_state rng;
 } rnn_runner;
 
 
@@ -40,6 +71,10 @@ void init_rnn_runner_with_filename (
         struct rnn_runner *runner,
         const char *filename);
 
+void init_rnn_runner_with_model (
+        struct rnn_runner *runner,
+        struct rnn_model *model);
+
 void free_rnn_runner (struct rnn_runner *runner);
 
 void set_init_state_of_rnn_runner (
@@ -48,6 +83,15 @@ void set_init_state_of_rnn_runner (
 
 void update_rnn_runner (struct rnn_runner *runner);
 
+void update_rnn_runner_batch (
+        struct rnn_runner **runners,
+        int num);
+
+void update_rnn_runner_batch_with_steps (
+        struct rnn_runner **runners,
+        int num,
+        int step_num);
+
 
 int rnn_in_state_size_from_runner (struct rnn_runner *runner);
 int rnn_c_state_size_from_runner (struct rnn_runner *runner);
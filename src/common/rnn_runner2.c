@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include <assert.h>
 
 #include "utils.h"
@@ -50,21 +51,66 @@ void _delete_rnn_runner2 (struct rnn_runner2 *runner)
 
 
 
+static double*** window_array (
+        struct rnn_state *rnn_s,
+        int k,
+        int *size)
+{
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+    switch (k) {
+    case 0: *size = rnn_p->in_state_size; return &rnn_s->in_state;
+    case 1: *size = rnn_p->out_state_size; return &rnn_s->teach_state;
+    case 2: *size = rnn_p->c_state_size; return &rnn_s->c_inputsum;
+    case 3: *size = rnn_p->c_state_size; return &rnn_s->c_inter_state;
+    case 4: *size = rnn_p->c_state_size; return &rnn_s->c_state;
+    case 5: *size = rnn_p->out_state_size; return &rnn_s->o_inter_state;
+    case 6: *size = rnn_p->out_state_size; return &rnn_s->out_state;
+    case 7: *size = rnn_p->out_state_size; return &rnn_s->v_inter_state;
+    default: *size = rnn_p->out_state_size; return &rnn_s->var_state;
+    }
+}
+
+static void init_window_ring (struct rnn_runner2 *runner)
+{
+    struct rnn_state *rnn_s = runner->rnn.rnn_s + runner->id;
+    const int length = rnn_s->length;
+    for (int k = 0; k < RNN_RUNNER2_WINDOW_ARRAY_NUM; k++) {
+        int size;
+        double ***x = window_array(rnn_s, k, &size);
+        runner->base[k] = *x;
+        MALLOC(runner->ring[k], 2 * length);
+        for (int n = 0; n < length; n++) {
+            runner->ring[k][n] = runner->base[k][n];
+            runner->ring[k][n + length] = runner->base[k][n];
+        }
+        *x = runner->ring[k];
+    }
+    runner->head = 0;
+}
+
+static void free_window_ring (struct rnn_runner2 *runner)
+{
+    struct rnn_state *rnn_s = runner->rnn.rnn_s + runner->id;
+    for (int k = 0; k < RNN_RUNNER2_WINDOW_ARRAY_NUM; k++) {
+        int size;
+        *window_array(rnn_s, k, &size) = runner->base[k];
+        FREE(runner->ring[k]);
+    }
+}
+
+
+/*
+ * This function initializes a runner with a model saved by rnn-learn.
+ * The model is loaded only for this runner (see rnn_model.h).
+ */
 void init_rnn_runner2 (
         struct rnn_runner2 *runner,
         FILE *fp,
         int window_length)
 {
-    assert(window_length > 0);
-    FREAD(&runner->delay_length, 1, fp);
-    fread_recurrent_neural_network(&runner->rnn, fp);
-    rnn_add_target(&runner->rnn, window_length + runner->delay_length, NULL,
-            NULL);
-    runner->id = runner->rnn.series_num - 1;
-    runner->rnn.rnn_p.fixed_weight = 1;
-    runner->rnn.rnn_p.fixed_threshold = 1;
-    runner->rnn.rnn_p.fixed_tau = 1;
-    runner->rnn.rnn_p.fixed_init_c_state = 0;
+    struct rnn_model *model = new_rnn_model(fp);
+    init_rnn_runner2_with_model(runner, model, window_length);
+    release_rnn_model(model);
 }
 
 
@@ -85,41 +131,59 @@ void init_rnn_runner2_with_filename (
 }
 
 
-void free_rnn_runner2 (struct rnn_runner2 *runner)
+/*
+ * This function initializes a runner which shares the parameters of model,
+ * and takes a reference to the model.
+ */
+void init_rnn_runner2_with_model (
+        struct rnn_runner2 *runner,
+        struct rnn_model *model,
+        int window_length)
 {
-    free_recurrent_neural_network(&runner->rnn);
+    assert(window_length > 0);
+    runner->model = retain_rnn_model(model);
+    runner->delay_length = model->delay_length;
+    runner->rnn.rnn_p = model->rnn_p;
+    runner->rnn.rnn_p.fixed_weight = 1;
+    runner->rnn.rnn_p.fixed_threshold = 1;
+    runner->rnn.rnn_p.fixed_tau = 1;
+    runner->rnn.rnn_p.fixed_init_c_state = 0;
+    runner->rnn.series_num = 0;
+    runner->rnn.rnn_s = NULL;
+    rnn_add_session_target(&runner->rnn, window_length + runner->delay_length);
+    runner->id = runner->rnn.series_num - 1;
+    init_window_ring(runner);
+    runner->incremental = 0;
+    runner->tolerance = 0;
+    runner->valid_length = 0;
+    runner->iteration_cost = 0;
+    runner->forward_cost = 0;
+    runner->latency_num = 0;
+    runner->latency_head = 0;
+    split_genrand(&runner->rng);
 }
 
 
-static void copy_init_state (
-        struct rnn_state *dst,
-        struct rnn_state *src)
+void free_rnn_runner2 (struct rnn_runner2 *runner)
 {
-    for (int n = 0; n < dst->length; n++) {
-        if (n < src->length) {
-            memmove(dst->in_state[n], src->in_state[n], sizeof(double) *
-                    dst->rnn_p->in_state_size);
-        } else {
-            for (int i = 0; i < dst->rnn_p->in_state_size; i++) {
-                dst->in_state[n][i] = (2*genrand_real3()-1);
-            }
-        }
-    }
-    memmove(dst->init_c_state, src->init_c_state, sizeof(double) *
-            dst->rnn_p->c_state_size);
-    memmove(dst->init_c_inter_state, src->init_c_inter_state, sizeof(double) *
-            dst->rnn_p->c_state_size);
+    free_window_ring(runner);
+    rnn_clean_target(&runner->rnn);
+    release_rnn_model(runner->model);
+    runner->model = NULL;
 }
 
-static void random_init_state (struct rnn_state *rnn_s)
+
+static void random_init_state (
+        struct rnn_state *rnn_s,
+        struct genrand_state *rng)
 {
     for (int n = 0; n < rnn_s->length; n++) {
         for (int i = 0; i < rnn_s->rnn_p->in_state_size; i++) {
-            rnn_s->in_state[n][i] = (2*genrand_real3()-1);
+            rnn_s->in_state[n][i] = (2*genrand_real3_r(rng)-1);
         }
     }
     for (int i = 0; i < rnn_s->rnn_p->c_state_size; i++) {
-        rnn_s->init_c_state[i] = (2*genrand_real3()-1);
+        rnn_s->init_c_state[i] = (2*genrand_real3_r(rng)-1);
         rnn_s->init_c_inter_state[i] = atanh(rnn_s->init_c_state[i]);
     }
 }
@@ -129,11 +193,12 @@ void set_init_state_of_rnn_runner2 (
         struct rnn_runner2 *runner,
         int series_id)
 {
-    if (series_id >= 0 && series_id < runner->id) {
-        copy_init_state(runner->rnn.rnn_s + runner->id, runner->rnn.rnn_s +
-                series_id);
+    runner->valid_length = 0;
+    if (series_id >= 0 && series_id < runner->model->series_num) {
+        rnn_model_copy_init_state(runner->model, series_id,
+                runner->rnn.rnn_s + runner->id, &runner->rng);
     } else {
-        random_init_state(runner->rnn.rnn_s + runner->id);
+        random_init_state(runner->rnn.rnn_s + runner->id, &runner->rng);
     }
 }
 
@@ -143,37 +208,163 @@ void set_init_state_of_rnn_runner2 (
 /******************************************************************************/
 
 
-static void rnn_fmap (
-        struct rnn_state *rnn_s,
-        int delay_length)
+/*
+ * This function computes the forward dynamics of the window from step
+ * valid_length, and the steps before it are reused.
+ */
+static void rnn_forward_dynamics_from_valid_length (
+        struct rnn_runner2 *runner,
+        struct rnn_state *rnn_s)
+{
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+    for (int n = runner->valid_length; n < rnn_s->length; n++) {
+        const double *prev_c_inter_state = (n == 0) ?
+            rnn_s->init_c_inter_state : rnn_s->c_inter_state[n-1];
+        const double *prev_c_state = (n == 0) ? rnn_s->init_c_state :
+            rnn_s->c_state[n-1];
+        rnn_forward_map(rnn_p, rnn_s->in_state[n], prev_c_inter_state,
+                prev_c_state, rnn_s->c_inputsum[n], rnn_s->c_inter_state[n],
+                rnn_s->c_state[n], rnn_s->o_inter_state[n],
+                rnn_s->out_state[n], rnn_s->v_inter_state[n],
+                rnn_s->var_state[n]);
+    }
+    if (runner->valid_length < rnn_s->length) {
+        runner->valid_length = rnn_s->length;
+    }
+}
+
+/*
+ * This function returns nonzero if every element of the next update of the
+ * initial state is less than tolerance.
+ */
+static int is_converged (
+        const struct rnn_state *rnn_s,
+        double rho_init,
+        double tolerance)
 {
     const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+    if (tolerance <= 0) {
+        return 0;
+    }
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        if (!rnn_p->const_init_c[i] &&
+                fabs(rho_init * rnn_s->delta_init_c_inter_state[i]) >=
+                tolerance) {
+            return 0;
+        }
+    }
+    return 1;
+}
 
-    rnn_forward_backward_dynamics(rnn_s);
+/*
+ * This function computes the dynamics in the window, and slides the window
+ * by one step. The window is slid by advancing the head of the ring buffers
+ * instead of moving all rows, and only the last row of each array, which
+ * remains as it is in the slid window, is copied.
+ * Since the new initial state is the state at the first step, the states of
+ * the slid window except the last step are still valid.
+ */
+static void rnn_fmap (struct rnn_runner2 *runner)
+{
+    struct rnn_state *rnn_s = runner->rnn.rnn_s + runner->id;
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+    const int length = rnn_s->length;
+
+    if (runner->incremental) {
+        rnn_forward_dynamics_from_valid_length(runner, rnn_s);
+    } else {
+        rnn_forward_backward_dynamics(rnn_s);
+    }
 
     memmove(rnn_s->init_c_inter_state, rnn_s->c_inter_state[0], sizeof(double) *
             rnn_p->c_state_size);
     memmove(rnn_s->init_c_state, rnn_s->c_state[0], sizeof(double) *
             rnn_p->c_state_size);
-    for (int n = 1; n < rnn_s->length; n++) {
-        memmove(rnn_s->teach_state[n-1], rnn_s->teach_state[n], sizeof(double) *
-                rnn_p->out_state_size);
-        memmove(rnn_s->in_state[n-1], rnn_s->in_state[n], sizeof(double) *
-                rnn_p->in_state_size);
-        memmove(rnn_s->c_inter_state[n-1], rnn_s->c_inter_state[n],
-                sizeof(double) * rnn_p->c_state_size);
-        memmove(rnn_s->c_state[n-1], rnn_s->c_state[n], sizeof(double) *
-                rnn_p->c_state_size);
+    if (length > 1) {
+        for (int k = 0; k < RNN_RUNNER2_WINDOW_ARRAY_NUM; k++) {
+            int size;
+            double **x = *window_array(rnn_s, k, &size);
+            memmove(x[0], x[length-1], sizeof(double) * size);
+        }
+        runner->head = (runner->head + 1) % length;
+        for (int k = 0; k < RNN_RUNNER2_WINDOW_ARRAY_NUM; k++) {
+            int size;
+            *window_array(rnn_s, k, &size) = runner->ring[k] + runner->head;
+        }
+        runner->valid_length = length - 1;
+    } else {
+        runner->valid_length = 0;
     }
 }
 
 
-void update_rnn_runner2 (
+/*
+ * This function switches the incremental mode of the runner. In the mode,
+ * the forward dynamics left by the previous update are reused, and the
+ * regression of the initial state stops before reg_count iterations once
+ * every element of its update is less than tolerance. The initial state is
+ * carried over from the previous update in either mode. If tolerance <= 0,
+ * the results are the same as those without the mode.
+ */
+void set_incremental_mode_of_rnn_runner2 (
+        struct rnn_runner2 *runner,
+        int incremental,
+        double tolerance)
+{
+    runner->incremental = incremental;
+    runner->tolerance = tolerance;
+    runner->valid_length = 0;
+}
+
+
+/*
+ * This function returns the time in seconds from a monotonic clock. If the
+ * clock is not available, the processor time is used instead.
+ */
+static double get_time (void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return ts.tv_sec + 1e-9 * ts.tv_nsec;
+    }
+#endif
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static void update_cost (double *cost, double t)
+{
+    *cost = (*cost > 0) ? 0.8 * (*cost) + 0.2 * t : t;
+}
+
+static void record_latency (
+        struct rnn_runner2 *runner,
+        double t)
+{
+    runner->latency[runner->latency_head] = t;
+    runner->latency_head = (runner->latency_head + 1) %
+        RNN_RUNNER2_LATENCY_SIZE;
+    if (runner->latency_num < RNN_RUNNER2_LATENCY_SIZE) {
+        runner->latency_num++;
+    }
+}
+
+
+/*
+ * This function writes input into the window, regresses the initial state,
+ * and computes the dynamics of the window. If deadline >= 0, an iteration
+ * of the regression starts only if it is expected to end, together with the
+ * forward dynamics, before the deadline. The function returns the number of
+ * iterations done.
+ */
+static int update_window (
         struct rnn_runner2 *runner,
         double *input,
         int reg_count,
         double rho_init,
-        double momentum)
+        double momentum,
+        double start,
+        double deadline)
 {
     struct rnn_state *rnn_s = runner->rnn.rnn_s + runner->id;
 
@@ -183,16 +374,89 @@ void update_rnn_runner2 (
         memmove(rnn_s->teach_state[rnn_s->length - runner->delay_length - 1],
                 input, sizeof(double) * rnn_s->rnn_p->out_state_size);
     }
+    if (runner->valid_length > rnn_s->length - 1) {
+        runner->valid_length = rnn_s->length - 1;
+    }
 
+    int count = 0;
+    double t = start;
     int tmp_length = rnn_s->length;
     rnn_s->length -= runner->delay_length;
-    for (int i = 0; i < reg_count; i++) {
-        rnn_forward_backward_dynamics(rnn_s);
-        rnn_update_delta_init_c_inter_state(rnn_s, momentum);
-        rnn_update_init_c_inter_state(rnn_s, rho_init);
+    while (count < reg_count) {
+        if (deadline >= 0 && t + runner->iteration_cost +
+                runner->forward_cost >= deadline) {
+            // the estimate is decreased so as not to be stuck in an
+            // overestimate, which is never measured again
+            if (count == 0) {
+                runner->iteration_cost *= 0.5;
+            }
+            break;
+        }
+        int converged = 0;
+        count++;
+        if (runner->incremental) {
+            rnn_forward_dynamics_from_valid_length(runner, rnn_s);
+            rnn_set_likelihood(rnn_s);
+            rnn_backward_dynamics(rnn_s);
+            rnn_update_delta_init_c_inter_state(rnn_s, momentum);
+            converged = is_converged(rnn_s, rho_init, runner->tolerance);
+        } else {
+            rnn_forward_backward_dynamics(rnn_s);
+            rnn_update_delta_init_c_inter_state(rnn_s, momentum);
+        }
+        if (!converged) {
+            rnn_update_init_c_inter_state(rnn_s, rho_init);
+            runner->valid_length = 0;
+        }
+        double now = get_time();
+        update_cost(&runner->iteration_cost, now - t);
+        t = now;
+        if (converged) {
+            break;
+        }
     }
     rnn_s->length = tmp_length;
-    rnn_fmap(rnn_s, runner->delay_length);
+    rnn_fmap(runner);
+    double now = get_time();
+    update_cost(&runner->forward_cost, now - t);
+    record_latency(runner, now - start);
+    return count;
+}
+
+
+void update_rnn_runner2 (
+        struct rnn_runner2 *runner,
+        double *input,
+        int reg_count,
+        double rho_init,
+        double momentum)
+{
+    update_window(runner, input, reg_count, rho_init, momentum, get_time(),
+            -1);
+}
+
+
+/*
+ * This function is the same as update_rnn_runner2 except that the number of
+ * iterations of the regression is bounded by time_budget (in seconds) as
+ * well as max_reg_count. The iterations are done as long as the next one
+ * and the forward dynamics are expected to end in time_budget, according to
+ * the costs measured in the previous iterations. Hence the output and the
+ * states of the runner are the best estimates obtained in time_budget.
+ *
+ *   @return  number of iterations of the regression
+ */
+int update_rnn_runner2_with_deadline (
+        struct rnn_runner2 *runner,
+        double *input,
+        double time_budget,
+        int max_reg_count,
+        double rho_init,
+        double momentum)
+{
+    const double start = get_time();
+    return update_window(runner, input, max_reg_count, rho_init, momentum,
+            start, start + (time_budget > 0 ? time_budget : 0));
 }
 
 
@@ -233,7 +497,7 @@ int rnn_output_type_from_runner2 (struct rnn_runner2 *runner)
 
 int rnn_target_num_from_runner2 (struct rnn_runner2 *runner)
 {
-    return runner->id;
+    return runner->model->series_num;
 }
 
 double* rnn_in_state_from_runner2 (struct rnn_runner2 *runner)
@@ -271,3 +535,33 @@ struct rnn_state* rnn_state_from_runner2 (struct rnn_runner2 *runner)
     return runner->rnn.rnn_s + runner->id;
 }
 
+static int compare_double (const void *a, const void *b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * This function returns the percentile (0 to 100) of the latencies (in
+ * seconds) of the latest updates, or 0 if no update has been done.
+ */
+double rnn_step_latency_from_runner2 (
+        struct rnn_runner2 *runner,
+        double percentile)
+{
+    const int num = runner->latency_num;
+    if (num == 0) {
+        return 0;
+    }
+    double x[num];
+    memcpy(x, runner->latency, sizeof(double) * num);
+    qsort(x, num, sizeof(double), compare_double);
+    int k = (int)ceil(percentile / 100.0 * num) - 1;
+    if (k < 0) {
+        k = 0;
+    } else if (k >= num) {
+        k = num - 1;
+    }
+    return x[k];
+}
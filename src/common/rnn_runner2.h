@@ -18,12 +18,67 @@
 #define RNN_RUNNER2_H
 
 #include "rnn.h"
+#include "rnn_model.h"
 
 
+#define RNN_RUNNER2_WINDOW_ARRAY_NUM 9
+#define RNN_RUNNER2_LATENCY_SIZE 1024
+
 typedef struct rnn_runner2 {
     int id;
     int delay_length;
+    /*
+     * rnn holds only the window of the runner, and the parameters and the
+     * training series are those of model, which may be shared by other
+     * runners (see rnn_model.h). rnn.rnn_p is a copy of the header of
+     * model->rnn_p with the fixed_* flags of the regression.
+     */
     struct recurrent_neural_network rnn;
+    struct rnn_model *model;
+
+    /*
+     * The window of the runner slides by one step at each update. The rows
+     * of the arrays of the state computed by the forward dynamics (and of
+     * teach_state) are kept as ring buffers: ring[k] has twice as many row
+     * pointers as the window (ring[k][n] and ring[k][n+length] refer to the
+     * same row), and the array of the state points to ring[k] + head.
+     * base[k] is the original array, which is restored before the state is
+     * freed.
+     */
+    double **ring[RNN_RUNNER2_WINDOW_ARRAY_NUM];
+    double **base[RNN_RUNNER2_WINDOW_ARRAY_NUM];
+    int head;
+
+    /*
+     * If incremental != 0, the forward dynamics of the first valid_length
+     * steps of the window, which are left by the previous update, are
+     * reused as long as the initial state is unchanged, and the regression
+     * stops when every element of the update of the initial state is less
+     * than tolerance.
+     */
+    int incremental;
+    double tolerance;
+    int valid_length;
+
+    /*
+     * iteration_cost and forward_cost are the estimated times (in seconds)
+     * of an iteration of the regression and of the forward dynamics of the
+     * window, which are exponential moving averages of measured times.
+     * latency holds the times of the latest updates in a ring buffer.
+     */
+    double iteration_cost;
+    double forward_cost;
+    double latency[RNN_RUNNER2_LATENCY_SIZE];
+    int latency_num;
+    int latency_head;
+
+    /*
+     * rng is the random number generator of the runner, which is seeded
+     * from the global one (see utils.h) at the initialization. The random
+     * initial state of the runner is drawn from rng, so that runners can
+     * be used from threads at once.
+     */
+    struct genrand_state rng;
 } rnn_runner2;
 
 
@@ -43,12 +98,22 @@ void init_rnn_runner2_with_filename (
         const char *filename,
         int window_length);
 
+void init_rnn_runner2_with_model (
+        struct rnn_runner2 *runner,
+        struct rnn_model *model,
+        int window_length);
+
 void free_rnn_runner2 (struct rnn_runner2 *runner);
 
 void set_init_state_of_rnn_runner2 (
         struct rnn_runner2 *runner,
         int series_id);
 
+void set_incremental_mode_of_rnn_runner2 (
+        struct rnn_runner2 *runner,
+        int incremental,
+        double tolerance);
+
 void update_rnn_runner2 (
         struct rnn_runner2 *runner,
         double *input,
@@ -56,6 +121,14 @@ void update_rnn_runner2 (
         double rho_init,
         double momentum);
 
+int update_rnn_runner2_with_deadline (
+        struct rnn_runner2 *runner,
+        double *input,
+        double time_budget,
+        int max_reg_count,
+        double rho_init,
+        double momentum);
+
 
 int rnn_in_state_size_from_runner2 (struct rnn_runner2 *runner);
 int rnn_c_state_size_from_runner2 (struct rnn_runner2 *runner);
@@ -70,6 +143,9 @@ double* rnn_c_inter_state_from_runner2 (struct rnn_runner2 *runner);
 double* rnn_out_state_from_runner2 (struct rnn_runner2 *runner);
 double* rnn_var_state_from_runner2 (struct rnn_runner2 *runner);
 struct rnn_state* rnn_state_from_runner2 (struct rnn_runner2 *runner);
+double rnn_step_latency_from_runner2 (
+        struct rnn_runner2 *runner,
+        double percentile);
 
 #endif
 
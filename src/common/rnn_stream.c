@@ -0,0 +1,400 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "utils.h"
+#include "rnn_stream.h"
+
+
+static void init_gradient (
+        struct rnn_state *gradient,
+        struct rnn_parameters *rnn_p)
+{
+    gradient->rnn_p = rnn_p;
+    MALLOC2(gradient->delta_w_ci, rnn_p->c_state_size, rnn_p->in_state_size);
+    MALLOC2(gradient->delta_w_cc, rnn_p->c_state_size, rnn_p->c_state_size);
+    MALLOC2(gradient->delta_w_oc, rnn_p->out_state_size, rnn_p->c_state_size);
+    MALLOC2(gradient->delta_w_vc, rnn_p->out_state_size, rnn_p->c_state_size);
+}
+
+static void free_gradient (struct rnn_state *gradient)
+{
+    FREE2(gradient->delta_w_ci);
+    FREE2(gradient->delta_w_cc);
+    FREE2(gradient->delta_w_oc);
+    FREE2(gradient->delta_w_vc);
+}
+
+static void clear_gradient (struct rnn_state *gradient)
+{
+    const struct rnn_parameters *rnn_p = gradient->rnn_p;
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        for (int j = 0; j < rnn_p->in_state_size; j++) {
+            gradient->delta_w_ci[i][j] = 0;
+        }
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            gradient->delta_w_cc[i][j] = 0;
+        }
+    }
+    for (int i = 0; i < rnn_p->out_state_size; i++) {
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            gradient->delta_w_oc[i][j] = 0;
+            gradient->delta_w_vc[i][j] = 0;
+        }
+    }
+}
+
+/*
+ * This function adds the gradients of the weights of rnn_s to gradient.
+ */
+static void add_gradient (
+        struct rnn_state *gradient,
+        const struct rnn_state *rnn_s)
+{
+    const struct rnn_parameters *rnn_p = gradient->rnn_p;
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        for (int j = 0; j < rnn_p->in_state_size; j++) {
+            gradient->delta_w_ci[i][j] += rnn_s->delta_w_ci[i][j];
+        }
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            gradient->delta_w_cc[i][j] += rnn_s->delta_w_cc[i][j];
+        }
+    }
+    for (int i = 0; i < rnn_p->out_state_size; i++) {
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            gradient->delta_w_oc[i][j] += rnn_s->delta_w_oc[i][j];
+            gradient->delta_w_vc[i][j] += rnn_s->delta_w_vc[i][j];
+        }
+    }
+}
+
+
+void init_rnn_stream (
+        struct rnn_stream *stream,
+        struct recurrent_neural_network *rnn)
+{
+    stream->rnn = rnn;
+    stream->max_length = 0;
+    for (int i = 0; i < rnn->series_num; i++) {
+        if (stream->max_length < rnn->rnn_s[i].length) {
+            stream->max_length = rnn->rnn_s[i].length;
+        }
+    }
+#ifdef _OPENMP
+    stream->work_num = omp_get_max_threads();
+#else
+    stream->work_num = 1;
+#endif
+    MALLOC(stream->work, stream->work_num);
+    for (int i = 0; i < stream->work_num; i++) {
+        stream->work[i].rnn_p = &rnn->rnn_p;
+        stream->work[i].length = (stream->max_length > 0) ?
+            stream->max_length : 1;
+        rnn_state_alloc(stream->work + i);
+    }
+    MALLOC2(stream->row, stream->work_num, 2 * stream->work[0].length);
+    MALLOC(stream->gradient, stream->work_num);
+    for (int i = 0; i < stream->work_num; i++) {
+        init_gradient(stream->gradient + i, &rnn->rnn_p);
+    }
+    MALLOC(stream->error, rnn->series_num);
+    MALLOC(stream->likelihood, rnn->series_num);
+    for (int i = 0; i < rnn->series_num; i++) {
+        stream->error[i] = 0;
+        stream->likelihood[i] = 0;
+    }
+    stream->release_target = 0;
+}
+
+
+void free_rnn_stream (struct rnn_stream *stream)
+{
+    for (int i = 0; i < stream->work_num; i++) {
+        free_rnn_state(stream->work + i);
+    }
+    FREE(stream->work);
+    FREE2(stream->row);
+    for (int i = 0; i < stream->work_num; i++) {
+        free_gradient(stream->gradient + i);
+    }
+    FREE(stream->gradient);
+    FREE(stream->error);
+    FREE(stream->likelihood);
+}
+
+
+#define SWAP(x,y) do { \
+    double **_t = (x); (x) = (y); (y) = _t; \
+} while(0)
+
+/*
+ * This function exchanges the work arrays of rnn_s with those of work.
+ * Calling it twice restores the original arrays of rnn_s.
+ */
+static void swap_work_arrays (
+        struct rnn_state *rnn_s,
+        struct rnn_state *work)
+{
+    SWAP(rnn_s->c_state, work->c_state);
+    SWAP(rnn_s->out_state, work->out_state);
+    SWAP(rnn_s->var_state, work->var_state);
+    SWAP(rnn_s->c_inputsum, work->c_inputsum);
+    SWAP(rnn_s->c_inter_state, work->c_inter_state);
+    SWAP(rnn_s->o_inter_state, work->o_inter_state);
+    SWAP(rnn_s->v_inter_state, work->v_inter_state);
+    SWAP(rnn_s->likelihood, work->likelihood);
+    SWAP(rnn_s->delta_likelihood, work->delta_likelihood);
+    SWAP(rnn_s->delta_c_inter, work->delta_c_inter);
+    SWAP(rnn_s->delta_o_inter, work->delta_o_inter);
+    SWAP(rnn_s->delta_v_inter, work->delta_v_inter);
+}
+
+/*
+ * This function lends the delta_w_* of work to rnn_s which has none.
+ * Calling it twice restores rnn_s.
+ */
+static void swap_delta_w (
+        struct rnn_state *rnn_s,
+        struct rnn_state *work)
+{
+    SWAP(rnn_s->delta_w_ci, work->delta_w_ci);
+    SWAP(rnn_s->delta_w_cc, work->delta_w_cc);
+    SWAP(rnn_s->delta_w_oc, work->delta_w_oc);
+    SWAP(rnn_s->delta_w_vc, work->delta_w_vc);
+}
+
+
+/*
+ * This function gives advice on the pages of contiguous rows of a time
+ * series.
+ */
+static void advise_rows (
+        const double *data,
+        int length,
+        int size,
+        int advice)
+{
+    if (data == NULL || length <= 0 || size <= 0) {
+        return;
+    }
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)data;
+    uintptr_t end = (uintptr_t)(data + (size_t)length * size);
+    begin -= begin % page_size;
+    posix_madvise((void*)begin, end - begin, advice);
+}
+
+/*
+ * This function points in_state and teach_state of a streamed series to
+ * the rows of in_data and teach_data, using the row pointers of the thread.
+ */
+static void resolve_rows (
+        struct rnn_state *rnn_s,
+        double **row)
+{
+    const int in_state_size = rnn_s->rnn_p->in_state_size;
+    const int out_state_size = rnn_s->rnn_p->out_state_size;
+    double **in_row = row;
+    double **teach_row = row + rnn_s->length;
+    for (int n = 0; n < rnn_s->length; n++) {
+        in_row[n] = (double*)(rnn_s->in_data + (size_t)n * in_state_size);
+    }
+    rnn_s->in_state = in_row;
+    if (rnn_s->teach_data != NULL) {
+        for (int n = 0; n < rnn_s->length; n++) {
+            teach_row[n] = (double*)(rnn_s->teach_data +
+                    (size_t)n * out_state_size);
+        }
+        rnn_s->teach_state = teach_row;
+    }
+}
+
+static int thread_index (void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * This function computes the index-th series by the work arrays of the
+ * thread. If has_gradient != 0, the gradients of the weights of the series
+ * are added to those of the thread.
+ */
+static void compute_series (
+        struct rnn_stream *stream,
+        int index,
+        void (*compute)(struct rnn_state*),
+        int has_gradient)
+{
+    struct rnn_state *rnn_s = stream->rnn->rnn_s + index;
+    const int in_state_size = rnn_s->rnn_p->in_state_size;
+    const int out_state_size = rnn_s->rnn_p->out_state_size;
+    const int k = thread_index();
+    struct rnn_state *work = stream->work + k;
+    const int streamed = (rnn_s->in_data != NULL);
+    const int lends_delta_w = (rnn_s->delta_w_ci == NULL);
+    if (stream->release_target) {
+        advise_rows(rnn_s->in_data, rnn_s->length, in_state_size,
+                POSIX_MADV_WILLNEED);
+        advise_rows(rnn_s->teach_data, rnn_s->length, out_state_size,
+                POSIX_MADV_WILLNEED);
+    }
+    if (streamed) {
+        resolve_rows(rnn_s, stream->row[k]);
+    }
+    swap_work_arrays(rnn_s, work);
+    if (lends_delta_w) {
+        swap_delta_w(rnn_s, work);
+    }
+    compute(rnn_s);
+    stream->error[index] = rnn_get_error(rnn_s);
+    stream->likelihood[index] = rnn_get_likelihood(rnn_s);
+    if (has_gradient && !rnn_s->rnn_p->fixed_weight) {
+        add_gradient(stream->gradient + k, rnn_s);
+    }
+    if (lends_delta_w) {
+        swap_delta_w(rnn_s, work);
+    }
+    swap_work_arrays(rnn_s, work);
+    if (streamed) {
+        rnn_s->in_state = NULL;
+        rnn_s->teach_state = NULL;
+    }
+    if (stream->release_target) {
+        advise_rows(rnn_s->in_data, rnn_s->length, in_state_size,
+                POSIX_MADV_DONTNEED);
+        advise_rows(rnn_s->teach_data, rnn_s->length, out_state_size,
+                POSIX_MADV_DONTNEED);
+    }
+}
+
+
+static void forward_dynamics (struct rnn_state *rnn_s)
+{
+    rnn_forward_dynamics(rnn_s);
+    rnn_set_likelihood(rnn_s);
+}
+
+/*
+ * This function is the streaming version of rnn_forward_dynamics_forall.
+ * The error and the likelihood of each series are set to stream->error and
+ * stream->likelihood.
+ */
+void rnn_stream_forward_dynamics_forall (struct rnn_stream *stream)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < stream->rnn->series_num; i++) {
+        compute_series(stream, i, forward_dynamics, 0);
+    }
+}
+
+/*
+ * This function is the streaming version of
+ * rnn_forward_backward_dynamics_forall. The error and the likelihood of the
+ * forward dynamics are also set to stream->error and stream->likelihood, and
+ * the gradients of the weights are accumulated into stream->gradient.
+ */
+void rnn_stream_forward_backward_dynamics_forall (struct rnn_stream *stream)
+{
+    struct recurrent_neural_network *rnn = stream->rnn;
+    for (int i = 0; i < stream->work_num; i++) {
+        clear_gradient(stream->gradient + i);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < rnn->series_num; i++) {
+        const struct rnn_state *rnn_s = rnn->rnn_s + i;
+        if (!rnn_s->reuse_delta || rnn_s->delta_w_ci == NULL) {
+            compute_series(stream, i, rnn_forward_backward_dynamics, 1);
+        } else if (!rnn->rnn_p.fixed_weight) {
+            add_gradient(stream->gradient + thread_index(), rnn_s);
+        }
+    }
+}
+
+
+/*
+ * This function is the version of rnn_update_delta_parameters which takes
+ * the gradients of the weights from those accumulated per thread.
+ */
+static void update_delta_parameters (
+        struct rnn_stream *stream,
+        double momentum)
+{
+    struct recurrent_neural_network *rnn = stream->rnn;
+    if (!rnn->rnn_p.fixed_weight) {
+        struct recurrent_neural_network sum = *rnn;
+        sum.series_num = stream->work_num;
+        sum.rnn_s = stream->gradient;
+        rnn_update_delta_weight(&sum, momentum);
+    }
+    if (!rnn->rnn_p.fixed_threshold) {
+        rnn_update_delta_threshold(rnn, momentum);
+    }
+    if (!rnn->rnn_p.fixed_tau) {
+        rnn_update_delta_tau(rnn, momentum);
+    }
+    if (!rnn->rnn_p.fixed_init_c_state) {
+        rnn_update_delta_rep_init_c(rnn, momentum);
+        for (int i = 0; i < rnn->series_num; i++) {
+            rnn_update_delta_init_c_inter_state(rnn->rnn_s + i, momentum);
+        }
+    }
+}
+
+
+/*
+ * This function is the streaming version of rnn_learn_s.
+ *
+ *   @parameter  stream     : stream of a recurrent neural network
+ *   @parameter  rho        : learning rate
+ *   @parameter  momentum   : momentum of learning
+ */
+void rnn_stream_learn_s (
+        struct rnn_stream *stream,
+        double rho,
+        double momentum)
+{
+    struct recurrent_neural_network *rnn = stream->rnn;
+    double r = 1.0 / (rnn_get_total_length(rnn) * rnn->rnn_p.out_state_size);
+    double rho_weight = r * rho;
+    double rho_tau = r * rho;
+    double rho_init = rho / rnn->rnn_p.out_state_size;
+
+    rnn_stream_forward_backward_dynamics_forall(stream);
+
+    update_delta_parameters(stream, momentum);
+    rnn_update_parameters(rnn, rho_weight, rho_tau, rho_init);
+}
+
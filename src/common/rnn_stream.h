@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RNN_STREAM_H
+#define RNN_STREAM_H
+
+#include "rnn.h"
+
+
+/*
+ * Streaming computation of a recurrent neural network.
+ * The series are computed in parallel as in rnn_forward_dynamics_forall, but
+ * the work arrays of time steps (c_state, out_state, delta_c_inter, etc.)
+ * are taken from the buffers of the thread only while the series is
+ * computed. Combined with rnn_add_streamed_targets, the memory for the work
+ * arrays is bounded by (number of threads) x (maximum length of series)
+ * regardless of the number of series, and the targets (e.g. a mapped binary
+ * target file) are read one series at a time. Neither are the row pointers of
+ * the targets kept per series. The gradients of the weights are accumulated
+ * per thread instead of per series, since a streamed series has no
+ * delta_w_* (see rnn_add_streamed_targets). A streamed series is therefore
+ * computed even if its reuse_delta is set, whereas the last gradients of
+ * the other series with reuse_delta are added to the accumulated ones.
+ */
+typedef struct rnn_stream {
+    struct recurrent_neural_network *rnn;
+    int max_length;
+
+    /* work[k] holds the work arrays for the k-th thread */
+    int work_num;
+    struct rnn_state *work;
+
+    /*
+     * row[k] holds 2 x max_length row pointers for the k-th thread. While a
+     * series added by rnn_add_streamed_targets is computed, its in_state and
+     * teach_state point to these rows resolved from in_data and teach_data.
+     */
+    double ***row;
+
+    /*
+     * gradient[k] accumulates the gradients of the weights (delta_w_*) of
+     * the series computed by the k-th thread. Only its delta_w_* are
+     * allocated.
+     */
+    struct rnn_state *gradient;
+
+    /*
+     * error[i] and likelihood[i] are the error and the likelihood of the
+     * i-th series in the last computation
+     */
+    double *error;
+    double *likelihood;
+
+    /*
+     * If release_target != 0, the pages of the inputs and the targets of a
+     * series are advised to be released after the series is computed.
+     */
+    int release_target;
+} rnn_stream;
+
+
+void init_rnn_stream (
+        struct rnn_stream *stream,
+        struct recurrent_neural_network *rnn);
+
+void free_rnn_stream (struct rnn_stream *stream);
+
+void rnn_stream_forward_dynamics_forall (struct rnn_stream *stream);
+
+void rnn_stream_forward_backward_dynamics_forall (struct rnn_stream *stream);
+
+void rnn_stream_learn_s (
+        struct rnn_stream *stream,
+        double rho,
+        double momentum);
+
+#endif
+
@@ -0,0 +1,345 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "rnn_trajectory.h"
+
+
+#define HEADER_SIZE (8 + 4 * sizeof(int32_t) + sizeof(int64_t))
+
+static size_t data_offset (
+        int series_num,
+        size_t text_size)
+{
+    size_t offset = HEADER_SIZE + series_num * sizeof(int32_t) + text_size;
+    return (offset + RNN_TRAJECTORY_ALIGNMENT - 1) /
+        RNN_TRAJECTORY_ALIGNMENT * RNN_TRAJECTORY_ALIGNMENT;
+}
+
+static size_t dtype_size (enum rnn_trajectory_dtype dtype)
+{
+    return (dtype == RNN_TRAJECTORY_FLOAT32) ? sizeof(float) : sizeof(double);
+}
+
+/*
+ * This function computes the offset of each series in a record and the size
+ * of a record.
+ */
+static void set_layout (struct rnn_trajectory *traj)
+{
+    size_t offset = sizeof(int64_t);
+    for (int i = 0; i < traj->series_num; i++) {
+        traj->offset[i] = offset;
+        offset += (size_t)traj->length[i] * traj->col_num *
+            dtype_size(traj->dtype);
+    }
+    traj->record_size = (offset + sizeof(int64_t) - 1) / sizeof(int64_t) *
+        sizeof(int64_t);
+}
+
+static void clear_mapping (struct rnn_trajectory *traj)
+{
+    traj->text = NULL;
+    traj->text_size = 0;
+    traj->record_num = 0;
+    traj->data = NULL;
+    traj->map = NULL;
+    traj->map_size = 0;
+}
+
+
+/*
+ * This function initializes the layout of records of series_num series.
+ *
+ *   @parameter  dtype      : type of values in the file
+ *   @parameter  series_num : number of the series
+ *   @parameter  length     : length[i] is the length of the i-th series
+ *   @parameter  col_num    : number of values at each time step
+ */
+void init_rnn_trajectory (
+        struct rnn_trajectory *traj,
+        enum rnn_trajectory_dtype dtype,
+        int series_num,
+        const int *length,
+        int col_num)
+{
+    traj->dtype = dtype;
+    traj->series_num = series_num;
+    traj->col_num = col_num;
+    MALLOC(traj->length, series_num);
+    MALLOC(traj->offset, series_num);
+    memcpy(traj->length, length, sizeof(int) * series_num);
+    set_layout(traj);
+    clear_mapping(traj);
+}
+
+void free_rnn_trajectory (struct rnn_trajectory *traj)
+{
+    if (traj->map != NULL) {
+        munmap(traj->map, traj->map_size);
+    }
+    FREE(traj->length);
+    FREE(traj->offset);
+    clear_mapping(traj);
+}
+
+
+/*
+ * This function returns 1 if the file begins with RNN_TRAJECTORY_MAGIC, and
+ * returns 0 otherwise.
+ */
+int is_rnn_trajectory_file (const char *filename)
+{
+    char magic[8];
+    FILE *fp;
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        return 0;
+    }
+    int is_trajectory = (fread(magic, 1, 8, fp) == 8 &&
+            memcmp(magic, RNN_TRAJECTORY_MAGIC, 8) == 0);
+    fclose(fp);
+    return is_trajectory;
+}
+
+
+/*
+ * This function maps a trajectory file into memory read-only. Records
+ * appended after the mapping are not visible.
+ * It returns 0 on success, and -1 on failure.
+ */
+int map_rnn_trajectory (
+        struct rnn_trajectory *traj,
+        const char *filename)
+{
+    int fd;
+    struct stat st;
+    traj->length = NULL;
+    traj->offset = NULL;
+    clear_mapping(traj);
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        print_error_msg("cannot open %s", filename);
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        print_error_msg("cannot stat %s", filename);
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < HEADER_SIZE) {
+        print_error_msg("%s is too short", filename);
+        close(fd);
+        return -1;
+    }
+    traj->map_size = st.st_size;
+    traj->map = mmap(NULL, traj->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (traj->map == MAP_FAILED) {
+        print_error_msg("cannot map %s", filename);
+        traj->map = NULL;
+        return -1;
+    }
+
+    const char *p = traj->map;
+    int32_t header[4];
+    int64_t text_size;
+    memcpy(header, p + 8, sizeof(header));
+    memcpy(&text_size, p + 8 + sizeof(header), sizeof(int64_t));
+    if (memcmp(p, RNN_TRAJECTORY_MAGIC, 8) != 0) {
+        print_error_msg("%s is not a trajectory file", filename);
+        goto error;
+    }
+    if (header[0] != RNN_TRAJECTORY_VERSION) {
+        print_error_msg("unsupported version %d in %s", header[0], filename);
+        goto error;
+    }
+    if (header[1] != RNN_TRAJECTORY_FLOAT64 &&
+            header[1] != RNN_TRAJECTORY_FLOAT32) {
+        print_error_msg("unsupported dtype %d in %s", header[1], filename);
+        goto error;
+    }
+    if (header[2] < 0 || header[3] < 0 || text_size < 0 ||
+            (uint64_t)text_size > traj->map_size ||
+            traj->map_size < data_offset(header[2], text_size)) {
+        print_error_msg("broken header in %s", filename);
+        goto error;
+    }
+    traj->dtype = header[1];
+    traj->series_num = header[2];
+    traj->col_num = header[3];
+    MALLOC(traj->length, traj->series_num);
+    MALLOC(traj->offset, traj->series_num);
+    for (int i = 0; i < traj->series_num; i++) {
+        int32_t length;
+        memcpy(&length, p + HEADER_SIZE + i * sizeof(int32_t),
+                sizeof(int32_t));
+        if (length < 0) {
+            print_error_msg("broken length of series %d in %s", i, filename);
+            goto error;
+        }
+        traj->length[i] = length;
+    }
+    set_layout(traj);
+    traj->text = p + HEADER_SIZE + traj->series_num * sizeof(int32_t);
+    traj->text_size = text_size;
+    traj->data = p + data_offset(traj->series_num, text_size);
+    traj->record_num = (traj->map_size - data_offset(traj->series_num,
+                text_size)) / traj->record_size;
+    return 0;
+error:
+    free_rnn_trajectory(traj);
+    return -1;
+}
+
+
+/*
+ * This function writes the header of a trajectory file. Records of
+ * traj->record_size bytes are appended after it.
+ */
+void fwrite_rnn_trajectory_header (
+        const struct rnn_trajectory *traj,
+        const char *text,
+        size_t text_size,
+        FILE *fp)
+{
+    const char padding[RNN_TRAJECTORY_ALIGNMENT] = {0};
+    int32_t header[4] = {RNN_TRAJECTORY_VERSION, traj->dtype,
+        traj->series_num, traj->col_num};
+    int64_t size = text_size;
+    FWRITE(RNN_TRAJECTORY_MAGIC, 8, fp);
+    FWRITE(header, 4, fp);
+    FWRITE(&size, 1, fp);
+    for (int i = 0; i < traj->series_num; i++) {
+        int32_t length = traj->length[i];
+        FWRITE(&length, 1, fp);
+    }
+    if (text_size > 0) {
+        FWRITE(text, text_size, fp);
+    }
+    size_t padding_size = data_offset(traj->series_num, text_size) -
+        (HEADER_SIZE + traj->series_num * sizeof(int32_t) + text_size);
+    if (padding_size > 0) {
+        FWRITE(padding, padding_size, fp);
+    }
+}
+
+
+/*
+ * These functions fill a record of traj->record_size bytes. The states of
+ * different series can be stored concurrently.
+ */
+void rnn_trajectory_put_epoch (
+        const struct rnn_trajectory *traj,
+        void *record,
+        long epoch)
+{
+    int64_t e = epoch;
+    memcpy(record, &e, sizeof(int64_t));
+    size_t size = traj->series_num > 0 ?
+        traj->offset[traj->series_num - 1] +
+        (size_t)traj->length[traj->series_num - 1] * traj->col_num *
+        dtype_size(traj->dtype) : sizeof(int64_t);
+    memset((char*)record + size, 0, traj->record_size - size);
+}
+
+void rnn_trajectory_put_state (
+        const struct rnn_trajectory *traj,
+        void *record,
+        int series,
+        int n,
+        const double *x)
+{
+    char *p = (char*)record + traj->offset[series] +
+        (size_t)n * traj->col_num * dtype_size(traj->dtype);
+    if (traj->dtype == RNN_TRAJECTORY_FLOAT32) {
+        float y[traj->col_num];
+        for (int i = 0; i < traj->col_num; i++) {
+            y[i] = (float)x[i];
+        }
+        memcpy(p, y, sizeof(float) * traj->col_num);
+    } else {
+        memcpy(p, x, sizeof(double) * traj->col_num);
+    }
+}
+
+
+long rnn_trajectory_epoch (
+        const struct rnn_trajectory *traj,
+        long index)
+{
+    int64_t epoch;
+    memcpy(&epoch, traj->data + index * traj->record_size, sizeof(int64_t));
+    return epoch;
+}
+
+/*
+ * This function reads the state at the time step n of a series in the
+ * index-th record of the mapping as double.
+ */
+void rnn_trajectory_get_state (
+        const struct rnn_trajectory *traj,
+        long index,
+        int series,
+        int n,
+        double *x)
+{
+    const char *p = traj->data + index * traj->record_size +
+        traj->offset[series] + (size_t)n * traj->col_num *
+        dtype_size(traj->dtype);
+    if (traj->dtype == RNN_TRAJECTORY_FLOAT32) {
+        float y[traj->col_num];
+        memcpy(y, p, sizeof(float) * traj->col_num);
+        for (int i = 0; i < traj->col_num; i++) {
+            x[i] = y[i];
+        }
+    } else {
+        memcpy(x, p, sizeof(double) * traj->col_num);
+    }
+}
+
+/*
+ * This function returns the index of the first record whose epoch is greater
+ * than or equal to epoch (record_num if there is no such record).
+ */
+long rnn_trajectory_find (
+        const struct rnn_trajectory *traj,
+        long epoch)
+{
+    long begin = 0, end = traj->record_num;
+    while (begin < end) {
+        long mid = begin + (end - begin) / 2;
+        if (rnn_trajectory_epoch(traj, mid) < epoch) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return begin;
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RNN_TRAJECTORY_H
+#define RNN_TRAJECTORY_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+/*
+ * Trajectory file
+ *
+ * The file holds the states of all training series at each logged epoch, and
+ * all integers are stored in the native byte order. A record is appended at
+ * each epoch, and every record has the same size, so that the state of any
+ * series at any epoch is found by computing its offset.
+ *
+ *   magic      : 8 bytes, RNN_TRAJECTORY_MAGIC
+ *   version    : int32, RNN_TRAJECTORY_VERSION
+ *   dtype      : int32, type of values (enum rnn_trajectory_dtype)
+ *   series_num : int32, number of the series
+ *   col_num    : int32, number of values at each time step
+ *   text_size  : int64, size of the text
+ *   length     : int32 x series_num, length of each series
+ *   text       : text_size bytes, the comment lines of the state log
+ *   padding    : up to the next multiple of RNN_TRAJECTORY_ALIGNMENT bytes
+ *   records    : each record consists of
+ *                  epoch   : int64
+ *                  states  : the i-th series is a (length[i] x col_num)
+ *                            row-major matrix of dtype, stored in order of i
+ *                  padding : up to the next multiple of 8 bytes
+ *
+ * A record left incomplete by an interrupted writer is ignored.
+ */
+#define RNN_TRAJECTORY_MAGIC "\x89RNS\r\n\x1a\n"
+#define RNN_TRAJECTORY_VERSION 1
+#define RNN_TRAJECTORY_ALIGNMENT 64
+
+typedef enum rnn_trajectory_dtype {
+    RNN_TRAJECTORY_FLOAT64 = 0,
+    RNN_TRAJECTORY_FLOAT32 = 1
+} rnn_trajectory_dtype;
+
+
+typedef struct rnn_trajectory {
+    enum rnn_trajectory_dtype dtype;
+    int series_num;
+    int col_num;
+    int *length;
+    size_t *offset;                     // offset of each series in a record
+    size_t record_size;
+
+    /* the followings are available if the file is mapped */
+    const char *text;
+    size_t text_size;
+    long record_num;
+    const char *data;                   // the first record in the mapping
+    void *map;
+    size_t map_size;
+} rnn_trajectory;
+
+
+void init_rnn_trajectory (
+        struct rnn_trajectory *traj,
+        enum rnn_trajectory_dtype dtype,
+        int series_num,
+        const int *length,
+        int col_num);
+
+void free_rnn_trajectory (struct rnn_trajectory *traj);
+
+int is_rnn_trajectory_file (const char *filename);
+
+int map_rnn_trajectory (
+        struct rnn_trajectory *traj,
+        const char *filename);
+
+void fwrite_rnn_trajectory_header (
+        const struct rnn_trajectory *traj,
+        const char *text,
+        size_t text_size,
+        FILE *fp);
+
+void rnn_trajectory_put_epoch (
+        const struct rnn_trajectory *traj,
+        void *record,
+        long epoch);
+
+void rnn_trajectory_put_state (
+        const struct rnn_trajectory *traj,
+        void *record,
+        int series,
+        int n,
+        const double *x);
+
+long rnn_trajectory_epoch (
+        const struct rnn_trajectory *traj,
+        long index);
+
+void rnn_trajectory_get_state (
+        const struct rnn_trajectory *traj,
+        long index,
+        int series,
+        int n,
+        double *x);
+
+long rnn_trajectory_find (
+        const struct rnn_trajectory *traj,
+        long epoch);
+
+#endif
@@ -14,6 +14,10 @@
     OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -25,25 +29,57 @@
 
 
 
-static uint32_t x = 123456789;
-static uint32_t y = 362436069;
-static uint32_t z = 521288629;
-static uint32_t w = 88675123;
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+static pthread_mutex_t genrand_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
-uint32_t xor128(void)
+static struct genrand_state genrand = {
+    123456789, 362436069, 521288629, 88675123
+};
+
+uint32_t xor128_r(struct genrand_state *state)
 {
     uint32_t t;
-    t = x ^ (x << 11);
-    x = y; y = z; z = w;
-    return w = (w ^ (w >> 19)) ^ (t ^ (t >> 8));
+    t = state->x ^ (state->x << 11);
+    state->x = state->y; state->y = state->z; state->z = state->w;
+    return state->w = (state->w ^ (state->w >> 19)) ^ (t ^ (t >> 8));
+}
+
+void init_xor128_r(struct genrand_state *state, uint32_t s)
+{
+    state->x = s;
+    state->y = 1812433253 * (state->x^(state->x>>30)) + 1;
+    state->z = 1812433253 * (state->y^(state->y>>30)) + 2;
+    state->w = 1812433253 * (state->z^(state->z>>30)) + 3;
+}
+
+/*
+ * The global generator is locked by every function below, so that it can be
+ * shared by threads (e.g. rnn_runner initialized in a thread while another
+ * draws random numbers).
+ */
+uint32_t xor128(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&genrand_mutex);
+#endif
+    uint32_t r = xor128_r(&genrand);
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&genrand_mutex);
+#endif
+    return r;
 }
 
 void init_xor128(uint32_t s)
 {
-    x = s;
-    y = 1812433253 * (x^(x>>30)) + 1;
-    z = 1812433253 * (y^(y>>30)) + 2;
-    w = 1812433253 * (z^(z>>30)) + 3;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&genrand_mutex);
+#endif
+    init_xor128_r(&genrand, s);
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&genrand_mutex);
+#endif
 }
 
 void init_genrand(unsigned long s)
@@ -51,6 +87,16 @@ void init_genrand(unsigned long s)
     init_xor128((uint32_t)(s & UINT32_MAX));
 }
 
+/*
+ * This function initializes state with a seed drawn from the global
+ * generator, so that the sequence of state is determined by init_genrand.
+ * Then state can be used in a thread without locking.
+ */
+void split_genrand(struct genrand_state *state)
+{
+    init_xor128_r(state, xor128());
+}
+
 /* generates a random number on [0,1]-interval */
 double genrand_real1(void)
 {
@@ -69,6 +115,11 @@ double genrand_real3(void)
     return (xor128() + 0.5) * (1.0 / (UINT32_MAX + 1.0));
 }
 
+double genrand_real3_r(struct genrand_state *state)
+{
+    return (xor128_r(state) + 0.5) * (1.0 / (UINT32_MAX + 1.0));
+}
+
 #ifndef _GNU_SOURCE
 
 /*
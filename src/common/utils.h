@@ -91,12 +91,25 @@
 
 #include <stdint.h>
 
+/*
+ * The functions with the suffix _r use a generator given by state instead
+ * of the global one, and are safe to call from threads each of which has
+ * its own state.
+ */
+typedef struct genrand_state {
+    uint32_t x, y, z, w;
+} genrand_state;
+
 uint32_t xor128(void);
 void init_xor128(uint32_t s);
 void init_genrand(unsigned long s);
 double genrand_real1(void);
 double genrand_real2(void);
 double genrand_real3(void);
+uint32_t xor128_r(struct genrand_state *state);
+void init_xor128_r(struct genrand_state *state, uint32_t s);
+void split_genrand(struct genrand_state *state);
+double genrand_real3_r(struct genrand_state *state);
 
 
 #include <sys/types.h>
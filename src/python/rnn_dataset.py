@@ -0,0 +1,46 @@
+# -*- coding:utf-8 -*-
+
+import re
+import struct
+import array
+
+# binary target file written by rnn-convert (see src/common/rnn_dataset.h)
+MAGIC = '\x89RNT\r\n\x1a\n'
+VERSION = 1
+ALIGNMENT = 64
+FLOAT64 = 0
+
+
+def is_dataset_file(file_name):
+    f = open(file_name, 'rb')
+    magic = f.read(len(MAGIC))
+    f.close()
+    return magic == MAGIC
+
+def read_dataset(file_name):
+    f = open(file_name, 'rb')
+    if f.read(len(MAGIC)) != MAGIC:
+        raise ValueError('%s is not a binary target file' % file_name)
+    version, dtype, dimension, num = struct.unpack('=4i', f.read(16))
+    if version != VERSION or dtype != FLOAT64:
+        raise ValueError('unsupported binary target file %s' % file_name)
+    length = struct.unpack('=%di' % num, f.read(4 * num))
+    offset = len(MAGIC) + 16 + 4 * num
+    f.read((ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT)
+    for l in length:
+        data = array.array('d')
+        data.fromfile(f, l * dimension)
+        yield [data[n * dimension:(n + 1) * dimension].tolist()
+                for n in xrange(l)]
+    f.close()
+
+def read_sequence(file_name):
+    if is_dataset_file(file_name):
+        for series in read_dataset(file_name):
+            for x in series:
+                yield x
+    else:
+        p = re.compile(r'(^#)|(^$)')
+        for line in open(file_name, 'r'):
+            if p.match(line) == None:
+                yield map(float, line[:-1].split())
@@ -2,8 +2,8 @@
 
 import sys
 import os
-import re
 import rnn_runner
+import rnn_dataset
 
 def main():
     seed = int(sys.argv[1]) if str.isdigit(sys.argv[1]) else 0
@@ -17,27 +17,24 @@ def main():
     runner.init(rnn_file)
     runner.set_time_series_id()
 
-    p = re.compile(r'(^#)|(^$)')
     out_state_queue = []
-    for line in open(sequence_file, 'r'):
-        if p.match(line) == None:
-            input = map(float, line[:-1].split())
-            if len(out_state_queue) >= runner.delay_length():
-                out_state = out_state_queue.pop(0)
-                for i in ignore_index:
-                    input[i] = out_state[i]
-            runner.in_state(input)
-            runner.update()
-            out_state = runner.out_state()
-            if type == 'o':
-                print '\t'.join([str(x) for x in out_state])
-            elif type == 'c':
-                c_state = runner.c_state()
-                print '\t'.join([str(x) for x in c_state])
-            elif type == 'a':
-                c_state = runner.c_state()
-                print '\t'.join([str(x) for x in out_state + c_state])
-            out_state_queue.append(out_state)
+    for input in rnn_dataset.read_sequence(sequence_file):
+        if len(out_state_queue) >= runner.delay_length():
+            out_state = out_state_queue.pop(0)
+            for i in ignore_index:
+                input[i] = out_state[i]
+        runner.in_state(input)
+        runner.update()
+        out_state = runner.out_state()
+        if type == 'o':
+            print '\t'.join([str(x) for x in out_state])
+        elif type == 'c':
+            c_state = runner.c_state()
+            print '\t'.join([str(x) for x in c_state])
+        elif type == 'a':
+            c_state = runner.c_state()
+            print '\t'.join([str(x) for x in out_state + c_state])
+        out_state_queue.append(out_state)
 
 if __name__ == '__main__':
     main()
@@ -0,0 +1,231 @@
+# -*- coding:utf-8 -*-
+
+import mmap
+import struct
+import array
+
+# binary log file written by rnn-learn (see src/common/rnn_log.h)
+MAGIC = '\x89RNL\r\n\x1a\n'
+VERSION = 1
+ALIGNMENT = 64
+HEADER_SIZE = len(MAGIC) + 24
+
+# trajectory file written by rnn-learn (see src/common/rnn_trajectory.h)
+TRAJECTORY_MAGIC = '\x89RNS\r\n\x1a\n'
+TRAJECTORY_VERSION = 1
+TRAJECTORY_HEADER_SIZE = len(TRAJECTORY_MAGIC) + 24
+
+# formats of values in the text log files
+FORMAT = {'# TAU FILE':'%g', '# ERROR FILE':'%g', '# ENTROPY FILE':'%g',
+        '# PERIOD FILE':'%d', '# VALIDATION ERROR FILE':'%g'}
+
+
+def is_log_file(file_name):
+    f = open(file_name, 'rb')
+    magic = f.read(len(MAGIC))
+    f.close()
+    return magic == MAGIC
+
+def is_trajectory_file(file_name):
+    f = open(file_name, 'rb')
+    magic = f.read(len(TRAJECTORY_MAGIC))
+    f.close()
+    return magic == TRAJECTORY_MAGIC
+
+def to_array(s, typecode='d'):
+    a = array.array(typecode)
+    if hasattr(a, 'frombytes'):
+        a.frombytes(s)
+    else:
+        a.fromstring(s)
+    return a
+
+
+class LogFile(object):
+    """
+    A binary log file mapped into memory. Records are found by their index
+    without reading the others.
+    """
+    def __init__(self, file_name):
+        f = open(file_name, 'rb')
+        self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        f.close()
+        if self.map[:len(MAGIC)] != MAGIC:
+            raise ValueError('%s is not a binary log file' % file_name)
+        version, self.id, self.row_num, self.col_num, text_size = \
+                struct.unpack_from('=4iq', self.map, len(MAGIC))
+        if version != VERSION:
+            raise ValueError('unsupported binary log file %s' % file_name)
+        self.text = self.map[HEADER_SIZE:HEADER_SIZE + text_size]
+        offset = HEADER_SIZE + text_size
+        self.data_offset = offset + (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT
+        self.size = self.row_num * self.col_num
+        self.record_size = 8 + 8 * self.size
+        self.record_num = (len(self.map) - self.data_offset) // \
+                self.record_size
+
+    def close(self):
+        self.map.close()
+
+    def __len__(self):
+        return self.record_num
+
+    def epoch(self, index):
+        return struct.unpack_from('=q', self.map, self.data_offset +
+                index * self.record_size)[0]
+
+    def values(self, index):
+        offset = self.data_offset + index * self.record_size + 8
+        return to_array(self.map[offset:offset + 8 * self.size])
+
+    def find(self, epoch):
+        """returns the index of the first record whose epoch >= epoch"""
+        begin, end = 0, self.record_num
+        while begin < end:
+            mid = (begin + end) // 2
+            if self.epoch(mid) < epoch:
+                begin = mid + 1
+            else:
+                end = mid
+        return begin
+
+    def read(self, begin=None, end=None, columns=None):
+        """
+        returns (epochs, values, shape) of the records in [begin, end], where
+        values is a flat array of doubles with the shape (number of records,
+        row_num, number of columns). They can be passed to numpy without
+        copying, e.g. numpy.frombuffer(values).reshape(shape).
+        """
+        first = 0 if begin == None else self.find(begin)
+        last = self.record_num if end == None else self.find(end + 1)
+        epochs = array.array('d')
+        values = array.array('d')
+        for k in xrange(first, last):
+            epochs.append(self.epoch(k))
+            x = self.values(k)
+            if columns == None:
+                values.extend(x)
+            else:
+                for i in xrange(self.row_num):
+                    row = i * self.col_num
+                    values.extend([x[row + j] for j in columns])
+        col_num = self.col_num if columns == None else len(columns)
+        return epochs, values, (last - first, self.row_num, col_num)
+
+    def write_text(self, f, begin=None, end=None):
+        """writes the records in [begin, end] as the text log file"""
+        f.write(self.text)
+        title = self.text.split('\n', 1)[0]
+        format = '\t' + FORMAT.get(title, '%f')
+        first = 0 if begin == None else self.find(begin)
+        last = self.record_num if end == None else self.find(end + 1)
+        for k in xrange(first, last):
+            epoch, x = self.epoch(k), self.values(k)
+            if title == '# STATE FILE' or title.startswith('# INIT FILE') or \
+                    title.startswith('# REP INIT FILE'):
+                f.write('# epoch = %d\n' % epoch)
+                if self.id >= 0:
+                    f.write('# target:%d\n' % self.id)
+                for i in xrange(self.row_num):
+                    row = x[i * self.col_num:(i + 1) * self.col_num]
+                    f.write('%d%s\n' % (i, ''.join([format % v for v in row])))
+                if self.id >= 0:
+                    f.write('\n')
+            else:
+                f.write('%d%s\n' % (epoch, ''.join([format % v for v in x])))
+
+    def write_epoch_text(self, f, epoch=None):
+        """writes the record of epoch (the last record if None) as text"""
+        if epoch == None:
+            if self.record_num > 0:
+                epoch = self.epoch(self.record_num - 1)
+            else:
+                epoch = 0
+        self.write_text(f, epoch, epoch)
+
+
+class TrajectoryFile(object):
+    """
+    A trajectory file mapped into memory, which holds the states of all the
+    series at each epoch. The states of a series at an epoch are found
+    without reading the others.
+    """
+    def __init__(self, file_name):
+        f = open(file_name, 'rb')
+        self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        f.close()
+        if self.map[:len(TRAJECTORY_MAGIC)] != TRAJECTORY_MAGIC:
+            raise ValueError('%s is not a trajectory file' % file_name)
+        version, dtype, self.series_num, self.col_num, text_size = \
+                struct.unpack_from('=4iq', self.map, len(TRAJECTORY_MAGIC))
+        if version != TRAJECTORY_VERSION or dtype not in (0, 1):
+            raise ValueError('unsupported trajectory file %s' % file_name)
+        self.typecode = 'd' if dtype == 0 else 'f'
+        value_size = 8 if dtype == 0 else 4
+        self.length = struct.unpack_from('=%di' % self.series_num, self.map,
+                TRAJECTORY_HEADER_SIZE)
+        offset = TRAJECTORY_HEADER_SIZE + 4 * self.series_num
+        self.text = self.map[offset:offset + text_size]
+        offset += text_size
+        self.data_offset = offset + (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT
+        self.offset = []
+        offset = 8
+        for length in self.length:
+            self.offset.append(offset)
+            offset += length * self.col_num * value_size
+        self.record_size = (offset + 7) // 8 * 8
+        self.record_num = (len(self.map) - self.data_offset) // \
+                self.record_size
+
+    def close(self):
+        self.map.close()
+
+    def __len__(self):
+        return self.record_num
+
+    def epoch(self, index):
+        return struct.unpack_from('=q', self.map, self.data_offset +
+                index * self.record_size)[0]
+
+    def state(self, index, series):
+        """returns the states of a series as a flat array (length, col_num)"""
+        size = self.length[series] * self.col_num
+        offset = self.data_offset + index * self.record_size + \
+                self.offset[series]
+        a = to_array(self.map[offset:offset + size *
+            array.array(self.typecode).itemsize], self.typecode)
+        return a if self.typecode == 'd' else array.array('d', a)
+
+    def find(self, epoch):
+        """returns the index of the first record whose epoch >= epoch"""
+        begin, end = 0, self.record_num
+        while begin < end:
+            mid = (begin + end) // 2
+            if self.epoch(mid) < epoch:
+                begin = mid + 1
+            else:
+                end = mid
+        return begin
+
+    def write_text(self, f, series, begin=None, end=None):
+        """writes the states of a series in [begin, end] as the state file"""
+        f.write(self.text)
+        first = 0 if begin == None else self.find(begin)
+        last = self.record_num if end == None else self.find(end + 1)
+        for k in xrange(first, last):
+            x = self.state(k, series)
+            f.write('# epoch = %d\n' % self.epoch(k))
+            f.write('# target:%d\n' % series)
+            for n in xrange(self.length[series]):
+                row = x[n * self.col_num:(n + 1) * self.col_num]
+                f.write('%d%s\n' % (n, ''.join(['\t%f' % v for v in row])))
+            f.write('\n')
+
+    def write_epoch_text(self, f, series, epoch=None):
+        """writes the states of epoch (the last record if None) as text"""
+        if epoch == None:
+            if self.record_num > 0:
+                epoch = self.epoch(self.record_num - 1)
+            else:
+                epoch = 0
+        self.write_text(f, series, epoch, epoch)
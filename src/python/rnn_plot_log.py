@@ -5,6 +5,7 @@ import re
 import subprocess
 import tempfile
 import rnn_print_log
+import rnn_log
 
 def plot_state(f, filename, epoch, multiplot=False):
     params = rnn_print_log.read_parameter(f)
@@ -361,9 +362,24 @@ def main():
     if str.isdigit(sys.argv[1]):
         epoch = int(sys.argv[1])
     for file in sys.argv[2:]:
-        f = open(file, 'r')
-        plot_log(f, file, epoch)
-        f.close()
+        if rnn_log.is_log_file(file):
+            # gnuplot reads the records converted to text
+            log = rnn_log.LogFile(file)
+            tmp = tempfile.NamedTemporaryFile()
+            if log.text.startswith('# STATE FILE'):
+                log.write_epoch_text(tmp, epoch)
+            else:
+                log.write_text(tmp)
+            log.close()
+            tmp.flush()
+            f = open(tmp.name, 'r')
+            plot_log(f, tmp.name, epoch)
+            f.close()
+            tmp.close()
+        else:
+            f = open(file, 'r')
+            plot_log(f, file, epoch)
+            f.close()
 
 
 if __name__ == '__main__':
@@ -2,6 +2,8 @@
 
 import sys
 import re
+import StringIO
+import rnn_log
 
 def tail_n(f, n=10, offset=0):
     avg_length = 74
@@ -233,6 +235,18 @@ def print_period(f, epoch=None):
         print 'Period'
         print '\t'.join([str(x) for x in error])
 
+def print_validation_error(f, epoch=None):
+    s = current_line(f, epoch)
+    if s != None:
+        epoch = s[0]
+        error = s[1:]
+        n = len(error) // 2
+        print 'epoch : %s' % epoch
+        print 'open-loop error / (length * dimension)'
+        print '\t'.join([str(x) for x in error[:n]])
+        print 'closed-loop error / (length * dimension)'
+        print '\t'.join([str(x) for x in error[n:]])
+
 def print_log(f, epoch=None):
     line = f.readline()
     if re.compile(r'^# STATE FILE').match(line):
@@ -249,6 +263,8 @@ def print_log(f, epoch=None):
         print_adapt_lr(f, epoch)
     elif re.compile(r'^# ERROR FILE').match(line):
         print_error(f, epoch)
+    elif re.compile(r'^# VALIDATION ERROR FILE').match(line):
+        print_validation_error(f, epoch)
     elif re.compile(r'^# LYAPUNOV FILE').match(line):
         print_lyapunov(f, epoch)
     elif re.compile(r'^# ENTROPY FILE').match(line):
@@ -262,7 +278,24 @@ def main():
     if str.isdigit(sys.argv[1]):
         epoch = int(sys.argv[1])
     for file in sys.argv[2:]:
-        f = open(file, 'r')
+        if rnn_log.is_trajectory_file(file):
+            traj = rnn_log.TrajectoryFile(file)
+            for i in xrange(traj.series_num):
+                f = StringIO.StringIO()
+                traj.write_epoch_text(f, i, epoch)
+                f.seek(0)
+                print_log(f, epoch)
+                f.close()
+            traj.close()
+            continue
+        if rnn_log.is_log_file(file):
+            log = rnn_log.LogFile(file)
+            f = StringIO.StringIO()
+            log.write_epoch_text(f, epoch)
+            log.close()
+            f.seek(0)
+        else:
+            f = open(file, 'r')
         print_log(f, epoch)
         f.close()
 
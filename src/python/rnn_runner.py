@@ -14,6 +14,10 @@ librunner.rnn_in_state_from_runner.restype = POINTER(c_double)
 librunner.rnn_c_state_from_runner.restype = POINTER(c_double)
 librunner.rnn_c_inter_state_from_runner.restype = POINTER(c_double)
 librunner.rnn_out_state_from_runner.restype = POINTER(c_double)
+librunner.new_rnn_model_with_filename.restype = c_void_p
+librunner.release_rnn_model.argtypes = [c_void_p]
+librunner.init_rnn_runner_with_model.argtypes = [c_void_p, c_void_p]
+librunner.update_rnn_runner_batch_with_steps.argtypes = [POINTER(c_void_p), c_int, c_int]
 
 
 def init_genrand(seed):
@@ -24,6 +28,27 @@ def init_genrand(seed):
     librunner.init_genrand(c_ulong(seed % 4294967295 + 1))
 
 
+def update_batch(runners, step_num=1, librunner=librunner):
+    """Updates the runners by step_num steps at once.
+
+    The runners sharing an RNNModel are computed together, which is faster
+    than updating them one by one.
+    """
+    array = (c_void_p * len(runners))(*[r.runner.value for r in runners])
+    librunner.update_rnn_runner_batch_with_steps(array, len(runners),
+            step_num)
+
+
+class RNNModel(object):
+    """Parameters of a model shared by runners (see rnn_model.h)"""
+    def __init__(self, file_name, librunner=librunner):
+        self.librunner = librunner
+        self.model = self.librunner.new_rnn_model_with_filename(file_name)
+
+    def __del__(self):
+        self.librunner.release_rnn_model(self.model)
+
+
 class RNNRunner(object):
     def __init__(self, librunner=librunner):
         self.runner = c_void_p()
@@ -40,6 +65,11 @@ class RNNRunner(object):
         self.librunner.init_rnn_runner_with_filename(self.runner, file_name)
         self.is_initialized = True
 
+    def init_with_model(self, model):
+        self.free()
+        self.librunner.init_rnn_runner_with_model(self.runner, model.model)
+        self.is_initialized = True
+
     def free(self):
         if self.is_initialized:
             self.librunner.free_rnn_runner(self.runner)
@@ -15,6 +15,13 @@ librunner.rnn_c_state_from_runner2.restype = POINTER(c_double)
 librunner.rnn_c_inter_state_from_runner2.restype = POINTER(c_double)
 librunner.rnn_out_state_from_runner2.restype = POINTER(c_double)
 librunner.update_rnn_runner2.argtypes = [c_void_p, POINTER(c_double), c_int, c_double, c_double]
+librunner.set_incremental_mode_of_rnn_runner2.argtypes = [c_void_p, c_int, c_double]
+librunner.update_rnn_runner2_with_deadline.argtypes = [c_void_p, POINTER(c_double), c_double, c_int, c_double, c_double]
+librunner.rnn_step_latency_from_runner2.argtypes = [c_void_p, c_double]
+librunner.rnn_step_latency_from_runner2.restype = c_double
+librunner.new_rnn_model_with_filename.restype = c_void_p
+librunner.release_rnn_model.argtypes = [c_void_p]
+librunner.init_rnn_runner2_with_model.argtypes = [c_void_p, c_void_p, c_int]
 
 
 def init_genrand(seed):
@@ -25,6 +32,16 @@ def init_genrand(seed):
     librunner.init_genrand(c_ulong(seed % 4294967295 + 1))
 
 
+class RNNModel(object):
+    """Parameters of a model shared by runners (see rnn_model.h)"""
+    def __init__(self, file_name, librunner=librunner):
+        self.librunner = librunner
+        self.model = self.librunner.new_rnn_model_with_filename(file_name)
+
+    def __del__(self):
+        self.librunner.release_rnn_model(self.model)
+
+
 class RNNRunner(object):
     def __init__(self, librunner=librunner):
         self.runner = c_void_p()
@@ -42,6 +59,12 @@ class RNNRunner(object):
                 window_length)
         self.is_initialized = True
 
+    def init_with_model(self, model, window_length):
+        self.free()
+        self.librunner.init_rnn_runner2_with_model(self.runner, model.model,
+                window_length)
+        self.is_initialized = True
+
     def free(self):
         if self.is_initialized:
             self.librunner.free_rnn_runner2(self.runner)
@@ -68,6 +91,10 @@ class RNNRunner(object):
     def output_type(self):
         return self.librunner.rnn_output_type_from_runner2(self.runner)
 
+    def set_incremental_mode(self, incremental=True, tolerance=0):
+        self.librunner.set_incremental_mode_of_rnn_runner2(self.runner,
+                1 if incremental else 0, tolerance)
+
     def update(self, in_state, reg_count, rho_init, momentum):
         if in_state != None:
             x = (c_double * len(in_state))()
@@ -78,6 +105,21 @@ class RNNRunner(object):
         self.librunner.update_rnn_runner2(self.runner, x, reg_count, rho_init,
                 momentum)
 
+    def update_with_deadline(self, in_state, time_budget, max_reg_count,
+            rho_init, momentum):
+        if in_state != None:
+            x = (c_double * len(in_state))()
+            for i in xrange(len(in_state)):
+                x[i] = c_double(in_state[i])
+        else:
+            x = None
+        return self.librunner.update_rnn_runner2_with_deadline(self.runner, x,
+                time_budget, max_reg_count, rho_init, momentum)
+
+    def step_latency(self, percentile=50):
+        return self.librunner.rnn_step_latency_from_runner2(self.runner,
+                percentile)
+
     def in_state(self, in_state=None):
         x = self.librunner.rnn_in_state_from_runner2(self.runner)
         if in_state != None:
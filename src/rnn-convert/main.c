@@ -0,0 +1,153 @@
+/*
+    Copyright (c) 2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef ENABLE_MTRACE
+#include <mcheck.h>
+#endif
+
+#include "utils.h"
+#include "target.h"
+
+
+#define TO_STRING_I(s) #s
+#define TO_STRING(s) TO_STRING_I(s)
+
+static void display_help (void)
+{
+    puts("rnn-convert  - a program to convert target files of rnn-learn");
+    puts("");
+    puts("Usage: rnn-convert [-o output-file] [-t] [target-file ...]");
+    puts("Usage: rnn-convert [-v] [-h]");
+    puts("");
+    puts("Available options are:");
+    puts("-o output-file");
+    puts("    Writes the converted time series to `output-file' instead of "
+            "the standard output.");
+    puts("-t");
+    puts("    Writes the time series as text instead of the binary format.");
+    puts("-v");
+    puts("    Prints the version information and exit.");
+    puts("-h");
+    puts("    Prints this help and exit.");
+    puts("");
+    puts("Program execution:");
+    puts("rnn-convert reads the time series in the target files (or the "
+            "standard input if no file is given), which are text files or "
+            "binary files, and writes them in the binary format which "
+            "rnn-learn maps into memory without parsing. With -t, binary "
+            "files are converted back into text.");
+}
+
+static void display_version (void)
+{
+    printf("rnn-convert version %s\n", TO_STRING(VERSION));
+}
+
+static void fprint_target (
+        const struct target_reader *t_reader,
+        FILE *fp)
+{
+    for (int k = 0; k < t_reader->num; k++) {
+        const struct target_t *t = t_reader->t_list + k;
+        if (k > 0) {
+            fprintf(fp, "\n");
+        }
+        for (int n = 0; n < t->length; n++) {
+            for (int i = 0; i < t_reader->dimension; i++) {
+                fprintf(fp, (i == 0) ? "%.17g" : "\t%.17g", t->target[n][i]);
+            }
+            fprintf(fp, "\n");
+        }
+    }
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_MTRACE
+    mtrace();
+#endif
+    const char *output_filename = NULL;
+    int text_mode = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:tvh")) != -1) {
+        switch (opt) {
+            case 'o':
+                output_filename = optarg;
+                break;
+            case 't':
+                text_mode = 1;
+                break;
+            case 'v':
+                display_version();
+                exit(EXIT_SUCCESS);
+            case 'h':
+                display_help();
+                exit(EXIT_SUCCESS);
+            default: /* '?' */
+                fprintf(stderr, "Try `rnn-convert -h' for more "
+                        "information.\n");
+                exit(EXIT_SUCCESS);
+        }
+    }
+
+    struct target_reader t_reader;
+    init_target_reader(&t_reader);
+    if (optind >= argc) {
+        if (read_target_from_file(&t_reader, " \t,", stdin) == -1) {
+            print_error_msg("error in the standard input");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (read_target_files(&t_reader, " \t,", argc - optind, argv + optind,
+                0) == -1) {
+        exit(EXIT_FAILURE);
+    }
+    if (t_reader.dimension < 0) {
+        t_reader.dimension = 0;
+    }
+    set_target_rows(&t_reader);
+
+    FILE *fp = stdout;
+    if (output_filename != NULL) {
+        if ((fp = fopen(output_filename, text_mode ? "w" : "wb")) == NULL) {
+            print_error_msg("cannot open %s", output_filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (text_mode) {
+        fprint_target(&t_reader, fp);
+    } else {
+        fwrite_target_dataset(&t_reader, 0, t_reader.num, fp);
+    }
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    free_target_reader(&t_reader);
+
+#ifdef ENABLE_MTRACE
+    muntrace();
+#endif
+    return EXIT_SUCCESS;
+}
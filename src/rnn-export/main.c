@@ -0,0 +1,154 @@
+/*
+    Copyright (c) 2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef ENABLE_MTRACE
+#include <mcheck.h>
+#endif
+
+#include "utils.h"
+#include "rnn.h"
+#include "rnn_file.h"
+
+
+#define TO_STRING_I(s) #s
+#define TO_STRING(s) TO_STRING_I(s)
+
+static void display_help (void)
+{
+    puts("rnn-export  - a program to export a model of rnn-learn for "
+            "inference");
+    puts("");
+    puts("Usage: rnn-export [-w window-length] model-file output-file");
+    puts("Usage: rnn-export [-v] [-h]");
+    puts("");
+    puts("Available options are:");
+    puts("-w window-length");
+    puts("    Keeps (window-length + feedback-delay) steps of the input of "
+            "each training series, which the initial state of the "
+            "predictor with a window (rnn_runner2) refers to. By default, "
+            "only feedback-delay steps are kept.");
+    puts("-v");
+    puts("    Prints the version information and exit.");
+    puts("-h");
+    puts("    Prints this help and exit.");
+    puts("");
+    puts("Program execution:");
+    puts("rnn-export reads a model saved by rnn-learn, and writes the "
+            "parameters and the initial states of the training series to "
+            "`output-file'. The gradients, the prior distribution, the state "
+            "of the optimizer and the teacher signals are omitted, so that "
+            "the output is much smaller than the model when the training "
+            "data are large. rnn-generate, rnn-lyapunov and the python "
+            "module accept the output as well as the model. rnn-learn "
+            "accepts it only with new target files.");
+}
+
+static void display_version (void)
+{
+    printf("rnn-export version %s\n", TO_STRING(VERSION));
+}
+
+static void read_model (
+        const char *filename,
+        struct recurrent_neural_network *rnn,
+        int *delay_length)
+{
+    if (is_rnn_file(filename)) {
+        struct rnn_file file;
+        if (map_rnn_file(&file, filename) != 0) {
+            exit(EXIT_FAILURE);
+        }
+        *delay_length = file.header->delay_length;
+        rnn_file_read_recurrent_neural_network(&file, rnn);
+        unmap_rnn_file(&file);
+    } else {
+        FILE *fp;
+        if ((fp = fopen(filename, "rb")) == NULL) {
+            print_error_msg("cannot open %s", filename);
+            exit(EXIT_FAILURE);
+        }
+        FREAD(delay_length, 1, fp);
+        fread_recurrent_neural_network(rnn, fp);
+        fclose(fp);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_MTRACE
+    mtrace();
+#endif
+    int window_length = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:vh")) != -1) {
+        switch (opt) {
+            case 'w':
+                window_length = atoi(optarg);
+                if (window_length < 0) {
+                    print_error_msg("window-length must be non-negative");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'v':
+                display_version();
+                exit(EXIT_SUCCESS);
+            case 'h':
+                display_help();
+                exit(EXIT_SUCCESS);
+            default: /* '?' */
+                fprintf(stderr, "Try `rnn-export -h' for more "
+                        "information.\n");
+                exit(EXIT_SUCCESS);
+        }
+    }
+    if (argc - optind != 2) {
+        fprintf(stderr, "%s: model-file and output-file are required\n",
+                argv[0]);
+        fprintf(stderr, "Try `rnn-export -h' for more information.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct recurrent_neural_network rnn;
+    int delay_length;
+    read_model(argv[optind], &rnn, &delay_length);
+
+    FILE *fp;
+    if ((fp = fopen(argv[optind + 1], "wb")) == NULL) {
+        print_error_msg("cannot open %s", argv[optind + 1]);
+        exit(EXIT_FAILURE);
+    }
+    struct rnn_file_writer writer;
+    init_rnn_file_writer(&writer, fp);
+    rnn_file_write_inference_network(&writer, &rnn, delay_length,
+            window_length + delay_length);
+    fini_rnn_file_writer(&writer);
+    fclose(fp);
+    free_recurrent_neural_network(&rnn);
+
+#ifdef ENABLE_MTRACE
+    muntrace();
+#endif
+    return EXIT_SUCCESS;
+}
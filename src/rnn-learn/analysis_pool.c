@@ -0,0 +1,218 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "utils.h"
+#include "analysis_pool.h"
+
+
+/*
+ * This function initializes a snapshot which has the same parameters as rnn,
+ * and whose series refer to the input and the target of rnn.
+ */
+static void init_snapshot (
+        struct recurrent_neural_network *snapshot,
+        const struct recurrent_neural_network *rnn)
+{
+    rnn_duplicate_parameters(&snapshot->rnn_p, &rnn->rnn_p);
+
+    int length[rnn->series_num];
+    const double* const* input[rnn->series_num];
+    const double* const* target[rnn->series_num];
+    for (int i = 0; i < rnn->series_num; i++) {
+        length[i] = rnn->rnn_s[i].length;
+        input[i] = (const double* const*)rnn->rnn_s[i].in_state;
+        target[i] = (const double* const*)rnn->rnn_s[i].teach_state;
+    }
+    snapshot->series_num = 0;
+    snapshot->rnn_s = NULL;
+    rnn_add_target_views(snapshot, rnn->series_num, length, input, target);
+}
+
+
+#ifdef HAVE_PTHREAD
+static void* analysis_pool_main (void *arg)
+{
+    struct analysis_pool *pool = arg;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->started == pool->submitted && !pool->quit) {
+            pthread_cond_wait(&pool->not_empty, &pool->mutex);
+        }
+        if (pool->started == pool->submitted) {
+            break;
+        }
+        const long seq = pool->started++;
+        struct analysis_task *task = pool->task + seq % pool->task_num;
+        pthread_mutex_unlock(&pool->mutex);
+        pool->analyze(task->epoch, &task->rnn, &task->writer, pool->arg);
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->written != seq) {
+            pthread_cond_wait(&pool->turn, &pool->mutex);
+        }
+        // the other threads wait for the turn, and the files are written
+        // only by this thread
+        pthread_mutex_unlock(&pool->mutex);
+        log_release(&task->writer);
+        pthread_mutex_lock(&pool->mutex);
+        pool->written++;
+        pthread_cond_broadcast(&pool->turn);
+        pthread_cond_signal(&pool->not_full);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+#endif
+
+
+void init_analysis_pool (
+        struct analysis_pool *pool,
+        const struct recurrent_neural_network *template,
+        int copy_initial_states,
+        int thread_num,
+        int queue_size,
+        int binary,
+        analysis_function analyze,
+        void *arg)
+{
+#ifndef HAVE_PTHREAD
+    if (thread_num > 0) {
+        print_error_msg("warning: background analysis is not supported");
+        thread_num = 0;
+    }
+#endif
+    pool->thread_num = thread_num > 0 ? thread_num : 0;
+    pool->copy_initial_states = copy_initial_states;
+    pool->task_num = pool->thread_num + (queue_size > 0 ? queue_size : 0);
+    if (pool->task_num == 0) {
+        pool->task_num = 1;
+    }
+    pool->analyze = analyze;
+    pool->arg = arg;
+    pool->submitted = 0;
+    pool->started = 0;
+    pool->written = 0;
+    MALLOC(pool->task, pool->task_num);
+    for (int i = 0; i < pool->task_num; i++) {
+        init_snapshot(&pool->task[i].rnn, template);
+        init_log_writer(&pool->task[i].writer, 0, binary, 1);
+        log_set_hold(&pool->task[i].writer, 1);
+    }
+#ifdef HAVE_PTHREAD
+    if (pool->thread_num > 0) {
+        pool->quit = 0;
+        pthread_mutex_init(&pool->mutex, NULL);
+        pthread_cond_init(&pool->not_empty, NULL);
+        pthread_cond_init(&pool->not_full, NULL);
+        pthread_cond_init(&pool->turn, NULL);
+        MALLOC(pool->thread, pool->thread_num);
+        for (int i = 0; i < pool->thread_num; i++) {
+            if (pthread_create(pool->thread + i, NULL, analysis_pool_main,
+                        pool) != 0) {
+                print_error_msg("cannot create a thread for analysis");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+#endif
+}
+
+
+/*
+ * This function waits until all the submitted analyses are written, and frees
+ * the pool.
+ */
+void free_analysis_pool (struct analysis_pool *pool)
+{
+#ifdef HAVE_PTHREAD
+    if (pool->thread_num > 0) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->quit = 1;
+        pthread_cond_broadcast(&pool->not_empty);
+        pthread_mutex_unlock(&pool->mutex);
+        for (int i = 0; i < pool->thread_num; i++) {
+            pthread_join(pool->thread[i], NULL);
+        }
+        FREE(pool->thread);
+        pthread_mutex_destroy(&pool->mutex);
+        pthread_cond_destroy(&pool->not_empty);
+        pthread_cond_destroy(&pool->not_full);
+        pthread_cond_destroy(&pool->turn);
+    }
+#endif
+    for (int i = 0; i < pool->task_num; i++) {
+        free_log_writer(&pool->task[i].writer);
+        free_recurrent_neural_network(&pool->task[i].rnn);
+    }
+    FREE(pool->task);
+}
+
+
+static void copy_to_snapshot (
+        struct analysis_pool *pool,
+        struct analysis_task *task,
+        long epoch,
+        const struct recurrent_neural_network *rnn)
+{
+    task->epoch = epoch;
+    if (pool->copy_initial_states) {
+        rnn_copy_learning_parameters(&task->rnn, rnn);
+    } else {
+        rnn_copy_parameters(&task->rnn.rnn_p, &rnn->rnn_p);
+    }
+}
+
+/*
+ * This function copies the parameters of rnn to a snapshot, and passes it to
+ * the threads. If all the snapshots are in use, this function waits until the
+ * oldest analysis is written.
+ */
+void submit_analysis (
+        struct analysis_pool *pool,
+        long epoch,
+        const struct recurrent_neural_network *rnn)
+{
+#ifdef HAVE_PTHREAD
+    if (pool->thread_num > 0) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->submitted - pool->written >= pool->task_num) {
+            pthread_cond_wait(&pool->not_full, &pool->mutex);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+        struct analysis_task *task = pool->task + pool->submitted %
+            pool->task_num;
+        copy_to_snapshot(pool, task, epoch, rnn);
+        pthread_mutex_lock(&pool->mutex);
+        pool->submitted++;
+        pthread_cond_signal(&pool->not_empty);
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+#endif
+    struct analysis_task *task = pool->task;
+    copy_to_snapshot(pool, task, epoch, rnn);
+    pool->analyze(task->epoch, &task->rnn, &task->writer, pool->arg);
+    log_release(&task->writer);
+    pool->submitted++;
+    pool->started++;
+    pool->written++;
+}
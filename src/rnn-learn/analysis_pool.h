@@ -0,0 +1,95 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ANALYSIS_POOL_H
+#define ANALYSIS_POOL_H
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "rnn.h"
+#include "log_writer.h"
+
+/*
+ * An analysis computes the closed-loop dynamics etc. of rnn at epoch, and
+ * submits its records to writer.
+ */
+typedef void (*analysis_function) (
+        long epoch,
+        struct recurrent_neural_network *rnn,
+        struct log_writer *writer,
+        void *arg);
+
+typedef struct analysis_task {
+    long epoch;
+    struct recurrent_neural_network rnn;    // snapshot of the model
+    struct log_writer writer;               // records held until written
+} analysis_task;
+
+/*
+ * analysis_pool runs analyses on snapshots of the model by thread_num
+ * background threads, so that learning continues during the analyses.
+ * At most queue_size snapshots wait for a thread, and submit_analysis waits
+ * until a snapshot is available if the queue is full. The records of the
+ * analyses are written in the order of submission.
+ * Each snapshot has the structure and the series of the template given to
+ * init_analysis_pool, and shares the input and the target of the series with
+ * the template, which must not change while the pool is used. The learning
+ * parameters of the model are copied to a snapshot at each submission, and
+ * if copy_initial_states!=0, the initial states of the series are also
+ * copied (the model must have the series of the template in that case).
+ * If thread_num=0, analyses are done in submit_analysis.
+ */
+typedef struct analysis_pool {
+    int thread_num;
+    int copy_initial_states;
+    int task_num;
+    struct analysis_task *task;             // ring of task_num snapshots
+    analysis_function analyze;
+    void *arg;
+    long submitted;                         // number of submitted tasks
+    long started;                           // number of started tasks
+    long written;                           // number of written tasks
+#ifdef HAVE_PTHREAD
+    int quit;
+    pthread_t *thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t turn;
+#endif
+} analysis_pool;
+
+
+void init_analysis_pool (
+        struct analysis_pool *pool,
+        const struct recurrent_neural_network *template,
+        int copy_initial_states,
+        int thread_num,
+        int queue_size,
+        int binary,
+        analysis_function analyze,
+        void *arg);
+
+void free_analysis_pool (struct analysis_pool *pool);
+
+void submit_analysis (
+        struct analysis_pool *pool,
+        long epoch,
+        const struct recurrent_neural_network *rnn);
+
+#endif
@@ -0,0 +1,183 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "utils.h"
+#include "rnn_file.h"
+#include "checkpoint.h"
+
+
+#ifndef CHECKPOINT_BUFFER_SIZE
+#define CHECKPOINT_BUFFER_SIZE (1 << 16)
+#endif
+
+
+void init_checkpoint (
+        struct checkpoint *cp,
+        const char *filename,
+        long epoch)
+{
+    cp->pid = -1;
+    cp->epoch = epoch;
+    cp->time = time(NULL);
+    MALLOC(cp->filename, strlen(filename) + 1);
+    strcpy(cp->filename, filename);
+    MALLOC(cp->tmp_filename, strlen(filename) + 5);
+    sprintf(cp->tmp_filename, "%s.tmp", filename);
+    const char *p = strrchr(filename, '/');
+    if (p == NULL) {
+        MALLOC(cp->dirname, 2);
+        strcpy(cp->dirname, ".");
+    } else {
+        size_t n = (p == filename) ? 1 : (size_t)(p - filename);
+        MALLOC(cp->dirname, n + 1);
+        memcpy(cp->dirname, filename, n);
+        cp->dirname[n] = '\0';
+    }
+    MALLOC(cp->buffer, CHECKPOINT_BUFFER_SIZE);
+}
+
+void free_checkpoint (struct checkpoint *cp)
+{
+    wait_checkpoint(cp, 1);
+    FREE(cp->filename);
+    FREE(cp->tmp_filename);
+    FREE(cp->dirname);
+    FREE(cp->buffer);
+}
+
+
+/*
+ * This function collects the child process of the last checkpoint. If block
+ * is zero and the child is still writing, this function returns 1 without
+ * waiting. Otherwise it returns 0.
+ */
+int wait_checkpoint (
+        struct checkpoint *cp,
+        int block)
+{
+    if (cp->pid == -1) {
+        return 0;
+    }
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(cp->pid, &status, block ? 0 : WNOHANG)) == -1) {
+        if (errno != EINTR) {
+            print_error_msg("warning: `waitpid' failed");
+            cp->pid = -1;
+            return 0;
+        }
+    }
+    if (pid == 0) {
+        return 1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        print_error_msg("warning: checkpoint at epoch %ld failed", cp->epoch);
+    }
+    cp->pid = -1;
+    return 0;
+}
+
+
+/*
+ * This function forks a child which saves a snapshot of the model. The
+ * previous checkpoint has to be collected by wait_checkpoint in advance.
+ * It returns 0 on success, and -1 on failure.
+ */
+int start_checkpoint (
+        struct checkpoint *cp,
+        long epoch,
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer,
+        int delay_length,
+        double adapt_lr,
+        long init_epoch)
+{
+    FILE *fp;
+    if ((fp = fopen(cp->tmp_filename, "wb")) == NULL) {
+        print_error_msg("warning: cannot open %s", cp->tmp_filename);
+        return -1;
+    }
+    setvbuf(fp, cp->buffer, _IOFBF, CHECKPOINT_BUFFER_SIZE);
+    int dir_fd = open(cp->dirname, O_RDONLY);
+    if (dir_fd == -1) {
+        print_error_msg("warning: cannot open %s", cp->dirname);
+        fclose(fp);
+        remove(cp->tmp_filename);
+        return -1;
+    }
+    // the child must not write out the buffered data of the parent again
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        fwrite_rnn_snapshot(rnn, optimizer, delay_length, adapt_lr,
+                init_epoch, fp);
+        if (fflush(fp) != 0 || fsync(fileno(fp)) != 0 ||
+                rename(cp->tmp_filename, cp->filename) != 0) {
+            unlink(cp->tmp_filename);
+            _exit(EXIT_FAILURE);
+        }
+        _exit((fsync(dir_fd) == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    // nothing has been written to the stream by the parent
+    fclose(fp);
+    close(dir_fd);
+    if (pid == -1) {
+        print_error_msg("warning: `fork' failed");
+        remove(cp->tmp_filename);
+    }
+    cp->pid = pid;
+    cp->epoch = epoch;
+    cp->time = time(NULL);
+    return (pid == -1) ? -1 : 0;
+}
+
+
+/*
+ * This function writes the model and the state of the optimizer as a model
+ * file. It allocates no memory, so that it can be called by the child of a
+ * checkpoint.
+ */
+void fwrite_rnn_snapshot (
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer,
+        int delay_length,
+        double adapt_lr,
+        long init_epoch,
+        FILE *fp)
+{
+    struct rnn_file_writer writer;
+    init_rnn_file_writer(&writer, fp);
+    rnn_file_write_recurrent_neural_network(&writer, rnn, delay_length,
+            adapt_lr, init_epoch);
+    rnn_file_begin_section(&writer, RNN_FILE_OPTIMIZER);
+    fwrite_rnn_optimizer(optimizer, fp);
+    rnn_file_end_section(&writer);
+    fini_rnn_file_writer(&writer);
+}
+
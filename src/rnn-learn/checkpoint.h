@@ -0,0 +1,84 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "rnn.h"
+#include "rnn_optimizer.h"
+
+/*
+ * A checkpoint saves a snapshot of the model to filename by a forked child
+ * from its copy-on-write image of the memory, so that learning goes on
+ * without waiting for the file. The snapshot is written to filename + ".tmp"
+ * and renamed to filename, so that the previous file is replaced atomically.
+ *
+ * The child of a multithreaded process may only call async-signal-safe
+ * functions in principle. Hence the temporary file and the buffer of its
+ * stream are prepared by the parent, and the child neither allocates memory
+ * nor opens a file: it writes the snapshot by stdio to that stream, which no
+ * other thread has used, and calls fsync, rename and _exit. The file is
+ * synchronized before it is renamed, and so is the directory opened by the
+ * parent afterwards, so that the snapshot survives a crash of the system
+ * once the checkpoint has succeeded. The remaining
+ * dependency is that stdio on such a stream works in the child, which holds
+ * on POSIX systems where the lock of the stream is free at fork, e.g. glibc.
+ * If writing fails, the child exits by exit(3) (see FWRITE).
+ */
+typedef struct checkpoint {
+    pid_t pid;              // child writing the snapshot (-1 if none)
+    long epoch;             // epoch when the last checkpoint was started
+    time_t time;            // time when the last checkpoint was started
+    char *filename;
+    char *tmp_filename;
+    char *dirname;          // directory which contains filename
+    char *buffer;           // buffer of the stream written by the child
+} checkpoint;
+
+
+void init_checkpoint (
+        struct checkpoint *cp,
+        const char *filename,
+        long epoch);
+
+void free_checkpoint (struct checkpoint *cp);
+
+int wait_checkpoint (
+        struct checkpoint *cp,
+        int block);
+
+int start_checkpoint (
+        struct checkpoint *cp,
+        long epoch,
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer,
+        int delay_length,
+        double adapt_lr,
+        long init_epoch);
+
+void fwrite_rnn_snapshot (
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer,
+        int delay_length,
+        double adapt_lr,
+        long init_epoch,
+        FILE *fp);
+
+#endif
@@ -0,0 +1,509 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "utils.h"
+#include "log_writer.h"
+
+#ifndef LOG_RECORD_CAPACITY
+#define LOG_RECORD_CAPACITY 4096
+#endif
+
+/*
+ * Data of a record is a sequence of chunks. Each chunk consists of the header
+ * below and n bytes of text (LOG_TEXT), or n numbers which are formatted with
+ * format one by one.
+ */
+enum log_chunk_type {
+    LOG_TEXT,
+    LOG_DOUBLE,
+    LOG_INT,
+};
+
+struct log_chunk {
+    int type;
+    int n;
+    const char *format;
+};
+
+
+static void reserve_log_record (
+        struct log_record *record,
+        size_t size)
+{
+    if (record->size + size > record->capacity) {
+        size_t capacity = record->capacity > 0 ? record->capacity : 1;
+        while (record->size + size > capacity) {
+            capacity *= 2;
+        }
+        REALLOC(record->data, capacity);
+        record->capacity = capacity;
+    }
+}
+
+static void append_log_chunk (
+        struct log_record *record,
+        int type,
+        int n,
+        const char *format,
+        const void *x,
+        size_t size)
+{
+    struct log_chunk chunk = {.type = type, .n = n, .format = format};
+    reserve_log_record(record, sizeof(struct log_chunk) + size);
+    memcpy(record->data + record->size, &chunk, sizeof(struct log_chunk));
+    record->size += sizeof(struct log_chunk);
+    if (size > 0) {
+        memcpy(record->data + record->size, x, size);
+        record->size += size;
+    }
+}
+
+
+/*
+ * This function appends a formatted value to the buffer of writer, and
+ * returns the new length of the text in the buffer.
+ */
+static size_t append_formatted_value (
+        struct log_writer *writer,
+        size_t length,
+        const char *format,
+        int type,
+        const void *x)
+{
+    for (;;) {
+        size_t rest = writer->buf_size - length;
+        int n;
+        if (type == LOG_DOUBLE) {
+            double value;
+            memcpy(&value, x, sizeof(double));
+            n = snprintf(writer->buf + length, rest, format, value);
+        } else {
+            int value;
+            memcpy(&value, x, sizeof(int));
+            n = snprintf(writer->buf + length, rest, format, value);
+        }
+        if (n < 0) {
+            print_error_msg("`snprintf' failed");
+            exit(EXIT_FAILURE);
+        } else if ((size_t)n < rest) {
+            return length + n;
+        }
+        writer->buf_size = 2 * writer->buf_size + n;
+        REALLOC(writer->buf, writer->buf_size);
+    }
+}
+
+/*
+ * This function converts the numbers of a record to double, and writes them
+ * after the epoch at once.
+ */
+static void write_binary_log_record (
+        struct log_writer *writer,
+        const struct log_record *record)
+{
+    size_t length = 0;
+    int64_t epoch = record->epoch;
+    // an int takes at most twice as much space as a double
+    if (writer->buf_size < 2 * record->size + sizeof(int64_t)) {
+        writer->buf_size = 2 * record->size + sizeof(int64_t);
+        REALLOC(writer->buf, writer->buf_size);
+    }
+    memcpy(writer->buf, &epoch, sizeof(int64_t));
+    length += sizeof(int64_t);
+    const char *p = record->data;
+    const char *end = record->data + record->size;
+    while (p < end) {
+        struct log_chunk chunk;
+        memcpy(&chunk, p, sizeof(struct log_chunk));
+        p += sizeof(struct log_chunk);
+        if (chunk.type == LOG_TEXT) {
+            p += chunk.n;
+        } else if (chunk.type == LOG_DOUBLE) {
+            memcpy(writer->buf + length, p, sizeof(double) * chunk.n);
+            length += sizeof(double) * chunk.n;
+            p += sizeof(double) * chunk.n;
+        } else {
+            for (int i = 0; i < chunk.n; i++) {
+                int value;
+                memcpy(&value, p, sizeof(int));
+                double x = value;
+                memcpy(writer->buf + length, &x, sizeof(double));
+                length += sizeof(double);
+                p += sizeof(int);
+            }
+        }
+    }
+    fwrite(writer->buf, 1, length, record->fp);
+    if (record->flush) {
+        fflush(record->fp);
+    }
+}
+
+/*
+ * This function formats the chunks of a record as printf does, and writes
+ * the whole text at once.
+ */
+static void write_log_record (
+        struct log_writer *writer,
+        const struct log_record *record)
+{
+    if (record->raw) {
+        fwrite(record->data, 1, record->size, record->fp);
+        if (record->flush) {
+            fflush(record->fp);
+        }
+        return;
+    } else if (writer->binary) {
+        write_binary_log_record(writer, record);
+        return;
+    }
+    size_t length = 0;
+    const char *p = record->data;
+    const char *end = record->data + record->size;
+    while (p < end) {
+        struct log_chunk chunk;
+        memcpy(&chunk, p, sizeof(struct log_chunk));
+        p += sizeof(struct log_chunk);
+        if (chunk.type == LOG_TEXT) {
+            if (length + chunk.n > writer->buf_size) {
+                writer->buf_size = 2 * writer->buf_size + chunk.n;
+                REALLOC(writer->buf, writer->buf_size);
+            }
+            memcpy(writer->buf + length, p, chunk.n);
+            length += chunk.n;
+            p += chunk.n;
+        } else {
+            size_t size = (chunk.type == LOG_DOUBLE) ? sizeof(double) :
+                sizeof(int);
+            for (int i = 0; i < chunk.n; i++) {
+                length = append_formatted_value(writer, length, chunk.format,
+                        chunk.type, p);
+                p += size;
+            }
+        }
+    }
+    if (length > 0) {
+        fwrite(writer->buf, 1, length, record->fp);
+    }
+    if (record->flush) {
+        fflush(record->fp);
+    }
+}
+
+
+static void init_log_records (
+        struct log_record *record,
+        int record_num)
+{
+    for (int i = 0; i < record_num; i++) {
+        record[i].fp = NULL;
+        record[i].epoch = 0;
+        record[i].flush = 0;
+        record[i].raw = 0;
+        record[i].size = 0;
+        record[i].capacity = LOG_RECORD_CAPACITY;
+        MALLOC(record[i].data, LOG_RECORD_CAPACITY);
+    }
+}
+
+
+#ifdef HAVE_PTHREAD
+static void* log_writer_main (void *arg)
+{
+    struct log_writer *writer = arg;
+    pthread_mutex_lock(&writer->mutex);
+    for (;;) {
+        while (writer->count == 0 && !writer->quit) {
+            pthread_cond_wait(&writer->not_empty, &writer->mutex);
+        }
+        if (writer->count == 0) {
+            break;
+        }
+        const struct log_record *record = writer->record + writer->tail;
+        pthread_mutex_unlock(&writer->mutex);
+        write_log_record(writer, record);
+        pthread_mutex_lock(&writer->mutex);
+        writer->tail = (writer->tail + 1) % writer->record_num;
+        writer->count--;
+        pthread_cond_signal(&writer->not_full);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+#endif
+
+
+void init_log_writer (
+        struct log_writer *writer,
+        int use_thread,
+        int binary,
+        int record_num)
+{
+#ifndef HAVE_PTHREAD
+    if (use_thread) {
+        print_error_msg("warning: asynchronous logging is not supported");
+        use_thread = 0;
+    }
+#endif
+    writer->use_thread = use_thread;
+    writer->binary = binary;
+    writer->record_num = (use_thread && record_num > 1) ? record_num : 1;
+    writer->hold = 0;
+    MALLOC(writer->record, writer->record_num);
+    init_log_records(writer->record, writer->record_num);
+    writer->head = 0;
+    writer->tail = 0;
+    writer->count = 0;
+    writer->buf_size = LOG_RECORD_CAPACITY;
+    MALLOC(writer->buf, writer->buf_size);
+#ifdef HAVE_PTHREAD
+    if (writer->use_thread) {
+        writer->quit = 0;
+        pthread_mutex_init(&writer->mutex, NULL);
+        pthread_cond_init(&writer->not_empty, NULL);
+        pthread_cond_init(&writer->not_full, NULL);
+        if (pthread_create(&writer->thread, NULL, log_writer_main,
+                    writer) != 0) {
+            print_error_msg("warning: cannot create a thread for logging");
+            pthread_mutex_destroy(&writer->mutex);
+            pthread_cond_destroy(&writer->not_empty);
+            pthread_cond_destroy(&writer->not_full);
+            writer->use_thread = 0;
+        }
+    }
+#endif
+}
+
+
+/*
+ * This function waits until all the submitted records are written, and frees
+ * the writer. The files are not closed.
+ */
+void free_log_writer (struct log_writer *writer)
+{
+#ifdef HAVE_PTHREAD
+    if (writer->use_thread) {
+        pthread_mutex_lock(&writer->mutex);
+        writer->quit = 1;
+        pthread_cond_signal(&writer->not_empty);
+        pthread_mutex_unlock(&writer->mutex);
+        pthread_join(writer->thread, NULL);
+        pthread_mutex_destroy(&writer->mutex);
+        pthread_cond_destroy(&writer->not_empty);
+        pthread_cond_destroy(&writer->not_full);
+    }
+#endif
+    log_release(writer);
+    for (int i = 0; i < writer->record_num; i++) {
+        FREE(writer->record[i].data);
+    }
+    FREE(writer->record);
+    FREE(writer->buf);
+}
+
+
+/*
+ * If hold!=0, the records submitted afterwards are kept until log_release is
+ * called. This is not available if the records are written by a thread.
+ */
+void log_set_hold (
+        struct log_writer *writer,
+        int hold)
+{
+    if (writer->use_thread && hold) {
+        print_error_msg("records are written by a thread");
+        exit(EXIT_FAILURE);
+    }
+    writer->hold = hold;
+}
+
+/*
+ * This function writes all the records kept by the writer in the order of
+ * submission.
+ */
+void log_release (struct log_writer *writer)
+{
+    if (writer->use_thread) return;
+    for (int i = 0; i < writer->count; i++) {
+        write_log_record(writer, writer->record + i);
+    }
+    writer->head = 0;
+    writer->count = 0;
+}
+
+
+/*
+ * This function submits all the records kept by held to writer in the order
+ * of submission, as if they were built by writer. The buffers of the records
+ * are exchanged between the writers instead of copied.
+ */
+void log_submit_held (
+        struct log_writer *writer,
+        struct log_writer *held)
+{
+    for (int i = 0; i < held->count; i++) {
+        struct log_record *src = held->record + i;
+        log_begin(writer, src->fp, src->epoch);
+        struct log_record *dst = writer->record + writer->head;
+        struct log_record tmp = *dst;
+        *dst = *src;
+        *src = tmp;
+        log_end(writer, dst->flush);
+    }
+    held->head = 0;
+    held->count = 0;
+}
+
+
+/*
+ * This function begins a record of epoch written to fp. If all the buffers
+ * are in use, this function waits until a record is written.
+ */
+void log_begin (
+        struct log_writer *writer,
+        FILE *fp,
+        long epoch)
+{
+#ifdef HAVE_PTHREAD
+    if (writer->use_thread) {
+        pthread_mutex_lock(&writer->mutex);
+        while (writer->count >= writer->record_num) {
+            pthread_cond_wait(&writer->not_full, &writer->mutex);
+        }
+        pthread_mutex_unlock(&writer->mutex);
+    }
+#endif
+    struct log_record *record = writer->record + writer->head;
+    record->fp = fp;
+    record->epoch = epoch;
+    record->flush = 0;
+    record->raw = 0;
+    record->size = 0;
+}
+
+/*
+ * This function begins a record of size bytes written to fp as it is, and
+ * returns the buffer of the record, which the caller fills before log_end.
+ */
+void* log_begin_raw (
+        struct log_writer *writer,
+        FILE *fp,
+        size_t size)
+{
+    log_begin(writer, fp, 0);
+    struct log_record *record = writer->record + writer->head;
+    record->raw = 1;
+    reserve_log_record(record, size);
+    record->size = size;
+    return record->data;
+}
+
+/*
+ * This function appends a text formatted immediately to the current record.
+ */
+void log_printf (
+        struct log_writer *writer,
+        const char *format,
+        ...)
+{
+    struct log_record *record = writer->record + writer->head;
+    va_list ap;
+    va_start(ap, format);
+    va_list aq;
+    va_copy(aq, ap);
+    int n = vsnprintf(NULL, 0, format, aq);
+    va_end(aq);
+    if (n < 0) {
+        print_error_msg("`vsnprintf' failed");
+        exit(EXIT_FAILURE);
+    }
+    struct log_chunk chunk = {.type = LOG_TEXT, .n = n, .format = NULL};
+    reserve_log_record(record, sizeof(struct log_chunk) + n + 1);
+    memcpy(record->data + record->size, &chunk, sizeof(struct log_chunk));
+    record->size += sizeof(struct log_chunk);
+    vsnprintf(record->data + record->size, n + 1, format, ap);
+    record->size += n;
+    va_end(ap);
+}
+
+/*
+ * These functions append n numbers to the current record. Each number is
+ * formatted with format (e.g. "\t%f") when the record is written. format must
+ * remain valid until then, so string literals are expected.
+ */
+void log_print_doubles (
+        struct log_writer *writer,
+        const char *format,
+        const double *x,
+        int n)
+{
+    append_log_chunk(writer->record + writer->head, LOG_DOUBLE, n, format, x,
+            sizeof(double) * n);
+}
+
+void log_print_ints (
+        struct log_writer *writer,
+        const char *format,
+        const int *x,
+        int n)
+{
+    append_log_chunk(writer->record + writer->head, LOG_INT, n, format, x,
+            sizeof(int) * n);
+}
+
+/*
+ * This function submits the current record. If flush!=0, the file is flushed
+ * after the record is written.
+ */
+void log_end (
+        struct log_writer *writer,
+        int flush)
+{
+    struct log_record *record = writer->record + writer->head;
+    record->flush = flush;
+#ifdef HAVE_PTHREAD
+    if (writer->use_thread) {
+        pthread_mutex_lock(&writer->mutex);
+        writer->head = (writer->head + 1) % writer->record_num;
+        writer->count++;
+        pthread_cond_signal(&writer->not_empty);
+        pthread_mutex_unlock(&writer->mutex);
+        return;
+    }
+#endif
+    if (writer->hold) {
+        writer->head++;
+        writer->count++;
+        if (writer->head == writer->record_num) {
+            REALLOC(writer->record, 2 * writer->record_num);
+            init_log_records(writer->record + writer->record_num,
+                    writer->record_num);
+            writer->record_num *= 2;
+        }
+        return;
+    }
+    write_log_record(writer, record);
+}
@@ -0,0 +1,127 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/*
+ * A record holds the data of a log entry written to a file. Texts are stored
+ * as they are, and arrays of numbers are stored in binary, which are
+ * formatted when the record is written.
+ */
+typedef struct log_record {
+    FILE *fp;
+    long epoch;
+    int flush;                          // if flush!=0, fp is flushed
+    int raw;                            // if raw!=0, data is written as is
+    size_t size;
+    size_t capacity;
+    char *data;
+} log_record;
+
+/*
+ * log_writer writes records to files in the order of submission. If
+ * use_thread!=0, records are passed through a ring of record_num buffers to
+ * a background thread which formats and writes them, so that the caller does
+ * not wait for the file. The buffers are reused, and grow only while they are
+ * smaller than the records. Otherwise, records are written when they are
+ * submitted. Records must be submitted by one thread.
+ * If binary!=0, texts are omitted, and each record is written as an int64
+ * epoch followed by the numbers in double (see rnn_log.h).
+ * Raw records, which are begun by log_begin_raw, are written as they are in
+ * both modes.
+ * If hold!=0 (use_thread must be 0), submitted records are kept until
+ * log_release is called, which writes them in order, or until
+ * log_submit_held passes them to another writer. This allows threads to
+ * prepare records which are written later by another thread.
+ */
+typedef struct log_writer {
+    int use_thread;
+    int binary;
+    int hold;
+    int record_num;
+    struct log_record *record;
+    int head;                           // index of the record being built
+    int tail;                           // index of the record being written
+    int count;                          // number of submitted records
+    char *buf;                          // buffer of formatted text
+    size_t buf_size;
+#ifdef HAVE_PTHREAD
+    int quit;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+#endif
+} log_writer;
+
+
+void init_log_writer (
+        struct log_writer *writer,
+        int use_thread,
+        int binary,
+        int record_num);
+
+void free_log_writer (struct log_writer *writer);
+
+void log_set_hold (
+        struct log_writer *writer,
+        int hold);
+
+void log_release (struct log_writer *writer);
+
+void log_submit_held (
+        struct log_writer *writer,
+        struct log_writer *held);
+
+void log_begin (
+        struct log_writer *writer,
+        FILE *fp,
+        long epoch);
+
+void* log_begin_raw (
+        struct log_writer *writer,
+        FILE *fp,
+        size_t size);
+
+void log_printf (
+        struct log_writer *writer,
+        const char *format,
+        ...);
+
+void log_print_doubles (
+        struct log_writer *writer,
+        const char *format,
+        const double *x,
+        int n);
+
+void log_print_ints (
+        struct log_writer *writer,
+        const char *format,
+        const int *x,
+        int n);
+
+void log_end (
+        struct log_writer *writer,
+        int flush);
+
+#endif
@@ -129,6 +129,16 @@ static void display_help (void)
             "series of training examples. Comments begin at a sign \"#\" and "
             "continue to the end of the line. If data are separated by a blank "
             "line, each data block is recognized as a different time series.");
+    puts("");
+    puts("Selective backpropagation:");
+    puts("If `selective_backprop_threshold' > 0 in a configuration file, a "
+            "series which is already fitted reuses its last gradient until "
+            "`selective_backprop_interval' epochs pass or the parameters "
+            "drift by `selective_backprop_drift' (default "
+            TO_STRING(SELECTIVE_BACKPROP_DRIFT) "). A reused gradient was "
+            "computed with older parameters, which biases the update, and the "
+            "errors of reused series in the error file are those of the "
+            "current parameters, not of their gradients.");
 }
 
 static void display_version (void)
@@ -157,11 +167,26 @@ static void init_parameters (struct general_parameters *gp)
     gp->mp.seed = (((unsigned long)(time(NULL) * getpid())) % 4294967295) + 1;
     gp->mp.epoch_size = EPOCH_SIZE;
     gp->mp.use_adaptive_lr = 0;
+    gp->mp.use_async_learning = 0;
+    gp->mp.use_streaming = 0;
     gp->mp.rho = RHO;
     gp->mp.momentum = MOMENTUM;
+    gp->mp.batch_size = BATCH_SIZE;
+    gp->mp.batch_size_growth = BATCH_SIZE_GROWTH;
+    gp->mp.batch_size_growth_interval = BATCH_SIZE_GROWTH_INTERVAL;
+    gp->mp.optimizer = OPTIMIZER;
+    gp->mp.adam_beta1 = ADAM_BETA1;
+    gp->mp.adam_beta2 = ADAM_BETA2;
+    gp->mp.adam_epsilon = ADAM_EPSILON;
+    gp->mp.lbfgs_memory = LBFGS_MEMORY;
+    gp->mp.selective_backprop_threshold = SELECTIVE_BACKPROP_THRESHOLD;
+    gp->mp.selective_backprop_interval = SELECTIVE_BACKPROP_INTERVAL;
+    gp->mp.selective_backprop_drift = SELECTIVE_BACKPROP_DRIFT;
     gp->mp.c_state_size = C_STATE_SIZE;
     gp->mp.rep_init_size = REP_INIT_SIZE;
     gp->mp.delay_length = DELAY_LENGTH;
+    gp->mp.chunk_length = CHUNK_LENGTH;
+    gp->mp.chunk_warmup_length = CHUNK_WARMUP_LENGTH;
     gp->mp.output_type = OUTPUT_TYPE;
     gp->mp.fixed_weight = 0;
     gp->mp.fixed_threshold = 0;
@@ -198,8 +223,21 @@ static void init_parameters (struct general_parameters *gp)
     gp->iop.lyapunov_filename = salloc(NULL, LYAPUNOV_FILENAME);
     gp->iop.entropy_filename = salloc(NULL, ENTROPY_FILENAME);
     gp->iop.period_filename = salloc(NULL, PERIOD_FILENAME);
+    gp->iop.validation_error_filename = salloc(NULL,
+            VALIDATION_ERROR_FILENAME);
     gp->iop.save_filename = salloc(NULL, SAVE_FILENAME);
     gp->iop.load_filename = salloc(NULL, LOAD_FILENAME);
+    gp->iop.validation_target_filename = salloc(NULL,
+            VALIDATION_TARGET_FILENAME);
+    gp->iop.use_target_cache = 0;
+    gp->iop.use_async_log = 0;
+    gp->iop.use_binary_log = 0;
+    gp->iop.use_state_store = 0;
+    gp->iop.state_store_type = 0;
+    gp->iop.analysis_thread_num = 0;
+    gp->iop.analysis_queue_size = 2;
+    gp->iop.checkpoint_interval = 0;
+    gp->iop.checkpoint_time = 0;
     struct print_interval default_interval = {
         .interval = PRINT_INTERVAL,
         .init = 0,
@@ -220,6 +258,7 @@ static void init_parameters (struct general_parameters *gp)
     gp->iop.interval_for_lyapunov_file = default_interval;
     gp->iop.interval_for_entropy_file = default_interval;
     gp->iop.interval_for_period_file = default_interval;
+    gp->iop.interval_for_validation_error_file = default_interval;
     gp->iop.verbose = 0;
 }
 
@@ -258,8 +297,10 @@ static void free_parameters (struct general_parameters *gp)
     FREE(gp->iop.lyapunov_filename);
     FREE(gp->iop.entropy_filename);
     FREE(gp->iop.period_filename);
+    FREE(gp->iop.validation_error_filename);
     FREE(gp->iop.save_filename);
     FREE(gp->iop.load_filename);
+    FREE(gp->iop.validation_target_filename);
 }
 
 static void set_seed (const char *opt, struct general_parameters *gp)
@@ -277,6 +318,18 @@ static void set_use_adaptive_lr (const char *opt, struct general_parameters *gp)
     gp->mp.use_adaptive_lr = 1;
 }
 
+static void set_use_async_learning (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->mp.use_async_learning = 1;
+}
+
+static void set_use_streaming (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.use_streaming = 1;
+}
+
 static void set_rho (const char *opt, struct general_parameters *gp)
 {
     gp->mp.rho = atof(opt);
@@ -287,6 +340,25 @@ static void set_momentum (const char *opt, struct general_parameters *gp)
     gp->mp.momentum = atof(opt);
 }
 
+static void set_batch_size (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.batch_size = atoi(opt);
+}
+
+static void set_batch_size_growth (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->mp.batch_size_growth = atof(opt);
+}
+
+static void set_batch_size_growth_interval (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->mp.batch_size_growth_interval = atol(opt);
+}
+
 static void set_c_state_size (const char *opt, struct general_parameters *gp)
 {
     gp->mp.c_state_size = atoi(opt);
@@ -302,6 +374,64 @@ static void set_delay_length (const char *opt, struct general_parameters *gp)
     gp->mp.delay_length = atoi(opt);
 }
 
+static void set_optimizer (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.optimizer = atoi(opt);
+}
+
+static void set_adam_beta1 (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.adam_beta1 = atof(opt);
+}
+
+static void set_adam_beta2 (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.adam_beta2 = atof(opt);
+}
+
+static void set_adam_epsilon (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.adam_epsilon = atof(opt);
+}
+
+static void set_lbfgs_memory (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.lbfgs_memory = atoi(opt);
+}
+
+static void set_selective_backprop_threshold (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->mp.selective_backprop_threshold = atof(opt);
+}
+
+static void set_selective_backprop_interval (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->mp.selective_backprop_interval = atol(opt);
+}
+
+static void set_selective_backprop_drift (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->mp.selective_backprop_drift = atof(opt);
+}
+
+static void set_chunk_length (const char *opt, struct general_parameters *gp)
+{
+    gp->mp.chunk_length = atoi(opt);
+}
+
+static void set_chunk_warmup_length (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->mp.chunk_warmup_length = atoi(opt);
+}
+
 static void set_output_type (const char *opt, struct general_parameters *gp)
 {
     gp->mp.output_type = atoi(opt);
@@ -471,6 +601,22 @@ static void set_closed_error_file (
     gp->iop.closed_error_filename = salloc(gp->iop.closed_error_filename, opt);
 }
 
+static void set_validation_error_file (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.validation_error_filename = salloc(
+            gp->iop.validation_error_filename, opt);
+}
+
+static void set_validation_target_file (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.validation_target_filename = salloc(
+            gp->iop.validation_target_filename, opt);
+}
+
 static void set_lyapunov_file (const char *opt, struct general_parameters *gp)
 {
     gp->iop.lyapunov_filename = salloc(gp->iop.lyapunov_filename, opt);
@@ -496,6 +642,69 @@ static void set_load_file (const char *opt, struct general_parameters *gp)
     gp->iop.load_filename = salloc(gp->iop.load_filename, opt);
 }
 
+static void set_use_target_cache (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.use_target_cache = 1;
+}
+
+static void set_use_async_log (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.use_async_log = 1;
+}
+
+static void set_use_binary_log (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.use_binary_log = 1;
+}
+
+static void set_use_state_store (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.use_state_store = 1;
+}
+
+static void set_state_store_type (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.state_store_type = atoi(opt);
+}
+
+static void set_analysis_thread_num (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.analysis_thread_num = atoi(opt);
+}
+
+static void set_analysis_queue_size (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.analysis_queue_size = atoi(opt);
+}
+
+static void set_checkpoint_interval (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.checkpoint_interval = atol(opt);
+}
+
+static void set_checkpoint_time (
+        const char *opt,
+        struct general_parameters *gp)
+{
+    gp->iop.checkpoint_time = atof(opt);
+}
+
 #define SET_DEFAULT_VALUE_OF_PRINT_INTERVAL_I(FILENAME,OPT) \
     do { \
         if (!gp->iop.interval_for_##FILENAME._set_##OPT##_flag) { \
@@ -519,6 +728,7 @@ static void set_load_file (const char *opt, struct general_parameters *gp)
         SET_DEFAULT_VALUE_OF_PRINT_INTERVAL_I(lyapunov_file,OPT); \
         SET_DEFAULT_VALUE_OF_PRINT_INTERVAL_I(entropy_file,OPT); \
         SET_DEFAULT_VALUE_OF_PRINT_INTERVAL_I(period_file,OPT); \
+        SET_DEFAULT_VALUE_OF_PRINT_INTERVAL_I(validation_error_file,OPT); \
     } while(0)
 
 static void set_print_interval (const char *opt, struct general_parameters *gp)
@@ -576,6 +786,7 @@ GEN_PRINT_INTERVAL_SETTER(closed_error_file)
 GEN_PRINT_INTERVAL_SETTER(lyapunov_file)
 GEN_PRINT_INTERVAL_SETTER(entropy_file)
 GEN_PRINT_INTERVAL_SETTER(period_file)
+GEN_PRINT_INTERVAL_SETTER(validation_error_file)
 
 static void set_verbose (const char *opt, struct general_parameters *gp)
 {
@@ -617,11 +828,26 @@ static struct option_information {
     {"seed", 1, set_seed},
     {"epoch_size", 1, set_epoch_size},
     {"use_adaptive_lr", 0, set_use_adaptive_lr},
+    {"use_async_learning", 0, set_use_async_learning},
+    {"use_streaming", 0, set_use_streaming},
     {"rho", 1, set_rho},
     {"momentum", 1, set_momentum},
+    {"batch_size", 1, set_batch_size},
+    {"batch_size_growth", 1, set_batch_size_growth},
+    {"batch_size_growth_interval", 1, set_batch_size_growth_interval},
+    {"optimizer", 1, set_optimizer},
+    {"adam_beta1", 1, set_adam_beta1},
+    {"adam_beta2", 1, set_adam_beta2},
+    {"adam_epsilon", 1, set_adam_epsilon},
+    {"lbfgs_memory", 1, set_lbfgs_memory},
+    {"selective_backprop_threshold", 1, set_selective_backprop_threshold},
+    {"selective_backprop_interval", 1, set_selective_backprop_interval},
+    {"selective_backprop_drift", 1, set_selective_backprop_drift},
     {"c_state_size", 1, set_c_state_size},
     {"rep_init_size", 1, set_rep_init_size},
     {"delay_length", 1, set_delay_length},
+    {"chunk_length", 1, set_chunk_length},
+    {"chunk_warmup_length", 1, set_chunk_warmup_length},
     {"output_type", 1, set_output_type},
     {"fixed_weight", 0, set_fixed_weight},
     {"fixed_threshold", 0, set_fixed_threshold},
@@ -656,8 +882,19 @@ static struct option_information {
     {"lyapunov_file", 1, set_lyapunov_file},
     {"entropy_file", 1, set_entropy_file},
     {"period_file", 1, set_period_file},
+    {"validation_error_file", 1, set_validation_error_file},
+    {"validation_target_file", 1, set_validation_target_file},
     {"save_file", 1, set_save_file},
     {"load_file", 1, set_load_file},
+    {"use_target_cache", 0, set_use_target_cache},
+    {"use_async_log", 0, set_use_async_log},
+    {"use_binary_log", 0, set_use_binary_log},
+    {"use_state_store", 0, set_use_state_store},
+    {"state_store_type", 1, set_state_store_type},
+    {"analysis_thread_num", 1, set_analysis_thread_num},
+    {"analysis_queue_size", 1, set_analysis_queue_size},
+    {"checkpoint_interval", 1, set_checkpoint_interval},
+    {"checkpoint_time", 1, set_checkpoint_time},
     {"print_interval", 1, set_print_interval},
     {"print_init", 1, set_print_init},
     {"print_end", 1, set_print_end},
@@ -675,6 +912,7 @@ static struct option_information {
     ENTRY_PRINT_INTERVAL_SETTER(lyapunov_file),
     ENTRY_PRINT_INTERVAL_SETTER(entropy_file),
     ENTRY_PRINT_INTERVAL_SETTER(period_file),
+    ENTRY_PRINT_INTERVAL_SETTER(validation_error_file),
     {"verbose", 0, set_verbose},
     {"config_file", 1, set_config_file},
     {0, 0, NULL}
@@ -832,20 +1070,31 @@ static void setup_target (
             print_error_msg("error in the standard input");
             exit(EXIT_FAILURE);
         }
-    } else {
-        for (int i = optind; i < argc; i++) {
-            FILE *fp;
-            if ((fp = fopen(argv[i], "r")) == NULL) {
-                print_error_msg("cannot open %s", argv[i]);
-                exit(EXIT_FAILURE);
-            }
-            if (read_target_from_file(t_reader, " \t,", fp) == -1) {
-                print_error_msg("error in %s", argv[i]);
-                exit(EXIT_FAILURE);
-            }
-            fclose(fp);
-        }
+    } else if (read_target_files(t_reader, " \t,", argc - optind,
+                argv + optind, gp->iop.use_target_cache) == -1) {
+        exit(EXIT_FAILURE);
     }
+    // the streaming computation reads the mapped series in place
+    if (!gp->mp.use_streaming) {
+        set_target_rows(t_reader);
+    }
+}
+
+static void setup_validation_target (
+        struct general_parameters *gp,
+        struct target_reader *v_reader)
+{
+    init_target_reader(v_reader);
+    if (strlen(gp->iop.validation_target_filename) == 0) {
+        return;
+    }
+    char *filename = gp->iop.validation_target_filename;
+    if (read_target_files(v_reader, " \t,", 1, &filename,
+                gp->iop.use_target_cache) == -1) {
+        exit(EXIT_FAILURE);
+    }
+    set_target_rows(v_reader);
+    gp->inp.validation = v_reader;
 }
 
 static void setup_parameters (
@@ -854,6 +1103,14 @@ static void setup_parameters (
 {
     gp->inp.adapt_lr = 1.0;
     gp->inp.init_epoch = 0;
+    gp->inp.optimizer_offset = -1;
+    gp->inp.chunk_link = NULL;
+    gp->inp.series_error = NULL;
+    gp->inp.series_epoch = NULL;
+    gp->inp.series_drift = NULL;
+    gp->inp.last_parameter = NULL;
+    gp->inp.stream = NULL;
+    gp->inp.validation = NULL;
     if (strlen(gp->iop.load_filename) == 0 && t_reader->num) {
         MALLOC2(gp->inp.has_connection_ci, gp->mp.c_state_size,
                 t_reader->dimension);
@@ -911,6 +1168,105 @@ static void check_parameters (
         print_error_msg("learning momentum not in valid range: x >= 0 (float)");
         exit(EXIT_FAILURE);
     }
+    if (gp->mp.batch_size < 0) {
+        print_error_msg("`batch_size' not in valid range: x >= 0 (integer)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.batch_size_growth < 1) {
+        print_error_msg("`batch_size_growth' not in valid range: x >= 1 "
+                "(float)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.batch_size_growth_interval <= 0) {
+        print_error_msg("`batch_size_growth_interval' not in valid range: "
+                "x > 0 (integer)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.use_async_learning && gp->mp.use_adaptive_lr) {
+        print_error_msg("option `use_async_learning' cannot be used with "
+                "`use_adaptive_lr'");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.use_async_learning && gp->mp.batch_size > 0) {
+        print_error_msg("option `use_async_learning' cannot be used with "
+                "`batch_size'");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.use_streaming && (gp->mp.use_adaptive_lr ||
+                gp->mp.use_async_learning || gp->mp.batch_size > 0 ||
+                gp->mp.optimizer != 0 || gp->mp.chunk_length > 0 ||
+                gp->mp.selective_backprop_threshold > 0)) {
+        print_error_msg("option `use_streaming' cannot be used with "
+                "`use_adaptive_lr', `use_async_learning', `batch_size', "
+                "`optimizer', `chunk_length' or "
+                "`selective_backprop_threshold'");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.use_streaming && (strlen(gp->iop.state_filename) > 0 ||
+                strlen(gp->iop.closed_state_filename) > 0 ||
+                strlen(gp->iop.closed_error_filename) > 0 ||
+                strlen(gp->iop.lyapunov_filename) > 0 ||
+                strlen(gp->iop.entropy_filename) > 0 ||
+                strlen(gp->iop.period_filename) > 0)) {
+        print_error_msg("option `use_streaming' cannot be used with output "
+                "files of states or closed-loop dynamics");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->iop.analysis_thread_num < 0 || gp->iop.analysis_queue_size < 0) {
+        print_error_msg("analysis_thread_num and analysis_queue_size must be "
+                "non-negative");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->iop.state_store_type < 0 || gp->iop.state_store_type > 1) {
+        print_error_msg("state_store_type must be 0(double) or 1(float)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.optimizer < 0 || gp->mp.optimizer > 2) {
+        print_error_msg("optimizer must be 0(momentum), 1(Adam) or 2(L-BFGS)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.optimizer != 0 && (gp->mp.use_adaptive_lr ||
+                gp->mp.use_async_learning || gp->mp.batch_size > 0)) {
+        print_error_msg("Adam and L-BFGS cannot be used with "
+                "`use_adaptive_lr', `use_async_learning' or `batch_size'");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.optimizer == 2 && gp->mp.selective_backprop_threshold > 0) {
+        print_error_msg("L-BFGS cannot be used with "
+                "`selective_backprop_threshold'");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.adam_beta1 < 0 || gp->mp.adam_beta1 >= 1) {
+        print_error_msg("`adam_beta1' not in valid range: 0 <= x < 1 (float)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.adam_beta2 < 0 || gp->mp.adam_beta2 >= 1) {
+        print_error_msg("`adam_beta2' not in valid range: 0 <= x < 1 (float)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.adam_epsilon <= 0) {
+        print_error_msg("`adam_epsilon' not in valid range: x > 0 (float)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.lbfgs_memory <= 0) {
+        print_error_msg("`lbfgs_memory' not in valid range: x > 0 (integer)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.selective_backprop_threshold < 0) {
+        print_error_msg("`selective_backprop_threshold' not in valid range: "
+                "x >= 0 (float)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.selective_backprop_interval <= 0) {
+        print_error_msg("`selective_backprop_interval' not in valid range: "
+                "x > 0 (integer)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.selective_backprop_drift <= 0) {
+        print_error_msg("`selective_backprop_drift' not in valid range: "
+                "x > 0 (float)");
+        exit(EXIT_FAILURE);
+    }
     if (gp->mp.c_state_size <= 0) {
         print_error_msg("number of context neurons must be greater than zero.");
         exit(EXIT_FAILURE);
@@ -925,6 +1281,16 @@ static void check_parameters (
                 "x > 0 (integer)");
         exit(EXIT_FAILURE);
     }
+    if (gp->mp.chunk_length < 0) {
+        print_error_msg("`chunk_length' not in valid range: x >= 0 (integer)");
+        exit(EXIT_FAILURE);
+    }
+    if (gp->mp.chunk_warmup_length < 0 || (gp->mp.chunk_length > 0 &&
+                gp->mp.chunk_warmup_length >= gp->mp.chunk_length)) {
+        print_error_msg("`chunk_warmup_length' not in valid range: "
+                "0 <= x < chunk_length (integer)");
+        exit(EXIT_FAILURE);
+    }
     if (gp->mp.output_type != 0 && gp->mp.output_type != 1) {
         print_error_msg("type of output function must be 0(tanh) or "
                 "1(softmax activation function)");
@@ -986,8 +1352,12 @@ int main (int argc, char *argv[])
     setup_parameters(&gp, &t_reader);
     check_parameters(&gp, &t_reader);
 
+    struct target_reader v_reader;
+    setup_validation_target(&gp, &v_reader);
+
     training_main(&gp, &t_reader);
 
+    free_target_reader(&v_reader);
     free_target_reader(&t_reader);
     free_parameters(&gp);
 
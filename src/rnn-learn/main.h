@@ -24,13 +24,71 @@ typedef struct main_parameters {
     long epoch_size;                    // number of epochs in learning
     /* if use_adaptive_lr!=0, learning rate is adaptively changed */
     int use_adaptive_lr;
+    /*
+     * if use_async_learning!=0, each series is learned asynchronously by
+     * a thread which updates the shared parameters without locking
+     */
+    int use_async_learning;
+    /*
+     * if use_streaming!=0, the work arrays of each series are allocated
+     * per thread only while the series is computed (see rnn_stream.h)
+     */
+    int use_streaming;
     double rho;                         // learning rate
     double momentum;                    // momentum of learning
+
+    /*
+     * If batch_size > 0, parameters are updated for each mini-batch of
+     * batch_size series drawn from the shuffled training data. The size is
+     * multiplied by batch_size_growth every batch_size_growth_interval epochs.
+     */
+    int batch_size;
+    double batch_size_growth;
+    long batch_size_growth_interval;
+
+    /*
+     * optimizer of learning (0:momentum, 1:Adam, 2:L-BFGS)
+     * adam_beta1, adam_beta2 and adam_epsilon are the parameters of Adam, and
+     * lbfgs_memory is the number of correction pairs stored by L-BFGS.
+     */
+    int optimizer;
+    double adam_beta1;
+    double adam_beta2;
+    double adam_epsilon;
+    int lbfgs_memory;
+
+    /*
+     * If selective_backprop_threshold > 0, a series whose averaged error is
+     * less than selective_backprop_threshold times the mean error of all
+     * series reuses its last gradient, and the gradient is recomputed only
+     * every selective_backprop_interval epochs, or as soon as the weights
+     * and the thresholds have drifted by selective_backprop_drift since it
+     * was computed. The drift is the sum over the epochs of the norm of the
+     * change of the parameters relative to their norm.
+     * A reused gradient belongs to the parameters of an earlier epoch but is
+     * summed with the others as if it were fresh, which biases the update,
+     * and the bias grows with the drift. The error file is computed with the
+     * current parameters for all series, hence the errors of reused series
+     * there are not those from which their gradients were computed.
+     */
+    double selective_backprop_threshold;
+    long selective_backprop_interval;
+    double selective_backprop_drift;
+
     int c_state_size;                   // number of context neurons
     /* number of representative points of initial state */
     int rep_init_size;
     int delay_length;                   // feedback delay
 
+    /*
+     * If chunk_length > 0, each target time series is divided into chunks of
+     * chunk_length steps, which are learned in parallel. Every chunk but the
+     * first starts chunk_warmup_length steps early, and its initial state is
+     * re-synchronized with the preceding chunk at each epoch.
+     */
+    int chunk_length;
+    int chunk_warmup_length;
+
     /*
      * type of a neural firing function in the output layer
      * (0:STANDARD_TYPE, 1:SOFTMAX_TYPE)
@@ -94,10 +152,66 @@ typedef struct io_parameters {
     char *lyapunov_filename;
     char *entropy_filename;
     char *period_filename;
+    char *validation_error_filename;
 
     char *save_filename;
     char *load_filename;
 
+    /*
+     * validation_target_filename is a target file of held-out series. Their
+     * errors in the open-loop and the closed-loop dynamics are written to
+     * validation_error_filename, which are computed on a copy of the model
+     * in the same way as the closed-loop data (see analysis_thread_num).
+     */
+    char *validation_target_filename;
+
+    /*
+     * if use_target_cache!=0, each text target file is converted into a
+     * binary file (file name + ".bin"), which is reused while the text file
+     * is unchanged
+     */
+    int use_target_cache;
+
+    /*
+     * if use_async_log!=0, the log files are formatted and written by a
+     * background thread (see log_writer.h)
+     */
+    int use_async_log;
+
+    /*
+     * if use_binary_log!=0, the log files are written in the binary format
+     * (see rnn_log.h) instead of text
+     */
+    int use_binary_log;
+
+    /*
+     * if use_state_store!=0, the states of all the series are written to a
+     * single trajectory file (state_filename or closed_state_filename, see
+     * rnn_trajectory.h) instead of a file per series. The values are stored
+     * in double if state_store_type=0, and in float if state_store_type=1.
+     */
+    int use_state_store;
+    int state_store_type;
+
+    /*
+     * If analysis_thread_num > 0, the closed-loop dynamics and its analyses
+     * (closed_error_file, closed_state_file, lyapunov_file, entropy_file and
+     * period_file) are computed on a copy of the model by
+     * analysis_thread_num background threads while learning continues. At
+     * most analysis_queue_size copies wait for the threads, and learning
+     * waits if the analyses fall further behind (see analysis_pool.h).
+     */
+    int analysis_thread_num;
+    int analysis_queue_size;
+
+    /*
+     * If checkpoint_interval > 0 (or checkpoint_time > 0), the model is
+     * saved to save_filename every checkpoint_interval epochs (or every
+     * checkpoint_time minutes) by a child process, while learning continues.
+     */
+    long checkpoint_interval;
+    double checkpoint_time;
+
     /* interval for printing data */
     struct print_interval {
         long interval;
@@ -122,6 +236,7 @@ typedef struct io_parameters {
     struct print_interval interval_for_lyapunov_file;
     struct print_interval interval_for_entropy_file;
     struct print_interval interval_for_period_file;
+    struct print_interval interval_for_validation_error_file;
 
     /* if verbose!=0, explain what is being done */
     int verbose;
@@ -131,6 +246,7 @@ typedef struct io_parameters {
 typedef struct internal_parameters {
     double adapt_lr;                    // adaptive learning rate
     long init_epoch;                    // number of initial epochs
+    long optimizer_offset;              // offset of optimizer in load file
     int **has_connection_ci;
     int **has_connection_cc;
     int **has_connection_oc;
@@ -143,6 +259,34 @@ typedef struct internal_parameters {
     int softmax_group_num;
     int *softmax_group_id;
     double *init_tau;
+
+    /*
+     * chunk_link[i] describes the chunk preceding the i-th series of rnn:
+     * its index (prev) and the time step (n) connected to the initial state
+     * of the i-th series. prev is -1 if the series has no preceding chunk.
+     */
+    struct chunk_link {
+        int prev;
+        int n;
+    } *chunk_link;
+
+    /*
+     * history of the averaged error of each series (negative if unknown),
+     * the last epoch when its gradient was computed, and parameter_drift at
+     * that epoch. parameter_drift accumulates the relative change of the
+     * weights and the thresholds, whose values at the last epoch are held in
+     * last_parameter.
+     */
+    double *series_error;
+    long *series_epoch;
+    double *series_drift;
+    double parameter_drift;
+    double *last_parameter;
+
+    struct rnn_stream *stream;          // stream used if use_streaming!=0
+
+    /* held-out series (NULL if validation_target_filename is empty) */
+    struct target_reader *validation;
 } internal_parameters;
 
 
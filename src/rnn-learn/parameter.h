@@ -24,11 +24,28 @@
 #define RHO 0.001
 #define MOMENTUM 0.9
 
+#define BATCH_SIZE 0
+#define BATCH_SIZE_GROWTH 1.0
+#define BATCH_SIZE_GROWTH_INTERVAL 1000
+
+#define OPTIMIZER 0
+#define ADAM_BETA1 0.9
+#define ADAM_BETA2 0.999
+#define ADAM_EPSILON 1e-8
+#define LBFGS_MEMORY 10
+
+#define SELECTIVE_BACKPROP_THRESHOLD 0
+#define SELECTIVE_BACKPROP_INTERVAL 10
+#define SELECTIVE_BACKPROP_DRIFT 0.01
+
 #define C_STATE_SIZE 10
 #define REP_INIT_SIZE 1
 
 #define DELAY_LENGTH 1
 
+#define CHUNK_LENGTH 0
+#define CHUNK_WARMUP_LENGTH 0
+
 #define OUTPUT_TYPE 0
 #define INIT_TAU 5
 #define PRIOR_STRENGTH 0
@@ -55,6 +72,8 @@
 #define LYAPUNOV_FILENAME ""
 #define ENTROPY_FILENAME ""
 #define PERIOD_FILENAME ""
+#define VALIDATION_ERROR_FILENAME "validation.log"
+#define VALIDATION_TARGET_FILENAME ""
 #define SAVE_FILENAME "rnn.dat"
 #define LOAD_FILENAME ""
 
@@ -22,13 +22,36 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "utils.h"
 #include "print.h"
+#include "target.h"
+#include "log_writer.h"
+#include "rnn_log.h"
+#include "rnn_trajectory.h"
 #include "entropy.h"
 #include "rnn_lyapunov.h"
+#include "rnn_stream.h"
 
 
+#ifndef LOG_RECORD_NUM
+#define LOG_RECORD_NUM 64
+#endif
+
+static void analyze_closed_loop_data (
+        long epoch,
+        struct recurrent_neural_network *rnn,
+        struct log_writer *writer,
+        void *arg);
+
+static void analyze_validation_data (
+        long epoch,
+        struct recurrent_neural_network *rnn,
+        struct log_writer *writer,
+        void *arg);
 
 static void fopen_array (
         FILE **fp_array,
@@ -63,14 +86,68 @@ error:
 }
 
 
+/*
+ * This function initializes the pool evaluating the held-out series with
+ * the parameters of rnn. The input and the target of each series are shifted
+ * by the delay as the training series.
+ */
+static void init_validation_pool (
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn,
+        struct output_files *fp_list)
+{
+    const struct target_reader *v_reader = gp->inp.validation;
+    if (v_reader->dimension != rnn->rnn_p.in_state_size ||
+            v_reader->dimension != rnn->rnn_p.out_state_size) {
+        print_error_msg("dimension of `%s' is different from that of the "
+                "model", gp->iop.validation_target_filename);
+        exit(EXIT_FAILURE);
+    }
+    int length[v_reader->num];
+    const double* const* input[v_reader->num];
+    const double* const* target[v_reader->num];
+    for (int i = 0; i < v_reader->num; i++) {
+        if (v_reader->t_list[i].length <= gp->mp.delay_length) {
+            print_error_msg("length of target time series must be greater "
+                    "than time delay.");
+            exit(EXIT_FAILURE);
+        }
+        length[i] = v_reader->t_list[i].length - gp->mp.delay_length;
+        input[i] = (const double* const*)v_reader->t_list[i].target;
+        target[i] = input[i] + gp->mp.delay_length;
+    }
+    struct recurrent_neural_network template;
+    rnn_duplicate_parameters(&template.rnn_p, &rnn->rnn_p);
+    template.series_num = 0;
+    template.rnn_s = NULL;
+    rnn_add_target_views(&template, v_reader->num, length, input, target);
+    init_analysis_pool(&fp_list->validation_pool, &template, 0,
+            gp->iop.analysis_thread_num, gp->iop.analysis_queue_size,
+            gp->iop.use_binary_log, analyze_validation_data, fp_list);
+    free_recurrent_neural_network(&template);
+}
+
+
+/*
+ * This function returns the number of values in a line of the state files.
+ */
+static int get_state_size (const struct rnn_parameters *rnn_p)
+{
+    return rnn_p->out_state_size * (rnn_p->output_type == STANDARD_TYPE ?
+            3 : 2) + rnn_p->c_state_size;
+}
+
+
 void init_output_files (
         const struct general_parameters *gp,
         const struct recurrent_neural_network *rnn,
         struct output_files *fp_list,
         const char *mode)
 {
+    init_log_writer(&fp_list->writer, gp->iop.use_async_log,
+            gp->iop.use_binary_log, LOG_RECORD_NUM);
     fp_list->array_size = rnn->series_num;
-    if (strlen(gp->iop.state_filename) > 0) {
+    if (!gp->iop.use_state_store && strlen(gp->iop.state_filename) > 0) {
         MALLOC(fp_list->fp_wstate_array, fp_list->array_size);
         fopen_array(fp_list->fp_wstate_array, fp_list->array_size,
                 gp->iop.state_filename, mode);
@@ -78,7 +155,8 @@ void init_output_files (
         fp_list->fp_wstate_array = NULL;
     }
 
-    if (strlen(gp->iop.closed_state_filename) > 0) {
+    if (!gp->iop.use_state_store &&
+            strlen(gp->iop.closed_state_filename) > 0) {
         MALLOC(fp_list->fp_wclosed_state_array, fp_list->array_size);
         fopen_array(fp_list->fp_wclosed_state_array, fp_list->array_size,
                 gp->iop.closed_state_filename, mode);
@@ -86,6 +164,29 @@ void init_output_files (
         fp_list->fp_wclosed_state_array = NULL;
     }
 
+    if (gp->iop.use_state_store && strlen(gp->iop.state_filename) > 0) {
+        fp_list->fp_wstate = fopen(gp->iop.state_filename, mode);
+        if (fp_list->fp_wstate == NULL) goto error;
+    } else {
+        fp_list->fp_wstate = NULL;
+    }
+    if (gp->iop.use_state_store &&
+            strlen(gp->iop.closed_state_filename) > 0) {
+        fp_list->fp_wclosed_state = fopen(gp->iop.closed_state_filename,
+                mode);
+        if (fp_list->fp_wclosed_state == NULL) goto error;
+    } else {
+        fp_list->fp_wclosed_state = NULL;
+    }
+    if (fp_list->fp_wstate || fp_list->fp_wclosed_state) {
+        int length[rnn->series_num];
+        for (int i = 0; i < rnn->series_num; i++) {
+            length[i] = rnn->rnn_s[i].length;
+        }
+        init_rnn_trajectory(&fp_list->trajectory, gp->iop.state_store_type,
+                rnn->series_num, length, get_state_size(&rnn->rnn_p));
+    }
+
     if (strlen(gp->iop.weight_filename) > 0) {
         fp_list->fp_wweight = fopen(gp->iop.weight_filename, mode);
         if (fp_list->fp_wweight == NULL) goto error;
@@ -152,6 +253,28 @@ void init_output_files (
     } else {
         fp_list->fp_wperiod = NULL;
     }
+    if (gp->inp.validation && gp->inp.validation->num > 0 &&
+            strlen(gp->iop.validation_error_filename) > 0) {
+        fp_list->fp_wvalidation_error = fopen(
+                gp->iop.validation_error_filename, mode);
+        if (fp_list->fp_wvalidation_error == NULL) goto error;
+    } else {
+        fp_list->fp_wvalidation_error = NULL;
+    }
+
+    fp_list->gp = gp;
+    fp_list->use_analysis_pool = (gp->iop.analysis_thread_num > 0 &&
+            (fp_list->fp_wclosed_error || fp_list->fp_wclosed_state_array ||
+             fp_list->fp_wclosed_state || fp_list->fp_wlyapunov ||
+             fp_list->fp_wentropy || fp_list->fp_wperiod));
+    if (fp_list->use_analysis_pool) {
+        init_analysis_pool(&fp_list->analysis_pool, rnn, 1,
+                gp->iop.analysis_thread_num, gp->iop.analysis_queue_size,
+                gp->iop.use_binary_log, analyze_closed_loop_data, fp_list);
+    }
+    if (fp_list->fp_wvalidation_error) {
+        init_validation_pool(gp, rnn, fp_list);
+    }
     return;
 error:
     print_error_msg();
@@ -160,6 +283,13 @@ error:
 
 void free_output_files (struct output_files *fp_list)
 {
+    if (fp_list->use_analysis_pool) {
+        free_analysis_pool(&fp_list->analysis_pool);
+    }
+    if (fp_list->fp_wvalidation_error) {
+        free_analysis_pool(&fp_list->validation_pool);
+    }
+    free_log_writer(&fp_list->writer);
     if (fp_list->fp_wstate_array) {
         for (int i = 0; i < fp_list->array_size; i++) {
             fclose(fp_list->fp_wstate_array[i]);
@@ -172,6 +302,15 @@ void free_output_files (struct output_files *fp_list)
         }
         FREE(fp_list->fp_wclosed_state_array);
     }
+    if (fp_list->fp_wstate || fp_list->fp_wclosed_state) {
+        free_rnn_trajectory(&fp_list->trajectory);
+    }
+    if (fp_list->fp_wstate) {
+        fclose(fp_list->fp_wstate);
+    }
+    if (fp_list->fp_wclosed_state) {
+        fclose(fp_list->fp_wclosed_state);
+    }
     if (fp_list->fp_wweight) {
         fclose(fp_list->fp_wweight);
     }
@@ -205,6 +344,9 @@ void free_output_files (struct output_files *fp_list)
     if (fp_list->fp_wperiod) {
         fclose(fp_list->fp_wperiod);
     }
+    if (fp_list->fp_wvalidation_error) {
+        fclose(fp_list->fp_wvalidation_error);
+    }
 }
 
 static void print_general_parameters (
@@ -215,8 +357,28 @@ static void print_general_parameters (
     if (gp->mp.use_adaptive_lr) {
         fprintf(fp, "# use_adaptive_lr\n");
     }
+    if (gp->mp.use_async_learning) {
+        fprintf(fp, "# use_async_learning\n");
+    }
+    if (gp->mp.use_streaming) {
+        fprintf(fp, "# use_streaming\n");
+    }
     fprintf(fp, "# rho = %f\n", gp->mp.rho);
     fprintf(fp, "# momentum = %f\n", gp->mp.momentum);
+    if (gp->mp.optimizer == 1) {
+        fprintf(fp, "# optimizer = Adam (beta1 = %f, beta2 = %f, "
+                "epsilon = %g)\n", gp->mp.adam_beta1, gp->mp.adam_beta2,
+                gp->mp.adam_epsilon);
+    } else if (gp->mp.optimizer == 2) {
+        fprintf(fp, "# optimizer = L-BFGS (memory = %d)\n",
+                gp->mp.lbfgs_memory);
+    }
+    if (gp->mp.selective_backprop_threshold > 0) {
+        fprintf(fp, "# selective_backprop_threshold = %f\n",
+                gp->mp.selective_backprop_threshold);
+        fprintf(fp, "# selective_backprop_interval = %ld\n",
+                gp->mp.selective_backprop_interval);
+    }
     fprintf(fp, "# delay_length = %d\n", gp->mp.delay_length);
     fprintf(fp, "# lambda = %f\n", gp->mp.lambda);
     fprintf(fp, "# alpha = %f\n", gp->mp.alpha);
@@ -315,99 +477,110 @@ static void print_rnn_parameters (
 
 
 static void print_rnn_weight (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct rnn_parameters *rnn_p)
 {
-    fprintf(fp, "%ld", epoch);
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
     for (int i = 0; i < rnn_p->c_state_size; i++) {
-        for (int j = 0; j < rnn_p->in_state_size; j++) {
-            fprintf(fp, "\t%f", rnn_p->weight_ci[i][j]);
-        }
-        for (int j = 0; j < rnn_p->c_state_size; j++) {
-            fprintf(fp, "\t%f", rnn_p->weight_cc[i][j]);
-        }
+        log_print_doubles(writer, "\t%f", rnn_p->weight_ci[i],
+                rnn_p->in_state_size);
+        log_print_doubles(writer, "\t%f", rnn_p->weight_cc[i],
+                rnn_p->c_state_size);
     }
     for (int i = 0; i < rnn_p->out_state_size; i++) {
-        for (int j = 0; j < rnn_p->c_state_size; j++) {
-            fprintf(fp, "\t%f", rnn_p->weight_oc[i][j]);
-        }
+        log_print_doubles(writer, "\t%f", rnn_p->weight_oc[i],
+                rnn_p->c_state_size);
     }
-    fprintf(fp, "\n");
+    log_printf(writer, "\n");
+    log_end(writer, 0);
 }
 
 
 static void print_rnn_threshold (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct rnn_parameters *rnn_p)
 {
-    fprintf(fp, "%ld", epoch);
-    for (int i = 0; i < rnn_p->c_state_size; i++) {
-        fprintf(fp, "\t%f", rnn_p->threshold_c[i]);
-    }
-    for (int i = 0; i < rnn_p->out_state_size; i++) {
-        fprintf(fp, "\t%f", rnn_p->threshold_o[i]);
-    }
-    fprintf(fp, "\n");
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%f", rnn_p->threshold_c,
+            rnn_p->c_state_size);
+    log_print_doubles(writer, "\t%f", rnn_p->threshold_o,
+            rnn_p->out_state_size);
+    log_printf(writer, "\n");
+    log_end(writer, 0);
 }
 
 
 static void print_rnn_tau (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct rnn_parameters *rnn_p)
 {
-    fprintf(fp, "%ld", epoch);
-    for (int i = 0; i < rnn_p->c_state_size; i++) {
-        fprintf(fp, "\t%g", rnn_p->tau[i]);
-    }
-    fprintf(fp, "\n");
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%g", rnn_p->tau, rnn_p->c_state_size);
+    log_printf(writer, "\n");
+    log_end(writer, 0);
 }
 
 static void print_rnn_init (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct recurrent_neural_network *rnn)
 {
-    fprintf(fp, "# epoch = %ld\n", epoch);
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "# epoch = %ld\n", epoch);
     for (int i = 0; i < rnn->series_num; i++) {
-        fprintf(fp, "%d", i);
-        for (int j = 0; j < rnn->rnn_p.rep_init_size; j++) {
-            fprintf(fp, "\t%f", rnn->rnn_s[i].gate_init_c[j]);
-        }
-        for (int j = 0; j < rnn->rnn_p.c_state_size; j++) {
-            fprintf(fp, "\t%f", rnn->rnn_s[i].init_c_inter_state[j]);
-        }
-        fprintf(fp, "\n");
-    }
+        log_printf(writer, "%d", i);
+        log_print_doubles(writer, "\t%f", rnn->rnn_s[i].gate_init_c,
+                rnn->rnn_p.rep_init_size);
+        log_print_doubles(writer, "\t%f", rnn->rnn_s[i].init_c_inter_state,
+                rnn->rnn_p.c_state_size);
+        log_printf(writer, "\n");
+    }
+    log_end(writer, 0);
 }
 
 static void print_rnn_rep_init (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct recurrent_neural_network *rnn)
 {
-    fprintf(fp, "# epoch = %ld\n", epoch);
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "# epoch = %ld\n", epoch);
     for (int i = 0; i < rnn->rnn_p.rep_init_size; i++) {
-        fprintf(fp, "%d", i);
-        for (int j = 0; j < rnn->rnn_p.c_state_size; j++) {
-            fprintf(fp, "\t%f", rnn->rnn_p.rep_init_c[i][j]);
-        }
-        fprintf(fp, "\n");
+        log_printf(writer, "%d", i);
+        log_print_doubles(writer, "\t%f", rnn->rnn_p.rep_init_c[i],
+                rnn->rnn_p.c_state_size);
+        log_printf(writer, "\n");
     }
+    log_end(writer, 0);
 }
 
 static void print_adapt_lr (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         double adapt_lr)
 {
-    fprintf(fp, "%ld\t%f\n", epoch, adapt_lr);
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%f", &adapt_lr, 1);
+    log_printf(writer, "\n");
+    log_end(writer, 1);
 }
 
 
 static void print_rnn_error (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct recurrent_neural_network *rnn)
@@ -420,49 +593,138 @@ static void print_rnn_error (
         error[i] = rnn_get_error(rnn->rnn_s + i);
         error[i] /= rnn->rnn_s[i].length * rnn->rnn_p.out_state_size;
     }
-    fprintf(fp, "%ld", epoch);
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%g", error, rnn->series_num);
+    log_printf(writer, "\n");
+    log_end(writer, 1);
+}
+
+
+static void print_rnn_stream_error (
+        struct log_writer *writer,
+        FILE *fp,
+        long epoch,
+        const struct rnn_stream *stream)
+{
+    const struct recurrent_neural_network *rnn = stream->rnn;
+    double error[rnn->series_num];
     for (int i = 0; i < rnn->series_num; i++) {
-        fprintf(fp, "\t%g", error[i]);
-    }
-    fprintf(fp, "\n");
+        error[i] = stream->error[i] /
+            (rnn->rnn_s[i].length * rnn->rnn_p.out_state_size);
+    }
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%g", error, rnn->series_num);
+    log_printf(writer, "\n");
+    log_end(writer, 1);
 }
 
 
 static void print_rnn_state (
-        FILE *fp,
+        struct log_writer *writer,
         const struct rnn_state *rnn_s)
 {
+    const int out_state_size = rnn_s->rnn_p->out_state_size;
+    double row[3 * out_state_size];
     for (int n = 0; n < rnn_s->length; n++) {
-        fprintf(fp, "%d", n);
-        for (int i = 0; i < rnn_s->rnn_p->out_state_size; i++) {
-            fprintf(fp, "\t%f", rnn_s->teach_state[n][i]);
-            fprintf(fp, "\t%f", rnn_s->out_state[n][i]);
+        int size = 0;
+        for (int i = 0; i < out_state_size; i++) {
+            row[size++] = rnn_s->teach_state[n][i];
+            row[size++] = rnn_s->out_state[n][i];
             if (rnn_s->rnn_p->output_type == STANDARD_TYPE) {
-                fprintf(fp, "\t%f", rnn_s->var_state[n][i]);
+                row[size++] = rnn_s->var_state[n][i];
             }
         }
-        for (int i = 0; i < rnn_s->rnn_p->c_state_size; i++) {
-            //fprintf(fp, "\t%f", rnn_s->c_state[n][i]);
-            fprintf(fp, "\t%f", rnn_s->c_inter_state[n][i]);
-        }
-        fprintf(fp, "\n");
+        log_printf(writer, "%d", n);
+        log_print_doubles(writer, "\t%f", row, size);
+        //log_print_doubles(writer, "\t%f", rnn_s->c_state[n],
+        //        rnn_s->rnn_p->c_state_size);
+        log_print_doubles(writer, "\t%f", rnn_s->c_inter_state[n],
+                rnn_s->rnn_p->c_state_size);
+        log_printf(writer, "\n");
     }
 }
 
 
+/*
+ * The record of each series is built in parallel by the held writer of the
+ * thread, and the records are passed to the writer, which formats them.
+ */
 static void print_rnn_state_forall (
+        struct log_writer *writer,
         FILE **fp_array,
         long epoch,
         const struct recurrent_neural_network *rnn)
 {
 #ifdef _OPENMP
-#pragma omp parallel for
+    const int thread_num = omp_get_max_threads();
+#else
+    const int thread_num = 1;
+#endif
+    struct log_writer held[thread_num];
+    for (int k = 0; k < thread_num; k++) {
+        init_log_writer(held + k, 0, writer->binary, 1);
+        log_set_hold(held + k, 1);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < rnn->series_num; i++) {
+#ifdef _OPENMP
+        struct log_writer *w = held + omp_get_thread_num();
+#else
+        struct log_writer *w = held;
+#endif
+        log_begin(w, fp_array[i], epoch);
+        log_printf(w, "# epoch = %ld\n", epoch);
+        log_printf(w, "# target:%d\n", i);
+        print_rnn_state(w, rnn->rnn_s + i);
+        log_printf(w, "\n");
+        log_end(w, 0);
+    }
+    for (int k = 0; k < thread_num; k++) {
+        log_submit_held(writer, held + k);
+        free_log_writer(held + k);
+    }
+}
+
+/*
+ * The states of all the series at an epoch are stored in one record of a
+ * trajectory file. Each series has its own block in the record, so that the
+ * blocks are filled in parallel.
+ */
+static void print_rnn_state_to_trajectory (
+        struct log_writer *writer,
+        FILE *fp,
+        const struct rnn_trajectory *traj,
+        long epoch,
+        const struct recurrent_neural_network *rnn)
+{
+    void *record = log_begin_raw(writer, fp, traj->record_size);
+    rnn_trajectory_put_epoch(traj, record, epoch);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
 #endif
     for (int i = 0; i < rnn->series_num; i++) {
-        fprintf(fp_array[i], "# epoch = %ld\n", epoch);
-        fprintf(fp_array[i], "# target:%d\n", i);
-        print_rnn_state(fp_array[i], rnn->rnn_s + i);
+        const struct rnn_state *rnn_s = rnn->rnn_s + i;
+        const int out_state_size = rnn_s->rnn_p->out_state_size;
+        double row[traj->col_num];
+        for (int n = 0; n < rnn_s->length; n++) {
+            int size = 0;
+            for (int j = 0; j < out_state_size; j++) {
+                row[size++] = rnn_s->teach_state[n][j];
+                row[size++] = rnn_s->out_state[n][j];
+                if (rnn_s->rnn_p->output_type == STANDARD_TYPE) {
+                    row[size++] = rnn_s->var_state[n][j];
+                }
+            }
+            memcpy(row + size, rnn_s->c_inter_state[n], sizeof(double) *
+                    rnn_s->rnn_p->c_state_size);
+            rnn_trajectory_put_state(traj, record, i, n, row);
+        }
     }
+    log_end(writer, 0);
 }
 
 
@@ -492,22 +754,33 @@ static void compute_lyapunov_spectrum_of_rnn_state (
 }
 
 
-static void print_lyapunov_spectrum_of_rnn (
-        FILE *fp,
-        long epoch,
+/* decides spectrum_size which is the number to evaluate Lyapunov exponents */
+static int get_lyapunov_spectrum_size (
         const struct recurrent_neural_network *rnn,
         int spectrum_size,
-        int delay_length,
-        int truncate_length)
+        int delay_length)
 {
     int max_num;
-    // decides spectrum_size which is the number to evaluate Lyapunov exponents
     max_num = (rnn->rnn_p.in_state_size * delay_length) +
         rnn->rnn_p.c_state_size;
     if (max_num < spectrum_size || spectrum_size < 0) {
         spectrum_size = max_num;
     }
+    return spectrum_size;
+}
 
+
+static void print_lyapunov_spectrum_of_rnn (
+        struct log_writer *writer,
+        FILE *fp,
+        long epoch,
+        const struct recurrent_neural_network *rnn,
+        int spectrum_size,
+        int delay_length,
+        int truncate_length)
+{
+    spectrum_size = get_lyapunov_spectrum_size(rnn, spectrum_size,
+            delay_length);
     if (spectrum_size <= 0) return;
 
     double **spectrum = NULL;
@@ -519,13 +792,12 @@ static void print_lyapunov_spectrum_of_rnn (
         compute_lyapunov_spectrum_of_rnn_state(rnn->rnn_s + i, spectrum_size,
                 delay_length, truncate_length, spectrum[i]);
     }
-    fprintf(fp, "%ld", epoch);
-    for (int i = 0; i < rnn->series_num; i++) {
-        for (int j = 0; j < spectrum_size; j++) {
-            fprintf(fp, "\t%f", spectrum[i][j]);
-        }
-    }
-    fprintf(fp, "\n");
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%f", spectrum[0],
+            rnn->series_num * spectrum_size);
+    log_printf(writer, "\n");
+    log_end(writer, 1);
     FREE2(spectrum);
 }
 
@@ -607,6 +879,7 @@ static void compute_kl_divergence_of_rnn_state (
 
 
 static void print_kl_divergence_of_rnn (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct recurrent_neural_network *rnn,
@@ -614,24 +887,21 @@ static void print_kl_divergence_of_rnn (
         int block_length,
         int divide_num)
 {
-    double kl_div[rnn->series_num];
-    double entropy_t[rnn->series_num];
-    double entropy_o[rnn->series_num];
-    double gen_rate[rnn->series_num];
+    // kl_div, gen_rate, entropy_t and entropy_o of each series
+    double value[rnn->series_num][4];
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
     for (int i = 0; i < rnn->series_num; i++) {
         compute_kl_divergence_of_rnn_state(rnn->rnn_s + i,
-                truncate_length, block_length, divide_num, kl_div + i,
-                entropy_t + i, entropy_o + i, gen_rate + i);
-    }
-    fprintf(fp, "%ld", epoch);
-    for (int i = 0; i < rnn->series_num; i++) {
-        fprintf(fp, "\t%g\t%g\t%g\t%g", kl_div[i], gen_rate[i], entropy_t[i],
-                entropy_o[i]);
-    }
-    fprintf(fp, "\n");
+                truncate_length, block_length, divide_num, &value[i][0],
+                &value[i][2], &value[i][3], &value[i][1]);
+    }
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%g", value[0], 4 * rnn->series_num);
+    log_printf(writer, "\n");
+    log_end(writer, 1);
 }
 
 
@@ -661,6 +931,7 @@ static int get_period_of_rnn_state (
 }
 
 static void print_period_of_rnn (
+        struct log_writer *writer,
         FILE *fp,
         long epoch,
         const struct recurrent_neural_network *rnn,
@@ -673,11 +944,11 @@ static void print_period_of_rnn (
     for (int i = 0; i < rnn->series_num; i++) {
         period[i] = get_period_of_rnn_state(rnn->rnn_s + i, threshold);
     }
-    fprintf(fp, "%ld", epoch);
-    for (int i = 0; i < rnn->series_num; i++) {
-        fprintf(fp, "\t%d", period[i]);
-    }
-    fprintf(fp, "\n");
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_ints(writer, "\t%d", period, rnn->series_num);
+    log_printf(writer, "\n");
+    log_end(writer, 1);
 }
 
 static int enable_print (
@@ -708,33 +979,36 @@ static void print_parameters_with_epoch (
 {
     if (fp_list->fp_wweight &&
             enable_print(epoch, &gp->iop.interval_for_weight_file)) {
-        print_rnn_weight(fp_list->fp_wweight, epoch, &rnn->rnn_p);
+        print_rnn_weight(&fp_list->writer, fp_list->fp_wweight, epoch,
+                &rnn->rnn_p);
     }
 
     if (fp_list->fp_wthreshold &&
             enable_print(epoch, &gp->iop.interval_for_threshold_file)) {
-        print_rnn_threshold(fp_list->fp_wthreshold, epoch, &rnn->rnn_p);
+        print_rnn_threshold(&fp_list->writer, fp_list->fp_wthreshold, epoch,
+                &rnn->rnn_p);
     }
 
     if (fp_list->fp_wtau &&
             enable_print(epoch, &gp->iop.interval_for_tau_file)) {
-        print_rnn_tau(fp_list->fp_wtau, epoch, &rnn->rnn_p);
+        print_rnn_tau(&fp_list->writer, fp_list->fp_wtau, epoch, &rnn->rnn_p);
     }
 
     if (fp_list->fp_winit &&
             enable_print(epoch, &gp->iop.interval_for_init_file)) {
-        print_rnn_init(fp_list->fp_winit, epoch, rnn);
+        print_rnn_init(&fp_list->writer, fp_list->fp_winit, epoch, rnn);
     }
 
     if (fp_list->fp_wrep_init &&
             enable_print(epoch, &gp->iop.interval_for_rep_init_file)) {
-        print_rnn_rep_init(fp_list->fp_wrep_init, epoch, rnn);
+        print_rnn_rep_init(&fp_list->writer, fp_list->fp_wrep_init, epoch,
+                rnn);
     }
 
     if (fp_list->fp_wadapt_lr &&
             enable_print(epoch, &gp->iop.interval_for_adapt_lr_file)) {
-        print_adapt_lr(fp_list->fp_wadapt_lr, epoch, gp->inp.adapt_lr);
-        fflush(fp_list->fp_wadapt_lr);
+        print_adapt_lr(&fp_list->writer, fp_list->fp_wadapt_lr, epoch,
+                gp->inp.adapt_lr);
     }
 }
 
@@ -747,14 +1021,18 @@ static void print_open_loop_data_with_epoch (
 {
     int compute_forward_dynamics = 0;
 
-    if (fp_list->fp_werror &&
+    if (fp_list->fp_werror && gp->inp.stream != NULL &&
+            enable_print(epoch, &gp->iop.interval_for_error_file)) {
+        rnn_stream_forward_dynamics_forall(gp->inp.stream);
+        print_rnn_stream_error(&fp_list->writer, fp_list->fp_werror, epoch,
+                gp->inp.stream);
+    } else if (fp_list->fp_werror &&
             enable_print(epoch, &gp->iop.interval_for_error_file)) {
         if (!compute_forward_dynamics) {
             rnn_forward_dynamics_forall(rnn);
             compute_forward_dynamics = 1;
         }
-        print_rnn_error(fp_list->fp_werror, epoch, rnn);
-        fflush(fp_list->fp_werror);
+        print_rnn_error(&fp_list->writer, fp_list->fp_werror, epoch, rnn);
     }
 
     if (fp_list->fp_wstate_array &&
@@ -763,10 +1041,18 @@ static void print_open_loop_data_with_epoch (
             rnn_forward_dynamics_forall(rnn);
             compute_forward_dynamics = 1;
         }
-        print_rnn_state_forall(fp_list->fp_wstate_array, epoch, rnn);
-        for (int i = 0; i < fp_list->array_size; i++) {
-            fprintf(fp_list->fp_wstate_array[i], "\n");
+        print_rnn_state_forall(&fp_list->writer, fp_list->fp_wstate_array,
+                epoch, rnn);
+    }
+
+    if (fp_list->fp_wstate &&
+            enable_print(epoch, &gp->iop.interval_for_state_file)) {
+        if (!compute_forward_dynamics) {
+            rnn_forward_dynamics_forall(rnn);
+            compute_forward_dynamics = 1;
         }
+        print_rnn_state_to_trajectory(&fp_list->writer, fp_list->fp_wstate,
+                &fp_list->trajectory, epoch, rnn);
     }
 }
 
@@ -774,7 +1060,8 @@ static void print_closed_loop_data_with_epoch (
         long epoch,
         const struct general_parameters *gp,
         struct recurrent_neural_network *rnn,
-        struct output_files *fp_list)
+        struct output_files *fp_list,
+        struct log_writer *writer)
 {
     int compute_forward_dynamics = 0;
 
@@ -785,8 +1072,7 @@ static void print_closed_loop_data_with_epoch (
                     gp->mp.delay_length);
             compute_forward_dynamics = 1;
         }
-        print_rnn_error(fp_list->fp_wclosed_error, epoch, rnn);
-        fflush(fp_list->fp_wclosed_error);
+        print_rnn_error(writer, fp_list->fp_wclosed_error, epoch, rnn);
     }
 
     if (fp_list->fp_wclosed_state_array &&
@@ -796,10 +1082,19 @@ static void print_closed_loop_data_with_epoch (
                     gp->mp.delay_length);
             compute_forward_dynamics = 1;
         }
-        print_rnn_state_forall(fp_list->fp_wclosed_state_array, epoch, rnn);
-        for (int i = 0; i < fp_list->array_size; i++) {
-            fprintf(fp_list->fp_wclosed_state_array[i], "\n");
+        print_rnn_state_forall(writer, fp_list->fp_wclosed_state_array,
+                epoch, rnn);
+    }
+
+    if (fp_list->fp_wclosed_state &&
+            enable_print(epoch, &gp->iop.interval_for_closed_state_file)) {
+        if (!compute_forward_dynamics) {
+            rnn_forward_dynamics_in_closed_loop_forall(rnn,
+                    gp->mp.delay_length);
+            compute_forward_dynamics = 1;
         }
+        print_rnn_state_to_trajectory(writer, fp_list->fp_wclosed_state,
+                &fp_list->trajectory, epoch, rnn);
     }
 
     if (fp_list->fp_wlyapunov &&
@@ -809,10 +1104,10 @@ static void print_closed_loop_data_with_epoch (
                     gp->mp.delay_length);
             compute_forward_dynamics = 1;
         }
-        print_lyapunov_spectrum_of_rnn(fp_list->fp_wlyapunov, epoch, rnn,
+        print_lyapunov_spectrum_of_rnn(writer, fp_list->fp_wlyapunov, epoch,
+                rnn,
                 gp->ap.lyapunov_spectrum_size, gp->mp.delay_length,
                 gp->ap.truncate_length);
-        fflush(fp_list->fp_wlyapunov);
     }
 
     if (fp_list->fp_wentropy &&
@@ -822,10 +1117,9 @@ static void print_closed_loop_data_with_epoch (
                     gp->mp.delay_length);
             compute_forward_dynamics = 1;
         }
-        print_kl_divergence_of_rnn(fp_list->fp_wentropy, epoch, rnn,
-                gp->ap.truncate_length, gp->ap.block_length,
+        print_kl_divergence_of_rnn(writer, fp_list->fp_wentropy, epoch,
+                rnn, gp->ap.truncate_length, gp->ap.block_length,
                 gp->ap.divide_num);
-        fflush(fp_list->fp_wentropy);
     }
 
     if (fp_list->fp_wperiod &&
@@ -835,86 +1129,270 @@ static void print_closed_loop_data_with_epoch (
                     gp->mp.delay_length);
             compute_forward_dynamics = 1;
         }
-        print_period_of_rnn(fp_list->fp_wperiod, epoch, rnn,
+        print_period_of_rnn(writer, fp_list->fp_wperiod, epoch, rnn,
                 gp->ap.threshold_period);
-        fflush(fp_list->fp_wperiod);
     }
 }
 
+static int enable_closed_loop_data (
+        long epoch,
+        const struct general_parameters *gp,
+        const struct output_files *fp_list)
+{
+    return (fp_list->fp_wclosed_error &&
+            enable_print(epoch, &gp->iop.interval_for_closed_error_file)) ||
+        ((fp_list->fp_wclosed_state_array || fp_list->fp_wclosed_state) &&
+         enable_print(epoch, &gp->iop.interval_for_closed_state_file)) ||
+        (fp_list->fp_wlyapunov &&
+         enable_print(epoch, &gp->iop.interval_for_lyapunov_file)) ||
+        (fp_list->fp_wentropy &&
+         enable_print(epoch, &gp->iop.interval_for_entropy_file)) ||
+        (fp_list->fp_wperiod &&
+         enable_print(epoch, &gp->iop.interval_for_period_file));
+}
+
+/*
+ * This function is called by the threads of the analysis pool with a
+ * snapshot of the model.
+ */
+static void analyze_closed_loop_data (
+        long epoch,
+        struct recurrent_neural_network *rnn,
+        struct log_writer *writer,
+        void *arg)
+{
+    struct output_files *fp_list = arg;
+    print_closed_loop_data_with_epoch(epoch, fp_list->gp, rnn, fp_list,
+            writer);
+}
+
+/*
+ * This function sets the initial state of a held-out series to the
+ * representative initial state rep_init_c[k].
+ */
+static void set_validation_init_state (
+        const struct rnn_parameters *rnn_p,
+        struct rnn_state *rnn_s,
+        int k)
+{
+    for (int j = 0; j < rnn_p->c_state_size; j++) {
+        rnn_s->init_c_inter_state[j] = rnn_p->const_init_c[j] ? 0 :
+            rnn_p->rep_init_c[k][j];
+        rnn_s->init_c_state[j] = tanh(rnn_s->init_c_inter_state[j]);
+    }
+}
+
+static void get_validation_error (
+        const struct recurrent_neural_network *rnn,
+        double *error)
+{
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < rnn->series_num; i++) {
+        error[i] = rnn_get_error(rnn->rnn_s + i);
+        error[i] /= rnn->rnn_s[i].length * rnn->rnn_p.out_state_size;
+    }
+}
+
+/*
+ * This function is called by the threads of the validation pool with a
+ * snapshot of the model whose series are the held-out ones. Since the
+ * held-out series have no initial states of their own, each series starts
+ * from the representative initial state which gives the least open-loop
+ * error. The open-loop and the closed-loop errors are printed in a line.
+ */
+static void analyze_validation_data (
+        long epoch,
+        struct recurrent_neural_network *rnn,
+        struct log_writer *writer,
+        void *arg)
+{
+    const struct output_files *fp_list = arg;
+    const int num = rnn->series_num;
+    int best_k[num];
+    double error[2 * num], best_error[num];
+
+    for (int i = 0; i < num; i++) {
+        best_k[i] = 0;
+        best_error[i] = HUGE_VAL;
+    }
+    for (int r = 0; r < rnn->rnn_p.rep_init_size; r++) {
+        for (int i = 0; i < num; i++) {
+            set_validation_init_state(&rnn->rnn_p, rnn->rnn_s + i, r);
+        }
+        rnn_forward_dynamics_forall(rnn);
+        get_validation_error(rnn, error);
+        for (int i = 0; i < num; i++) {
+            if (error[i] < best_error[i]) {
+                best_k[i] = r;
+                best_error[i] = error[i];
+            }
+        }
+    }
+    for (int i = 0; i < num; i++) {
+        set_validation_init_state(&rnn->rnn_p, rnn->rnn_s + i, best_k[i]);
+    }
+    rnn_forward_dynamics_in_closed_loop_forall(rnn,
+            fp_list->gp->mp.delay_length);
+    get_validation_error(rnn, error + num);
+    for (int i = 0; i < num; i++) {
+        error[i] = best_error[i];
+    }
+    log_begin(writer, fp_list->fp_wvalidation_error, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%g", error, 2 * num);
+    log_printf(writer, "\n");
+    log_end(writer, 1);
+}
+
+
+/*
+ * This function returns the comment lines at the head of a log file, whose
+ * size is stored in size. The returned text must be freed by the caller.
+ */
+static char* sprint_header_text (
+        const char *title,
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn,
+        size_t *size)
+{
+    FILE *tmp;
+    if ((tmp = tmpfile()) == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(tmp, "%s\n", title);
+    print_general_parameters(tmp, gp);
+    print_rnn_parameters(tmp, rnn);
+    long length = ftell(tmp);
+    char *text;
+    MALLOC(text, length + 1);
+    rewind(tmp);
+    FREAD(text, length, tmp);
+    fclose(tmp);
+    *size = length;
+    return text;
+}
+
+/*
+ * This function writes the comment lines at the head of a log file. In a
+ * binary log, the lines are stored in the header with the shape of records,
+ * which consist of row_num x col_num values.
+ */
+static void print_header (
+        FILE *fp,
+        const char *title,
+        int id,
+        int row_num,
+        int col_num,
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn)
+{
+    if (!gp->iop.use_binary_log) {
+        fprintf(fp, "%s\n", title);
+        print_general_parameters(fp, gp);
+        print_rnn_parameters(fp, rnn);
+        return;
+    }
+    size_t size;
+    char *text = sprint_header_text(title, gp, rnn, &size);
+    fwrite_rnn_log_header(id, row_num, col_num, text, size, fp);
+    FREE(text);
+}
+
+static void print_trajectory_header (
+        FILE *fp,
+        const struct rnn_trajectory *traj,
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn)
+{
+    size_t size;
+    char *text = sprint_header_text("# STATE FILE", gp, rnn, &size);
+    fwrite_rnn_trajectory_header(traj, text, size, fp);
+    FREE(text);
+}
+
 
 void print_training_main_begin (
         const struct general_parameters *gp,
         const struct recurrent_neural_network *rnn,
         struct output_files *fp_list)
 {
+    const struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    const int state_size = get_state_size(rnn_p);
     if (fp_list->fp_wstate_array) {
         for (int i = 0; i < fp_list->array_size; i++) {
-            fprintf(fp_list->fp_wstate_array[i], "# STATE FILE\n");
-            print_general_parameters(fp_list->fp_wstate_array[i], gp);
-            print_rnn_parameters(fp_list->fp_wstate_array[i], rnn);
+            print_header(fp_list->fp_wstate_array[i], "# STATE FILE", i,
+                    rnn->rnn_s[i].length, state_size, gp, rnn);
         }
     }
     if (fp_list->fp_wclosed_state_array) {
         for (int i = 0; i < fp_list->array_size; i++) {
-            fprintf(fp_list->fp_wclosed_state_array[i],  "# STATE FILE\n");
-            print_general_parameters(fp_list->fp_wclosed_state_array[i], gp);
-            print_rnn_parameters(fp_list->fp_wclosed_state_array[i], rnn);
+            print_header(fp_list->fp_wclosed_state_array[i], "# STATE FILE",
+                    i, rnn->rnn_s[i].length, state_size, gp, rnn);
         }
     }
+    if (fp_list->fp_wstate) {
+        print_trajectory_header(fp_list->fp_wstate, &fp_list->trajectory, gp,
+                rnn);
+    }
+    if (fp_list->fp_wclosed_state) {
+        print_trajectory_header(fp_list->fp_wclosed_state,
+                &fp_list->trajectory, gp, rnn);
+    }
     if (fp_list->fp_wweight) {
-        fprintf(fp_list->fp_wweight, "# WEIGHT FILE\n");
-        print_general_parameters(fp_list->fp_wweight, gp);
-        print_rnn_parameters(fp_list->fp_wweight, rnn);
+        print_header(fp_list->fp_wweight, "# WEIGHT FILE", -1, 1,
+                rnn_p->c_state_size * (rnn_p->in_state_size +
+                    rnn_p->c_state_size + rnn_p->out_state_size), gp, rnn);
     }
     if (fp_list->fp_wthreshold) {
-        fprintf(fp_list->fp_wthreshold, "# THRESHOLD FILE\n");
-        print_general_parameters(fp_list->fp_wthreshold, gp);
-        print_rnn_parameters(fp_list->fp_wthreshold, rnn);
+        print_header(fp_list->fp_wthreshold, "# THRESHOLD FILE", -1, 1,
+                rnn_p->c_state_size + rnn_p->out_state_size, gp, rnn);
     }
     if (fp_list->fp_wtau) {
-        fprintf(fp_list->fp_wtau, "# TAU FILE\n");
-        print_general_parameters(fp_list->fp_wtau, gp);
-        print_rnn_parameters(fp_list->fp_wtau, rnn);
+        print_header(fp_list->fp_wtau, "# TAU FILE", -1, 1,
+                rnn_p->c_state_size, gp, rnn);
     }
     if (fp_list->fp_winit) {
-        fprintf(fp_list->fp_winit, "# INIT FILE\n");
-        print_general_parameters(fp_list->fp_winit, gp);
-        print_rnn_parameters(fp_list->fp_winit, rnn);
+        print_header(fp_list->fp_winit, "# INIT FILE", -1, rnn->series_num,
+                rnn_p->rep_init_size + rnn_p->c_state_size, gp, rnn);
     }
     if (fp_list->fp_wrep_init) {
-        fprintf(fp_list->fp_wrep_init, "# REP INIT FILE\n");
-        print_general_parameters(fp_list->fp_wrep_init, gp);
-        print_rnn_parameters(fp_list->fp_wrep_init, rnn);
+        print_header(fp_list->fp_wrep_init, "# REP INIT FILE", -1,
+                rnn_p->rep_init_size, rnn_p->c_state_size, gp, rnn);
     }
     if (fp_list->fp_wadapt_lr) {
-        fprintf(fp_list->fp_wadapt_lr, "# ADAPT_LR FILE\n");
-        print_general_parameters(fp_list->fp_wadapt_lr, gp);
-        print_rnn_parameters(fp_list->fp_wadapt_lr, rnn);
+        print_header(fp_list->fp_wadapt_lr, "# ADAPT_LR FILE", -1, 1, 1, gp,
+                rnn);
     }
     if (fp_list->fp_werror) {
-        fprintf(fp_list->fp_werror, "# ERROR FILE\n");
-        print_general_parameters(fp_list->fp_werror, gp);
-        print_rnn_parameters(fp_list->fp_werror, rnn);
+        print_header(fp_list->fp_werror, "# ERROR FILE", -1, 1,
+                rnn->series_num, gp, rnn);
     }
     if (fp_list->fp_wclosed_error) {
-        fprintf(fp_list->fp_wclosed_error, "# ERROR FILE\n");
-        print_general_parameters(fp_list->fp_wclosed_error, gp);
-        print_rnn_parameters(fp_list->fp_wclosed_error, rnn);
+        print_header(fp_list->fp_wclosed_error, "# ERROR FILE", -1, 1,
+                rnn->series_num, gp, rnn);
     }
     if (fp_list->fp_wlyapunov) {
-        fprintf(fp_list->fp_wlyapunov, "# LYAPUNOV FILE\n");
-        print_general_parameters(fp_list->fp_wlyapunov, gp);
-        print_rnn_parameters(fp_list->fp_wlyapunov, rnn);
+        int spectrum_size = get_lyapunov_spectrum_size(rnn,
+                gp->ap.lyapunov_spectrum_size, gp->mp.delay_length);
+        print_header(fp_list->fp_wlyapunov, "# LYAPUNOV FILE", -1,
+                rnn->series_num, spectrum_size > 0 ? spectrum_size : 0, gp,
+                rnn);
     }
     if (fp_list->fp_wentropy) {
-        fprintf(fp_list->fp_wentropy, "# ENTROPY FILE\n");
-        print_general_parameters(fp_list->fp_wentropy, gp);
-        print_rnn_parameters(fp_list->fp_wentropy, rnn);
+        print_header(fp_list->fp_wentropy, "# ENTROPY FILE", -1,
+                rnn->series_num, 4, gp, rnn);
     }
     if (fp_list->fp_wperiod) {
-        fprintf(fp_list->fp_wperiod, "# PERIOD FILE\n");
-        print_general_parameters(fp_list->fp_wperiod, gp);
-        print_rnn_parameters(fp_list->fp_wperiod, rnn);
+        print_header(fp_list->fp_wperiod, "# PERIOD FILE", -1, 1,
+                rnn->series_num, gp, rnn);
+    }
+    if (fp_list->fp_wvalidation_error) {
+        print_header(fp_list->fp_wvalidation_error,
+                "# VALIDATION ERROR FILE", -1, 2,
+                gp->inp.validation->num, gp, rnn);
     }
 }
 
@@ -926,7 +1404,16 @@ void print_training_main_loop (
 {
     print_parameters_with_epoch(epoch, gp, rnn, fp_list);
     print_open_loop_data_with_epoch(epoch, gp, rnn, fp_list);
-    print_closed_loop_data_with_epoch(epoch, gp, rnn, fp_list);
+    if (!fp_list->use_analysis_pool) {
+        print_closed_loop_data_with_epoch(epoch, gp, rnn, fp_list,
+                &fp_list->writer);
+    } else if (enable_closed_loop_data(epoch, gp, fp_list)) {
+        submit_analysis(&fp_list->analysis_pool, epoch, rnn);
+    }
+    if (fp_list->fp_wvalidation_error &&
+            enable_print(epoch, &gp->iop.interval_for_validation_error_file)) {
+        submit_analysis(&fp_list->validation_pool, epoch, rnn);
+    }
 }
 
 
@@ -19,11 +19,17 @@
 
 #include "main.h"
 #include "rnn.h"
+#include "log_writer.h"
+#include "rnn_trajectory.h"
+#include "analysis_pool.h"
 
 typedef struct output_files {
     int array_size;
     FILE **fp_wstate_array;
     FILE **fp_wclosed_state_array;
+    FILE *fp_wstate;                    // trajectory file of states
+    FILE *fp_wclosed_state;             // trajectory file of closed states
+    struct rnn_trajectory trajectory;   // layout of the trajectory files
     FILE *fp_wweight;
     FILE *fp_wthreshold;
     FILE *fp_wtau;
@@ -35,6 +41,19 @@ typedef struct output_files {
     FILE *fp_wlyapunov;
     FILE *fp_wentropy;
     FILE *fp_wperiod;
+    FILE *fp_wvalidation_error;
+    struct log_writer writer;
+
+    /*
+     * If use_analysis_pool!=0, the closed-loop data are printed by the
+     * threads of analysis_pool with gp.
+     */
+    int use_analysis_pool;
+    struct analysis_pool analysis_pool;
+    const struct general_parameters *gp;
+
+    /* the held-out series are evaluated by the threads of validation_pool */
+    struct analysis_pool validation_pool;
 } output_files;
 
 
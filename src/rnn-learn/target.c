@@ -24,6 +24,15 @@
 #include <math.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdint.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "utils.h"
 #include "target.h"
@@ -33,6 +42,11 @@
 #define INIT_MEMSIZE 1024
 #endif
 
+/* minimum number of bytes of a text file parsed by one thread */
+#ifndef MIN_CHUNK_SIZE
+#define MIN_CHUNK_SIZE (1 << 20)
+#endif
+
 
 static int num_of_items_in_str (
         const char *str,
@@ -98,14 +112,25 @@ void init_target_reader (struct target_reader *t_reader)
     t_reader->dimension = -1;
     t_reader->num = 0;
     t_reader->t_list = NULL;
+    t_reader->dataset_num = 0;
+    t_reader->dataset = NULL;
 }
 
 void free_target_reader (struct target_reader *t_reader)
 {
     for (int i = 0; i < t_reader->num; i++) {
-        FREE2(t_reader->t_list[i].target);
+        if (t_reader->t_list[i].is_mapped) {
+            FREE(t_reader->t_list[i].target);
+        } else {
+            FREE2(t_reader->t_list[i].target);
+        }
     }
     FREE(t_reader->t_list);
+    for (int i = 0; i < t_reader->dataset_num; i++) {
+        unmap_rnn_dataset(t_reader->dataset + i);
+    }
+    FREE(t_reader->dataset);
+    t_reader->dataset_num = 0;
 }
 
 static void set_target (
@@ -115,7 +140,9 @@ static void set_target (
         int dimension)
 {
     t->length = length;
+    t->is_mapped = 0;
     MALLOC2(t->target, t->length, dimension);
+    t->data = (length > 0) ? t->target[0] : NULL;
     for (int n = 0; n < t->length; n++) {
         memcpy(t->target[n], vec_series[n], sizeof(double) * dimension);
     }
@@ -187,3 +214,717 @@ error:
 }
 
 
+
+/*
+ * A chunk is a range of whole lines of a mapped text file, which is parsed
+ * independently of the other chunks.
+ * The rows parsed in a chunk are stored in value, and the blank lines between
+ * them are recorded in event: a positive event means consecutive rows, and
+ * zero means a blank line.
+ * Line numbers in a chunk are counted from the beginning of the chunk.
+ */
+struct text_chunk {
+    const char *begin;
+    const char *end;
+
+    double *value;
+    size_t value_num;
+    size_t value_size;
+    int *event;
+    int event_num;
+    int event_size;
+
+    int dimension;      /* number of items in the first row (-1 if no row) */
+    int first_row_line;
+    int line;
+
+    int error_line;     /* zero if no error occurs */
+    int error_column;   /* zero if the number of items is wrong */
+};
+
+/* powers of ten which are exactly representable as double */
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/*
+ * This function scans a decimal number of at most 15 significant digits
+ * whose value is m * 10^e (|e| <= 22). Since both m and 10^e are exact,
+ * one multiplication or division gives the correctly rounded result, the
+ * same as strtod.
+ * It returns NULL if the token is not such a number, and then the caller
+ * falls back on strtod.
+ */
+static const char* scan_double (
+        const char *p,
+        const char *end,
+        double *x)
+{
+    int negative = 0;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = (*p == '-');
+        p++;
+    }
+    long long m = 0;
+    int digits = 0, exponent = 0, has_digit = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        has_digit = 1;
+        if (m != 0 || *p != '0') {
+            if (digits++ >= 15) { return NULL; }
+            m = 10 * m + (*p - '0');
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            has_digit = 1;
+            if (m != 0 || *p != '0') {
+                if (digits++ >= 15) { return NULL; }
+                m = 10 * m + (*p - '0');
+            }
+            exponent--;
+        }
+    }
+    if (!has_digit) {
+        return NULL;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int e_negative = 0, e = 0;
+        if (q < end && (*q == '+' || *q == '-')) {
+            e_negative = (*q == '-');
+            q++;
+        }
+        if (q < end && *q >= '0' && *q <= '9') {
+            for (; q < end && *q >= '0' && *q <= '9'; q++) {
+                if (e < 10000) { e = 10 * e + (*q - '0'); }
+            }
+            exponent += e_negative ? -e : e;
+            p = q;
+        }
+    }
+    if (p < end && (*p == 'x' || *p == 'X')) {
+        return NULL; // hexadecimal
+    }
+    double v;
+    if (m == 0) {
+        v = 0;
+    } else if (exponent >= 0 && exponent <= 22) {
+        v = (double)m * exact_pow10[exponent];
+    } else if (exponent < 0 && exponent >= -22) {
+        v = (double)m / exact_pow10[-exponent];
+    } else {
+        return NULL;
+    }
+    *x = negative ? -v : v;
+    return p;
+}
+
+static int token_to_double (
+        const char *begin,
+        const char *end,
+        double *x)
+{
+    if (scan_double(begin, end, x) != NULL) {
+        return 0;
+    }
+    char buf[64], *str = buf;
+    size_t n = end - begin;
+    if (n >= sizeof(buf)) {
+        MALLOC(str, n + 1);
+    }
+    memcpy(str, begin, n);
+    str[n] = '\0';
+    char *endptr;
+    *x = strtod(str, &endptr);
+    errno = 0;
+    int stat = (endptr == str) ? -1 : 0;
+    if (str != buf) {
+        FREE(str);
+    }
+    return stat;
+}
+
+static void push_chunk_event (
+        struct text_chunk *chunk,
+        int is_row)
+{
+    if (is_row && chunk->event_num > 0 &&
+            chunk->event[chunk->event_num - 1] > 0) {
+        chunk->event[chunk->event_num - 1]++;
+        return;
+    }
+    if (chunk->event_size <= chunk->event_num) {
+        chunk->event_size *= 2;
+        REALLOC(chunk->event, chunk->event_size);
+    }
+    chunk->event[chunk->event_num++] = is_row ? 1 : 0;
+}
+
+static void parse_text_chunk (
+        struct text_chunk *chunk,
+        const char *is_separator)
+{
+    const char *p = chunk->begin;
+    while (p < chunk->end) {
+        const char *eol = memchr(p, '\n', chunk->end - p);
+        if (eol == NULL) { eol = chunk->end; }
+        chunk->line++;
+        if (p == eol || *p == '#' || *p == '\0') {
+            push_chunk_event(chunk, 0);
+            p = eol + 1;
+            continue;
+        }
+        int n = 0;
+        while (p < eol && *p != '#' && *p != '\0') {
+            if (is_separator[(unsigned char)*p]) {
+                p++;
+                continue;
+            }
+            const char *token = p;
+            while (p < eol && *p != '#' && *p != '\0' &&
+                    !is_separator[(unsigned char)*p]) {
+                p++;
+            }
+            if (chunk->value_size <= chunk->value_num) {
+                chunk->value_size *= 2;
+                REALLOC(chunk->value, chunk->value_size);
+            }
+            if (token_to_double(token, p,
+                        chunk->value + chunk->value_num) == -1) {
+                chunk->error_line = chunk->line;
+                chunk->error_column = n + 1;
+                return;
+            }
+            chunk->value_num++;
+            n++;
+        }
+        if (chunk->dimension < 0) {
+            chunk->dimension = n;
+            chunk->first_row_line = chunk->line;
+        } else if (chunk->dimension != n) {
+            chunk->error_line = chunk->line;
+            chunk->error_column = 0;
+            return;
+        }
+        push_chunk_event(chunk, 1);
+        p = eol + 1;
+    }
+}
+
+
+/* rows of a series spanning over several chunks */
+struct series_piece {
+    const double *value;
+    int length;
+};
+
+static void add_series_pieces (
+        struct target_reader *t_reader,
+        const struct series_piece *piece,
+        int piece_num,
+        int length)
+{
+    const int dimension = t_reader->dimension;
+    t_reader->num++;
+    REALLOC(t_reader->t_list, t_reader->num);
+    struct target_t *t = t_reader->t_list + t_reader->num - 1;
+    t->length = length;
+    t->is_mapped = 0;
+    MALLOC2(t->target, length, dimension);
+    t->data = t->target[0];
+    double *dst = t->target[0];
+    for (int i = 0; i < piece_num; i++) {
+        size_t size = (size_t)piece[i].length * dimension;
+        memcpy(dst, piece[i].value, sizeof(double) * size);
+        dst += size;
+    }
+}
+
+/*
+ * This function joins the rows of chunks into time series in order, and
+ * reports the first error in the file as read_target_from_file does.
+ */
+static int merge_text_chunks (
+        struct target_reader *t_reader,
+        struct text_chunk *chunk,
+        int chunk_num)
+{
+    int stat = 0;
+    int line = 0, length = 0;
+    int piece_num = 0, piece_size = chunk_num + 1;
+    struct series_piece *piece = NULL;
+    MALLOC(piece, piece_size);
+
+    for (int k = 0; k < chunk_num; k++) {
+        const struct text_chunk *c = chunk + k;
+        const double *value = c->value;
+        for (int i = 0; i < c->event_num; i++) {
+            if (c->event[i] > 0) {
+                if (value == c->value) {
+                    if (t_reader->dimension < 0) {
+                        t_reader->dimension = c->dimension;
+                    } else if (t_reader->dimension != c->dimension) {
+                        print_error_msg("wrong number of data items at "
+                                "line %d", line + c->first_row_line);
+                        goto error;
+                    }
+                }
+                if (piece_num > 0 && piece[piece_num - 1].value +
+                        (size_t)piece[piece_num - 1].length * c->dimension ==
+                        value) {
+                    piece[piece_num - 1].length += c->event[i];
+                } else {
+                    if (piece_size <= piece_num) {
+                        piece_size *= 2;
+                        REALLOC(piece, piece_size);
+                    }
+                    piece[piece_num].value = value;
+                    piece[piece_num].length = c->event[i];
+                    piece_num++;
+                }
+                length += c->event[i];
+                value += (size_t)c->event[i] * c->dimension;
+            } else if (length > 0) {
+                add_series_pieces(t_reader, piece, piece_num, length);
+                piece_num = length = 0;
+            }
+        }
+        if (c->error_line > 0) {
+            if (c->error_column > 0) {
+                print_error_msg("no digits were found");
+                print_error_msg("error at column %d", c->error_column);
+                print_error_msg("error at line %d", line + c->error_line);
+            } else {
+                print_error_msg("wrong number of data items at line %d",
+                        line + c->error_line);
+            }
+            goto error;
+        }
+        line += c->line;
+    }
+    if (length > 0) {
+        add_series_pieces(t_reader, piece, piece_num, length);
+    }
+    stat = 1;
+error:
+    FREE(piece);
+    return (stat ? 0 : -1);
+}
+
+static int read_target_from_mapped_text (
+        struct target_reader *t_reader,
+        const char *separator,
+        const char *text,
+        size_t size)
+{
+    char is_separator[256];
+    memset(is_separator, 0, sizeof(is_separator));
+    for (const char *s = separator; *s != '\0'; s++) {
+        is_separator[(unsigned char)*s] = 1;
+    }
+#ifdef _OPENMP
+    int max_chunk_num = 4 * omp_get_max_threads();
+#else
+    int max_chunk_num = 1;
+#endif
+    int chunk_num = (int)(size / MIN_CHUNK_SIZE);
+    if (chunk_num > max_chunk_num) { chunk_num = max_chunk_num; }
+    if (chunk_num < 1) { chunk_num = 1; }
+
+    struct text_chunk *chunk = NULL;
+    MALLOC(chunk, chunk_num);
+    const char *begin = text, *end = text + size;
+    for (int k = 0; k < chunk_num; k++) {
+        const char *p = text + (size_t)((double)size * (k + 1) / chunk_num);
+        if (k == chunk_num - 1 || p <= begin) {
+            p = (k == chunk_num - 1) ? end : begin;
+        } else {
+            p = memchr(p - 1, '\n', end - (p - 1));
+            p = (p == NULL) ? end : p + 1;
+        }
+        chunk[k].begin = begin;
+        chunk[k].end = p;
+        begin = p;
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int k = 0; k < chunk_num; k++) {
+        struct text_chunk *c = chunk + k;
+        c->value_num = 0;
+        c->value_size = 16 + (c->end - c->begin) / 8;
+        MALLOC(c->value, c->value_size);
+        c->event_num = 0;
+        c->event_size = 16;
+        MALLOC(c->event, c->event_size);
+        c->dimension = -1;
+        c->first_row_line = 0;
+        c->line = 0;
+        c->error_line = 0;
+        c->error_column = 0;
+        parse_text_chunk(c, is_separator);
+    }
+    int stat = merge_text_chunks(t_reader, chunk, chunk_num);
+    for (int k = 0; k < chunk_num; k++) {
+        FREE(chunk[k].value);
+        FREE(chunk[k].event);
+    }
+    FREE(chunk);
+    return stat;
+}
+
+/*
+ * This function reads time series from a text file in the same format as
+ * read_target_from_file. A regular file is mapped into memory and parsed in
+ * parallel, and other files (e.g. pipes) are read by read_target_from_file.
+ * It returns 0 on success, and -1 on failure.
+ */
+int read_target_from_text_file (
+        struct target_reader *t_reader,
+        const char *separator,
+        const char *filename)
+{
+    int fd;
+    struct stat st;
+    if ((fd = open(filename, O_RDONLY)) == -1) {
+        print_error_msg("cannot open %s", filename);
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        print_error_msg("cannot stat %s", filename);
+        close(fd);
+        return -1;
+    }
+    void *map = MAP_FAILED;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        errno = 0;
+        int stat = 0;
+        if (!S_ISREG(st.st_mode) || st.st_size > 0) {
+            FILE *fp = fdopen(fd, "r");
+            if (fp == NULL) {
+                print_error_msg("cannot open %s", filename);
+                close(fd);
+                return -1;
+            }
+            stat = read_target_from_file(t_reader, separator, fp);
+            fclose(fp);
+        } else {
+            close(fd);
+        }
+        return stat;
+    }
+    close(fd);
+    posix_madvise(map, st.st_size, POSIX_MADV_WILLNEED);
+    int stat = read_target_from_mapped_text(t_reader, separator, map,
+            st.st_size);
+    munmap(map, st.st_size);
+    return stat;
+}
+
+/*
+ * This function adds the time series in a binary target file (see
+ * rnn_dataset.h) to t_reader. The file is mapped into memory, and the rows of
+ * the targets refer to the mapping without copying.
+ * It returns 0 on success, and -1 on failure.
+ */
+int map_target_file (
+        struct target_reader *t_reader,
+        const char *filename)
+{
+    struct rnn_dataset dataset;
+    if (map_rnn_dataset(&dataset, filename) == -1) {
+        return -1;
+    }
+    if (dataset.num > 0 && t_reader->dimension >= 0 &&
+            t_reader->dimension != dataset.dimension) {
+        print_error_msg("wrong dimension of data items (%d != %d)",
+                dataset.dimension, t_reader->dimension);
+        unmap_rnn_dataset(&dataset);
+        return -1;
+    }
+    if (dataset.num > 0) {
+        t_reader->dimension = dataset.dimension;
+    }
+    REALLOC(t_reader->t_list, t_reader->num + dataset.num);
+    for (int i = 0; i < dataset.num; i++) {
+        struct target_t *t = t_reader->t_list + t_reader->num + i;
+        t->length = dataset.length[i];
+        t->is_mapped = 1;
+        t->target = NULL;
+        t->data = (double*)dataset.data[i];
+    }
+    t_reader->num += dataset.num;
+    t_reader->dataset_num++;
+    REALLOC(t_reader->dataset, t_reader->dataset_num);
+    t_reader->dataset[t_reader->dataset_num - 1] = dataset;
+    return 0;
+}
+
+
+/*
+ * This function sets the row pointers of the mapped series of t_reader,
+ * which are needed to refer to the series as arrays of rows (e.g. by
+ * rnn_add_target_views). The streaming computation uses the rows in place
+ * without calling this function.
+ */
+void set_target_rows (struct target_reader *t_reader)
+{
+    for (int i = 0; i < t_reader->num; i++) {
+        struct target_t *t = t_reader->t_list + i;
+        if (t->target != NULL || t->length == 0) {
+            continue;
+        }
+        MALLOC(t->target, t->length);
+        for (int n = 0; n < t->length; n++) {
+            t->target[n] = t->data + (size_t)n * t_reader->dimension;
+        }
+    }
+}
+
+
+/*
+ * This function writes the time series from offset to offset + num - 1 of
+ * t_reader in the binary format of rnn_dataset.h. The rows of the mapped
+ * series must be set by set_target_rows in advance.
+ */
+void fwrite_target_dataset (
+        const struct target_reader *t_reader,
+        int offset,
+        int num,
+        FILE *fp)
+{
+    int *length = NULL;
+    const double* const* *data = NULL;
+    MALLOC(length, num);
+    MALLOC(data, num);
+    for (int i = 0; i < num; i++) {
+        length[i] = t_reader->t_list[offset + i].length;
+        data[i] = (const double* const*)t_reader->t_list[offset + i].target;
+    }
+    fwrite_rnn_dataset(t_reader->dimension, num, length,
+            (const double* const* const*)data, fp);
+    FREE(length);
+    FREE(data);
+}
+
+/*
+ * The cache of a text file is followed by a stamp of the text file, so that
+ * the cache is used only while the size and the modification time of the
+ * text file are the same. The stamp is ignored by map_target_file because
+ * it follows the time series.
+ */
+#define TARGET_CACHE_MAGIC "RNTSTAMP"
+
+typedef struct target_cache_stamp {
+    char magic[8];
+    int64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+} target_cache_stamp;
+
+static void set_target_cache_stamp (
+        struct target_cache_stamp *stamp,
+        const struct stat *st)
+{
+    memset(stamp, 0, sizeof(struct target_cache_stamp));
+    memcpy(stamp->magic, TARGET_CACHE_MAGIC, sizeof(stamp->magic));
+    stamp->size = st->st_size;
+    stamp->mtime = st->st_mtime;
+#if defined(HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC)
+    stamp->mtime_nsec = st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMENSEC)
+    stamp->mtime_nsec = st->st_mtimensec;
+#endif
+}
+
+/*
+ * This function returns 1 if the cache has the stamp of the text file whose
+ * status is st, and returns 0 otherwise.
+ */
+static int is_fresh_target_cache (
+        const char *cache_filename,
+        const struct stat *st)
+{
+    struct target_cache_stamp stamp, cache_stamp;
+    FILE *fp;
+    if ((fp = fopen(cache_filename, "rb")) == NULL) {
+        return 0;
+    }
+    int fresh = (fseek(fp, -(long)sizeof(struct target_cache_stamp),
+                SEEK_END) == 0 && fread(&cache_stamp,
+                    sizeof(struct target_cache_stamp), 1, fp) == 1);
+    fclose(fp);
+    set_target_cache_stamp(&stamp, st);
+    return fresh && memcmp(&stamp, &cache_stamp,
+            sizeof(struct target_cache_stamp)) == 0;
+}
+
+static void write_target_cache (
+        const struct target_reader *t_reader,
+        int offset,
+        const char *cache_filename,
+        const struct stat *st)
+{
+    FILE *fp;
+    char *tmp_filename;
+    MALLOC(tmp_filename, strlen(cache_filename) + 32);
+#ifdef _OPENMP
+    sprintf(tmp_filename, "%s.%ld.%d", cache_filename, (long)getpid(),
+            omp_get_thread_num());
+#else
+    sprintf(tmp_filename, "%s.%ld", cache_filename, (long)getpid());
+#endif
+    if ((fp = fopen(tmp_filename, "wb")) == NULL) {
+        // the cache is optional (e.g. the directory is read-only)
+        errno = 0;
+        FREE(tmp_filename);
+        return;
+    }
+    struct target_cache_stamp stamp;
+    set_target_cache_stamp(&stamp, st);
+    fwrite_target_dataset(t_reader, offset, t_reader->num - offset, fp);
+    FWRITE(&stamp, 1, fp);
+    if (fclose(fp) != 0 || rename(tmp_filename, cache_filename) != 0) {
+        remove(tmp_filename);
+        errno = 0;
+    }
+    FREE(tmp_filename);
+}
+
+/*
+ * This function reads time series from a text file as
+ * read_target_from_text_file, and caches them in a binary file whose name
+ * is filename + TARGET_CACHE_SUFFIX. The size and the modification time
+ * (including nanoseconds where available) of the text file are stored in the
+ * cache, and the cache is mapped instead of parsing the text file while they
+ * are the same.
+ * It returns 0 on success, and -1 on failure.
+ */
+int read_target_with_cache (
+        struct target_reader *t_reader,
+        const char *separator,
+        const char *filename)
+{
+    struct stat st;
+    if (stat(filename, &st) == -1 || !S_ISREG(st.st_mode)) {
+        errno = 0;
+        return read_target_from_text_file(t_reader, separator, filename);
+    }
+    int status = 0;
+    char *cache_filename;
+    MALLOC(cache_filename, strlen(filename) + sizeof(TARGET_CACHE_SUFFIX));
+    sprintf(cache_filename, "%s" TARGET_CACHE_SUFFIX, filename);
+    if (is_fresh_target_cache(cache_filename, &st) &&
+            is_rnn_dataset_file(cache_filename)) {
+        if (map_target_file(t_reader, cache_filename) == 0) {
+            goto end;
+        }
+    }
+    errno = 0;
+    int offset = t_reader->num;
+    if (read_target_from_text_file(t_reader, separator, filename) == -1) {
+        status = -1;
+        goto end;
+    }
+    if (t_reader->num > offset) {
+        write_target_cache(t_reader, offset, cache_filename, &st);
+    }
+end:
+    FREE(cache_filename);
+    return status;
+}
+
+static int read_target_of_any_type (
+        struct target_reader *t_reader,
+        const char *separator,
+        const char *filename,
+        int use_cache)
+{
+    if (is_rnn_dataset_file(filename)) {
+        return map_target_file(t_reader, filename);
+    } else if (use_cache) {
+        return read_target_with_cache(t_reader, separator, filename);
+    }
+    return read_target_from_text_file(t_reader, separator, filename);
+}
+
+/* moves the time series and the mappings of src to the end of dst */
+static void move_target_reader (
+        struct target_reader *dst,
+        struct target_reader *src)
+{
+    if (src->num > 0) {
+        dst->dimension = src->dimension;
+        REALLOC(dst->t_list, dst->num + src->num);
+        memcpy(dst->t_list + dst->num, src->t_list,
+                sizeof(struct target_t) * src->num);
+        dst->num += src->num;
+    }
+    if (src->dataset_num > 0) {
+        REALLOC(dst->dataset, dst->dataset_num + src->dataset_num);
+        memcpy(dst->dataset + dst->dataset_num, src->dataset,
+                sizeof(struct rnn_dataset) * src->dataset_num);
+        dst->dataset_num += src->dataset_num;
+    }
+    FREE(src->t_list);
+    FREE(src->dataset);
+    init_target_reader(src);
+}
+
+/*
+ * This function reads text or binary target files concurrently into a
+ * reader per file, and adds their time series to t_reader in the order of
+ * filename, so that the indices of the series do not depend on the order
+ * of completion. If use_cache != 0, text files are read by
+ * read_target_with_cache.
+ * It returns 0 on success. On failure, it reports the first file in error
+ * and returns -1.
+ */
+int read_target_files (
+        struct target_reader *t_reader,
+        const char *separator,
+        int num,
+        char* const* filename,
+        int use_cache)
+{
+    int stat = 0;
+    struct target_reader *reader = NULL;
+    int *file_stat = NULL;
+    MALLOC(reader, num);
+    MALLOC(file_stat, num);
+    for (int i = 0; i < num; i++) {
+        init_target_reader(reader + i);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) if (num > 1)
+#endif
+    for (int i = 0; i < num; i++) {
+        file_stat[i] = read_target_of_any_type(reader + i, separator,
+                filename[i], use_cache);
+    }
+    for (int i = 0; i < num; i++) {
+        if (file_stat[i] == -1) {
+            errno = 0;
+            print_error_msg("error in %s", filename[i]);
+            stat = -1;
+            break;
+        }
+        if (reader[i].num > 0 && t_reader->dimension >= 0 &&
+                t_reader->dimension != reader[i].dimension) {
+            print_error_msg("wrong dimension of data items in %s (%d != %d)",
+                    filename[i], reader[i].dimension, t_reader->dimension);
+            stat = -1;
+            break;
+        }
+        move_target_reader(t_reader, reader + i);
+    }
+    for (int i = 0; i < num; i++) {
+        free_target_reader(reader + i);
+    }
+    FREE(reader);
+    FREE(file_stat);
+    return stat;
+}
@@ -17,6 +17,12 @@
 #ifndef TARGET_H
 #define TARGET_H
 
+#include <stdio.h>
+
+#include "rnn_dataset.h"
+
+/* suffix of the binary cache of a text target file */
+#define TARGET_CACHE_SUFFIX ".bin"
 
 
 typedef struct target_reader {
@@ -24,8 +30,19 @@ typedef struct target_reader {
     int num;
     struct target_t {
         int length;
+        /*
+         * The rows of a series are stored contiguously from data, and
+         * target[n] points to the n-th row. If is_mapped != 0, data refers
+         * to a mapped file, and target is NULL until set_target_rows is
+         * called, so that the mapped series need no memory per time step.
+         */
         double **target;
+        double *data;
+        int is_mapped;
     } *t_list;
+    /* binary target files mapped into memory */
+    int dataset_num;
+    struct rnn_dataset *dataset;
 } target_reader;
 
 void init_target_reader (struct target_reader *t_reader);
@@ -35,6 +52,35 @@ int read_target_from_file (
         const char *separator,
         FILE *fp);
 
+int read_target_from_text_file (
+        struct target_reader *t_reader,
+        const char *separator,
+        const char *filename);
+
+int read_target_with_cache (
+        struct target_reader *t_reader,
+        const char *separator,
+        const char *filename);
+
+int read_target_files (
+        struct target_reader *t_reader,
+        const char *separator,
+        int num,
+        char* const* filename,
+        int use_cache);
+
+int map_target_file (
+        struct target_reader *t_reader,
+        const char *filename);
+
+void set_target_rows (struct target_reader *t_reader);
+
+void fwrite_target_dataset (
+        const struct target_reader *t_reader,
+        int offset,
+        int num,
+        FILE *fp);
+
 void free_target_reader (struct target_reader *t_reader);
 
 
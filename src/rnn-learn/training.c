@@ -23,25 +23,41 @@
 #include <string.h>
 #include <signal.h>
 #include <math.h>
+#include <time.h>
 
 #include "utils.h"
 #include "training.h"
 #include "rnn.h"
+#include "rnn_file.h"
+#include "rnn_optimizer.h"
+#include "rnn_stream.h"
 #include "print.h"
+#include "checkpoint.h"
 
 
 #ifndef SEED_TRANSIENT
 #define SEED_TRANSIENT 100000
 #endif
 
+#ifndef SERIES_ERROR_DECAY
+#define SERIES_ERROR_DECAY 0.5
+#endif
+
 static void init_rnn (
-        const struct general_parameters *gp,
+        struct general_parameters *gp,
         const struct target_reader *t_reader,
         struct recurrent_neural_network *rnn);
 
+static int write_rnn (
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer,
+        long init_epoch);
+
 static void save_rnn (
         const struct general_parameters *gp,
-        const struct recurrent_neural_network *rnn);
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer);
 
 static void load_rnn (
         struct general_parameters *gp,
@@ -50,10 +66,19 @@ static void load_rnn (
 
 static void free_rnn (struct recurrent_neural_network *rnn);
 
+static void synchronize_chunks (
+        const struct general_parameters *gp,
+        struct recurrent_neural_network *rnn);
+
 static void set_parameters_to_recurrent_neural_network (
         const struct general_parameters *gp,
         struct recurrent_neural_network *rnn);
 
+static void init_optimizer (
+        const struct general_parameters *gp,
+        struct recurrent_neural_network *rnn,
+        struct rnn_optimizer *optimizer);
+
 /******************************************************************************/
 /************** Training Main *************************************************/
 /******************************************************************************/
@@ -71,10 +96,186 @@ void sigfunc_term (int sig)
     signal_term = 1;
 }
 
+static void learn_rnn (
+        struct general_parameters *gp,
+        struct recurrent_neural_network *rnn)
+{
+    if (gp->mp.use_streaming) {
+        rnn_stream_learn_s(gp->inp.stream, gp->mp.rho, gp->mp.momentum);
+    } else if (gp->mp.use_async_learning) {
+        rnn_learn_s_async(rnn, gp->mp.rho, gp->mp.momentum);
+    } else if (!gp->mp.use_adaptive_lr) {
+        rnn_learn_s(rnn, gp->mp.rho, gp->mp.momentum);
+    } else {
+#ifdef ENABLE_ADAPTIVE_LEARNING_RATE
+        gp->inp.adapt_lr = rnn_learn_s_with_adapt_lr(rnn, gp->inp.adapt_lr,
+                gp->mp.rho, gp->mp.momentum);
+#else
+        print_error_msg("option `use_adaptive_lr' is not supported");
+        exit(EXIT_FAILURE);
+#endif
+    }
+}
+
+
+static int get_batch_size (
+        long epoch,
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn)
+{
+    double batch_size = gp->mp.batch_size * pow(gp->mp.batch_size_growth,
+            epoch / gp->mp.batch_size_growth_interval);
+    if (batch_size >= rnn->series_num) {
+        return rnn->series_num;
+    }
+    return (int)batch_size;
+}
+
+
+/*
+ * This function learns all series once in mini-batches drawn from a random
+ * permutation of the series.
+ */
+static void learn_with_mini_batch (
+        long epoch,
+        struct general_parameters *gp,
+        struct recurrent_neural_network *rnn)
+{
+    const int series_num = rnn->series_num;
+    const int batch_size = get_batch_size(epoch, gp, rnn);
+    int *index;
+    MALLOC(index, series_num);
+    for (int i = 0; i < series_num; i++) {
+        int j = (int)(genrand_real2() * (i + 1));
+        index[i] = index[j];
+        index[j] = i;
+    }
+    for (int i = 0; i < series_num; i += batch_size) {
+        struct recurrent_neural_network batch;
+        int size = (series_num - i < batch_size) ? series_num - i : batch_size;
+        init_rnn_batch(&batch, rnn, size, index + i);
+        learn_rnn(gp, &batch);
+        free_rnn_batch(&batch);
+    }
+    FREE(index);
+}
+
+
+/*
+ * Selective backpropagation: the gradient of a series which is already
+ * fitted is not recomputed at each epoch. The averaged error of each series
+ * is recorded as an exponential moving average whenever its gradient is
+ * computed.
+ */
+static void init_series_error (
+        struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer)
+{
+    if (gp->mp.selective_backprop_threshold <= 0) {
+        return;
+    }
+    MALLOC(gp->inp.series_error, rnn->series_num);
+    MALLOC(gp->inp.series_epoch, rnn->series_num);
+    MALLOC(gp->inp.series_drift, rnn->series_num);
+    for (int i = 0; i < rnn->series_num; i++) {
+        gp->inp.series_error[i] = -1;
+        gp->inp.series_epoch[i] = 0;
+        gp->inp.series_drift[i] = 0;
+    }
+    // the weights and the thresholds precede the other parameters
+    const int size = optimizer->group_offset[2];
+    MALLOC(gp->inp.last_parameter, size);
+    for (int i = 0; i < size; i++) {
+        gp->inp.last_parameter[i] = *optimizer->param[i];
+    }
+    gp->inp.parameter_drift = 0;
+}
+
+
+static void select_series (
+        long epoch,
+        const struct general_parameters *gp,
+        struct recurrent_neural_network *rnn)
+{
+    if (gp->inp.series_error == NULL) {
+        return;
+    }
+    double mean = 0;
+    for (int i = 0; i < rnn->series_num; i++) {
+        mean += gp->inp.series_error[i];
+    }
+    mean /= rnn->series_num;
+    const double threshold = gp->mp.selective_backprop_threshold * mean;
+    for (int i = 0; i < rnn->series_num; i++) {
+        const double error = gp->inp.series_error[i];
+        rnn->rnn_s[i].reuse_delta = (error >= 0 && error < threshold &&
+                epoch - gp->inp.series_epoch[i] <
+                gp->mp.selective_backprop_interval &&
+                gp->inp.parameter_drift - gp->inp.series_drift[i] <
+                gp->mp.selective_backprop_drift);
+    }
+}
+
+
+static void update_series_error (
+        long epoch,
+        struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn)
+{
+    if (gp->inp.series_error == NULL) {
+        return;
+    }
+    for (int i = 0; i < rnn->series_num; i++) {
+        const struct rnn_state *rnn_s = rnn->rnn_s + i;
+        if (rnn_s->reuse_delta) {
+            continue;
+        }
+        double error = (gp->inp.stream != NULL) ? gp->inp.stream->error[i] :
+            rnn_get_error(rnn_s);
+        error /= rnn_s->length;
+        if (gp->inp.series_error[i] >= 0) {
+            error = SERIES_ERROR_DECAY * gp->inp.series_error[i] +
+                (1 - SERIES_ERROR_DECAY) * error;
+        }
+        gp->inp.series_error[i] = error;
+        gp->inp.series_epoch[i] = epoch;
+        gp->inp.series_drift[i] = gp->inp.parameter_drift;
+    }
+}
+
+
+/*
+ * This function adds the change of the weights and the thresholds in the
+ * last epoch, relative to their norm, to parameter_drift, which bounds the
+ * staleness of reused gradients.
+ */
+static void update_parameter_drift (
+        struct general_parameters *gp,
+        const struct rnn_optimizer *optimizer)
+{
+    if (gp->inp.series_error == NULL) {
+        return;
+    }
+    double change = 0, norm = 0;
+    for (int i = 0; i < optimizer->group_offset[2]; i++) {
+        const double x = *optimizer->param[i];
+        const double d = x - gp->inp.last_parameter[i];
+        change += d * d;
+        norm += gp->inp.last_parameter[i] * gp->inp.last_parameter[i];
+        gp->inp.last_parameter[i] = x;
+    }
+    gp->inp.parameter_drift += (norm > 0) ? sqrt(change / norm) :
+        sqrt(change);
+}
+
+
 static void init_training_main (
         struct general_parameters *gp,
         const struct target_reader *t_reader,
         struct recurrent_neural_network *rnn,
+        struct rnn_optimizer *optimizer,
+        struct rnn_stream *stream,
         struct output_files *fp_list)
 {
     init_genrand(gp->mp.seed);
@@ -90,6 +291,13 @@ static void init_training_main (
     }
 
     set_parameters_to_recurrent_neural_network(gp, rnn);
+    init_optimizer(gp, rnn, optimizer);
+    if (gp->mp.use_streaming) {
+        init_rnn_stream(stream, rnn);
+        stream->release_target = 1;
+        gp->inp.stream = stream;
+    }
+    init_series_error(gp, rnn, optimizer);
 
     if (!has_load_file || t_reader->num > 0) {
         init_output_files(gp, rnn, fp_list, "w");
@@ -99,15 +307,62 @@ static void init_training_main (
 }
 
 
-static void fini_training_main (
+/*
+ * This function saves a snapshot of the model every checkpoint_interval epochs
+ * or checkpoint_time minutes (see checkpoint.h). A checkpoint is postponed
+ * while the previous one is still being written.
+ */
+static void checkpoint_rnn (
+        long epoch,
         const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer,
+        struct checkpoint *cp)
+{
+    if (strlen(gp->iop.save_filename) == 0) {
+        return;
+    }
+    time_t now = time(NULL);
+    int due = 0;
+    if (gp->iop.checkpoint_interval > 0 &&
+            epoch - cp->epoch >= gp->iop.checkpoint_interval) {
+        due = 1;
+    }
+    if (gp->iop.checkpoint_time > 0 &&
+            difftime(now, cp->time) >= 60 * gp->iop.checkpoint_time) {
+        due = 1;
+    }
+    if (!due || wait_checkpoint(cp, 0)) {
+        return;
+    }
+    start_checkpoint(cp, epoch, rnn, optimizer, gp->mp.delay_length,
+            gp->inp.adapt_lr, epoch + 1);
+}
+
+
+static void fini_training_main (
+        struct general_parameters *gp,
         struct recurrent_neural_network *rnn,
-        struct output_files *fp_list)
+        struct rnn_optimizer *optimizer,
+        struct rnn_stream *stream,
+        struct output_files *fp_list,
+        struct checkpoint *cp)
 {
+    free_checkpoint(cp);
     if (strlen(gp->iop.save_filename) > 0) {
-        save_rnn(gp, rnn);
+        save_rnn(gp, rnn, optimizer);
+    }
+    free_rnn_optimizer(optimizer);
+    if (gp->inp.stream != NULL) {
+        free_rnn_stream(stream);
+        gp->inp.stream = NULL;
     }
     free_rnn(rnn);
+    FREE(gp->inp.chunk_link);
+    FREE(gp->inp.series_error);
+    FREE(gp->inp.series_epoch);
+    FREE(gp->inp.series_drift);
+    FREE(gp->inp.last_parameter);
     free_output_files(fp_list);
 }
 
@@ -117,7 +372,10 @@ void training_main (
         const struct target_reader *t_reader)
 {
     struct recurrent_neural_network rnn;
+    struct rnn_optimizer optimizer;
+    struct rnn_stream stream;
     struct output_files fp_list;
+    struct checkpoint cp;
 
     sigset_t sigblock;
     sigemptyset(&sigblock);
@@ -134,24 +392,25 @@ void training_main (
         print_error_msg();
     }
 
-    init_training_main(gp, t_reader, &rnn, &fp_list);
+    init_training_main(gp, t_reader, &rnn, &optimizer, &stream, &fp_list);
+    init_checkpoint(&cp, gp->iop.save_filename, gp->inp.init_epoch - 1);
 
     if (strlen(gp->iop.load_filename) == 0 || t_reader->num > 0) {
         print_training_main_begin(gp, &rnn, &fp_list);
     }
 
     for (long epoch = gp->inp.init_epoch; epoch <= gp->mp.epoch_size; epoch++) {
-        if (!gp->mp.use_adaptive_lr) {
-            rnn_learn_s(&rnn, gp->mp.rho, gp->mp.momentum);
+        select_series(epoch, gp, &rnn);
+        if (gp->mp.optimizer != MOMENTUM_OPTIMIZER) {
+            rnn_learn_with_optimizer(&optimizer, gp->mp.rho);
+        } else if (gp->mp.batch_size > 0) {
+            learn_with_mini_batch(epoch, gp, &rnn);
         } else {
-#ifdef ENABLE_ADAPTIVE_LEARNING_RATE
-            gp->inp.adapt_lr = rnn_learn_s_with_adapt_lr(&rnn, gp->inp.adapt_lr,
-                    gp->mp.rho, gp->mp.momentum);
-#else
-            print_error_msg("option `use_adaptive_lr' is not supported");
-            exit(EXIT_FAILURE);
-#endif
+            learn_rnn(gp, &rnn);
         }
+        update_series_error(epoch, gp, &rnn);
+        update_parameter_drift(gp, &optimizer);
+        synchronize_chunks(gp, &rnn);
         if (gp->iop.verbose) {
             printf("epoch = %ld\n", epoch);
             fflush(stdout);
@@ -162,9 +421,12 @@ void training_main (
             gp->mp.epoch_size = epoch;
         }
         sigprocmask(SIG_UNBLOCK, &sigblock, NULL);
+        if (epoch < gp->mp.epoch_size) {
+            checkpoint_rnn(epoch, gp, &rnn, &optimizer, &cp);
+        }
     }
 
-    fini_training_main(gp, &rnn, &fp_list);
+    fini_training_main(gp, &rnn, &optimizer, &stream, &fp_list, &cp);
 }
 
 
@@ -235,47 +497,199 @@ static void set_parameters_to_recurrent_neural_network (
 }
 
 
-static void init_rnn (
+/*
+ * This function divides the target time series into the series of rnn, and
+ * returns the number of them. If length != NULL, the length of each series
+ * of rnn, the index of the target time series and the beginning of the
+ * series in it are stored in length, index and begin, and the links between
+ * the chunks are stored in chunk_link. Hence the arrays can be allocated at
+ * once by calling this function twice.
+ */
+static int divide_target (
         const struct general_parameters *gp,
         const struct target_reader *t_reader,
-        struct recurrent_neural_network *rnn)
+        int offset,
+        int *length,
+        int *index,
+        int *begin,
+        struct chunk_link *chunk_link)
 {
-    init_recurrent_neural_network(rnn, t_reader->dimension, gp->mp.c_state_size,
-            t_reader->dimension, gp->mp.rep_init_size);
+    const int chunk_length = gp->mp.chunk_length;
+    const int warmup_length = gp->mp.chunk_warmup_length;
+    int num = 0;
     for (int i = 0; i < t_reader->num; i++) {
         if (t_reader->t_list[i].length <= gp->mp.delay_length) {
             print_error_msg("length of target time series must be greater "
                     "than time delay.");
             exit(EXIT_FAILURE);
         }
-        rnn_add_target(rnn, t_reader->t_list[i].length - gp->mp.delay_length,
-                (const double* const*)t_reader->t_list[i].target,
-                (const double* const*)t_reader->t_list[i].target +
-                gp->mp.delay_length);
+        const int t_length = t_reader->t_list[i].length - gp->mp.delay_length;
+        int prev = -1, prev_begin = 0;
+        for (int end = 0; end < t_length; num++) {
+            int b = (end == 0 || chunk_length <= 0) ? 0 : end - warmup_length;
+            end = (chunk_length <= 0) ? t_length : end + chunk_length;
+            if (end > t_length) {
+                end = t_length;
+            }
+            if (length == NULL) {
+                continue;
+            }
+            length[num] = end - b;
+            index[num] = i;
+            begin[num] = b;
+            if (chunk_link != NULL) {
+                chunk_link[num].prev = prev;
+                chunk_link[num].n = b - 1 - prev_begin;
+                prev = offset + num;
+                prev_begin = b;
+            }
+        }
     }
+    return num;
 }
 
+/*
+ * This function adds the target time series to rnn.
+ * If gp->mp.chunk_length > 0, each time series is divided into chunks, and
+ * the link between consecutive chunks is recorded in gp->inp.chunk_link.
+ * The streamed series refer to the contiguous rows of the targets, so that
+ * the row pointers of the targets are not needed.
+ */
+static void add_target_to_rnn (
+        struct general_parameters *gp,
+        const struct target_reader *t_reader,
+        struct recurrent_neural_network *rnn)
+{
+    const int offset = rnn->series_num;
+    const int num = divide_target(gp, t_reader, offset, NULL, NULL, NULL,
+            NULL);
+    const int delay_length = gp->mp.delay_length;
+    int *length, *index, *begin;
+    struct chunk_link *chunk_link = NULL;
+    MALLOC(length, num);
+    MALLOC(index, num);
+    MALLOC(begin, num);
+    if (gp->mp.chunk_length > 0) {
+        REALLOC(gp->inp.chunk_link, offset + num);
+        chunk_link = gp->inp.chunk_link + offset;
+    }
+    divide_target(gp, t_reader, offset, length, index, begin, chunk_link);
+    if (gp->mp.use_streaming) {
+        const size_t dimension = t_reader->dimension;
+        const double **input, **target;
+        MALLOC(input, num);
+        MALLOC(target, num);
+        for (int i = 0; i < num; i++) {
+            const double *data = t_reader->t_list[index[i]].data;
+            input[i] = data + begin[i] * dimension;
+            target[i] = data + (begin[i] + delay_length) * dimension;
+        }
+        rnn_add_streamed_targets(rnn, num, length, input, target);
+        FREE(input);
+        FREE(target);
+    } else {
+        const double* const* *input;
+        const double* const* *target;
+        MALLOC(input, num);
+        MALLOC(target, num);
+        for (int i = 0; i < num; i++) {
+            const double* const* t = (const double* const*)
+                t_reader->t_list[index[i]].target;
+            input[i] = t + begin[i];
+            target[i] = t + begin[i] + delay_length;
+        }
+        rnn_add_target_views(rnn, num, length, input, target);
+        FREE(input);
+        FREE(target);
+    }
+    FREE(length);
+    FREE(index);
+    FREE(begin);
+}
 
-static void save_rnn (
+
+/*
+ * This function re-synchronizes the initial state of each chunk with the
+ * internal state of the preceding chunk.
+ */
+static void synchronize_chunks (
         const struct general_parameters *gp,
-        const struct recurrent_neural_network *rnn)
+        struct recurrent_neural_network *rnn)
+{
+    if (gp->inp.chunk_link == NULL) {
+        return;
+    }
+    for (int i = 0; i < rnn->series_num; i++) {
+        const struct chunk_link *link = gp->inp.chunk_link + i;
+        if (link->prev >= 0) {
+            rnn_connect_init_c_inter_state(rnn->rnn_s + i,
+                    rnn->rnn_s + link->prev, link->n);
+        }
+    }
+}
+
+
+static void init_rnn (
+        struct general_parameters *gp,
+        const struct target_reader *t_reader,
+        struct recurrent_neural_network *rnn)
+{
+    init_recurrent_neural_network(rnn, t_reader->dimension, gp->mp.c_state_size,
+            t_reader->dimension, gp->mp.rep_init_size);
+    add_target_to_rnn(gp, t_reader, rnn);
+}
+
+
+/*
+ * This function writes the model to a temporary file, and renames it to
+ * save_filename, so that the previous file is replaced atomically. It returns
+ * 0 on success, and -1 on failure.
+ */
+static int write_rnn (
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer,
+        long init_epoch)
 {
     FILE *fp;
+    char *tmp_filename;
+    MALLOC(tmp_filename, strlen(gp->iop.save_filename) + 5);
+    sprintf(tmp_filename, "%s.tmp", gp->iop.save_filename);
+    if ((fp = fopen(tmp_filename, "wb")) == NULL) {
+        print_error_msg("cannot open %s", tmp_filename);
+        FREE(tmp_filename);
+        return -1;
+    }
+    fwrite_rnn_snapshot(rnn, optimizer, gp->mp.delay_length,
+            gp->inp.adapt_lr, init_epoch, fp);
+    int error = (fclose(fp) != 0);
+    if (!error && rename(tmp_filename, gp->iop.save_filename) != 0) {
+        print_error_msg("cannot rename %s to %s", tmp_filename,
+                gp->iop.save_filename);
+        error = 1;
+    }
+    if (error) {
+        remove(tmp_filename);
+    }
+    FREE(tmp_filename);
+    return error ? -1 : 0;
+}
+
+
+static void save_rnn (
+        const struct general_parameters *gp,
+        const struct recurrent_neural_network *rnn,
+        const struct rnn_optimizer *optimizer)
+{
     long init_epoch;
     if (gp->mp.epoch_size >= 0) {
         init_epoch = gp->mp.epoch_size + 1;
     } else {
         init_epoch = 0;
     }
-    if ((fp = fopen(gp->iop.save_filename, "wb")) == NULL) {
-        print_error_msg("cannot open %s", gp->iop.save_filename);
+    if (write_rnn(gp, rnn, optimizer, init_epoch) != 0) {
         exit(EXIT_FAILURE);
     }
-    FWRITE(&gp->mp.delay_length, 1, fp);
-    fwrite_recurrent_neural_network(rnn, fp);
-    FWRITE(&gp->inp.adapt_lr, 1, fp);
-    FWRITE(&init_epoch, 1, fp);
-    fclose(fp);
 }
 
 
@@ -293,18 +707,9 @@ static void reset_target_of_rnn (
                 rnn->rnn_p.out_state_size);
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < t_reader->num; i++) {
-        if (t_reader->t_list[i].length <= gp->mp.delay_length) {
-            print_error_msg("length of target time series must be greater "
-                    "than time delay.");
-            exit(EXIT_FAILURE);
-        }
-        rnn_add_target(rnn, t_reader->t_list[i].length - gp->mp.delay_length,
-                (const double* const*)t_reader->t_list[i].target,
-                (const double* const*)t_reader->t_list[i].target +
-                gp->mp.delay_length);
-    }
+    add_target_to_rnn(gp, t_reader, rnn);
     gp->inp.init_epoch = 0;
+    gp->inp.optimizer_offset = -1;
 }
 
 
@@ -313,22 +718,75 @@ static void load_rnn (
         const struct target_reader *t_reader,
         struct recurrent_neural_network *rnn)
 {
-    FILE *fp;
-    if ((fp= fopen(gp->iop.load_filename, "rb")) == NULL) {
-        print_error_msg("cannot open %s", gp->iop.load_filename);
-        exit(EXIT_FAILURE);
+    if (is_rnn_file(gp->iop.load_filename)) {
+        struct rnn_file file;
+        if (map_rnn_file(&file, gp->iop.load_filename) != 0) {
+            exit(EXIT_FAILURE);
+        }
+        if (t_reader->num == 0 && rnn_file_get_section(&file,
+                    RNN_FILE_TEACH_STATE, NULL) == NULL) {
+            print_error_msg("%s is exported for inference, and has no "
+                    "target", gp->iop.load_filename);
+            exit(EXIT_FAILURE);
+        }
+        gp->mp.delay_length = file.header->delay_length;
+        rnn_file_read_recurrent_neural_network(&file, rnn);
+        gp->inp.adapt_lr = file.header->adapt_lr;
+        gp->inp.init_epoch = file.header->init_epoch;
+        gp->inp.optimizer_offset = rnn_file_section_offset(&file,
+                RNN_FILE_OPTIMIZER);
+        unmap_rnn_file(&file);
+    } else {
+        FILE *fp;
+        if ((fp= fopen(gp->iop.load_filename, "rb")) == NULL) {
+            print_error_msg("cannot open %s", gp->iop.load_filename);
+            exit(EXIT_FAILURE);
+        }
+        FREAD(&gp->mp.delay_length, 1, fp);
+        fread_recurrent_neural_network(rnn, fp);
+        FREAD(&gp->inp.adapt_lr, 1, fp);
+        FREAD(&gp->inp.init_epoch, 1, fp);
+        gp->inp.optimizer_offset = ftell(fp);
+        fclose(fp);
     }
-    FREAD(&gp->mp.delay_length, 1, fp);
-    fread_recurrent_neural_network(rnn, fp);
-    FREAD(&gp->inp.adapt_lr, 1, fp);
-    FREAD(&gp->inp.init_epoch, 1, fp);
-    fclose(fp);
     if (t_reader->num > 0) {
         reset_target_of_rnn(gp, t_reader, rnn);
     }
 }
 
 
+/*
+ * This function initializes the optimizer of learning. If the model is loaded
+ * to continue learning, the state of the optimizer saved after the model is
+ * restored (files without the state are accepted).
+ */
+static void init_optimizer (
+        const struct general_parameters *gp,
+        struct recurrent_neural_network *rnn,
+        struct rnn_optimizer *optimizer)
+{
+    init_rnn_optimizer(optimizer, rnn, (enum rnn_optimizer_t)
+            gp->mp.optimizer, gp->mp.lbfgs_memory);
+    optimizer->momentum = gp->mp.momentum;
+    optimizer->beta1 = gp->mp.adam_beta1;
+    optimizer->beta2 = gp->mp.adam_beta2;
+    optimizer->epsilon = gp->mp.adam_epsilon;
+    if (gp->inp.optimizer_offset >= 0) {
+        FILE *fp;
+        if ((fp = fopen(gp->iop.load_filename, "rb")) == NULL) {
+            print_error_msg("cannot open %s", gp->iop.load_filename);
+            exit(EXIT_FAILURE);
+        }
+        if (fseek(fp, gp->inp.optimizer_offset, SEEK_SET) != 0) {
+            print_error_msg("`fseek' failed");
+            exit(EXIT_FAILURE);
+        }
+        fread_rnn_optimizer(optimizer, fp);
+        fclose(fp);
+    }
+}
+
+
 static void free_rnn (struct recurrent_neural_network *rnn)
 {
     free_recurrent_neural_network(rnn);
@@ -0,0 +1,262 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#ifdef ENABLE_MTRACE
+#include <mcheck.h>
+#endif
+
+#include "utils.h"
+#include "rnn_log.h"
+
+
+#define TO_STRING_I(s) #s
+#define TO_STRING(s) TO_STRING_I(s)
+
+#ifndef PRECISION
+#define PRECISION 6
+#endif
+
+static void display_help (void)
+{
+    puts("rnn-query-log  - a program to extract records from binary log "
+            "files of rnn-learn");
+    puts("");
+    puts("Usage: rnn-query-log [-e epochs] [-c columns] [-p precision] [-n] "
+            "file ...");
+    puts("Usage: rnn-query-log [-v] [-h]");
+    puts("");
+    puts("Available options are:");
+    puts("-e epochs");
+    puts("    Prints the records of `epochs', which is an epoch or a range "
+            "of epochs `begin:end' (both ends are included, and can be "
+            "omitted). By default, all the records are printed.");
+    puts("-c columns");
+    puts("    Prints the columns of each row in `columns', which is a comma "
+            "separated list of indices or ranges counted from 0 (e.g. "
+            "`0-2,5'). By default, all the columns are printed.");
+    puts("-p precision");
+    puts("    Number of significant digits of values. Default is "
+            TO_STRING(PRECISION) ".");
+    puts("-n");
+    puts("    Omits the comment lines.");
+    puts("-v");
+    puts("    Prints the version information and exit.");
+    puts("-h");
+    puts("    Prints this help and exit.");
+    puts("");
+    puts("Program execution:");
+    puts("rnn-query-log prints the comment lines of each file, followed by "
+            "the records. A record which has one row is printed as a line "
+            "beginning with the epoch. Otherwise, each row of the record is "
+            "printed as a line beginning with the epoch and the index of the "
+            "row, and records are separated by a blank line. The records are "
+            "found by binary search without reading the whole file.");
+}
+
+static void display_version (void)
+{
+    printf("rnn-query-log version %s\n", TO_STRING(VERSION));
+}
+
+
+static void parse_epochs (
+        const char *str,
+        long *begin,
+        long *end)
+{
+    char *p;
+    const char *colon = strchr(str, ':');
+    *begin = LONG_MIN;
+    *end = LONG_MAX;
+    if (colon == NULL) {
+        *begin = *end = strtol(str, &p, 0);
+        if (p == str || *p != '\0') goto error;
+        return;
+    }
+    if (colon != str) {
+        *begin = strtol(str, &p, 0);
+        if (p != colon) goto error;
+    }
+    if (*(colon + 1) != '\0') {
+        *end = strtol(colon + 1, &p, 0);
+        if (*p != '\0') goto error;
+    }
+    return;
+error:
+    print_error_msg("invalid epochs: %s", str);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * This function sets selected[j] to 1 if the j-th column is in str, and to 0
+ * otherwise.
+ */
+static void parse_columns (
+        const char *str,
+        int col_num,
+        int *selected)
+{
+    for (int j = 0; j < col_num; j++) {
+        selected[j] = (str == NULL);
+    }
+    if (str == NULL) {
+        return;
+    }
+    const char *p = str;
+    while (*p != '\0') {
+        char *q;
+        long first = strtol(p, &q, 10), last;
+        if (q == p) goto error;
+        if (*q == '-') {
+            p = q + 1;
+            last = strtol(p, &q, 10);
+            if (q == p) goto error;
+        } else {
+            last = first;
+        }
+        for (long j = first; j <= last; j++) {
+            if (j >= 0 && j < col_num) {
+                selected[j] = 1;
+            }
+        }
+        if (*q == ',') {
+            q++;
+        } else if (*q != '\0') {
+            goto error;
+        }
+        p = q;
+    }
+    return;
+error:
+    print_error_msg("invalid columns: %s", str);
+    exit(EXIT_FAILURE);
+}
+
+
+static void print_record (
+        const struct rnn_log *log,
+        long index,
+        const int *selected,
+        int precision)
+{
+    long epoch = rnn_log_epoch(log, index);
+    const double *values = rnn_log_values(log, index);
+    for (int i = 0; i < log->row_num; i++) {
+        if (log->row_num == 1) {
+            printf("%ld", epoch);
+        } else {
+            printf("%ld\t%d", epoch, i);
+        }
+        for (int j = 0; j < log->col_num; j++) {
+            if (selected[j]) {
+                printf("\t%.*g", precision, values[i * log->col_num + j]);
+            }
+        }
+        printf("\n");
+    }
+    if (log->row_num > 1) {
+        printf("\n");
+    }
+}
+
+static void query_log (
+        const char *filename,
+        long begin,
+        long end,
+        const char *columns,
+        int precision,
+        int print_comment)
+{
+    struct rnn_log log;
+    if (map_rnn_log(&log, filename) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (print_comment) {
+        fwrite(log.text, 1, log.text_size, stdout);
+        if (log.id >= 0) {
+            printf("# target:%d\n", log.id);
+        }
+    }
+    int selected[log.col_num > 0 ? log.col_num : 1];
+    parse_columns(columns, log.col_num, selected);
+    for (long k = rnn_log_find(&log, begin); k < log.record_num &&
+            rnn_log_epoch(&log, k) <= end; k++) {
+        print_record(&log, k, selected, precision);
+    }
+    unmap_rnn_log(&log);
+}
+
+
+int main (int argc, char *argv[])
+{
+#ifdef ENABLE_MTRACE
+    mtrace();
+#endif
+    long begin = LONG_MIN, end = LONG_MAX;
+    const char *columns = NULL;
+    int precision = PRECISION;
+    int print_comment = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "e:c:p:nvh")) != -1) {
+        switch (opt) {
+            case 'e':
+                parse_epochs(optarg, &begin, &end);
+                break;
+            case 'c':
+                columns = optarg;
+                break;
+            case 'p':
+                precision = atoi(optarg);
+                break;
+            case 'n':
+                print_comment = 0;
+                break;
+            case 'v':
+                display_version();
+                exit(EXIT_SUCCESS);
+            case 'h':
+                display_help();
+                exit(EXIT_SUCCESS);
+            default: /* '?' */
+                fprintf(stderr, "Try `rnn-query-log -h' for more "
+                        "information.\n");
+                exit(EXIT_SUCCESS);
+        }
+    }
+    if (argc == optind) {
+        fprintf(stderr, "%s: no input files\n", argv[0]);
+        fprintf(stderr, "Try `rnn-query-log -h' for more information.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = optind; i < argc; i++) {
+        query_log(argv[i], begin, end, columns, precision, print_comment);
+    }
+
+#ifdef ENABLE_MTRACE
+    muntrace();
+#endif
+    return EXIT_SUCCESS;
+}
@@ -35,9 +35,16 @@
 #include "test_entropy.h"
 #include "test_solver.h"
 #include "test_rnn_lyapunov.h"
+#include "test_rnn_optimizer.h"
+#include "test_rnn_stream.h"
 #include "test_target.h"
 #include "test_parse.h"
 #include "test_rnn_runner.h"
+#include "test_rnn_file.h"
+#include "test_log_writer.h"
+#include "test_analysis_pool.h"
+#include "test_checkpoint.h"
+#include "test_rnn_runner2.h"
 #include "utils.h"
 
 
@@ -59,9 +66,16 @@ int main (void)
     test_entropy();
     test_solver();
     test_rnn_lyapunov();
+    test_rnn_optimizer();
+    test_rnn_stream();
     test_target();
     test_parse();
     test_rnn_runner();
+    test_rnn_file();
+    test_log_writer();
+    test_analysis_pool();
+    test_checkpoint();
+    test_rnn_runner2();
 
 #ifdef ENABLE_MTRACE
     muntrace();
@@ -52,5 +52,18 @@
                 "vector sequences %s and %s differ\n", #x, #y); \
     } while(0)
 
+#define assert_equal_file(fp1,fp2) \
+    do { \
+        long size1, size2; \
+        int iseq=1; \
+        fseek(fp1,0L,SEEK_END); size1=ftell(fp1); rewind(fp1); \
+        fseek(fp2,0L,SEEK_END); size2=ftell(fp2); rewind(fp2); \
+        if(size1!=size2){iseq=0;} \
+        else{for(long n=0;n<size1;n++){ \
+            if(fgetc(fp1)!=fgetc(fp2)){iseq=0;break;}}} \
+        mu_assert_with_msg(iseq, "files %s (%ld bytes) and %s (%ld bytes) " \
+                "differ\n", #fp1, size1, #fp2, size2); \
+    } while(0)
+
 #endif
 
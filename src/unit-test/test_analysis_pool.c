@@ -0,0 +1,178 @@
+/*
+    Copyright (c) 2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define TEST_CODE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "minunit.h"
+#include "my_assert.h"
+#include "utils.h"
+#include "rnn.h"
+#include "log_writer.h"
+#include "analysis_pool.h"
+
+
+void test_rnn_state_setup (
+        struct recurrent_neural_network *rnn,
+        int target_num,
+        int *target_length);
+
+
+/* test functions */
+
+static FILE* open_tmpfile (void)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    return fp;
+}
+
+static void print_closed_loop_error (
+        long epoch,
+        struct recurrent_neural_network *rnn,
+        struct log_writer *writer,
+        void *arg)
+{
+    FILE *fp = arg;
+    double error[rnn->series_num];
+    rnn_forward_dynamics_in_closed_loop_forall(rnn, 1);
+    for (int i = 0; i < rnn->series_num; i++) {
+        error[i] = rnn_get_error(rnn->rnn_s + i);
+    }
+    log_begin(writer, fp, epoch);
+    log_printf(writer, "%ld", epoch);
+    log_print_doubles(writer, "\t%.17g", error, rnn->series_num);
+    log_print_doubles(writer, "\t%.17g", rnn->rnn_s[0].out_state[2],
+            rnn->rnn_p.out_state_size);
+    log_printf(writer, "\n");
+    log_end(writer, 0);
+}
+
+/*
+ * The model is changed at each epoch, and analyses of the snapshots are
+ * compared with those computed in place.
+ */
+static void test_submit_analysis_with_args (
+        struct recurrent_neural_network *rnn,
+        int thread_num,
+        int queue_size)
+{
+    FILE *fp = open_tmpfile();
+    FILE *fp_expected = open_tmpfile();
+    struct recurrent_neural_network rnn2;
+    FILE *tmp = open_tmpfile();
+    fwrite_recurrent_neural_network(rnn, tmp);
+    rewind(tmp);
+    fread_recurrent_neural_network(&rnn2, tmp);
+    fclose(tmp);
+
+    struct analysis_pool pool;
+    struct log_writer writer;
+    init_analysis_pool(&pool, &rnn2, 1, thread_num, queue_size, 0,
+            print_closed_loop_error, fp);
+    init_log_writer(&writer, 0, 0, 1);
+    for (long epoch = 0; epoch < 40; epoch++) {
+        rnn2.rnn_p.weight_cc[epoch % rnn2.rnn_p.c_state_size][0] += 0.1;
+        rnn2.rnn_p.threshold_o[0] -= 0.05;
+        rnn2.rnn_s[epoch % rnn2.series_num].init_c_inter_state[0] += 0.2;
+        rnn2.rnn_s[epoch % rnn2.series_num].init_c_state[0] =
+            tanh(rnn2.rnn_s[epoch % rnn2.series_num].init_c_inter_state[0]);
+        submit_analysis(&pool, epoch, &rnn2);
+        print_closed_loop_error(epoch, &rnn2, &writer, fp_expected);
+    }
+    free_analysis_pool(&pool);
+    free_log_writer(&writer);
+
+    assert_equal_file(fp_expected, fp);
+    fclose(fp);
+    fclose(fp_expected);
+    free_recurrent_neural_network(&rnn2);
+}
+
+/*
+ * If the initial states are not copied, the snapshots keep those of the
+ * template while the parameters follow the model.
+ */
+static void test_submit_analysis_without_initial_states (
+        struct recurrent_neural_network *rnn,
+        int thread_num,
+        int queue_size)
+{
+    FILE *fp = open_tmpfile();
+    FILE *fp_expected = open_tmpfile();
+    struct recurrent_neural_network rnn2, rnn3;
+    FILE *tmp = open_tmpfile();
+    fwrite_recurrent_neural_network(rnn, tmp);
+    rewind(tmp);
+    fread_recurrent_neural_network(&rnn2, tmp);
+    rewind(tmp);
+    fread_recurrent_neural_network(&rnn3, tmp);
+    fclose(tmp);
+
+    struct analysis_pool pool;
+    struct log_writer writer;
+    init_analysis_pool(&pool, &rnn3, 0, thread_num, queue_size, 0,
+            print_closed_loop_error, fp);
+    init_log_writer(&writer, 0, 0, 1);
+    for (long epoch = 0; epoch < 20; epoch++) {
+        rnn2.rnn_p.weight_cc[epoch % rnn2.rnn_p.c_state_size][0] += 0.1;
+        rnn2.rnn_s[epoch % rnn2.series_num].init_c_inter_state[0] += 0.2;
+        rnn2.rnn_s[epoch % rnn2.series_num].init_c_state[0] =
+            tanh(rnn2.rnn_s[epoch % rnn2.series_num].init_c_inter_state[0]);
+        submit_analysis(&pool, epoch, &rnn2);
+        rnn_copy_parameters(&rnn3.rnn_p, &rnn2.rnn_p);
+        print_closed_loop_error(epoch, &rnn3, &writer, fp_expected);
+    }
+    free_analysis_pool(&pool);
+    free_log_writer(&writer);
+
+    assert_equal_file(fp_expected, fp);
+    fclose(fp);
+    fclose(fp_expected);
+    free_recurrent_neural_network(&rnn2);
+    free_recurrent_neural_network(&rnn3);
+}
+
+static void test_submit_analysis (struct recurrent_neural_network *rnn)
+{
+    test_submit_analysis_with_args(rnn, 0, 0);
+    test_submit_analysis_with_args(rnn, 1, 0);
+    test_submit_analysis_with_args(rnn, 1, 2);
+    test_submit_analysis_with_args(rnn, 3, 1);
+    test_submit_analysis_without_initial_states(rnn, 0, 0);
+    test_submit_analysis_without_initial_states(rnn, 2, 1);
+}
+
+
+void test_analysis_pool (void)
+{
+    struct recurrent_neural_network rnn;
+    init_genrand(3141L);
+    init_recurrent_neural_network(&rnn, 3, 10, 3, 2);
+    test_rnn_state_setup(&rnn, 3, (int[]){30,50,20});
+    mu_run_test_with_args(test_submit_analysis, &rnn);
+    free_recurrent_neural_network(&rnn);
+}
@@ -0,0 +1,149 @@
+/*
+    Copyright (c) 2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define TEST_CODE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "minunit.h"
+#include "my_assert.h"
+#include "utils.h"
+#include "rnn.h"
+#include "rnn_file.h"
+#include "rnn_optimizer.h"
+#include "checkpoint.h"
+
+
+void assert_equal_rnn_p (
+        const struct rnn_parameters *rnn_p,
+        const struct rnn_parameters *rnn_p2);
+
+void test_rnn_state_setup (
+        struct recurrent_neural_network *rnn,
+        int target_num,
+        int *target_length);
+
+
+/* reads the whole contents of fp */
+static char* read_contents (
+        FILE *fp,
+        long *size)
+{
+    char *buf;
+    fseek(fp, 0L, SEEK_END);
+    *size = ftell(fp);
+    MALLOC(buf, *size);
+    rewind(fp);
+    if (fread(buf, 1, *size, fp) != (size_t)*size) {
+        print_error_msg("`fread' failed");
+        exit(EXIT_FAILURE);
+    }
+    return buf;
+}
+
+
+static void test_start_checkpoint (struct recurrent_neural_network *rnn)
+{
+    char filename[64];
+    snprintf(filename, sizeof(filename), "rnn-unit-test-%ld.dat",
+            (long)getpid());
+    struct rnn_optimizer optimizer;
+    init_rnn_optimizer(&optimizer, rnn, ADAM_OPTIMIZER, 1);
+
+    // synchronous save of the model at the checkpoint
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    fwrite_rnn_snapshot(rnn, &optimizer, 2, 0.5, 11, fp);
+    fflush(fp);
+
+    struct checkpoint cp;
+    init_checkpoint(&cp, filename, 0);
+    assert_equal_string(".", cp.dirname);
+    assert_equal_int(0, start_checkpoint(&cp, 10, rnn, &optimizer, 2, 0.5,
+                11));
+    mu_assert(cp.pid > 0);
+    assert_equal_int(10, cp.epoch);
+    // the child writes its copy-on-write image of the model
+    const double weight = rnn->rnn_p.weight_cc[0][0];
+    rnn->rnn_p.weight_cc[0][0] += 1.0;
+    assert_equal_int(0, wait_checkpoint(&cp, 1));
+    assert_equal_int(-1, cp.pid);
+    rnn->rnn_p.weight_cc[0][0] = weight;
+    mu_assert(access(cp.tmp_filename, F_OK) == -1);
+
+    FILE *fp2 = fopen(filename, "rb");
+    mu_assert(fp2 != NULL);
+    if (fp2 != NULL) {
+        long size, size2;
+        char *buf = read_contents(fp, &size);
+        char *buf2 = read_contents(fp2, &size2);
+        assert_equal_memory(buf, size, buf2, size2);
+        FREE(buf);
+        FREE(buf2);
+        fclose(fp2);
+    }
+    fclose(fp);
+
+    // the renamed file is loaded as a model file
+    struct rnn_file file;
+    struct recurrent_neural_network rnn2;
+    assert_equal_int(0, map_rnn_file(&file, filename));
+    assert_equal_int(2, file.header->delay_length);
+    rnn_file_read_recurrent_neural_network(&file, &rnn2);
+    assert_equal_rnn_p(&rnn->rnn_p, &rnn2.rnn_p);
+    assert_equal_int(rnn->series_num, rnn2.series_num);
+    mu_assert(rnn_file_get_section(&file, RNN_FILE_OPTIMIZER, NULL) != NULL);
+    free_recurrent_neural_network(&rnn2);
+    unmap_rnn_file(&file);
+
+    free_checkpoint(&cp);
+    free_rnn_optimizer(&optimizer);
+    remove(filename);
+}
+
+/* the directory synchronized after the rename is that of the file */
+static void test_checkpoint_dirname (void)
+{
+    struct checkpoint cp;
+    init_checkpoint(&cp, "model/run1/rnn.dat", 0);
+    assert_equal_string("model/run1", cp.dirname);
+    assert_equal_string("model/run1/rnn.dat.tmp", cp.tmp_filename);
+    free_checkpoint(&cp);
+    init_checkpoint(&cp, "/rnn.dat", 0);
+    assert_equal_string("/", cp.dirname);
+    free_checkpoint(&cp);
+}
+
+
+void test_checkpoint (void)
+{
+    struct recurrent_neural_network rnn;
+    init_genrand(2718L);
+    init_recurrent_neural_network(&rnn, 3, 10, 3, 2);
+    test_rnn_state_setup(&rnn, 2, (int[]){30,40});
+    mu_run_test_with_args(test_start_checkpoint, &rnn);
+    mu_run_test(test_checkpoint_dirname);
+    free_recurrent_neural_network(&rnn);
+}
@@ -0,0 +1,369 @@
+/*
+    Copyright (c) 2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define TEST_CODE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "minunit.h"
+#include "my_assert.h"
+#include "utils.h"
+#include "log_writer.h"
+#include "rnn_log.h"
+#include "rnn_trajectory.h"
+
+
+/* test functions */
+
+static FILE* open_tmpfile (void)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    return fp;
+}
+
+static void test_write_log_records_with_args (int use_thread, int record_num)
+{
+    FILE *fp[2], *fp_expected[2];
+    double x[100];
+    int y[10];
+    for (int i = 0; i < 100; i++) {
+        x[i] = (genrand_real1() - 0.5) * pow(10, i % 20 - 5);
+    }
+    x[0] = 0;
+    x[1] = -0.0;
+    x[2] = 1e300;
+    for (int i = 0; i < 10; i++) {
+        y[i] = (int)((genrand_real2() - 0.5) * 2e9);
+    }
+    for (int i = 0; i < 2; i++) {
+        fp[i] = open_tmpfile();
+        fp_expected[i] = open_tmpfile();
+    }
+
+    struct log_writer writer;
+    init_log_writer(&writer, use_thread, 0, record_num);
+    for (long epoch = 0; epoch < 1000; epoch++) {
+        int k = epoch % 2;
+        log_begin(&writer, fp[k], epoch);
+        log_printf(&writer, "# epoch = %ld\n", epoch);
+        log_print_doubles(&writer, "\t%f", x, 100);
+        log_print_doubles(&writer, "\t%g", x, epoch % 100);
+        log_print_ints(&writer, "\t%d", y, 10);
+        log_printf(&writer, "\n");
+        log_end(&writer, k);
+
+        fprintf(fp_expected[k], "# epoch = %ld\n", epoch);
+        for (int i = 0; i < 100; i++) {
+            fprintf(fp_expected[k], "\t%f", x[i]);
+        }
+        for (int i = 0; i < epoch % 100; i++) {
+            fprintf(fp_expected[k], "\t%g", x[i]);
+        }
+        for (int i = 0; i < 10; i++) {
+            fprintf(fp_expected[k], "\t%d", y[i]);
+        }
+        fprintf(fp_expected[k], "\n");
+    }
+    free_log_writer(&writer);
+
+    for (int i = 0; i < 2; i++) {
+        assert_equal_file(fp_expected[i], fp[i]);
+        fclose(fp[i]);
+        fclose(fp_expected[i]);
+    }
+}
+
+static void test_write_log_records (void)
+{
+    test_write_log_records_with_args(0, 1);
+    test_write_log_records_with_args(1, 1);
+    test_write_log_records_with_args(1, 4);
+}
+
+static void test_hold_log_records (void)
+{
+    FILE *fp = open_tmpfile(), *fp_expected = open_tmpfile();
+    double x[10];
+    for (int i = 0; i < 10; i++) {
+        x[i] = genrand_real1() - 0.5;
+    }
+    struct log_writer writer;
+    init_log_writer(&writer, 0, 0, 1);
+    for (int k = 0; k < 2; k++) {
+        log_set_hold(&writer, 1);
+        for (long epoch = 0; epoch < 100; epoch++) {
+            log_begin(&writer, fp, epoch);
+            log_printf(&writer, "%ld", epoch);
+            log_print_doubles(&writer, "\t%f", x, epoch % 10);
+            log_printf(&writer, "\n");
+            log_end(&writer, 1);
+
+            fprintf(fp_expected, "%ld", epoch);
+            for (int i = 0; i < epoch % 10; i++) {
+                fprintf(fp_expected, "\t%f", x[i]);
+            }
+            fprintf(fp_expected, "\n");
+        }
+        long size = ftell(fp);
+        assert_equal_int(k == 0 ? 0 : ftell(fp_expected) / 2, size);
+        log_release(&writer);
+        log_set_hold(&writer, 0);
+    }
+    free_log_writer(&writer);
+    assert_equal_file(fp_expected, fp);
+    fclose(fp);
+    fclose(fp_expected);
+}
+
+static void test_submit_held_log_records (void)
+{
+    FILE *fp[2], *fp_expected[2];
+    double x[20];
+    for (int i = 0; i < 20; i++) {
+        x[i] = 0.37 * i - 3.1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fp[i] = open_tmpfile();
+        fp_expected[i] = open_tmpfile();
+    }
+    struct log_writer writer, held[2];
+    init_log_writer(&writer, 1, 0, 4);
+    for (int k = 0; k < 2; k++) {
+        init_log_writer(held + k, 0, 0, 1);
+        log_set_hold(held + k, 1);
+    }
+    for (long epoch = 0; epoch < 100; epoch++) {
+        for (int k = 0; k < 2; k++) {
+            log_begin(held + k, fp[k], epoch);
+            log_printf(held + k, "%ld", epoch);
+            log_print_doubles(held + k, "\t%f", x, (epoch + k) % 20);
+            log_printf(held + k, "\n");
+            log_end(held + k, 0);
+
+            fprintf(fp_expected[k], "%ld", epoch);
+            for (int i = 0; i < (epoch + k) % 20; i++) {
+                fprintf(fp_expected[k], "\t%f", x[i]);
+            }
+            fprintf(fp_expected[k], "\n");
+        }
+        if (epoch % 30 == 29) {
+            log_submit_held(&writer, held + epoch % 2);
+        }
+    }
+    for (int k = 0; k < 2; k++) {
+        log_submit_held(&writer, held + k);
+        assert_equal_int(0, held[k].count);
+        free_log_writer(held + k);
+    }
+    free_log_writer(&writer);
+    for (int i = 0; i < 2; i++) {
+        assert_equal_file(fp_expected[i], fp[i]);
+        fclose(fp[i]);
+        fclose(fp_expected[i]);
+    }
+}
+
+static void test_write_binary_log_records (void)
+{
+    char filename[64];
+    snprintf(filename, sizeof(filename), "rnn-unit-test-%ld.log",
+            (long)getpid());
+    const char *text = "# ERROR FILE\n# seed = 1\n";
+    const int row_num = 3, col_num = 5;
+    double x[100][row_num][col_num - 1];
+    int y[100][row_num];
+    for (int k = 0; k < 100; k++) {
+        for (int i = 0; i < row_num; i++) {
+            for (int j = 0; j < col_num - 1; j++) {
+                x[k][i][j] = genrand_real1() - 0.5;
+            }
+            y[k][i] = (int)((genrand_real2() - 0.5) * 2e9);
+        }
+    }
+
+    for (int use_thread = 0; use_thread <= 1; use_thread++) {
+        FILE *fp;
+        if ((fp = fopen(filename, "wb")) == NULL) {
+            print_error_msg("cannot open %s", filename);
+            exit(EXIT_FAILURE);
+        }
+        fwrite_rnn_log_header(7, row_num, col_num, text, strlen(text), fp);
+        struct log_writer writer;
+        init_log_writer(&writer, use_thread, 1, 4);
+        for (int k = 0; k < 100; k++) {
+            log_begin(&writer, fp, 2 * k);
+            log_printf(&writer, "%d", 2 * k);
+            for (int i = 0; i < row_num; i++) {
+                log_print_doubles(&writer, "\t%f", x[k][i], col_num - 1);
+                log_print_ints(&writer, "\t%d", &y[k][i], 1);
+                log_printf(&writer, "\n");
+            }
+            log_end(&writer, 0);
+        }
+        free_log_writer(&writer);
+        // an incomplete record
+        fwrite(x, sizeof(double), 3, fp);
+        fclose(fp);
+
+        mu_assert(is_rnn_log_file(filename));
+        struct rnn_log log;
+        int stat = map_rnn_log(&log, filename);
+        assert_equal_int(0, stat);
+        assert_equal_int(7, log.id);
+        assert_equal_int(row_num, log.row_num);
+        assert_equal_int(col_num, log.col_num);
+        assert_equal_int(strlen(text), log.text_size);
+        mu_assert(memcmp(text, log.text, log.text_size) == 0);
+        assert_equal_int(100, log.record_num);
+        for (int k = 0; k < 100; k++) {
+            assert_equal_int(2 * k, rnn_log_epoch(&log, k));
+            const double *values = rnn_log_values(&log, k);
+            for (int i = 0; i < row_num; i++) {
+                for (int j = 0; j < col_num - 1; j++) {
+                    mu_assert(values[i * col_num + j] == x[k][i][j]);
+                }
+                mu_assert(values[i * col_num + col_num - 1] == y[k][i]);
+            }
+        }
+        assert_equal_int(0, rnn_log_find(&log, -1));
+        assert_equal_int(0, rnn_log_find(&log, 0));
+        assert_equal_int(5, rnn_log_find(&log, 9));
+        assert_equal_int(5, rnn_log_find(&log, 10));
+        assert_equal_int(100, rnn_log_find(&log, 199));
+        unmap_rnn_log(&log);
+    }
+
+    FILE *fp;
+    if ((fp = fopen(filename, "w")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "# ERROR FILE\n");
+    fclose(fp);
+    mu_assert(!is_rnn_log_file(filename));
+    remove(filename);
+}
+
+
+static void test_write_trajectory_records (void)
+{
+    char filename[64];
+    snprintf(filename, sizeof(filename), "rnn-unit-test-%ld.log",
+            (long)getpid());
+    const char *text = "# STATE FILE\n# seed = 1\n";
+    const int series_num = 3, col_num = 5;
+    const int length[3] = {4, 0, 7};
+    double x[50][3][7][5];
+    for (int k = 0; k < 50; k++) {
+        for (int i = 0; i < series_num; i++) {
+            for (int n = 0; n < length[i]; n++) {
+                for (int j = 0; j < col_num; j++) {
+                    x[k][i][n][j] = genrand_real1() - 0.5;
+                }
+            }
+        }
+    }
+
+    for (int dtype = 0; dtype <= 1; dtype++) {
+        for (int use_thread = 0; use_thread <= 1; use_thread++) {
+            struct rnn_trajectory traj;
+            init_rnn_trajectory(&traj, dtype, series_num, length, col_num);
+            assert_equal_int(0, traj.record_size % 8);
+            FILE *fp;
+            if ((fp = fopen(filename, "wb")) == NULL) {
+                print_error_msg("cannot open %s", filename);
+                exit(EXIT_FAILURE);
+            }
+            fwrite_rnn_trajectory_header(&traj, text, strlen(text), fp);
+            struct log_writer writer;
+            init_log_writer(&writer, use_thread, 0, 4);
+            for (int k = 0; k < 50; k++) {
+                void *record = log_begin_raw(&writer, fp, traj.record_size);
+                rnn_trajectory_put_epoch(&traj, record, 3 * k);
+                for (int i = series_num - 1; i >= 0; i--) {
+                    for (int n = 0; n < length[i]; n++) {
+                        rnn_trajectory_put_state(&traj, record, i, n,
+                                x[k][i][n]);
+                    }
+                }
+                log_end(&writer, 0);
+            }
+            free_log_writer(&writer);
+            // an incomplete record
+            fwrite(x, sizeof(double), 3, fp);
+            fclose(fp);
+            free_rnn_trajectory(&traj);
+
+            mu_assert(is_rnn_trajectory_file(filename));
+            mu_assert(!is_rnn_log_file(filename));
+            int stat = map_rnn_trajectory(&traj, filename);
+            assert_equal_int(0, stat);
+            assert_equal_int(dtype, (int)traj.dtype);
+            assert_equal_int(series_num, traj.series_num);
+            assert_equal_int(col_num, traj.col_num);
+            for (int i = 0; i < series_num; i++) {
+                assert_equal_int(length[i], traj.length[i]);
+            }
+            assert_equal_int(strlen(text), traj.text_size);
+            mu_assert(memcmp(text, traj.text, traj.text_size) == 0);
+            assert_equal_int(50, traj.record_num);
+            for (int k = 0; k < 50; k++) {
+                assert_equal_int(3 * k, rnn_trajectory_epoch(&traj, k));
+                for (int i = 0; i < series_num; i++) {
+                    for (int n = 0; n < length[i]; n++) {
+                        double y[col_num];
+                        rnn_trajectory_get_state(&traj, k, i, n, y);
+                        for (int j = 0; j < col_num; j++) {
+                            if (dtype == RNN_TRAJECTORY_FLOAT32) {
+                                mu_assert(y[j] == (float)x[k][i][n][j]);
+                            } else {
+                                mu_assert(y[j] == x[k][i][n][j]);
+                            }
+                        }
+                    }
+                }
+            }
+            assert_equal_int(0, rnn_trajectory_find(&traj, 0));
+            assert_equal_int(4, rnn_trajectory_find(&traj, 10));
+            assert_equal_int(4, rnn_trajectory_find(&traj, 12));
+            assert_equal_int(50, rnn_trajectory_find(&traj, 148));
+            free_rnn_trajectory(&traj);
+        }
+    }
+    remove(filename);
+}
+
+
+void test_log_writer (void)
+{
+    init_genrand(5489UL);
+    mu_run_test(test_write_log_records);
+    mu_run_test(test_hold_log_records);
+    mu_run_test(test_submit_held_log_records);
+    mu_run_test(test_write_binary_log_records);
+    mu_run_test(test_write_trajectory_records);
+}
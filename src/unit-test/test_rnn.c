@@ -207,10 +207,13 @@ void assert_equal_rnn_s (
     assert_equal_memory(rnn1_s->delta_beta_init_c, rep_msz1,
             rnn2_s->delta_beta_init_c, rep_msz2);
 
-    assert_equal_vector_sequence(rnn1_s->in_state, in_msz1, rnn1_s->length,
-            rnn2_s->in_state, in_msz2, rnn2_s->length);
-    assert_equal_vector_sequence(rnn1_s->teach_state, out_msz1, rnn1_s->length,
-            rnn2_s->teach_state, out_msz2, rnn2_s->length);
+    // the rows of streamed series are resolved from in_data and teach_data
+    for (int n = 0; n < rnn1_s->length && n < rnn2_s->length; n++) {
+        assert_equal_memory(rnn_in_state_row(rnn1_s, n), in_msz1,
+                rnn_in_state_row(rnn2_s, n), in_msz2);
+        assert_equal_memory(rnn_teach_state_row(rnn1_s, n), out_msz1,
+                rnn_teach_state_row(rnn2_s, n), out_msz2);
+    }
 }
 
 void assert_rnn_forward_context_map (
@@ -665,6 +668,71 @@ static void test_fwrite_recurrent_neural_network (
 }
 
 
+static void test_rnn_duplicate_parameters (struct rnn_parameters *rnn_p)
+{
+    struct rnn_parameters rnn_p2;
+    rnn_duplicate_parameters(&rnn_p2, rnn_p);
+    assert_equal_rnn_p(rnn_p, &rnn_p2);
+    free_rnn_parameters(&rnn_p2);
+}
+
+static void test_rnn_add_targets (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2;
+    int length[rnn->series_num];
+    const double* const* input[rnn->series_num];
+    const double* const* target[rnn->series_num];
+
+    init_recurrent_neural_network(&rnn2, rnn->rnn_p.in_state_size,
+            rnn->rnn_p.c_state_size, rnn->rnn_p.out_state_size,
+            rnn->rnn_p.rep_init_size);
+    for (int i = 0; i < rnn->series_num; i++) {
+        length[i] = rnn->rnn_s[i].length;
+        input[i] = (const double* const*)rnn->rnn_s[i].in_state;
+        target[i] = (const double* const*)rnn->rnn_s[i].teach_state;
+    }
+    rnn_add_targets(&rnn2, rnn->series_num, length, input, target);
+    rnn_add_targets(&rnn2, rnn->series_num, length, input, target);
+    assert_equal_int(2 * rnn->series_num, rnn2.series_num);
+    for (int i = 0; i < rnn->series_num; i++) {
+        assert_equal_rnn_s(rnn->rnn_s + i, rnn2.rnn_s + i);
+        assert_equal_rnn_s(rnn->rnn_s + i, rnn2.rnn_s + rnn->series_num + i);
+    }
+    rnn_clean_target(&rnn2);
+    assert_equal_int(0, rnn2.series_num);
+    assert_equal_pointer(NULL, rnn2.rnn_s);
+    free_recurrent_neural_network(&rnn2);
+}
+
+
+static void test_rnn_add_target_views (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2;
+    int length[rnn->series_num];
+    const double* const* input[rnn->series_num];
+    const double* const* target[rnn->series_num];
+
+    init_recurrent_neural_network(&rnn2, rnn->rnn_p.in_state_size,
+            rnn->rnn_p.c_state_size, rnn->rnn_p.out_state_size,
+            rnn->rnn_p.rep_init_size);
+    for (int i = 0; i < rnn->series_num; i++) {
+        length[i] = rnn->rnn_s[i].length;
+        input[i] = (const double* const*)rnn->rnn_s[i].in_state;
+        target[i] = (const double* const*)rnn->rnn_s[i].teach_state;
+    }
+    rnn_add_target_views(&rnn2, rnn->series_num, length, input, target);
+    assert_equal_int(rnn->series_num, rnn2.series_num);
+    for (int i = 0; i < rnn->series_num; i++) {
+        assert_equal_rnn_s(rnn->rnn_s + i, rnn2.rnn_s + i);
+        for (int n = 0; n < length[i]; n++) {
+            assert_equal_pointer(input[i][n], rnn2.rnn_s[i].in_state[n]);
+            assert_equal_pointer(target[i][n], rnn2.rnn_s[i].teach_state[n]);
+        }
+    }
+    free_recurrent_neural_network(&rnn2);
+}
+
+
 static void test_rnn_set_uniform_tau (struct recurrent_neural_network *rnn)
 {
     rnn_set_uniform_tau(&(rnn->rnn_p), 10.0);
@@ -1108,6 +1176,29 @@ static void test_rnn_forward_backward_dynamics_forall (
     free_recurrent_neural_network(&rnn2);
 }
 
+static void test_rnn_reuse_delta (struct recurrent_neural_network *rnn)
+{
+    const size_t c_msz = rnn->rnn_p.c_state_size * sizeof(double);
+    double delta_t_c[rnn->series_num][rnn->rnn_p.c_state_size];
+
+    rnn_forward_backward_dynamics_forall(rnn);
+    for (int i = 0; i < rnn->series_num; i++) {
+        memcpy(delta_t_c[i], rnn->rnn_s[i].delta_t_c, c_msz);
+    }
+    double threshold = rnn->rnn_p.threshold_c[0];
+    rnn->rnn_p.threshold_c[0] += 0.5;
+    rnn->rnn_s[0].reuse_delta = 1;
+    rnn_forward_backward_dynamics_forall(rnn);
+    assert_equal_memory(delta_t_c[0], c_msz, rnn->rnn_s[0].delta_t_c, c_msz);
+    for (int i = 1; i < rnn->series_num; i++) {
+        mu_assert(memcmp(delta_t_c[i], rnn->rnn_s[i].delta_t_c, c_msz) != 0);
+    }
+    rnn->rnn_s[0].reuse_delta = 0;
+    rnn_forward_backward_dynamics_forall(rnn);
+    mu_assert(memcmp(delta_t_c[0], rnn->rnn_s[0].delta_t_c, c_msz) != 0);
+    rnn->rnn_p.threshold_c[0] = threshold;
+}
+
 static void test_rnn_forward_dynamics_in_closed_loop_forall (
         struct recurrent_neural_network *rnn)
 {
@@ -1166,6 +1257,43 @@ static void test_rnn_forward_dynamics_in_closed_loop_forall (
 }
 
 
+static void test_rnn_connect_init_c_inter_state (
+        struct recurrent_neural_network *rnn)
+{
+    const int c_state_size = rnn->rnn_p.c_state_size;
+    if (rnn->series_num < 2) {
+        return;
+    }
+    struct rnn_state *prev_s = rnn->rnn_s;
+    struct rnn_state *rnn_s = rnn->rnn_s + 1;
+    double init_c_inter_state[c_state_size], init_c_state[c_state_size];
+    memcpy(init_c_inter_state, rnn_s->init_c_inter_state, sizeof(double) *
+            c_state_size);
+    memcpy(init_c_state, rnn_s->init_c_state, sizeof(double) * c_state_size);
+
+    rnn_forward_dynamics_forall(rnn);
+    rnn->rnn_p.const_init_c[0] = 1;
+    const int step = (prev_s->length >= 3) ? prev_s->length / 3 : 1;
+    for (int n = 0; n < prev_s->length; n += step) {
+        rnn_connect_init_c_inter_state(rnn_s, prev_s, n);
+        assert_equal_double(init_c_inter_state[0], rnn_s->init_c_inter_state[0],
+                1e-14);
+        assert_equal_double(init_c_state[0], rnn_s->init_c_state[0], 1e-14);
+        for (int i = 1; i < c_state_size; i++) {
+            assert_equal_double(prev_s->c_inter_state[n][i],
+                    rnn_s->init_c_inter_state[i], 1e-14);
+            assert_equal_double(prev_s->c_state[n][i], rnn_s->init_c_state[i],
+                    1e-14);
+        }
+    }
+    rnn->rnn_p.const_init_c[0] = 0;
+
+    memcpy(rnn_s->init_c_inter_state, init_c_inter_state, sizeof(double) *
+            c_state_size);
+    memcpy(rnn_s->init_c_state, init_c_state, sizeof(double) * c_state_size);
+}
+
+
 static void test_rnn_learn (struct recurrent_neural_network *rnn)
 {
     for (int n = 0; n < 3; n++) {
@@ -1246,6 +1374,96 @@ static void test_rnn_learn_s (struct recurrent_neural_network *rnn)
     free_recurrent_neural_network(&rnn2);
 }
 
+static void test_init_rnn_batch (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2, batch;
+    FILE *fp;
+    const int series_num = rnn->series_num;
+    int index[series_num];
+
+    fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    fwrite_recurrent_neural_network(rnn, fp);
+    fseek(fp, 0L, SEEK_SET);
+    fread_recurrent_neural_network(&rnn2, fp);
+    fclose(fp);
+
+    for (int i = 0; i < series_num; i++) {
+        index[i] = i;
+    }
+    rnn->rnn_p.output_type = rnn2.rnn_p.output_type = STANDARD_TYPE;
+    rnn->rnn_p.prior_strength = rnn2.rnn_p.prior_strength = 0.01;
+    init_rnn_batch(&batch, rnn, series_num, index);
+    assert_equal_double(0.01, batch.rnn_p.prior_strength, 1e-14);
+    rnn_learn_s(&batch, 1e-8, 0.9);
+    free_rnn_batch(&batch);
+    rnn_learn_s(&rnn2, 1e-8, 0.9);
+    assert_equal_rnn_p(&rnn->rnn_p, &rnn2.rnn_p);
+    for (int i = 0; i < series_num; i++) {
+        assert_equal_rnn_s(rnn->rnn_s + i, rnn2.rnn_s + i);
+    }
+
+    for (int i = 0; i < series_num; i++) {
+        index[i] = series_num - 1 - i;
+    }
+    int batch_size = (series_num + 1) / 2;
+    init_rnn_batch(&batch, rnn, batch_size, index);
+    assert_equal_int(batch_size, batch.series_num);
+    int batch_length = 0;
+    for (int i = 0; i < batch_size; i++) {
+        struct rnn_state *rnn_s = rnn->rnn_s + index[i];
+        assert_equal_int(rnn_s->length, batch.rnn_s[i].length);
+        assert_equal_pointer(rnn_s->init_c_inter_state,
+                batch.rnn_s[i].init_c_inter_state);
+        assert_equal_pointer(rnn_s->delta_w_ci, batch.rnn_s[i].delta_w_ci);
+        batch_length += rnn_s->length;
+    }
+    assert_equal_pointer(rnn->rnn_p.weight_ci, batch.rnn_p.weight_ci);
+    assert_equal_double(0.01 * batch_length / rnn_get_total_length(rnn),
+            batch.rnn_p.prior_strength, 1e-14);
+    free_rnn_batch(&batch);
+    assert_equal_int(0, batch.series_num);
+    assert_equal_pointer(NULL, batch.rnn_s);
+
+    free_recurrent_neural_network(&rnn2);
+}
+
+static void test_rnn_learn_s_async (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2, series, series2;
+    FILE *fp;
+    const int n = rnn->series_num - 1;
+
+    fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    fwrite_recurrent_neural_network(rnn, fp);
+    fseek(fp, 0L, SEEK_SET);
+    fread_recurrent_neural_network(&rnn2, fp);
+    fclose(fp);
+
+    rnn->rnn_p.output_type = rnn2.rnn_p.output_type = STANDARD_TYPE;
+    rnn->rnn_p.prior_strength = rnn2.rnn_p.prior_strength = 0.01;
+    init_rnn_batch(&series, rnn, 1, &n);
+    init_rnn_batch(&series2, &rnn2, 1, &n);
+    rnn_learn_s_async(&series, 1e-8, 0.9);
+    rnn_learn_s(&series2, 1e-8, 0.9);
+    free_rnn_batch(&series);
+    free_rnn_batch(&series2);
+    assert_equal_rnn_p(&rnn->rnn_p, &rnn2.rnn_p);
+    assert_equal_rnn_s(rnn->rnn_s + n, rnn2.rnn_s + n);
+
+    rnn_learn_s_async(rnn, 1e-8, 0.9);
+    assert_equal_double(0.01, rnn->rnn_p.prior_strength, 1e-14);
+
+    free_recurrent_neural_network(&rnn2);
+}
+
 static void test_rnn_backup_learning_parameters (
         struct recurrent_neural_network *rnn)
 {
@@ -1537,6 +1755,10 @@ void test_rnn (void)
     for (int i = 0; i < 5; i++) {
         mu_run_test_with_args(test_fwrite_recurrent_neural_network,
                 &t_data[i].rnn);
+        mu_run_test_with_args(test_rnn_duplicate_parameters,
+                &t_data[i].rnn.rnn_p);
+        mu_run_test_with_args(test_rnn_add_targets, &t_data[i].rnn);
+        mu_run_test_with_args(test_rnn_add_target_views, &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_set_uniform_tau, &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_set_tau, &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_get_total_length, &t_data[i].rnn,
@@ -1552,10 +1774,15 @@ void test_rnn (void)
         mu_run_test_with_args(test_rnn_forward_dynamics_forall, &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_forward_backward_dynamics_forall,
                 &t_data[i].rnn);
+        mu_run_test_with_args(test_rnn_reuse_delta, &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_forward_dynamics_in_closed_loop_forall,
                 &t_data[i].rnn);
+        mu_run_test_with_args(test_rnn_connect_init_c_inter_state,
+                &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_learn, &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_learn_s, &t_data[i].rnn);
+        mu_run_test_with_args(test_init_rnn_batch, &t_data[i].rnn);
+        mu_run_test_with_args(test_rnn_learn_s_async, &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_backup_learning_parameters,
                 &t_data[i].rnn);
         mu_run_test_with_args(test_rnn_learn_with_adapt_lr, &t_data[i].rnn);
@@ -0,0 +1,405 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define TEST_CODE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "minunit.h"
+#include "my_assert.h"
+#include "utils.h"
+#include "rnn_file.h"
+#include "rnn_runner.h"
+
+
+void assert_equal_rnn_p (
+        const struct rnn_parameters *rnn_p,
+        const struct rnn_parameters *rnn_p2);
+
+void assert_equal_rnn_s (
+        const struct rnn_state *rnn_s,
+        const struct rnn_state *rnn_s2);
+
+void test_rnn_state_setup (
+        struct recurrent_neural_network *rnn,
+        int target_num,
+        int *target_length);
+
+
+static FILE* write_rnn_file (
+        const struct recurrent_neural_network *rnn,
+        int delay_length)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    struct rnn_file_writer writer;
+    init_rnn_file_writer(&writer, fp);
+    rnn_file_write_recurrent_neural_network(&writer, rnn, delay_length, 0.5,
+            100);
+    rnn_file_write_section(&writer, RNN_FILE_OPTIMIZER, "optimizer", 9);
+    fini_rnn_file_writer(&writer);
+    fflush(fp);
+    fseek(fp, 0L, SEEK_SET);
+    return fp;
+}
+
+
+static void test_rnn_file_writer (struct recurrent_neural_network *rnn)
+{
+    struct rnn_file file;
+    FILE *fp = write_rnn_file(rnn, 3);
+    mu_assert(is_rnn_file_stream(fp));
+    assert_equal_int(0, ftell(fp));
+    int stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    fclose(fp);
+    assert_equal_int(0, stat);
+
+    assert_equal_int(RNN_FILE_SECTION_ID_NUM, file.section_num);
+    for (int i = 0; i < file.section_num; i++) {
+        assert_equal_int(i, file.section[i].id);
+        assert_equal_int(0, (int)(file.section[i].offset %
+                    RNN_FILE_ALIGNMENT));
+    }
+    assert_equal_int(3, file.header->delay_length);
+    assert_equal_int(rnn->rnn_p.in_state_size, file.header->in_state_size);
+    assert_equal_int(rnn->rnn_p.c_state_size, file.header->c_state_size);
+    assert_equal_int(rnn->rnn_p.out_state_size, file.header->out_state_size);
+    assert_equal_int(rnn->rnn_p.rep_init_size, file.header->rep_init_size);
+    assert_equal_int(rnn->series_num, file.header->series_num);
+    assert_equal_double(0.5, file.header->adapt_lr, 0);
+    assert_equal_int(100, file.header->init_epoch);
+
+    size_t size;
+    const char *p = rnn_file_get_section(&file, RNN_FILE_OPTIMIZER, &size);
+    assert_equal_memory("optimizer", 9, p, size);
+    assert_equal_int(p - (const char*)file.map,
+            rnn_file_section_offset(&file, RNN_FILE_OPTIMIZER));
+    const double *weight = rnn_file_get_section(&file, RNN_FILE_WEIGHT_CC,
+            &size);
+    assert_equal_memory(rnn->rnn_p.weight_cc[0], sizeof(double) *
+            rnn->rnn_p.c_state_size * rnn->rnn_p.c_state_size, weight, size);
+    unmap_rnn_file(&file);
+    mu_assert(file.map == NULL);
+}
+
+
+static void test_rnn_file_read_recurrent_neural_network (
+        struct recurrent_neural_network *rnn)
+{
+    struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            rnn_p->delta_weight_cc[i][j] = genrand_real1();
+        }
+        rnn_p->delta_tau[i] = genrand_real1();
+        rnn_p->prior_threshold_c[i] = genrand_real1();
+    }
+    for (int i = 0; i < rnn->series_num; i++) {
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            rnn->rnn_s[i].init_c_inter_state[j] = genrand_real1();
+            rnn->rnn_s[i].delta_init_c_inter_state[j] = genrand_real1();
+        }
+    }
+
+    struct rnn_file file;
+    struct recurrent_neural_network rnn2;
+    FILE *fp = write_rnn_file(rnn, 1);
+    int stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    fclose(fp);
+    assert_equal_int(0, stat);
+    rnn_file_read_recurrent_neural_network(&file, &rnn2);
+    unmap_rnn_file(&file);
+
+    assert_equal_int(0, rnn2.rnn_p.mapped);
+    assert_equal_rnn_p(rnn_p, &rnn2.rnn_p);
+    assert_equal_int(rnn->series_num, rnn2.series_num);
+    for (int i = 0; i < rnn->series_num; i++) {
+        assert_equal_rnn_s(rnn->rnn_s + i, rnn2.rnn_s + i);
+    }
+    free_recurrent_neural_network(&rnn2);
+
+    rnn_reset_delta_parameters(rnn_p);
+    rnn_reset_prior_distribution(rnn_p);
+}
+
+
+static void test_rnn_file_map_recurrent_neural_network (
+        struct recurrent_neural_network *rnn)
+{
+    struct rnn_file file;
+    struct recurrent_neural_network rnn2;
+    FILE *fp = write_rnn_file(rnn, 1);
+    int stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    fclose(fp);
+    assert_equal_int(0, stat);
+    rnn_file_map_recurrent_neural_network(&file, &rnn2);
+
+    assert_equal_int(1, rnn2.rnn_p.mapped);
+    assert_equal_pointer(rnn_file_get_section(&file, RNN_FILE_TAU, NULL),
+            rnn2.rnn_p.tau);
+    assert_equal_rnn_p(&rnn->rnn_p, &rnn2.rnn_p);
+    assert_equal_int(rnn->series_num, rnn2.series_num);
+    for (int i = 0; i < rnn->series_num; i++) {
+        const struct rnn_state *rnn_s = rnn->rnn_s + i;
+        const struct rnn_state *rnn_s2 = rnn2.rnn_s + i;
+        const int c_state_size = rnn->rnn_p.c_state_size;
+        assert_equal_int(rnn_s->length, rnn_s2->length);
+        assert_equal_memory(rnn_s->init_c_state, c_state_size *
+                sizeof(double), rnn_s2->init_c_state, c_state_size *
+                sizeof(double));
+        assert_equal_memory(rnn_s->init_c_inter_state, c_state_size *
+                sizeof(double), rnn_s2->init_c_inter_state, c_state_size *
+                sizeof(double));
+        assert_equal_pointer(NULL, rnn_s2->in_state);
+        for (int n = 0; n < rnn_s->length; n++) {
+            assert_equal_memory(rnn_s->in_state[n], rnn->rnn_p.in_state_size *
+                    sizeof(double), rnn_in_state_row(rnn_s2, n),
+                    rnn->rnn_p.in_state_size * sizeof(double));
+        }
+    }
+    free_recurrent_neural_network(&rnn2);
+    assert_equal_int(0, rnn2.rnn_p.mapped);
+    unmap_rnn_file(&file);
+}
+
+
+/* a runner initialized with a model file agrees with a legacy file */
+static void test_init_rnn_runner_with_rnn_file (
+        struct recurrent_neural_network *rnn)
+{
+    const int delay_length = 2;
+    struct rnn_runner runner, runner2;
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    FWRITE(&delay_length, 1, fp);
+    fwrite_recurrent_neural_network(rnn, fp);
+    fseek(fp, 0L, SEEK_SET);
+    init_rnn_runner(&runner, fp);
+    fclose(fp);
+    mu_assert(runner.model->file.map == NULL);
+
+    fp = write_rnn_file(rnn, delay_length);
+    init_rnn_runner(&runner2, fp);
+    fclose(fp);
+    mu_assert(runner2.model->file.map != NULL);
+    assert_equal_int(delay_length, rnn_delay_length_from_runner(&runner2));
+    assert_equal_int(rnn_target_num_from_runner(&runner),
+            rnn_target_num_from_runner(&runner2));
+
+    const int out_mem_size = rnn->rnn_p.out_state_size * sizeof(double);
+    const int c_mem_size = rnn->rnn_p.c_state_size * sizeof(double);
+    for (int i = 0; i < rnn->series_num; i++) {
+        set_init_state_of_rnn_runner(&runner, i);
+        set_init_state_of_rnn_runner(&runner2, i);
+        for (int n = 0; n < 20; n++) {
+            update_rnn_runner(&runner);
+            update_rnn_runner(&runner2);
+            assert_equal_memory(rnn_out_state_from_runner(&runner),
+                    out_mem_size, rnn_out_state_from_runner(&runner2),
+                    out_mem_size);
+            assert_equal_memory(rnn_c_state_from_runner(&runner), c_mem_size,
+                    rnn_c_state_from_runner(&runner2), c_mem_size);
+        }
+    }
+    free_rnn_runner(&runner);
+    free_rnn_runner(&runner2);
+    mu_assert(runner2.model == NULL);
+}
+
+
+/* a runner initialized with a model for inference agrees with a full model */
+static void test_rnn_file_write_inference_network (
+        struct recurrent_neural_network *rnn)
+{
+    const int delay_length = 2;
+    struct rnn_runner runner, runner2;
+    FILE *fp = write_rnn_file(rnn, delay_length);
+    init_rnn_runner(&runner, fp);
+    fclose(fp);
+
+    fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    struct rnn_file_writer writer;
+    init_rnn_file_writer(&writer, fp);
+    rnn_file_write_inference_network(&writer, rnn, delay_length,
+            delay_length);
+    fini_rnn_file_writer(&writer);
+    fflush(fp);
+    fseek(fp, 0L, SEEK_SET);
+    init_rnn_runner(&runner2, fp);
+    fclose(fp);
+
+    const struct rnn_file *file = &runner2.model->file;
+    mu_assert(rnn_file_get_section(file, RNN_FILE_DELTA_WEIGHT_CI, NULL) ==
+            NULL);
+    mu_assert(rnn_file_get_section(file, RNN_FILE_PRIOR_TAU, NULL) == NULL);
+    mu_assert(rnn_file_get_section(file, RNN_FILE_TEACH_STATE, NULL) ==
+            NULL);
+    assert_equal_int(-1, rnn_file_section_offset(file, RNN_FILE_OPTIMIZER));
+    const int *length = rnn_file_get_section(file, RNN_FILE_SERIES_LENGTH,
+            NULL);
+    const int *in_length = rnn_file_get_section(file,
+            RNN_FILE_IN_STATE_LENGTH, NULL);
+    for (int i = 0; i < rnn->series_num; i++) {
+        assert_equal_int(rnn->rnn_s[i].length, length[i]);
+        assert_equal_int(delay_length, in_length[i]);
+        assert_equal_int(delay_length, runner2.model->series[i].length);
+    }
+
+    const int out_mem_size = rnn->rnn_p.out_state_size * sizeof(double);
+    for (int i = 0; i < rnn->series_num; i++) {
+        set_init_state_of_rnn_runner(&runner, i);
+        set_init_state_of_rnn_runner(&runner2, i);
+        for (int n = 0; n < 20; n++) {
+            update_rnn_runner(&runner);
+            update_rnn_runner(&runner2);
+            assert_equal_memory(rnn_out_state_from_runner(&runner),
+                    out_mem_size, rnn_out_state_from_runner(&runner2),
+                    out_mem_size);
+        }
+    }
+    free_rnn_runner(&runner);
+    free_rnn_runner(&runner2);
+}
+
+
+static void test_map_broken_rnn_file (struct recurrent_neural_network *rnn)
+{
+    struct rnn_file file;
+    int stat;
+    FILE *fp = write_rnn_file(rnn, 1);
+    fseek(fp, 0L, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+
+    char *buf;
+    MALLOC(buf, size);
+    fp = write_rnn_file(rnn, 1);
+    if (fread(buf, 1, size, fp) != (size_t)size) {
+        print_error_msg("`fread' failed");
+        exit(EXIT_FAILURE);
+    }
+    fclose(fp);
+
+    // truncated file
+    fp = tmpfile();
+    FWRITE(buf, size / 2, fp);
+    fflush(fp);
+    stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    assert_equal_int(-1, stat);
+    mu_assert(file.map == NULL);
+    fclose(fp);
+
+    // unsupported version
+    buf[8]++;
+    fp = tmpfile();
+    FWRITE(buf, size, fp);
+    fflush(fp);
+    stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    assert_equal_int(-1, stat);
+    fclose(fp);
+    buf[8]--;
+
+    // connection domain out of the state size
+    fp = write_rnn_file(rnn, 1);
+    stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    assert_equal_int(0, stat);
+    long offset = rnn_file_section_offset(&file, RNN_FILE_CONNECTION_CC);
+    unmap_rnn_file(&file);
+    fclose(fp);
+    mu_assert(offset > 0);
+    struct connection_domain domain, broken = {0,
+        rnn->rnn_p.c_state_size + 1};
+    memcpy(&domain, buf + offset, sizeof(domain));
+    memcpy(buf + offset, &broken, sizeof(broken));
+    fp = tmpfile();
+    FWRITE(buf, size, fp);
+    fflush(fp);
+    stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    assert_equal_int(-1, stat);
+    fclose(fp);
+    memcpy(buf + offset, &domain, sizeof(domain));
+
+    // not a model file
+    buf[1] = 'X';
+    fp = tmpfile();
+    FWRITE(buf, size, fp);
+    fflush(fp);
+    fseek(fp, 0L, SEEK_SET);
+    mu_assert(!is_rnn_file_stream(fp));
+    stat = map_rnn_file_descriptor(&file, fileno(fp), "tmpfile");
+    assert_equal_int(-1, stat);
+    fclose(fp);
+    FREE(buf);
+}
+
+
+static void test_rnn_file_setup (
+        struct recurrent_neural_network *rnn,
+        unsigned long seed,
+        int in_state_size,
+        int c_state_size,
+        int out_state_size,
+        int rep_init_size,
+        int target_num,
+        int *target_length)
+{
+    init_genrand(seed);
+    init_recurrent_neural_network(rnn, in_state_size, c_state_size,
+            out_state_size, rep_init_size);
+    test_rnn_state_setup(rnn, target_num, target_length);
+}
+
+
+void test_rnn_file (void)
+{
+    struct recurrent_neural_network rnn[3];
+    test_rnn_file_setup(rnn, 6047L, 3, 10, 3, 2, 3, (int[]){40,25,60});
+    test_rnn_file_setup(rnn+1, 813L, 0, 7, 2, 1, 2, (int[]){30,50});
+    rnn[1].rnn_p.output_type = SOFTMAX_TYPE;
+    test_rnn_file_setup(rnn+2, 23L, 4, 12, 4, 3, 1, (int[]){15});
+    rnn_delete_connection(rnn[2].rnn_p.c_state_size,
+            rnn[2].rnn_p.connection_cc[2], 3, 8);
+    rnn_reset_weight_by_connection(&rnn[2].rnn_p);
+
+    for (int i = 0; i < 3; i++) {
+        mu_run_test_with_args(test_rnn_file_writer, rnn + i);
+        mu_run_test_with_args(test_rnn_file_read_recurrent_neural_network,
+                rnn + i);
+        mu_run_test_with_args(test_rnn_file_map_recurrent_neural_network,
+                rnn + i);
+        mu_run_test_with_args(test_init_rnn_runner_with_rnn_file, rnn + i);
+        mu_run_test_with_args(test_rnn_file_write_inference_network,
+                rnn + i);
+        mu_run_test_with_args(test_map_broken_rnn_file, rnn + i);
+        free_recurrent_neural_network(rnn + i);
+    }
+}
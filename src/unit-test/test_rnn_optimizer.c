@@ -0,0 +1,411 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define TEST_CODE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "minunit.h"
+#include "my_assert.h"
+#include "utils.h"
+#include "rnn_optimizer.h"
+
+
+void assert_equal_rnn_p (
+        const struct rnn_parameters *rnn_p,
+        const struct rnn_parameters *rnn_p2);
+
+void assert_equal_rnn_s (
+        const struct rnn_state *rnn_s,
+        const struct rnn_state *rnn_s2);
+
+
+static void copy_rnn (
+        struct recurrent_neural_network *dst,
+        const struct recurrent_neural_network *src)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    fwrite_recurrent_neural_network(src, fp);
+    fseek(fp, 0L, SEEK_SET);
+    fread_recurrent_neural_network(dst, fp);
+    fclose(fp);
+}
+
+/*
+ * returns the gradient of rnn in the order of the table of optimizer
+ * (for L-BFGS, without the attraction of the initial states)
+ */
+static void get_gradient (
+        const struct rnn_optimizer *optimizer,
+        double *grad)
+{
+    struct recurrent_neural_network rnn;
+    struct rnn_optimizer tmp;
+    copy_rnn(&rnn, optimizer->rnn);
+    init_rnn_optimizer(&tmp, &rnn, optimizer->type, optimizer->memory_size);
+    rnn_forward_backward_dynamics_forall(&rnn);
+    rnn_update_delta_parameters(&rnn, 0);
+#ifdef ENABLE_ATTRACTION_OF_INIT_C
+    if (optimizer->type == LBFGS_OPTIMIZER) {
+        for (int k = 0; k < rnn.series_num; k++) {
+            double attraction[rnn.rnn_p.c_state_size];
+            rnn_get_attraction_of_init_c(rnn.rnn_s + k, attraction);
+            for (int i = 0; i < rnn.rnn_p.c_state_size; i++) {
+                rnn.rnn_s[k].delta_init_c_inter_state[i] -= attraction[i];
+            }
+        }
+    }
+#endif
+    for (int i = 0; i < tmp.size; i++) {
+        grad[i] = *tmp.delta[i];
+    }
+    free_rnn_optimizer(&tmp);
+    free_recurrent_neural_network(&rnn);
+}
+
+
+static int count_connection (
+        int size,
+        const struct connection_domain *connection)
+{
+    int has_connection[size];
+    int n = 0;
+    rnn_get_connection(size, connection, has_connection);
+    for (int i = 0; i < size; i++) {
+        n += has_connection[i];
+    }
+    return n;
+}
+
+static void test_init_rnn_optimizer (struct recurrent_neural_network *rnn)
+{
+    struct rnn_optimizer optimizer;
+    const struct rnn_parameters *rnn_p = &rnn->rnn_p;
+    const int c_state_size = rnn_p->c_state_size;
+    int weight_size = 0;
+    for (int i = 0; i < c_state_size; i++) {
+        weight_size += count_connection(rnn_p->in_state_size,
+                rnn_p->connection_ci[i]);
+        weight_size += count_connection(c_state_size, rnn_p->connection_cc[i]);
+    }
+    for (int i = 0; i < rnn_p->out_state_size; i++) {
+        weight_size += count_connection(c_state_size, rnn_p->connection_oc[i]);
+        weight_size += count_connection(c_state_size, rnn_p->connection_vc[i]);
+    }
+    int tau_size = 0;
+    for (int i = 0; i < c_state_size; i++) {
+        tau_size += isfinite(rnn_p->tau[i]) ? 1 : 0;
+    }
+    int init_size = 0;
+    for (int i = 0; i < c_state_size; i++) {
+        init_size += rnn_p->const_init_c[i] ? 0 : 1;
+    }
+    init_size = (rnn_p->rep_init_size + init_size) * rnn->series_num +
+        rnn_p->rep_init_size * c_state_size;
+
+    init_rnn_optimizer(&optimizer, rnn, MOMENTUM_OPTIMIZER, 5);
+    assert_equal_int(0, optimizer.size);
+    free_rnn_optimizer(&optimizer);
+
+    init_rnn_optimizer(&optimizer, rnn, ADAM_OPTIMIZER, 5);
+    assert_equal_int(0, optimizer.group_offset[0]);
+    assert_equal_int(weight_size, optimizer.group_offset[1]);
+    assert_equal_int(c_state_size + 2 * rnn_p->out_state_size,
+            optimizer.group_offset[2] - optimizer.group_offset[1]);
+    assert_equal_int(tau_size,
+            optimizer.group_offset[3] - optimizer.group_offset[2]);
+    assert_equal_int(init_size,
+            optimizer.group_offset[4] - optimizer.group_offset[3]);
+    assert_equal_int(optimizer.group_offset[4], optimizer.size);
+    const int n = optimizer.group_offset[1];
+    assert_equal_pointer(rnn_p->threshold_c, optimizer.param[n]);
+    assert_equal_pointer(rnn_p->delta_threshold_c, optimizer.delta[n]);
+    const int m = optimizer.size - 1;
+    const struct rnn_state *rnn_s = rnn->rnn_s + rnn->series_num - 1;
+    assert_equal_pointer(rnn_s->init_c_inter_state + c_state_size - 1,
+            optimizer.param[m]);
+    assert_equal_pointer(rnn_s->delta_init_c_inter_state + c_state_size - 1,
+            optimizer.delta[m]);
+    free_rnn_optimizer(&optimizer);
+}
+
+
+static void test_momentum_optimizer (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2;
+    struct rnn_optimizer optimizer;
+
+    copy_rnn(&rnn2, rnn);
+    init_rnn_optimizer(&optimizer, &rnn2, MOMENTUM_OPTIMIZER, 5);
+    optimizer.momentum = 0.9;
+    for (int n = 0; n < 3; n++) {
+        rnn_learn_s(rnn, 1e-3, 0.9);
+        rnn_learn_with_optimizer(&optimizer, 1e-3);
+        assert_equal_rnn_p(&rnn->rnn_p, &rnn2.rnn_p);
+        for (int i = 0; i < rnn->series_num; i++) {
+            assert_equal_rnn_s(rnn->rnn_s + i, rnn2.rnn_s + i);
+        }
+    }
+    assert_equal_int(3, optimizer.step);
+    free_rnn_optimizer(&optimizer);
+    free_recurrent_neural_network(&rnn2);
+}
+
+
+static void test_adam_optimizer (struct recurrent_neural_network *rnn)
+{
+    struct rnn_optimizer optimizer;
+
+    init_rnn_optimizer(&optimizer, rnn, ADAM_OPTIMIZER, 5);
+    double grad[optimizer.size];
+    get_gradient(&optimizer, grad);
+    rnn_forward_backward_dynamics_forall(rnn);
+    rnn_optimizer_update_delta_parameters(&optimizer);
+    assert_equal_int(1, optimizer.step);
+    for (int i = 0; i < optimizer.size; i++) {
+        double d = grad[i] / (fabs(grad[i]) + optimizer.epsilon);
+        assert_equal_double(d, *optimizer.delta[i], 1e-10);
+        assert_equal_double(0.1 * grad[i], optimizer.moment1[i], 1e-10);
+    }
+
+    double error = rnn_get_total_error(rnn);
+    for (int n = 0; n < 20; n++) {
+        rnn_learn_with_optimizer(&optimizer, 1e-3);
+    }
+    rnn_forward_dynamics_forall(rnn);
+    mu_assert(rnn_get_total_error(rnn) < error);
+    free_rnn_optimizer(&optimizer);
+}
+
+
+static void test_lbfgs_optimizer (struct recurrent_neural_network *rnn)
+{
+    struct rnn_optimizer optimizer;
+
+    init_rnn_optimizer(&optimizer, rnn, LBFGS_OPTIMIZER, 3);
+    double grad[optimizer.size];
+    get_gradient(&optimizer, grad);
+    rnn_forward_backward_dynamics_forall(rnn);
+    rnn_optimizer_update_delta_parameters(&optimizer);
+    double norm = 0;
+    for (int i = 0; i < optimizer.size; i++) {
+        norm += grad[i] * grad[i];
+    }
+    norm = sqrt(norm);
+    for (int i = 0; i < optimizer.size; i++) {
+        assert_equal_double(grad[i] / norm, *optimizer.delta[i], 1e-10);
+    }
+    assert_equal_int(0, optimizer.memory_num);
+
+    double objective = rnn_get_total_likelihood(rnn) + rnn_get_log_prior(rnn);
+    for (int n = 0; n < 10; n++) {
+        get_gradient(&optimizer, grad);
+        rnn_learn_with_optimizer(&optimizer, 1.0);
+        double p = 0;
+        for (int i = 0; i < optimizer.size; i++) {
+            p += grad[i] * *optimizer.delta[i];
+        }
+        mu_assert(p > 0);
+        double next_objective = rnn_get_total_likelihood(rnn) +
+            rnn_get_log_prior(rnn);
+        mu_assert(next_objective >= objective);
+        objective = next_objective;
+    }
+    assert_equal_int(11, optimizer.step);
+    mu_assert(optimizer.memory_num > 0 && optimizer.memory_num <= 3);
+    free_rnn_optimizer(&optimizer);
+}
+
+
+/* sets the parameter i of the table of optimizer, and what depends on it */
+static void set_parameter (
+        struct rnn_optimizer *optimizer,
+        int i,
+        double x)
+{
+    struct recurrent_neural_network *rnn = optimizer->rnn;
+    *optimizer->param[i] = x;
+    rnn_set_tau(&rnn->rnn_p, rnn->rnn_p.tau);
+    for (int k = 0; k < rnn->series_num; k++) {
+        rnn_update_init_c_inter_state(rnn->rnn_s + k, 0);
+    }
+}
+
+/* the gradient for L-BFGS agrees with the finite difference of its objective */
+static void test_lbfgs_objective (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2;
+    struct rnn_optimizer optimizer;
+    const double h = 1e-5;
+
+    copy_rnn(&rnn2, rnn);
+    double tau[rnn2.rnn_p.c_state_size];
+    for (int i = 0; i < rnn2.rnn_p.c_state_size; i++) {
+        tau[i] = rnn2.rnn_p.tau[i] + 1.5;
+    }
+    rnn_set_tau(&rnn2.rnn_p, tau);
+    rnn2.rnn_p.fixed_weight = 0;
+    rnn2.rnn_p.fixed_threshold = 0;
+    rnn2.rnn_p.fixed_tau = 0;
+    rnn2.rnn_p.fixed_init_c_state = 0;
+    rnn_reset_prior_distribution(&rnn2.rnn_p);
+    init_rnn_optimizer(&optimizer, &rnn2, ADAM_OPTIMIZER, 3);
+    for (int n = 0; n < 3; n++) {
+        rnn_learn_with_optimizer(&optimizer, 1e-2);
+    }
+    free_rnn_optimizer(&optimizer);
+    rnn2.rnn_p.prior_strength = 0.5;
+
+    init_rnn_optimizer(&optimizer, &rnn2, LBFGS_OPTIMIZER, 3);
+    double grad[optimizer.size];
+    get_gradient(&optimizer, grad);
+    for (int i = 0; i < optimizer.size; i++) {
+        const double x = *optimizer.param[i];
+        set_parameter(&optimizer, i, x + h);
+        double f1 = rnn_optimizer_get_objective(&optimizer);
+        set_parameter(&optimizer, i, x - h);
+        double f2 = rnn_optimizer_get_objective(&optimizer);
+        set_parameter(&optimizer, i, x);
+        assert_equal_double(grad[i], (f1 - f2) / (2 * h),
+                1e-4 * (1 + fabs(grad[i])));
+    }
+
+    rnn_forward_backward_dynamics_forall(&rnn2);
+    rnn_optimizer_update_delta_parameters(&optimizer);
+    for (int i = 0; i < optimizer.size; i++) {
+        assert_equal_double(grad[i], optimizer.prev_grad[i], 1e-10);
+    }
+    free_rnn_optimizer(&optimizer);
+    free_recurrent_neural_network(&rnn2);
+}
+
+
+static void test_fwrite_rnn_optimizer (struct recurrent_neural_network *rnn)
+{
+    const enum rnn_optimizer_t type[] = {MOMENTUM_OPTIMIZER, ADAM_OPTIMIZER,
+        LBFGS_OPTIMIZER};
+    for (int k = 0; k < 3; k++) {
+        struct rnn_optimizer optimizer, optimizer2, optimizer3;
+        FILE *fp = tmpfile();
+        if (fp == NULL) {
+            print_error_msg("cannot open tmpfile");
+            exit(EXIT_FAILURE);
+        }
+        init_rnn_optimizer(&optimizer, rnn, type[k], 3);
+        for (int n = 0; n < 3; n++) {
+            rnn_learn_with_optimizer(&optimizer, 1e-4);
+        }
+        const int magic = 12345;
+        fwrite_rnn_optimizer(&optimizer, fp);
+        FWRITE(&magic, 1, fp);
+        fwrite_rnn_optimizer(&optimizer, fp);
+
+        init_rnn_optimizer(&optimizer2, rnn, type[k], 3);
+        init_rnn_optimizer(&optimizer3, rnn, type[(k+1)%3], 3);
+        fseek(fp, 0L, SEEK_SET);
+        int x = fread_rnn_optimizer(&optimizer3, fp);
+        assert_equal_int(0, x);
+        assert_equal_int(0, optimizer3.step);
+        FREAD(&x, 1, fp);
+        assert_equal_int(magic, x);
+        x = fread_rnn_optimizer(&optimizer2, fp);
+        assert_equal_int(1, x);
+        x = fread_rnn_optimizer(&optimizer2, fp);
+        assert_equal_int(0, x);
+        fclose(fp);
+
+        const int size = optimizer.size;
+        assert_equal_int(optimizer.step, optimizer2.step);
+        if (type[k] == ADAM_OPTIMIZER) {
+            assert_equal_memory(optimizer.moment1, sizeof(double) * size,
+                    optimizer2.moment1, sizeof(double) * size);
+            assert_equal_memory(optimizer.moment2, sizeof(double) * size,
+                    optimizer2.moment2, sizeof(double) * size);
+        } else if (type[k] == LBFGS_OPTIMIZER) {
+            assert_equal_int(optimizer.memory_num, optimizer2.memory_num);
+            assert_equal_int(optimizer.memory_head, optimizer2.memory_head);
+            assert_equal_vector_sequence(optimizer.s, sizeof(double) * size,
+                    3, optimizer2.s, sizeof(double) * size, 3);
+            assert_equal_vector_sequence(optimizer.y, sizeof(double) * size,
+                    3, optimizer2.y, sizeof(double) * size, 3);
+            assert_equal_memory(optimizer.prev_grad, sizeof(double) * size,
+                    optimizer2.prev_grad, sizeof(double) * size);
+        }
+        free_rnn_optimizer(&optimizer);
+        free_rnn_optimizer(&optimizer2);
+        free_rnn_optimizer(&optimizer3);
+    }
+}
+
+
+void test_rnn_state_setup (
+        struct recurrent_neural_network *rnn,
+        int target_num,
+        int *target_length);
+
+static void test_rnn_optimizer_setup (
+        struct recurrent_neural_network *rnn,
+        unsigned long seed,
+        int in_state_size,
+        int c_state_size,
+        int out_state_size,
+        int rep_init_size,
+        int target_num,
+        int *target_length)
+{
+    init_genrand(seed);
+    init_recurrent_neural_network(rnn, in_state_size, c_state_size,
+            out_state_size, rep_init_size);
+    test_rnn_state_setup(rnn, target_num, target_length);
+}
+
+
+void test_rnn_optimizer (void)
+{
+    struct recurrent_neural_network rnn[3];
+    test_rnn_optimizer_setup(rnn, 8921L, 4, 10, 4, 2, 2, (int[]){50,30});
+    test_rnn_optimizer_setup(rnn+1, 2231L, 0, 8, 3, 1, 3,
+            (int[]){40,40,20});
+    rnn_set_tau(&rnn[1].rnn_p, (double[]){1,2,3,4,5,6,7,INFINITY});
+    rnn[1].rnn_p.const_init_c[0] = 1;
+    test_rnn_optimizer_setup(rnn+2, 731L, 5, 12, 5, 1, 1, (int[]){60});
+    rnn_delete_connection(rnn[2].rnn_p.c_state_size,
+            rnn[2].rnn_p.connection_cc[3], 2, 7);
+    rnn_delete_connection(rnn[2].rnn_p.c_state_size,
+            rnn[2].rnn_p.connection_oc[1], 0, 4);
+    rnn_reset_weight_by_connection(&rnn[2].rnn_p);
+
+    for (int i = 0; i < 3; i++) {
+        mu_run_test_with_args(test_init_rnn_optimizer, rnn + i);
+        mu_run_test_with_args(test_momentum_optimizer, rnn + i);
+        mu_run_test_with_args(test_adam_optimizer, rnn + i);
+        mu_run_test_with_args(test_lbfgs_optimizer, rnn + i);
+        mu_run_test_with_args(test_lbfgs_objective, rnn + i);
+        mu_run_test_with_args(test_fwrite_rnn_optimizer, rnn + i);
+        free_recurrent_neural_network(rnn + i);
+    }
+}
+
@@ -23,6 +23,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "minunit.h"
 #include "my_assert.h"
@@ -56,6 +59,7 @@ static void test_new_rnn_runner (void)
 
 typedef struct test_rnn_runner_data {
     struct rnn_runner runner;
+    struct recurrent_neural_network rnn;
     int in_state_size;
     int c_state_size;
     int out_state_size;
@@ -83,13 +87,13 @@ static void test_init_rnn_runner (
         int target_num,
         int *target_length)
 {
-    struct recurrent_neural_network rnn;
+    struct recurrent_neural_network *rnn = &t_data->rnn;
     FILE *fp;
 
-    init_recurrent_neural_network(&rnn, in_state_size, c_state_size,
+    init_recurrent_neural_network(rnn, in_state_size, c_state_size,
             out_state_size, rep_init_size);
-    rnn.rnn_p.output_type = output_type;
-    test_rnn_state_setup(&rnn, target_num, target_length);
+    rnn->rnn_p.output_type = output_type;
+    test_rnn_state_setup(rnn, target_num, target_length);
 
     fp = tmpfile();
     if (fp == NULL) {
@@ -100,7 +104,7 @@ static void test_init_rnn_runner (
         print_error_msg();
         exit(EXIT_FAILURE);
     }
-    fwrite_recurrent_neural_network(&rnn, fp);
+    fwrite_recurrent_neural_network(rnn, fp);
     fseek(fp, 0L, SEEK_SET);
     init_rnn_runner(&t_data->runner, fp);
     fclose(fp);
@@ -126,11 +130,21 @@ static void test_init_rnn_runner (
     assert_equal_int((int)output_type,
             rnn_output_type_from_runner(&t_data->runner));
     assert_equal_int(target_num, rnn_target_num_from_runner(&t_data->runner));
-    assert_equal_rnn_p(&rnn.rnn_p, &t_data->runner.rnn.rnn_p);
+    assert_equal_rnn_p(&rnn->rnn_p, &t_data->runner.rnn.rnn_p);
+    // only the state of the runner resides in memory
+    assert_equal_int(1, t_data->runner.rnn.series_num);
+    // which has no gradients of the parameters fixed in the runner
+    const struct rnn_state *rnn_s = t_data->runner.rnn.rnn_s;
+    assert_equal_pointer(NULL, rnn_s->delta_w_ci);
+    assert_equal_pointer(NULL, rnn_s->delta_w_cc);
+    assert_equal_pointer(NULL, rnn_s->delta_w_oc);
+    assert_equal_pointer(NULL, rnn_s->delta_w_vc);
+    assert_equal_pointer(NULL, rnn_s->delta_t_c);
+    assert_equal_pointer(NULL, rnn_s->delta_tau);
     for (int i = 0; i < target_num; i++) {
-        assert_equal_rnn_s(rnn.rnn_s + i, t_data->runner.rnn.rnn_s + i);
+        assert_equal_int(rnn->rnn_s[i].length,
+                t_data->runner.model->series[i].length);
     }
-    free_recurrent_neural_network(&rnn);
 }
 
 
@@ -141,11 +155,11 @@ static void test_set_init_state_of_rnn_runner (
     for (int i = 0; i < t_data->target_num; i++) {
         set_init_state_of_rnn_runner(runner, i);
         int length = rnn_delay_length_from_runner(runner);
-        if (length > runner->rnn.rnn_s[i].length) {
-            length = runner->rnn.rnn_s[i].length;
+        if (length > t_data->rnn.rnn_s[i].length) {
+            length = t_data->rnn.rnn_s[i].length;
         }
         const struct rnn_state *dst = rnn_state_from_runner(runner);
-        const struct rnn_state *src = runner->rnn.rnn_s + i;
+        const struct rnn_state *src = t_data->rnn.rnn_s + i;
         assert_equal_vector_sequence(src->in_state, src->rnn_p->in_state_size,
                 length, dst->in_state, dst->rnn_p->in_state_size, length);
         assert_equal_memory(src->init_c_state, src->rnn_p->c_state_size *
@@ -164,7 +178,7 @@ static void test_update_rnn_runner (struct test_rnn_runner_data *t_data)
     const int out_mem_size = t_data->out_state_size * sizeof(double);
     for (int i = 0; i < t_data->target_num; i++) {
         set_init_state_of_rnn_runner(runner, i);
-        struct rnn_state *rnn_s = runner->rnn.rnn_s + i;
+        struct rnn_state *rnn_s = t_data->rnn.rnn_s + i;
         rnn_forward_dynamics_in_closed_loop(rnn_s, t_data->delay_length);
         for (int n = 0; n < rnn_s->length; n++) {
             update_rnn_runner(runner);
@@ -183,6 +197,158 @@ static void test_update_rnn_runner (struct test_rnn_runner_data *t_data)
 }
 
 
+static struct rnn_model* new_test_rnn_model (
+        struct test_rnn_runner_data *t_data)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("Cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    FWRITE(&t_data->delay_length, 1, fp);
+    fwrite_recurrent_neural_network(&t_data->rnn, fp);
+    fseek(fp, 0L, SEEK_SET);
+    struct rnn_model *model = new_rnn_model(fp);
+    fclose(fp);
+    return model;
+}
+
+typedef struct test_shared_runner_data {
+    struct rnn_runner runner;
+    const struct rnn_state *rnn_s;
+    int out_state_size;
+    int error;
+} test_shared_runner_data;
+
+static void* run_shared_runner (void *arg)
+{
+    struct test_shared_runner_data *data = arg;
+    const int out_mem_size = data->out_state_size * sizeof(double);
+    data->error = 0;
+    for (int n = 0; n < data->rnn_s->length; n++) {
+        update_rnn_runner(&data->runner);
+        if (memcmp(data->rnn_s->out_state[n],
+                    rnn_out_state_from_runner(&data->runner),
+                    out_mem_size) != 0) {
+            data->error = 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * runners sharing a model, which are updated at once, agree with the closed
+ * loop dynamics computed by test_update_rnn_runner
+ */
+static void test_share_rnn_model (struct test_rnn_runner_data *t_data)
+{
+    const int num = t_data->target_num;
+    struct test_shared_runner_data data[num];
+    struct rnn_model *model = new_test_rnn_model(t_data);
+    assert_equal_int(1, model->ref_count);
+
+    for (int i = 0; i < num; i++) {
+        init_rnn_runner_with_model(&data[i].runner, model);
+        set_init_state_of_rnn_runner(&data[i].runner, i);
+        data[i].rnn_s = t_data->rnn.rnn_s + i;
+        data[i].out_state_size = t_data->out_state_size;
+        assert_equal_pointer(model->rnn_p.weight_cc,
+                data[i].runner.rnn.rnn_p.weight_cc);
+    }
+    assert_equal_int(num + 1, model->ref_count);
+    release_rnn_model(model);
+    assert_equal_int(num, model->ref_count);
+
+#ifdef HAVE_PTHREAD
+    pthread_t th[num];
+    for (int i = 0; i < num; i++) {
+        pthread_create(th + i, NULL, run_shared_runner, data + i);
+    }
+    for (int i = 0; i < num; i++) {
+        pthread_join(th[i], NULL);
+    }
+#else
+    for (int i = 0; i < num; i++) {
+        run_shared_runner(data + i);
+    }
+#endif
+    for (int i = 0; i < num; i++) {
+        assert_equal_int(0, data[i].error);
+        assert_equal_int(rnn_target_num_from_runner(&t_data->runner),
+                rnn_target_num_from_runner(&data[i].runner));
+        free_rnn_runner(&data[i].runner);
+    }
+}
+
+
+/*
+ * runners updated in a batch agree with runners updated one by one, where
+ * the batch is split into blocks of the runners with the same model
+ */
+static void test_update_rnn_runner_batch (struct test_rnn_runner_data *t_data)
+{
+    const int num = RNN_RUNNER_BATCH_SIZE + 30;
+    const int c_mem_size = t_data->c_state_size * sizeof(double);
+    const int out_mem_size = t_data->out_state_size * sizeof(double);
+    struct rnn_model *model[2];
+    struct rnn_runner runner[num], runner2[num], *batch[num];
+    model[0] = new_test_rnn_model(t_data);
+    model[1] = new_test_rnn_model(t_data);
+    for (int k = 0; k < num; k++) {
+        struct rnn_model *m = model[(k / 20) % 2];
+        init_rnn_runner_with_model(runner + k, m);
+        init_rnn_runner_with_model(runner2 + k, m);
+        set_init_state_of_rnn_runner(runner + k, k % (t_data->target_num + 1));
+        struct rnn_state *src = rnn_state_from_runner(runner + k);
+        struct rnn_state *dst = rnn_state_from_runner(runner2 + k);
+        for (int n = 0; n < src->length; n++) {
+            memcpy(dst->in_state[n], src->in_state[n],
+                    t_data->in_state_size * sizeof(double));
+        }
+        memcpy(dst->init_c_state, src->init_c_state, c_mem_size);
+        memcpy(dst->init_c_inter_state, src->init_c_inter_state, c_mem_size);
+        batch[k] = runner2 + k;
+    }
+    release_rnn_model(model[0]);
+    release_rnn_model(model[1]);
+
+    for (int n = 0; n < 5; n++) {
+        for (int k = 0; k < num; k++) {
+            update_rnn_runner(runner + k);
+        }
+        update_rnn_runner_batch(batch, num);
+    }
+    for (int n = 0; n < 10; n++) {
+        for (int k = 0; k < num; k++) {
+            update_rnn_runner(runner + k);
+        }
+    }
+    update_rnn_runner_batch_with_steps(batch, num, 10);
+
+    for (int k = 0; k < num; k++) {
+        assert_equal_memory(rnn_out_state_from_runner(runner + k),
+                out_mem_size, rnn_out_state_from_runner(runner2 + k),
+                out_mem_size);
+        if (t_data->output_type == STANDARD_TYPE) {
+            assert_equal_memory(rnn_var_state_from_runner(runner + k),
+                    out_mem_size, rnn_var_state_from_runner(runner2 + k),
+                    out_mem_size);
+        }
+        assert_equal_memory(rnn_c_state_from_runner(runner + k), c_mem_size,
+                rnn_c_state_from_runner(runner2 + k), c_mem_size);
+        assert_equal_memory(rnn_c_inter_state_from_runner(runner + k),
+                c_mem_size, rnn_c_inter_state_from_runner(runner2 + k),
+                c_mem_size);
+        assert_equal_memory(rnn_in_state_from_runner(runner + k),
+                t_data->in_state_size * sizeof(double),
+                rnn_in_state_from_runner(runner2 + k),
+                t_data->in_state_size * sizeof(double));
+        free_rnn_runner(runner + k);
+        free_rnn_runner(runner2 + k);
+    }
+}
+
+
 static void test_rnn_in_state_size_from_runner (
         struct test_rnn_runner_data *t_data)
 {
@@ -297,6 +463,8 @@ void test_rnn_runner (void)
     for (int i = 0; i < 4; i++) {
         mu_run_test_with_args(test_set_init_state_of_rnn_runner, t_data + i);
         mu_run_test_with_args(test_update_rnn_runner, t_data + i);
+        mu_run_test_with_args(test_share_rnn_model, t_data + i);
+        mu_run_test_with_args(test_update_rnn_runner_batch, t_data + i);
         mu_run_test_with_args(test_rnn_in_state_size_from_runner, t_data + i);
         mu_run_test_with_args(test_rnn_c_state_size_from_runner, t_data + i);
         mu_run_test_with_args(test_rnn_out_state_size_from_runner, t_data + i);
@@ -312,6 +480,7 @@ void test_rnn_runner (void)
         mu_run_test_with_args(test_rnn_state_from_runner, t_data + i);
 
         free_rnn_runner(&t_data[i].runner);
+        free_recurrent_neural_network(&t_data[i].rnn);
     }
 }
 
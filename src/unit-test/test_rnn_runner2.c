@@ -0,0 +1,527 @@
+/*
+    Copyright (c) 2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define TEST_CODE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "minunit.h"
+#include "my_assert.h"
+#include "utils.h"
+#include "rnn_runner2.h"
+
+
+/* assert functions */
+
+static void assert_equal_window (
+        const struct rnn_state *rnn1_s,
+        const struct rnn_state *rnn2_s)
+{
+    const struct rnn_parameters *rnn_p = rnn1_s->rnn_p;
+    const int in_msz = rnn_p->in_state_size * sizeof(double);
+    const int c_msz = rnn_p->c_state_size * sizeof(double);
+    const int out_msz = rnn_p->out_state_size * sizeof(double);
+    const int length = rnn1_s->length;
+    assert_equal_int(rnn1_s->length, rnn2_s->length);
+    assert_equal_memory(rnn1_s->init_c_state, c_msz, rnn2_s->init_c_state,
+            c_msz);
+    assert_equal_memory(rnn1_s->init_c_inter_state, c_msz,
+            rnn2_s->init_c_inter_state, c_msz);
+    assert_equal_vector_sequence(rnn1_s->in_state, in_msz, length,
+            rnn2_s->in_state, in_msz, length);
+    assert_equal_vector_sequence(rnn1_s->teach_state, out_msz, length,
+            rnn2_s->teach_state, out_msz, length);
+    assert_equal_vector_sequence(rnn1_s->c_state, c_msz, length,
+            rnn2_s->c_state, c_msz, length);
+    assert_equal_vector_sequence(rnn1_s->c_inter_state, c_msz, length,
+            rnn2_s->c_inter_state, c_msz, length);
+    assert_equal_memory(rnn1_s->out_state[length-1], out_msz,
+            rnn2_s->out_state[length-1], out_msz);
+    if (rnn_p->output_type == STANDARD_TYPE) {
+        assert_equal_memory(rnn1_s->var_state[length-1], out_msz,
+                rnn2_s->var_state[length-1], out_msz);
+    }
+}
+
+
+
+
+/* test functions */
+
+typedef struct test_rnn_runner2_data {
+    struct rnn_model *model;
+    struct recurrent_neural_network rnn;
+    int in_state_size;
+    int c_state_size;
+    int delay_length;
+} test_rnn_runner2_data;
+
+
+void test_rnn_state_setup (
+        struct recurrent_neural_network *rnn,
+        int target_num,
+        int *target_length);
+
+static void test_rnn_runner2_data_setup (
+        struct test_rnn_runner2_data *t_data,
+        int in_state_size,
+        int c_state_size,
+        int rep_init_size,
+        int delay_length,
+        rnn_output_t output_type,
+        int target_num,
+        int *target_length)
+{
+    struct recurrent_neural_network *rnn = &t_data->rnn;
+    init_recurrent_neural_network(rnn, in_state_size, c_state_size,
+            in_state_size, rep_init_size);
+    rnn->rnn_p.output_type = output_type;
+    test_rnn_state_setup(rnn, target_num, target_length);
+
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("Cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    FWRITE(&delay_length, 1, fp);
+    fwrite_recurrent_neural_network(rnn, fp);
+    fseek(fp, 0L, SEEK_SET);
+    t_data->model = new_rnn_model(fp);
+    fclose(fp);
+
+    t_data->in_state_size = in_state_size;
+    t_data->c_state_size = c_state_size;
+    t_data->delay_length = delay_length;
+}
+
+static void test_rnn_runner2_data_free (struct test_rnn_runner2_data *t_data)
+{
+    release_rnn_model(t_data->model);
+    free_recurrent_neural_network(&t_data->rnn);
+}
+
+static void set_test_input (
+        double *input,
+        int size,
+        int n)
+{
+    for (int i = 0; i < size; i++) {
+        input[i] = 0.5 + 0.4 * sin(0.3 * n + i);
+    }
+}
+
+static void set_test_window (
+        struct rnn_runner2 *runner,
+        int in_state_size)
+{
+    struct rnn_state *rnn_s = rnn_state_from_runner2(runner);
+    for (int n = 0; n < rnn_s->length; n++) {
+        set_test_input(rnn_s->in_state[n], in_state_size, -n);
+        set_test_input(rnn_s->teach_state[n], in_state_size, -n);
+    }
+}
+
+
+/*
+ * The window of the reference below slides by moving all rows of the arrays
+ * carried over to the next update, as rnn_runner2 did before the rows were
+ * kept as ring buffers.
+ */
+static void init_memmove_window (
+        struct recurrent_neural_network *ref,
+        struct rnn_runner2 *runner)
+{
+    const struct rnn_state *src = rnn_state_from_runner2(runner);
+    const struct rnn_parameters *rnn_p = src->rnn_p;
+    ref->rnn_p = runner->rnn.rnn_p;
+    ref->series_num = 0;
+    ref->rnn_s = NULL;
+    rnn_add_target(ref, src->length, NULL, NULL);
+    struct rnn_state *dst = ref->rnn_s;
+    for (int n = 0; n < src->length; n++) {
+        memcpy(dst->in_state[n], src->in_state[n], sizeof(double) *
+                rnn_p->in_state_size);
+        memcpy(dst->teach_state[n], src->teach_state[n], sizeof(double) *
+                rnn_p->out_state_size);
+    }
+    memcpy(dst->init_c_state, src->init_c_state, sizeof(double) *
+            rnn_p->c_state_size);
+    memcpy(dst->init_c_inter_state, src->init_c_inter_state, sizeof(double) *
+            rnn_p->c_state_size);
+    memcpy(dst->delta_init_c_inter_state, src->delta_init_c_inter_state,
+            sizeof(double) * rnn_p->c_state_size);
+    memcpy(dst->beta_init_c, src->beta_init_c, sizeof(double) *
+            rnn_p->rep_init_size);
+    memcpy(dst->delta_beta_init_c, src->delta_beta_init_c, sizeof(double) *
+            rnn_p->rep_init_size);
+    memcpy(dst->gate_init_c, src->gate_init_c, sizeof(double) *
+            rnn_p->rep_init_size);
+}
+
+static void update_memmove_window (
+        struct recurrent_neural_network *ref,
+        int delay_length,
+        const double *input,
+        int reg_count,
+        double rho_init,
+        double momentum)
+{
+    struct rnn_state *rnn_s = ref->rnn_s;
+    const struct rnn_parameters *rnn_p = rnn_s->rnn_p;
+
+    memmove(rnn_s->in_state[rnn_s->length - 1], input, sizeof(double) *
+            rnn_p->in_state_size);
+    memmove(rnn_s->teach_state[rnn_s->length - delay_length - 1], input,
+            sizeof(double) * rnn_p->out_state_size);
+
+    int tmp_length = rnn_s->length;
+    rnn_s->length -= delay_length;
+    for (int i = 0; i < reg_count; i++) {
+        rnn_forward_backward_dynamics(rnn_s);
+        rnn_update_delta_init_c_inter_state(rnn_s, momentum);
+        rnn_update_init_c_inter_state(rnn_s, rho_init);
+    }
+    rnn_s->length = tmp_length;
+
+    rnn_forward_backward_dynamics(rnn_s);
+    memmove(rnn_s->init_c_inter_state, rnn_s->c_inter_state[0], sizeof(double) *
+            rnn_p->c_state_size);
+    memmove(rnn_s->init_c_state, rnn_s->c_state[0], sizeof(double) *
+            rnn_p->c_state_size);
+    for (int n = 1; n < rnn_s->length; n++) {
+        memmove(rnn_s->teach_state[n-1], rnn_s->teach_state[n], sizeof(double) *
+                rnn_p->out_state_size);
+        memmove(rnn_s->in_state[n-1], rnn_s->in_state[n], sizeof(double) *
+                rnn_p->in_state_size);
+        memmove(rnn_s->c_inter_state[n-1], rnn_s->c_inter_state[n],
+                sizeof(double) * rnn_p->c_state_size);
+        memmove(rnn_s->c_state[n-1], rnn_s->c_state[n], sizeof(double) *
+                rnn_p->c_state_size);
+    }
+}
+
+/*
+ * the state of a runner has the gradients of the initial state only, since
+ * the weights, the thresholds and the time constants are fixed
+ */
+static void test_init_rnn_runner2 (struct test_rnn_runner2_data *t_data)
+{
+    struct rnn_runner2 runner;
+    init_rnn_runner2_with_model(&runner, t_data->model, 5);
+    const struct rnn_state *rnn_s = rnn_state_from_runner2(&runner);
+    assert_equal_int(5 + t_data->delay_length, rnn_s->length);
+    assert_equal_pointer(NULL, rnn_s->delta_w_ci);
+    assert_equal_pointer(NULL, rnn_s->delta_w_cc);
+    assert_equal_pointer(NULL, rnn_s->delta_w_oc);
+    assert_equal_pointer(NULL, rnn_s->delta_w_vc);
+    assert_equal_pointer(NULL, rnn_s->delta_t_c);
+    assert_equal_pointer(NULL, rnn_s->delta_t_o);
+    assert_equal_pointer(NULL, rnn_s->delta_t_v);
+    assert_equal_pointer(NULL, rnn_s->delta_tau);
+    mu_assert(rnn_s->delta_i != NULL);
+    mu_assert(rnn_s->delta_b != NULL);
+    free_rnn_runner2(&runner);
+}
+
+/*
+ * the random initial state of a runner is drawn from its own generator,
+ * which is seeded by the global one at the initialization
+ */
+static void test_set_init_state_of_rnn_runner2 (
+        struct test_rnn_runner2_data *t_data)
+{
+    struct rnn_runner2 runner, runner2;
+    init_genrand(4L);
+    init_rnn_runner2_with_model(&runner, t_data->model, 5);
+    init_genrand(4L);
+    init_rnn_runner2_with_model(&runner2, t_data->model, 5);
+    // the draws from the global generator do not affect the runners
+    genrand_real3();
+    set_init_state_of_rnn_runner2(&runner, -1);
+    genrand_real3();
+    set_init_state_of_rnn_runner2(&runner2, -1);
+
+    const struct rnn_state *rnn_s = rnn_state_from_runner2(&runner);
+    const struct rnn_state *rnn2_s = rnn_state_from_runner2(&runner2);
+    const int in_msz = t_data->in_state_size * sizeof(double);
+    const int c_msz = t_data->c_state_size * sizeof(double);
+    assert_equal_vector_sequence(rnn_s->in_state, in_msz, rnn_s->length,
+            rnn2_s->in_state, in_msz, rnn2_s->length);
+    assert_equal_memory(rnn_s->init_c_state, c_msz, rnn2_s->init_c_state,
+            c_msz);
+    assert_equal_memory(rnn_s->init_c_inter_state, c_msz,
+            rnn2_s->init_c_inter_state, c_msz);
+    set_init_state_of_rnn_runner2(&runner, -1);
+    mu_assert(memcmp(rnn_s->init_c_state, rnn2_s->init_c_state, c_msz) != 0);
+    free_rnn_runner2(&runner);
+    free_rnn_runner2(&runner2);
+}
+
+/*
+ * the window slid by the ring buffers agrees with the window slid by moving
+ * all rows, over several turns of the rings
+ */
+static void test_update_rnn_runner2 (
+        struct test_rnn_runner2_data *t_data,
+        int window_length)
+{
+    struct rnn_runner2 runner;
+    struct recurrent_neural_network ref;
+    double input[t_data->in_state_size];
+
+    init_rnn_runner2_with_model(&runner, t_data->model, window_length);
+    set_init_state_of_rnn_runner2(&runner, 0);
+    set_test_window(&runner, t_data->in_state_size);
+    init_memmove_window(&ref, &runner);
+    const int step = 3 * (window_length + t_data->delay_length) + 2;
+    for (int n = 0; n < step; n++) {
+        set_test_input(input, t_data->in_state_size, n);
+        update_rnn_runner2(&runner, input, 3, 0.1, 0.9);
+        update_memmove_window(&ref, t_data->delay_length, input, 3, 0.1, 0.9);
+        assert_equal_window(ref.rnn_s, rnn_state_from_runner2(&runner));
+    }
+    rnn_clean_target(&ref);
+    free_rnn_runner2(&runner);
+}
+
+/*
+ * in the incremental mode with tolerance 0, the results are bit-identical
+ * to those without the mode, even if some inputs are missing
+ */
+static void test_set_incremental_mode_of_rnn_runner2 (
+        struct test_rnn_runner2_data *t_data,
+        int window_length)
+{
+    struct rnn_runner2 runner, runner2;
+    double input[t_data->in_state_size];
+
+    init_rnn_runner2_with_model(&runner, t_data->model, window_length);
+    init_rnn_runner2_with_model(&runner2, t_data->model, window_length);
+    struct rnn_state *rnn_s = rnn_state_from_runner2(&runner);
+    struct rnn_state *rnn2_s = rnn_state_from_runner2(&runner2);
+    set_init_state_of_rnn_runner2(&runner, 0);
+    set_init_state_of_rnn_runner2(&runner2, 0);
+    // the rows of the windows, which are referred to while the inputs are
+    // missing, are the same in both runners
+    for (int n = 0; n < rnn_s->length; n++) {
+        set_test_input(rnn_s->teach_state[n], t_data->in_state_size, -n);
+        memcpy(rnn2_s->teach_state[n], rnn_s->teach_state[n], sizeof(double) *
+                t_data->in_state_size);
+        memcpy(rnn2_s->in_state[n], rnn_s->in_state[n], sizeof(double) *
+                t_data->in_state_size);
+    }
+    set_incremental_mode_of_rnn_runner2(&runner2, 1, 0);
+    for (int n = 0; n < 300; n++) {
+        set_test_input(input, t_data->in_state_size, n);
+        double *x = (n % 7 == 3 || n % 11 == 5) ? NULL : input;
+        update_rnn_runner2(&runner, x, 2, 0.1, 0.9);
+        update_rnn_runner2(&runner2, x, 2, 0.1, 0.9);
+        const int out_msz = rnn_s->rnn_p->out_state_size * sizeof(double);
+        assert_equal_window(rnn_s, rnn2_s);
+        assert_equal_vector_sequence(rnn_s->out_state, out_msz,
+                rnn_s->length, rnn2_s->out_state, out_msz, rnn2_s->length);
+    }
+    free_rnn_runner2(&runner);
+    free_rnn_runner2(&runner2);
+}
+
+
+/*
+ * the number of iterations is 0 with no time budget, and is max_reg_count
+ * with an unlimited time budget, in which case the results are the same as
+ * those of update_rnn_runner2
+ */
+static void test_update_rnn_runner2_with_deadline (
+        struct test_rnn_runner2_data *t_data)
+{
+    struct rnn_runner2 runner, runner2;
+    double input[t_data->in_state_size];
+
+    init_rnn_runner2_with_model(&runner, t_data->model, 5);
+    init_rnn_runner2_with_model(&runner2, t_data->model, 5);
+    set_init_state_of_rnn_runner2(&runner, 0);
+    set_init_state_of_rnn_runner2(&runner2, 0);
+    set_test_window(&runner, t_data->in_state_size);
+    set_test_window(&runner2, t_data->in_state_size);
+    for (int n = 0; n < 20; n++) {
+        set_test_input(input, t_data->in_state_size, n);
+        int count = update_rnn_runner2_with_deadline(&runner, input, 1e9, 7,
+                0.1, 0.9);
+        assert_equal_int(7, count);
+        update_rnn_runner2(&runner2, input, 7, 0.1, 0.9);
+        assert_equal_window(rnn_state_from_runner2(&runner2),
+                rnn_state_from_runner2(&runner));
+    }
+    for (int n = 20; n < 25; n++) {
+        set_test_input(input, t_data->in_state_size, n);
+        assert_equal_int(0, update_rnn_runner2_with_deadline(&runner, input,
+                    0, 7, 0.1, 0.9));
+        assert_equal_int(0, update_rnn_runner2_with_deadline(&runner, input,
+                    -1, 7, 0.1, 0.9));
+    }
+    free_rnn_runner2(&runner);
+    free_rnn_runner2(&runner2);
+}
+
+/*
+ * the percentile is selected from the latencies of the updates in the ring,
+ * which holds RNN_RUNNER2_LATENCY_SIZE latest ones
+ */
+static void test_rnn_step_latency_from_runner2 (
+        struct test_rnn_runner2_data *t_data)
+{
+    struct rnn_runner2 runner;
+    double input[t_data->in_state_size];
+
+    init_rnn_runner2_with_model(&runner, t_data->model, 1);
+    set_init_state_of_rnn_runner2(&runner, 0);
+    set_test_window(&runner, t_data->in_state_size);
+    set_test_input(input, t_data->in_state_size, 0);
+    assert_equal_double(0, rnn_step_latency_from_runner2(&runner, 50), 0);
+
+    // before the ring is full
+    for (int n = 0; n < 10; n++) {
+        update_rnn_runner2(&runner, input, 1, 0.1, 0.9);
+    }
+    assert_equal_int(10, runner.latency_num);
+    double min = runner.latency[0], max = runner.latency[0];
+    for (int n = 1; n < 10; n++) {
+        min = fmin(min, runner.latency[n]);
+        max = fmax(max, runner.latency[n]);
+    }
+    assert_equal_double(min, rnn_step_latency_from_runner2(&runner, 0), 0);
+    assert_equal_double(max, rnn_step_latency_from_runner2(&runner, 100), 0);
+    const double x[] = {5, 1, 4, 2, 3};
+    memcpy(runner.latency, x, sizeof(x));
+    runner.latency_num = 5;
+    assert_equal_double(1, rnn_step_latency_from_runner2(&runner, 0), 0);
+    assert_equal_double(1, rnn_step_latency_from_runner2(&runner, 20), 0);
+    assert_equal_double(2, rnn_step_latency_from_runner2(&runner, 21), 0);
+    assert_equal_double(3, rnn_step_latency_from_runner2(&runner, 50), 0);
+    assert_equal_double(5, rnn_step_latency_from_runner2(&runner, 100), 0);
+    assert_equal_double(5, rnn_step_latency_from_runner2(&runner, 200), 0);
+
+    // after the ring wraps around
+    runner.latency_num = 10;
+    for (int n = 10; n < RNN_RUNNER2_LATENCY_SIZE + 6; n++) {
+        update_rnn_runner2(&runner, input, 1, 0.1, 0.9);
+    }
+    assert_equal_int(RNN_RUNNER2_LATENCY_SIZE, runner.latency_num);
+    assert_equal_int(6, runner.latency_head);
+    for (int n = 0; n < RNN_RUNNER2_LATENCY_SIZE; n++) {
+        runner.latency[n] = (37 * n) % RNN_RUNNER2_LATENCY_SIZE + 1;
+    }
+    assert_equal_double(1, rnn_step_latency_from_runner2(&runner, 0), 0);
+    assert_equal_double(512, rnn_step_latency_from_runner2(&runner, 50), 0);
+    assert_equal_double(1014, rnn_step_latency_from_runner2(&runner, 99), 0);
+    assert_equal_double(1024, rnn_step_latency_from_runner2(&runner, 100), 0);
+    free_rnn_runner2(&runner);
+}
+
+
+
+#ifdef HAVE_PTHREAD
+#define GENRAND_THREAD_NUM 4
+#define GENRAND_DRAW_NUM 20000
+
+static void* draw_genrand (void *arg)
+{
+    uint32_t *x = arg;
+    for (int n = 0; n < GENRAND_DRAW_NUM; n++) {
+        x[n] = xor128();
+    }
+    return NULL;
+}
+
+static int compare_uint32 (const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * the global generator, from which the generators of runners are split, is
+ * shared by threads without losing or repeating any draw
+ */
+static void test_genrand_from_threads (void)
+{
+    const int num = GENRAND_THREAD_NUM * GENRAND_DRAW_NUM;
+    uint32_t *x, *y;
+    MALLOC(x, num);
+    MALLOC(y, num);
+    init_genrand(7L);
+    for (int n = 0; n < num; n++) {
+        x[n] = xor128();
+    }
+    init_genrand(7L);
+    pthread_t th[GENRAND_THREAD_NUM];
+    for (int i = 0; i < GENRAND_THREAD_NUM; i++) {
+        pthread_create(th + i, NULL, draw_genrand, y + i * GENRAND_DRAW_NUM);
+    }
+    for (int i = 0; i < GENRAND_THREAD_NUM; i++) {
+        pthread_join(th[i], NULL);
+    }
+    qsort(x, num, sizeof(uint32_t), compare_uint32);
+    qsort(y, num, sizeof(uint32_t), compare_uint32);
+    assert_equal_memory(x, num * sizeof(uint32_t), y, num * sizeof(uint32_t));
+    FREE(x);
+    FREE(y);
+}
+#endif
+
+
+void test_rnn_runner2 (void)
+{
+    struct test_rnn_runner2_data t_data[2];
+
+    init_genrand(2011L);
+
+    test_rnn_runner2_data_setup(t_data, 2, 5, 2, 1, STANDARD_TYPE, 2,
+            (int[]){20,30});
+    test_rnn_runner2_data_setup(t_data+1, 3, 8, 3, 3, SOFTMAX_TYPE, 1,
+            (int[]){10});
+
+    for (int i = 0; i < 2; i++) {
+        mu_run_test_with_args(test_init_rnn_runner2, t_data + i);
+        mu_run_test_with_args(test_set_init_state_of_rnn_runner2, t_data + i);
+        const int window_length[] = {1, 2, 7};
+        for (int j = 0; j < 3; j++) {
+            mu_run_test_with_args(test_update_rnn_runner2, t_data + i,
+                    window_length[j]);
+        }
+        for (int j = 0; j < 5; j++) {
+            const int window_length[] = {1, 2, 5, 20, 60};
+            mu_run_test_with_args(test_set_incremental_mode_of_rnn_runner2,
+                    t_data + i, window_length[j]);
+        }
+        mu_run_test_with_args(test_update_rnn_runner2_with_deadline,
+                t_data + i);
+        mu_run_test_with_args(test_rnn_step_latency_from_runner2, t_data + i);
+        test_rnn_runner2_data_free(t_data + i);
+    }
+#ifdef HAVE_PTHREAD
+    mu_run_test(test_genrand_from_threads);
+#endif
+}
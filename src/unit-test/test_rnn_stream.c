@@ -0,0 +1,315 @@
+/*
+    Copyright (c) 2009-2011, Jun Namikawa <jnamika@gmail.com>
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose with or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+    MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define TEST_CODE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "minunit.h"
+#include "my_assert.h"
+#include "utils.h"
+#include "rnn_stream.h"
+
+
+void assert_equal_rnn_s (
+        const struct rnn_state *rnn_s,
+        const struct rnn_state *rnn_s2);
+
+
+static void copy_rnn (
+        struct recurrent_neural_network *dst,
+        const struct recurrent_neural_network *src)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        print_error_msg("cannot open tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    fwrite_recurrent_neural_network(src, fp);
+    fseek(fp, 0L, SEEK_SET);
+    fread_recurrent_neural_network(dst, fp);
+    fclose(fp);
+}
+
+/*
+ * The gradients of the weights are summed per thread by the streaming
+ * computation, so that the parameters agree with rnn_learn_s only up to the
+ * rounding errors of the order of summation.
+ */
+static void assert_near_rnn_p (
+        const struct rnn_parameters *rnn_p,
+        const struct rnn_parameters *rnn_p2)
+{
+    assert_equal_int(rnn_p->c_state_size, rnn_p2->c_state_size);
+    for (int i = 0; i < rnn_p->c_state_size; i++) {
+        for (int j = 0; j < rnn_p->in_state_size; j++) {
+            assert_equal_double(rnn_p->weight_ci[i][j],
+                    rnn_p2->weight_ci[i][j], 1e-12);
+            assert_equal_double(rnn_p->delta_weight_ci[i][j],
+                    rnn_p2->delta_weight_ci[i][j], 1e-12);
+        }
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            assert_equal_double(rnn_p->weight_cc[i][j],
+                    rnn_p2->weight_cc[i][j], 1e-12);
+            assert_equal_double(rnn_p->delta_weight_cc[i][j],
+                    rnn_p2->delta_weight_cc[i][j], 1e-12);
+        }
+        assert_equal_double(rnn_p->threshold_c[i], rnn_p2->threshold_c[i],
+                1e-12);
+        assert_equal_double(rnn_p->tau[i], rnn_p2->tau[i], 1e-12);
+    }
+    for (int i = 0; i < rnn_p->out_state_size; i++) {
+        for (int j = 0; j < rnn_p->c_state_size; j++) {
+            assert_equal_double(rnn_p->weight_oc[i][j],
+                    rnn_p2->weight_oc[i][j], 1e-12);
+            assert_equal_double(rnn_p->weight_vc[i][j],
+                    rnn_p2->weight_vc[i][j], 1e-12);
+            assert_equal_double(rnn_p->delta_weight_oc[i][j],
+                    rnn_p2->delta_weight_oc[i][j], 1e-12);
+            assert_equal_double(rnn_p->delta_weight_vc[i][j],
+                    rnn_p2->delta_weight_vc[i][j], 1e-12);
+        }
+        assert_equal_double(rnn_p->threshold_o[i], rnn_p2->threshold_o[i],
+                1e-12);
+        assert_equal_double(rnn_p->threshold_v[i], rnn_p2->threshold_v[i],
+                1e-12);
+    }
+}
+
+static void assert_near_rnn_s (
+        const struct rnn_state *rnn_s,
+        const struct rnn_state *rnn_s2)
+{
+    assert_equal_int(rnn_s->length, rnn_s2->length);
+    for (int i = 0; i < rnn_s->rnn_p->c_state_size; i++) {
+        assert_equal_double(rnn_s->init_c_inter_state[i],
+                rnn_s2->init_c_inter_state[i], 1e-12);
+        assert_equal_double(rnn_s->delta_init_c_inter_state[i],
+                rnn_s2->delta_init_c_inter_state[i], 1e-12);
+    }
+    for (int i = 0; i < rnn_s->rnn_p->rep_init_size; i++) {
+        assert_equal_double(rnn_s->beta_init_c[i], rnn_s2->beta_init_c[i],
+                1e-12);
+    }
+}
+
+
+/* copies rnn whose series are added by rnn_add_streamed_targets */
+static void copy_rnn_with_streamed_targets (
+        struct recurrent_neural_network *dst,
+        const struct recurrent_neural_network *src)
+{
+    int length[src->series_num];
+    const double *input[src->series_num];
+    const double *target[src->series_num];
+    copy_rnn(dst, src);
+    rnn_clean_target(dst);
+    for (int i = 0; i < src->series_num; i++) {
+        length[i] = src->rnn_s[i].length;
+        input[i] = src->rnn_s[i].in_state[0];
+        target[i] = src->rnn_s[i].teach_state[0];
+    }
+    rnn_add_streamed_targets(dst, src->series_num, length, input, target);
+}
+
+
+static void test_init_rnn_stream (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2;
+    struct rnn_stream stream;
+
+    copy_rnn_with_streamed_targets(&rnn2, rnn);
+    for (int i = 0; i < rnn2.series_num; i++) {
+        assert_equal_rnn_s(rnn->rnn_s + i, rnn2.rnn_s + i);
+        assert_equal_pointer(NULL, rnn2.rnn_s[i].c_state);
+        assert_equal_pointer(NULL, rnn2.rnn_s[i].delta_c_inter);
+        assert_equal_pointer(NULL, rnn2.rnn_s[i].delta_w_ci);
+        assert_equal_pointer(NULL, rnn2.rnn_s[i].delta_w_vc);
+    }
+    init_rnn_stream(&stream, &rnn2);
+    int max_length = 0;
+    for (int i = 0; i < rnn->series_num; i++) {
+        if (max_length < rnn->rnn_s[i].length) {
+            max_length = rnn->rnn_s[i].length;
+        }
+    }
+    assert_equal_int(max_length, stream.max_length);
+    mu_assert(stream.work_num >= 1);
+    for (int i = 0; i < stream.work_num; i++) {
+        assert_equal_int(max_length, stream.work[i].length);
+    }
+    free_rnn_stream(&stream);
+    free_recurrent_neural_network(&rnn2);
+}
+
+
+static void test_rnn_stream_forward_dynamics_forall (
+        struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2;
+    struct rnn_stream stream;
+
+    copy_rnn_with_streamed_targets(&rnn2, rnn);
+    init_rnn_stream(&stream, &rnn2);
+    rnn_forward_dynamics_forall(rnn);
+    rnn_stream_forward_dynamics_forall(&stream);
+    for (int i = 0; i < rnn->series_num; i++) {
+        rnn_set_likelihood(rnn->rnn_s + i);
+        assert_equal_double(rnn_get_error(rnn->rnn_s + i), stream.error[i],
+                1e-12);
+        assert_equal_double(rnn_get_likelihood(rnn->rnn_s + i),
+                stream.likelihood[i], 1e-12);
+        assert_equal_pointer(NULL, rnn2.rnn_s[i].c_state);
+    }
+    free_rnn_stream(&stream);
+    free_recurrent_neural_network(&rnn2);
+}
+
+
+static void test_rnn_stream_learn_s (struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2, rnn3, rnn4;
+    struct rnn_stream stream3, stream4;
+
+    copy_rnn(&rnn2, rnn);
+    copy_rnn(&rnn3, rnn);
+    copy_rnn_with_streamed_targets(&rnn4, rnn);
+    double **out_state[rnn->series_num];
+    for (int i = 0; i < rnn->series_num; i++) {
+        out_state[i] = rnn3.rnn_s[i].out_state;
+    }
+    init_rnn_stream(&stream3, &rnn3);
+    init_rnn_stream(&stream4, &rnn4);
+    stream4.release_target = 1;
+    for (int n = 0; n < 3; n++) {
+        rnn_learn_s(&rnn2, 1e-3, 0.9);
+        rnn_stream_learn_s(&stream3, 1e-3, 0.9);
+        rnn_stream_learn_s(&stream4, 1e-3, 0.9);
+        assert_near_rnn_p(&rnn2.rnn_p, &rnn3.rnn_p);
+        assert_near_rnn_p(&rnn2.rnn_p, &rnn4.rnn_p);
+        for (int i = 0; i < rnn2.series_num; i++) {
+            assert_near_rnn_s(rnn2.rnn_s + i, rnn3.rnn_s + i);
+            assert_near_rnn_s(rnn2.rnn_s + i, rnn4.rnn_s + i);
+            assert_equal_double(rnn_get_error(rnn2.rnn_s + i),
+                    stream4.error[i], 1e-12);
+            assert_equal_double(rnn_get_likelihood(rnn2.rnn_s + i),
+                    stream4.likelihood[i], 1e-12);
+        }
+    }
+    // the original work arrays of rnn3 are restored, and rnn4 has neither
+    // work arrays nor gradients of the weights
+    for (int i = 0; i < rnn->series_num; i++) {
+        assert_equal_pointer(out_state[i], rnn3.rnn_s[i].out_state);
+        assert_equal_pointer(NULL, rnn4.rnn_s[i].out_state);
+        assert_equal_pointer(NULL, rnn4.rnn_s[i].delta_w_ci);
+    }
+    free_rnn_stream(&stream3);
+    free_rnn_stream(&stream4);
+    free_recurrent_neural_network(&rnn2);
+    free_recurrent_neural_network(&rnn3);
+    free_recurrent_neural_network(&rnn4);
+}
+
+
+/*
+ * The last gradients of the series with reuse_delta are used as in
+ * rnn_learn_s, while a streamed series is computed regardless of reuse_delta.
+ */
+static void test_rnn_stream_learn_s_with_reuse_delta (
+        struct recurrent_neural_network *rnn)
+{
+    struct recurrent_neural_network rnn2, rnn3, rnn4, rnn5;
+    struct rnn_stream stream3, stream4;
+
+    copy_rnn(&rnn2, rnn);
+    copy_rnn(&rnn3, rnn);
+    copy_rnn_with_streamed_targets(&rnn4, rnn);
+    copy_rnn(&rnn5, rnn);
+    init_rnn_stream(&stream3, &rnn3);
+    init_rnn_stream(&stream4, &rnn4);
+    rnn_learn_s(&rnn2, 1e-3, 0.9);
+    rnn_stream_learn_s(&stream3, 1e-3, 0.9);
+    rnn_stream_learn_s(&stream4, 1e-3, 0.9);
+    rnn_learn_s(&rnn5, 1e-3, 0.9);
+    rnn2.rnn_s[0].reuse_delta = 1;
+    rnn3.rnn_s[0].reuse_delta = 1;
+    rnn4.rnn_s[0].reuse_delta = 1;
+    rnn_learn_s(&rnn2, 1e-3, 0.9);
+    rnn_stream_learn_s(&stream3, 1e-3, 0.9);
+    rnn_stream_learn_s(&stream4, 1e-3, 0.9);
+    rnn_learn_s(&rnn5, 1e-3, 0.9);
+    assert_near_rnn_p(&rnn2.rnn_p, &rnn3.rnn_p);
+    assert_near_rnn_p(&rnn5.rnn_p, &rnn4.rnn_p);
+    free_rnn_stream(&stream3);
+    free_rnn_stream(&stream4);
+    free_recurrent_neural_network(&rnn2);
+    free_recurrent_neural_network(&rnn3);
+    free_recurrent_neural_network(&rnn4);
+    free_recurrent_neural_network(&rnn5);
+}
+
+
+void test_rnn_state_setup (
+        struct recurrent_neural_network *rnn,
+        int target_num,
+        int *target_length);
+
+static void test_rnn_stream_setup (
+        struct recurrent_neural_network *rnn,
+        unsigned long seed,
+        int in_state_size,
+        int c_state_size,
+        int out_state_size,
+        int rep_init_size,
+        int target_num,
+        int *target_length)
+{
+    init_genrand(seed);
+    init_recurrent_neural_network(rnn, in_state_size, c_state_size,
+            out_state_size, rep_init_size);
+    test_rnn_state_setup(rnn, target_num, target_length);
+}
+
+
+void test_rnn_stream (void)
+{
+    struct recurrent_neural_network rnn[3];
+    test_rnn_stream_setup(rnn, 5123L, 4, 10, 4, 2, 3, (int[]){50,80,30});
+    test_rnn_stream_setup(rnn+1, 771L, 0, 8, 3, 1, 2, (int[]){40,20});
+    rnn_set_tau(&rnn[1].rnn_p, (double[]){1,2,3,4,5,6,7,INFINITY});
+    test_rnn_stream_setup(rnn+2, 9091L, 5, 12, 5, 3, 4,
+            (int[]){60,10,35,60});
+    rnn_delete_connection(rnn[2].rnn_p.c_state_size,
+            rnn[2].rnn_p.connection_cc[3], 2, 7);
+    rnn_reset_weight_by_connection(&rnn[2].rnn_p);
+
+    for (int i = 0; i < 3; i++) {
+        mu_run_test_with_args(test_init_rnn_stream, rnn + i);
+        mu_run_test_with_args(test_rnn_stream_forward_dynamics_forall,
+                rnn + i);
+        mu_run_test_with_args(test_rnn_stream_learn_s, rnn + i);
+        mu_run_test_with_args(test_rnn_stream_learn_s_with_reuse_delta,
+                rnn + i);
+        free_recurrent_neural_network(rnn + i);
+    }
+}
+
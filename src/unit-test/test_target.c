@@ -23,6 +23,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <utime.h>
 
 #include "minunit.h"
 #include "my_assert.h"
@@ -195,9 +197,397 @@ static void test_read_target_from_file (void)
 }
 
 
+static void write_text_target (
+        const char *filename,
+        int error_line,
+        int wrong_dim_line)
+{
+    static const char *special[] = {
+        ".5", "5.", "+1.25", "-0", "0x1p-3", "1e400", "-inf", "1.0abc",
+        "12345678901234567890", "0.000000000000000000000000123", "1e-5",
+        "3.14159265358979323846", "7E+2", "2e", "00012.50"};
+    const int special_num = sizeof(special) / sizeof(special[0]);
+    FILE *fp;
+    if ((fp = fopen(filename, "w")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    srand(7);
+    int line = 0;
+    while (line < 2000) {
+        line++;
+        if (line % 97 == 0) {
+            fprintf(fp, "\n");
+            continue;
+        } else if (line % 131 == 0) {
+            fprintf(fp, "# comment only\n");
+            continue;
+        }
+        const int dim = (line == wrong_dim_line) ? 2 : 3;
+        for (int i = 0; i < dim; i++) {
+            const char *sep = (i == 0) ? "" : ((i % 2) ? "\t" : " , ");
+            double x = 2.0 * rand() / RAND_MAX - 1.0;
+            if (line == error_line && i == 1) {
+                fprintf(fp, "%sfoo", sep);
+            } else if (rand() % 10 == 0) {
+                fprintf(fp, "%s%s", sep, special[rand() % special_num]);
+            } else if (rand() % 2) {
+                fprintf(fp, "%s%.17g", sep, x);
+            } else {
+                fprintf(fp, "%s%.4f", sep, x);
+            }
+        }
+        fprintf(fp, (line % 53 == 0) ? " # comment\n" : "\n");
+    }
+    fprintf(fp, "0.5\t0.25\t0.125");
+    fclose(fp);
+}
+
+static void test_read_target_from_text_file (void)
+{
+    const char *separator = " \t,";
+    char filename[64];
+    snprintf(filename, sizeof(filename), "rnn-unit-test-%ld.txt",
+            (long)getpid());
+
+    const int error_line[] = {0, 1500, 0};
+    const int wrong_dim_line[] = {0, 0, 1700};
+    for (int k = 0; k < 3; k++) {
+        struct target_reader t_reader1, t_reader2;
+        write_text_target(filename, error_line[k], wrong_dim_line[k]);
+        FILE *fp;
+        if ((fp = fopen(filename, "r")) == NULL) {
+            print_error_msg("cannot open %s", filename);
+            exit(EXIT_FAILURE);
+        }
+        init_target_reader(&t_reader1);
+        int stat = read_target_from_file(&t_reader1, separator, fp);
+        fclose(fp);
+        init_target_reader(&t_reader2);
+        int stat2 = read_target_from_text_file(&t_reader2, separator,
+                filename);
+        assert_equal_int(stat, stat2);
+        assert_equal_int((k == 0) ? 0 : -1, stat);
+        assert_equal_int(t_reader1.dimension, t_reader2.dimension);
+        assert_equal_int(t_reader1.num, t_reader2.num);
+        for (int i = 0; i < t_reader1.num; i++) {
+            struct target_t *t1 = t_reader1.t_list + i;
+            struct target_t *t2 = t_reader2.t_list + i;
+            assert_equal_int(t1->length, t2->length);
+            assert_equal_int(0, t2->is_mapped);
+            assert_equal_memory(t1->data,
+                    sizeof(double) * t1->length * t_reader1.dimension,
+                    t2->data,
+                    sizeof(double) * t2->length * t_reader2.dimension);
+        }
+        free_target_reader(&t_reader1);
+        free_target_reader(&t_reader2);
+    }
+    // empty file
+    struct target_reader t_reader;
+    FILE *fp;
+    if ((fp = fopen(filename, "w")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    fclose(fp);
+    init_target_reader(&t_reader);
+    mu_assert(read_target_from_text_file(&t_reader, separator, filename) !=
+            -1);
+    assert_equal_int(0, t_reader.num);
+    free_target_reader(&t_reader);
+
+    remove(filename);
+    init_target_reader(&t_reader);
+    mu_assert(read_target_from_text_file(&t_reader, separator, filename) ==
+            -1);
+    free_target_reader(&t_reader);
+}
+
+static void test_read_target_with_cache (void)
+{
+    const char *separator = " \t,";
+    char filename[64], cache_filename[80];
+    snprintf(filename, sizeof(filename), "rnn-unit-test-%ld.txt",
+            (long)getpid());
+    snprintf(cache_filename, sizeof(cache_filename), "%s"
+            TARGET_CACHE_SUFFIX, filename);
+    remove(cache_filename);
+    write_text_target(filename, 0, 0);
+
+    struct target_reader t_reader1, t_reader2;
+    init_target_reader(&t_reader1);
+    mu_assert(read_target_with_cache(&t_reader1, separator, filename) != -1);
+    mu_assert(is_rnn_dataset_file(cache_filename));
+    assert_equal_int(0, t_reader1.t_list[0].is_mapped);
+    init_target_reader(&t_reader2);
+    mu_assert(read_target_with_cache(&t_reader2, separator, filename) != -1);
+    assert_equal_int(1, t_reader2.dataset_num);
+    assert_equal_int(t_reader1.dimension, t_reader2.dimension);
+    assert_equal_int(t_reader1.num, t_reader2.num);
+    for (int i = 0; i < t_reader1.num; i++) {
+        struct target_t *t1 = t_reader1.t_list + i;
+        struct target_t *t2 = t_reader2.t_list + i;
+        assert_equal_int(t1->length, t2->length);
+        assert_equal_int(1, t2->is_mapped);
+        assert_equal_memory(t1->data,
+                sizeof(double) * t1->length * t_reader1.dimension,
+                t2->data,
+                sizeof(double) * t2->length * t_reader2.dimension);
+    }
+    free_target_reader(&t_reader2);
+
+    // the text file is modified
+    struct utimbuf times = {0, 1};
+    utime(filename, &times);
+    init_target_reader(&t_reader2);
+    mu_assert(read_target_with_cache(&t_reader2, separator, filename) != -1);
+    assert_equal_int(0, t_reader2.dataset_num);
+    assert_equal_int(t_reader1.num, t_reader2.num);
+    free_target_reader(&t_reader2);
+
+    // the size is changed but the modification time is not
+    init_target_reader(&t_reader2);
+    mu_assert(read_target_with_cache(&t_reader2, separator, filename) != -1);
+    assert_equal_int(1, t_reader2.dataset_num);
+    free_target_reader(&t_reader2);
+    FILE *fp;
+    if ((fp = fopen(filename, "a")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "\n0 0 0\n");
+    fclose(fp);
+    utime(filename, &times);
+    init_target_reader(&t_reader2);
+    mu_assert(read_target_with_cache(&t_reader2, separator, filename) != -1);
+    assert_equal_int(0, t_reader2.dataset_num);
+    assert_equal_int(t_reader1.num, t_reader2.num);
+    const int last = t_reader1.num - 1;
+    assert_equal_int(t_reader1.t_list[last].length + 1,
+            t_reader2.t_list[last].length);
+    free_target_reader(&t_reader2);
+    free_target_reader(&t_reader1);
+
+    remove(filename);
+    remove(cache_filename);
+}
+
+static void test_read_target_files (void)
+{
+    const char *separator = " \t,";
+    char filename[4][64];
+    char *file_list[5];
+    for (int i = 0; i < 4; i++) {
+        snprintf(filename[i], sizeof(filename[i]), "rnn-unit-test-%ld-%d",
+                (long)getpid(), i);
+    }
+    FILE *fp;
+    write_text_target(filename[0], 0, 0);
+    if ((fp = fopen(filename[1], "w")) == NULL) {
+        print_error_msg("cannot open %s", filename[1]);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "1 2 3\n4 5 6\n\n7 8 9\n");
+    fclose(fp);
+    if ((fp = fopen(filename[3], "w")) == NULL) {
+        print_error_msg("cannot open %s", filename[3]);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "1 2\n");
+    fclose(fp);
+
+    struct target_reader t_reader1, t_reader2;
+    init_target_reader(&t_reader1);
+    mu_assert(read_target_from_text_file(&t_reader1, separator, filename[1])
+            != -1);
+    if ((fp = fopen(filename[2], "wb")) == NULL) {
+        print_error_msg("cannot open %s", filename[2]);
+        exit(EXIT_FAILURE);
+    }
+    fwrite_target_dataset(&t_reader1, 0, t_reader1.num, fp);
+    fclose(fp);
+    mu_assert(read_target_from_text_file(&t_reader1, separator, filename[0])
+            != -1);
+    mu_assert(map_target_file(&t_reader1, filename[2]) != -1);
+    mu_assert(read_target_from_text_file(&t_reader1, separator, filename[1])
+            != -1);
+
+    file_list[0] = filename[1];
+    file_list[1] = filename[0];
+    file_list[2] = filename[2];
+    file_list[3] = filename[1];
+    init_target_reader(&t_reader2);
+    mu_assert(read_target_files(&t_reader2, separator, 4, file_list, 0) !=
+            -1);
+    assert_equal_int(t_reader1.dimension, t_reader2.dimension);
+    assert_equal_int(t_reader1.num, t_reader2.num);
+    assert_equal_int(1, t_reader2.dataset_num);
+    for (int i = 0; i < t_reader1.num; i++) {
+        struct target_t *t1 = t_reader1.t_list + i;
+        struct target_t *t2 = t_reader2.t_list + i;
+        assert_equal_int(t1->length, t2->length);
+        assert_equal_int(t1->is_mapped, t2->is_mapped);
+        assert_equal_memory(t1->data,
+                sizeof(double) * t1->length * t_reader1.dimension,
+                t2->data,
+                sizeof(double) * t2->length * t_reader2.dimension);
+    }
+    free_target_reader(&t_reader2);
+
+    // dimension mismatch
+    file_list[4] = filename[3];
+    init_target_reader(&t_reader2);
+    mu_assert(read_target_files(&t_reader2, separator, 5, file_list, 0) ==
+            -1);
+    free_target_reader(&t_reader2);
+    free_target_reader(&t_reader1);
+
+    for (int i = 0; i < 4; i++) {
+        remove(filename[i]);
+    }
+}
+
+static void test_map_target_file (void)
+{
+    struct target_reader t_reader;
+    char filename[64];
+    snprintf(filename, sizeof(filename), "rnn-unit-test-%ld.bin",
+            (long)getpid());
+
+    const int length[] = {50, 100, 75};
+    const int dim = 6;
+    double **src[3];
+    for (int k = 0; k < 3; k++) {
+        MALLOC2(src[k], length[k], dim);
+        for (int n = 0; n < length[k]; n++) {
+            for (int i = 0; i < dim; i++) {
+                src[k][n][i] = 0.01 * (n * k * i) - 0.5;
+            }
+        }
+    }
+    FILE *fp;
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    fwrite_rnn_dataset(dim, 3, length, (const double* const* const*)src, fp);
+    fclose(fp);
+
+    mu_assert(is_rnn_dataset_file(filename));
+    init_target_reader(&t_reader);
+    mu_assert(map_target_file(&t_reader, filename) != -1);
+    mu_assert(map_target_file(&t_reader, filename) != -1);
+    assert_equal_int(dim, t_reader.dimension);
+    assert_equal_int(6, t_reader.num);
+    assert_equal_int(2, t_reader.dataset_num);
+    for (int k = 0; k < 6; k++) {
+        assert_equal_int(length[k % 3], t_reader.t_list[k].length);
+        assert_equal_int(1, t_reader.t_list[k].is_mapped);
+        assert_equal_pointer(NULL, t_reader.t_list[k].target);
+        assert_equal_memory(src[k % 3][0], sizeof(double) * length[k % 3] *
+                dim, t_reader.t_list[k].data, sizeof(double) * length[k % 3] *
+                dim);
+    }
+    set_target_rows(&t_reader);
+    for (int k = 0; k < 6; k++) {
+        for (int n = 0; n < length[k % 3]; n++) {
+            assert_equal_memory(src[k % 3][n], sizeof(double) * dim,
+                    t_reader.t_list[k].target[n], sizeof(double) * dim);
+        }
+    }
+    free_target_reader(&t_reader);
+
+    // dimension mismatch
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    fwrite_rnn_dataset(dim - 1, 1, length, (const double* const* const*)src,
+            fp);
+    fclose(fp);
+    init_target_reader(&t_reader);
+    t_reader.dimension = dim;
+    mu_assert(map_target_file(&t_reader, filename) == -1);
+    assert_equal_int(0, t_reader.num);
+    free_target_reader(&t_reader);
+
+    // text file
+    if ((fp = fopen(filename, "w")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "0.1\t0.2\n");
+    fclose(fp);
+    mu_assert(!is_rnn_dataset_file(filename));
+    init_target_reader(&t_reader);
+    mu_assert(map_target_file(&t_reader, filename) == -1);
+    free_target_reader(&t_reader);
+
+    remove(filename);
+    for (int k = 0; k < 3; k++) {
+        FREE2(src[k]);
+    }
+}
+
+/*
+ * an empty input, which rnn-convert writes with dimension 0, is read back as
+ * a dataset without series, while dimension 0 is rejected for any series
+ */
+static void test_map_empty_target_file (void)
+{
+    struct target_reader t_reader;
+    char filename[64];
+    snprintf(filename, sizeof(filename), "rnn-unit-test-%ld.bin",
+            (long)getpid());
+
+    FILE *fp;
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    init_target_reader(&t_reader);
+    t_reader.dimension = 0;
+    set_target_rows(&t_reader);
+    fwrite_target_dataset(&t_reader, 0, t_reader.num, fp);
+    free_target_reader(&t_reader);
+    fclose(fp);
+
+    mu_assert(is_rnn_dataset_file(filename));
+    init_target_reader(&t_reader);
+    mu_assert(map_target_file(&t_reader, filename) != -1);
+    assert_equal_int(0, t_reader.num);
+    assert_equal_int(-1, t_reader.dimension);
+    assert_equal_int(1, t_reader.dataset_num);
+    free_target_reader(&t_reader);
+
+    // the dimension of a dataset with series must be positive
+    const int length[] = {3};
+    double *row[3] = {NULL, NULL, NULL};
+    double **src[] = {row};
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        print_error_msg("cannot open %s", filename);
+        exit(EXIT_FAILURE);
+    }
+    fwrite_rnn_dataset(0, 1, length, (const double* const* const*)src, fp);
+    fclose(fp);
+    init_target_reader(&t_reader);
+    mu_assert(map_target_file(&t_reader, filename) == -1);
+    assert_equal_int(0, t_reader.num);
+    free_target_reader(&t_reader);
+
+    remove(filename);
+}
+
+
 void test_target (void)
 {
     mu_run_test(test_read_target_from_file);
+    mu_run_test(test_read_target_from_text_file);
+    mu_run_test(test_read_target_with_cache);
+    mu_run_test(test_read_target_files);
+    mu_run_test(test_map_target_file);
+    mu_run_test(test_map_empty_target_file);
 }
 
 